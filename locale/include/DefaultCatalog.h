@@ -65,6 +65,8 @@ struct _IMPEXP_LOCALE CatKey {
 	bool operator== (const CatKey& right) const;
 	status_t GetStringParts(BString* str, BString* ctx, BString* cmt) const;
 	static size_t HashFun(const char* s);
+	static size_t HashFun(const char* str, const char* ctx, const char* cmt);
+		// yields the same value as HashFun() for the complete key-string
 };
 
 /*
@@ -92,6 +94,10 @@ class _IMPEXP_LOCALE DefaultCatalog : public BCatalogAddOn {
 						const char *comment = NULL);
 		const char *GetString(uint32 id);
 		const char *GetString(const CatKey& key);
+		const char *GetString(const char *string, const char *context,
+						const char *comment, size_t hashVal);
+				// lookup with a hash-value that has been computed 
+				// beforehand by CatKey::HashFun(string, context, comment)
 		//
 		status_t SetString(const char *string, const char *translated, 
 					const char *context = NULL, const char *comment = NULL);
@@ -106,6 +112,9 @@ class _IMPEXP_LOCALE DefaultCatalog : public BCatalogAddOn {
 		status_t WriteToFile(const char *path = NULL);
 		status_t WriteToAttribute(entry_ref *appOrAddOnRef);
 		status_t WriteToResource(entry_ref *appOrAddOnRef);
+		status_t WriteIndexedToFile(const char *path = NULL);
+				// writes the catalog in the indexed format, which
+				// ReadFromFile() maps as it is instead of unflattening it
 		//
 		void MakeEmpty();
 		int32 CountItems() const;
@@ -125,9 +134,26 @@ class _IMPEXP_LOCALE DefaultCatalog : public BCatalogAddOn {
 		int32 ComputeFingerprint() const;
 		void UpdateAttributes(BFile& catalogFile);
 
+		status_t ReadIndexed(BFile& catalogFile, off_t size);
+		status_t FlattenIndexed(char **_image, size_t *_imageSize);
+		const char *GetIndexedString(size_t hashVal, const char *keyString,
+						const char *string = NULL, const char *context = NULL,
+						const char *comment = NULL) const;
+		void MakeMapFromIndex();
+		status_t MakeIndexFromMap();
+		void UnsetIndex();
+
 		typedef hash_map<CatKey, BString, hash<CatKey>, equal_to<CatKey> > CatMap;
 		CatMap 				fCatMap;
 		mutable BString 	fPath;
+		const char			*fIndex;
+			// the contents of an indexed catalog(-file); as long as it is set,
+			// all strings are looked up in there and fCatMap is empty
+		size_t				fIndexSize;
+		bool				fIndexIsMapped;
+		bool				fWantsIndex;
+			// set after unflattening, the first lookup by string then
+			// builds the index from fCatMap
 
 	public:
 		/*
@@ -186,6 +212,7 @@ DefaultCatalog::GetWalker(CatWalker *walker)
 {
 	if (!walker)
 		return B_BAD_VALUE;
+	MakeMapFromIndex();
 	*walker = CatWalker(fCatMap);
 	return B_OK;
 }		
@@ -49,6 +49,66 @@ getPrimaryChar(uint32 c)
 }
 
 
+static inline bool
+isAsciiAlNum(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+		|| (c >= '0' && c <= '9');
+}
+
+
+static inline bool
+hasZeroByte(uint32 word)
+{
+	return ((word - 0x01010101UL) & ~word & 0x80808080UL) != 0;
+}
+
+
+/** Advances both strings behind their common prefix - the collation of
+ *	identical characters is identical, so there is no need to look at them.
+ *	Both strings are left at the start of a UTF-8 character.
+ */
+
+static void
+skipCommonPrefix(const char **_a, const char **_b)
+{
+	const char *a = *_a;
+	const char *b = *_b;
+
+	if (((size_t)a & 3) == ((size_t)b & 3)) {
+		// both strings can be compared a word at a time; aligned words
+		// never cross a page boundary, so we won't read beyond the string
+		while (((size_t)a & 3) != 0 && *a == *b && *a != '\0') {
+			a++;
+			b++;
+		}
+		if (((size_t)a & 3) == 0) {
+			const uint32 *wordA = (const uint32 *)a;
+			const uint32 *wordB = (const uint32 *)b;
+			while (*wordA == *wordB && !hasZeroByte(*wordA)) {
+				wordA++;
+				wordB++;
+			}
+			a = (const char *)wordA;
+			b = (const char *)wordB;
+		}
+	}
+	while (*a == *b && *a != '\0') {
+		a++;
+		b++;
+	}
+
+	// go back to the start of the character that differs
+	while (a > *_a && (((uint8)*a & 0xc0) == 0x80 || ((uint8)*b & 0xc0) == 0x80)) {
+		a--;
+		b--;
+	}
+
+	*_a = a;
+	*_b = b;
+}
+
+
 BCollatorAddOn::input_context::input_context(bool ignorePunctuation)
 	:
 	ignore_punctuation(ignorePunctuation),
@@ -384,76 +444,68 @@ BCollatorAddOn::Compare(const char *a, const char *b, int32 length, int8 strengt
 		ignorePunctuation = false;
 	}
 
+	if (strength != B_COLLATE_PRIMARY && strength != B_COLLATE_SECONDARY
+		&& strength != B_COLLATE_TERTIARY && strength != B_COLLATE_QUATERNARY)
+		return strncmp(a, b, length);
+
+	// subclasses may combine several characters into one, so we can only
+	// take shortcuts if we know how GetNextChar() works
+	bool plainCollator = typeid(*this) == typeid(BCollatorAddOn);
+	if (plainCollator && length == 0x7fffffff)
+		skipCommonPrefix(&a, &b);
+
 	input_context contextA(ignorePunctuation);
 	input_context contextB(ignorePunctuation);
 
-	switch (strength) {
-		case B_COLLATE_PRIMARY:
-		{
-			for (int32 i = 0; i < length; i++) {
-				uint32 charA = GetNextChar(&a, contextA);
-				uint32 charB = GetNextChar(&b, contextB);
-				if (charA == 0)
-					return charB == 0 ? 0 : -(int32)charB;
-				else if (charB == 0)
-					return (int32)charA;
-
-				charA = getPrimaryChar(charA);
-				charB = getPrimaryChar(charB);
-
-				if (charA != charB)
-					return (int32)charA - (int32)charB;
-			}
-			return 0;
+	// All levels are compared in a single pass: diacriticals and case can
+	// only change the order between strings that are equal otherwise, so
+	// we just remember the first difference of each kind along the way.
+	int32 secondary = 0;
+	int32 tertiary = 0;
+
+	for (int32 i = 0; i < length; i++) {
+		uint32 charA, charB;
+		if (plainCollator && isAsciiAlNum(*a) && isAsciiAlNum(*b)
+			&& contextA.next_char == 0 && contextB.next_char == 0) {
+			// letters and digits are neither punctuation nor substituted
+			charA = *a++;
+			charB = *b++;
+		} else {
+			charA = GetNextChar(&a, contextA);
+			charB = GetNextChar(&b, contextB);
 		}
 
-		case B_COLLATE_SECONDARY:
-		{
-			// diacriticals can only change the order between equal strings
-			int32 compare = Compare(a, b, length, B_COLLATE_PRIMARY, ignorePunctuation);
-			if (compare != 0)
-				return compare;
-
-			for (int32 i = 0; i < length; i++) {
-				uint32 charA = BUnicodeChar::ToLower(GetNextChar(&a, contextA));
-				uint32 charB = BUnicodeChar::ToLower(GetNextChar(&b, contextB));
-
-				// the two strings does have the same size when we get here
-				if (charA == 0)
-					return 0;
-
-				if (charA != charB)
-					return (int32)charA - (int32)charB;
-			}
-			return 0;
+		if (charA == 0) {
+			if (charB != 0)
+				return -(int32)charB;
+			break;
+		} else if (charB == 0)
+			return (int32)charA;
+
+		if (charA == charB)
+			continue;
+
+		uint32 primaryA = getPrimaryChar(charA);
+		uint32 primaryB = getPrimaryChar(charB);
+		if (primaryA != primaryB)
+			return (int32)primaryA - (int32)primaryB;
+
+		if (tertiary == 0)
+			tertiary = (int32)charA - (int32)charB;
+		if (secondary == 0) {
+			uint32 lowerA = BUnicodeChar::ToLower(charA);
+			uint32 lowerB = BUnicodeChar::ToLower(charB);
+			if (lowerA != lowerB)
+				secondary = (int32)lowerA - (int32)lowerB;
 		}
+	}
 
-		case B_COLLATE_TERTIARY:
-		case B_COLLATE_QUATERNARY:
-		{
-			// diacriticals can only change the order between equal strings
-			int32 compare = Compare(a, b, length, B_COLLATE_PRIMARY, ignorePunctuation);
-			if (compare != 0)
-				return compare;
-
-			for (int32 i = 0; i < length; i++) {
-				uint32 charA = GetNextChar(&a, contextA);
-				uint32 charB = GetNextChar(&b, contextB);
-
-				// the two strings does have the same size when we get here
-				if (charA == 0)
-					return 0;
+	if (strength == B_COLLATE_SECONDARY)
+		return secondary;
+	if (strength >= B_COLLATE_TERTIARY)
+		return tertiary;
 
-				if (charA != charB)
-					return (int32)charA - (int32)charB;
-			}
-			return 0;
-		}
-
-		case B_COLLATE_IDENTICAL:
-		default:
-			return strncmp(a, b, length);
-	}
+	return 0;
 }
 
 
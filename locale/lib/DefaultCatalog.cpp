@@ -5,7 +5,13 @@
 
 
 #include <memory>
+#include <stdlib.h>
 #include <syslog.h>
+#ifdef __HAIKU__
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
 
 #include <Application.h>
 #include <DataIO.h>
@@ -149,6 +155,59 @@ size_t CatKey::HashFun(const char* s) {
 }
 
 
+/*
+ * computes the same hash-value as HashFun() would for the key-string 
+ * made up from the given parts, but without building that string.
+ */
+size_t CatKey::HashFun(const char* str, const char* ctx, const char* cmt) {
+	unsigned long h = 0; 
+	if (str) {
+		for ( ; *str; ++str)
+			h = 5*h + *str;
+	}
+	h = 5*h + kSeparator;
+	if (ctx) {
+		for ( ; *ctx; ++ctx)
+			h = 5*h + *ctx;
+	}
+	h = 5*h + kSeparator;
+	if (cmt) {
+		for ( ; *cmt; ++cmt)
+			h = 5*h + *cmt;
+	}
+
+	return size_t(h); 
+}
+
+
+/*
+ * compares the given key-string with the key-string that would be made up
+ * from the given parts.
+ */
+static bool
+KeyMatchesParts(const char *key, const char *str, const char *ctx, 
+	const char *cmt)
+{
+	if (str) {
+		while (*str && *key == *str)
+			key++, str++;
+		if (*str)
+			return false;
+	}
+	if (*key++ != kSeparator)
+		return false;
+	if (ctx) {
+		while (*ctx && *key == *ctx)
+			key++, ctx++;
+		if (*ctx)
+			return false;
+	}
+	if (*key++ != kSeparator)
+		return false;
+	return strcmp(key, cmt ? cmt : "") == 0;
+}
+
+
 static const char *kCatFolder = "catalogs";
 static const char *kCatExtension = ".catalog";
 
@@ -159,6 +218,54 @@ static int16 kCatArchiveVersion = 1;
 	// version of the catalog archive structure, bump this if you change it!
 
 
+/*
+ * Layout of an indexed catalog-file, all values are stored little-endian:
+ * the header is followed by an open-addressing hash-table with fTableSize
+ * slots (the slot for a key is found by probing linearly from its hash-value)
+ * and a pool of zero-terminated strings that the slots point into.
+ * Such a file is used as it is, nothing gets copied into the CatMap.
+ */
+static const uint32 kIndexedCatMagic = 'LCix';
+static const uint32 kIndexedCatVersion = 1;
+static const uint32 kEmptySlot = 0xffffffffUL;
+
+struct IndexedCatHeader {
+	uint32 fMagic;
+	uint32 fVersion;
+	int32 fFingerprint;
+	uint32 fCount;
+	uint32 fTableSize;
+		// always a power of two
+	uint32 fLanguageOffset;
+	uint32 fSignatureOffset;
+		// offsets into the string-pool
+	uint32 fPoolSize;
+};
+
+struct IndexedCatSlot {
+	uint32 fHashVal;
+	uint32 fKeyOffset;
+		// kEmptySlot for unused slots
+	uint32 fValueOffset;
+};
+
+
+static inline const IndexedCatSlot *
+IndexedCatTable(const char *index)
+{
+	return reinterpret_cast<const IndexedCatSlot *>(
+		index + sizeof(IndexedCatHeader));
+}
+
+
+static inline const char *
+IndexedCatPool(const char *index, uint32 tableSize)
+{
+	return index + sizeof(IndexedCatHeader) 
+		+ tableSize * sizeof(IndexedCatSlot);
+}
+
+
 /* 
  * constructs a DefaultCatalog with given signature and language and reads
  * the catalog from disk.
@@ -168,7 +275,11 @@ static int16 kCatArchiveVersion = 1;
 DefaultCatalog::DefaultCatalog(const char *signature, const char *language,
 	int32 fingerprint)
 	:
-	BCatalogAddOn(signature, language, fingerprint)
+	BCatalogAddOn(signature, language, fingerprint),
+	fIndex(NULL),
+	fIndexSize(0),
+	fIndexIsMapped(false),
+	fWantsIndex(false)
 {
 	// give highest priority to catalog living in sub-folder of app's folder:
 	app_info appInfo;
@@ -228,7 +339,11 @@ DefaultCatalog::DefaultCatalog(const char *signature, const char *language,
  */
 DefaultCatalog::DefaultCatalog(entry_ref *appOrAddOnRef)
 	:
-	BCatalogAddOn("", "", 0)
+	BCatalogAddOn("", "", 0),
+	fIndex(NULL),
+	fIndexSize(0),
+	fIndexIsMapped(false),
+	fWantsIndex(false)
 {
 	fInitCheck = ReadFromResource(appOrAddOnRef);
 	log_team(LOG_DEBUG, 
@@ -246,7 +361,11 @@ DefaultCatalog::DefaultCatalog(const char *path, const char *signature,
 	const char *language)
 	:
 	BCatalogAddOn(signature, language, 0),
-	fPath(path)
+	fPath(path),
+	fIndex(NULL),
+	fIndexSize(0),
+	fIndexIsMapped(false),
+	fWantsIndex(false)
 {
 	fInitCheck = B_OK;
 }
@@ -254,6 +373,7 @@ DefaultCatalog::DefaultCatalog(const char *path, const char *signature,
 
 DefaultCatalog::~DefaultCatalog()
 {
+	UnsetIndex();
 }
 
 
@@ -279,6 +399,15 @@ DefaultCatalog::ReadFromFile(const char *path)
 		log_team(LOG_ERR, "couldn't get size for catalog-file %s", path);
 		return res;
 	}
+
+	uint32 magic;
+	if (catalogFile.ReadAt(0, &magic, sizeof(magic)) == sizeof(magic)
+		&& B_LENDIAN_TO_HOST_INT32(magic) == kIndexedCatMagic) {
+		res = ReadIndexed(catalogFile, sz);
+		if (res == B_OK)
+			UpdateAttributes(catalogFile);
+		return res;
+	}
 	
 	auto_ptr<char> buf(new char [sz]);
 	res = catalogFile.Read(buf.get(), sz);
@@ -480,9 +609,335 @@ DefaultCatalog::WriteToResource(entry_ref *appOrAddOnRef)
 }
 
 
+/*
+ * writes the catalog as an indexed catalog-file (see IndexedCatHeader).
+ */
+status_t
+DefaultCatalog::WriteIndexedToFile(const char *path)
+{
+	BFile catalogFile;
+	if (path)
+		fPath = path;
+	status_t res = catalogFile.SetTo(fPath.String(),
+		B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	if (res != B_OK)
+		return res;
+
+	UpdateFingerprint();
+		// make sure we have the correct fingerprint before we flatten it
+	char *image;
+	size_t imageSize;
+	res = FlattenIndexed(&image, &imageSize);
+	if (res != B_OK)
+		return res;
+
+	ssize_t written = catalogFile.Write(image, imageSize);
+	free(image);
+	if (written != (ssize_t)imageSize)
+		return B_FILE_ERROR;
+
+	// set mimetype-, language- and signature-attributes:
+	UpdateAttributes(catalogFile);
+	// finally write fingerprint:
+	catalogFile.WriteAttr(BLocaleRoster::kCatFingerprintAttr, B_INT32_TYPE, 
+		0, &fFingerprint, sizeof(int32));
+	return B_OK;
+}
+
+
+/*
+ * builds the complete image of an indexed catalog in a single malloc()ed 
+ * buffer, which is handed over to the caller. The size of the string-pool
+ * is computed beforehand, so every string is copied exactly once.
+ */
+status_t
+DefaultCatalog::FlattenIndexed(char **_image, size_t *_imageSize)
+{
+	MakeMapFromIndex();
+
+	// keep the table at most half full, so that probe-sequences stay short
+	uint32 count = fCatMap.size();
+	uint32 tableSize = 16;
+	while (tableSize < 2 * count)
+		tableSize *= 2;
+
+	size_t poolSize = fLanguageName.Length() + 1 + fSignature.Length() + 1;
+	CatMap::const_iterator iter;
+	for (iter = fCatMap.begin(); iter != fCatMap.end(); ++iter)
+		poolSize += iter->first.fKey.Length() + 1 + iter->second.Length() + 1;
+
+	size_t tableBytes = tableSize * sizeof(IndexedCatSlot);
+	size_t imageSize = sizeof(IndexedCatHeader) + tableBytes + poolSize;
+	char *image = (char *)malloc(imageSize);
+	if (!image)
+		return B_NO_MEMORY;
+
+	IndexedCatSlot *table = reinterpret_cast<IndexedCatSlot *>(
+		image + sizeof(IndexedCatHeader));
+	for (uint32 i = 0; i < tableSize; ++i)
+		table[i].fKeyOffset = B_HOST_TO_LENDIAN_INT32(kEmptySlot);
+
+	char *pool = image + sizeof(IndexedCatHeader) + tableBytes;
+	uint32 poolPos = 0;
+	uint32 languageOffset = poolPos;
+	memcpy(pool + poolPos, fLanguageName.String(), fLanguageName.Length() + 1);
+	poolPos += fLanguageName.Length() + 1;
+	uint32 signatureOffset = poolPos;
+	memcpy(pool + poolPos, fSignature.String(), fSignature.Length() + 1);
+	poolPos += fSignature.Length() + 1;
+
+	for (iter = fCatMap.begin(); iter != fCatMap.end(); ++iter) {
+		uint32 hashVal = iter->first.fHashVal;
+		uint32 slot = hashVal & (tableSize - 1);
+		while (table[slot].fKeyOffset != B_HOST_TO_LENDIAN_INT32(kEmptySlot))
+			slot = (slot + 1) & (tableSize - 1);
+
+		IndexedCatSlot &entry = table[slot];
+		entry.fHashVal = B_HOST_TO_LENDIAN_INT32(hashVal);
+		entry.fKeyOffset = B_HOST_TO_LENDIAN_INT32(poolPos);
+		memcpy(pool + poolPos, iter->first.fKey.String(), 
+			iter->first.fKey.Length() + 1);
+		poolPos += iter->first.fKey.Length() + 1;
+		entry.fValueOffset = B_HOST_TO_LENDIAN_INT32(poolPos);
+		memcpy(pool + poolPos, iter->second.String(), 
+			iter->second.Length() + 1);
+		poolPos += iter->second.Length() + 1;
+	}
+
+	IndexedCatHeader *header = reinterpret_cast<IndexedCatHeader *>(image);
+	header->fMagic = B_HOST_TO_LENDIAN_INT32(kIndexedCatMagic);
+	header->fVersion = B_HOST_TO_LENDIAN_INT32(kIndexedCatVersion);
+	header->fFingerprint = B_HOST_TO_LENDIAN_INT32(fFingerprint);
+	header->fCount = B_HOST_TO_LENDIAN_INT32(count);
+	header->fTableSize = B_HOST_TO_LENDIAN_INT32(tableSize);
+	header->fLanguageOffset = B_HOST_TO_LENDIAN_INT32(languageOffset);
+	header->fSignatureOffset = B_HOST_TO_LENDIAN_INT32(signatureOffset);
+	header->fPoolSize = B_HOST_TO_LENDIAN_INT32(poolSize);
+
+	*_image = image;
+	*_imageSize = imageSize;
+	return B_OK;
+}
+
+
+/*
+ * turns the contents of fCatMap into an index that is kept in memory, such
+ * that lookups needn't allocate anything (see GetString()). This is done
+ * on the first lookup that can use the index, not when the catalog is loaded.
+ */
+status_t
+DefaultCatalog::MakeIndexFromMap()
+{
+	fWantsIndex = false;
+	if (fIndex)
+		return B_OK;
+
+	char *index;
+	size_t indexSize;
+	status_t res = FlattenIndexed(&index, &indexSize);
+	if (res != B_OK)
+		return res;
+
+	fCatMap.clear();
+	fIndex = index;
+	fIndexSize = indexSize;
+	fIndexIsMapped = false;
+	return B_OK;
+}
+
+
+/*
+ * makes the given indexed catalog-file available for lookups. Where
+ * possible the file is mapped into memory, otherwise it is read in one go.
+ * Either way, the strings are used right where they are.
+ */
+status_t
+DefaultCatalog::ReadIndexed(BFile& catalogFile, off_t size)
+{
+	fWantsIndex = false;
+	UnsetIndex();
+	fCatMap.clear();
+
+	if (size < (off_t)sizeof(IndexedCatHeader)) {
+		log_team(LOG_ERR, "indexed catalog-file %s is truncated", 
+			fPath.String());
+		return B_BAD_DATA;
+	}
+
+	const char *index = NULL;
+	bool isMapped = false;
+#ifdef __HAIKU__
+	int fd = open(fPath.String(), O_RDONLY);
+	if (fd >= 0) {
+		void *address = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (address != MAP_FAILED) {
+			index = (const char *)address;
+			isMapped = true;
+		}
+	}
+#endif
+	if (index == NULL) {
+		char *buf = (char *)malloc(size);
+		if (!buf)
+			return B_NO_MEMORY;
+		ssize_t bytesRead = catalogFile.ReadAt(0, buf, size);
+		if (bytesRead < size) {
+			log_team(LOG_ERR, "couldn't read from catalog-file %s", 
+				fPath.String());
+			free(buf);
+			return bytesRead < B_OK ? bytesRead : B_BAD_DATA;
+		}
+		index = buf;
+	}
+	fIndex = index;
+	fIndexSize = size;
+	fIndexIsMapped = isMapped;
+
+	// check the table, so that lookups needn't care
+	const IndexedCatHeader *header 
+		= reinterpret_cast<const IndexedCatHeader *>(fIndex);
+	uint32 tableSize = B_LENDIAN_TO_HOST_INT32(header->fTableSize);
+	uint32 poolSize = B_LENDIAN_TO_HOST_INT32(header->fPoolSize);
+	bool valid = B_LENDIAN_TO_HOST_INT32(header->fVersion) == kIndexedCatVersion
+		&& tableSize > 0 && (tableSize & (tableSize - 1)) == 0
+		&& tableSize < (fIndexSize / sizeof(IndexedCatSlot))
+		&& poolSize > 0
+		&& sizeof(IndexedCatHeader) + tableSize * sizeof(IndexedCatSlot)
+			+ poolSize == fIndexSize;
+	const char *pool = IndexedCatPool(fIndex, tableSize);
+	valid = valid && pool[poolSize - 1] == '\0'
+		&& B_LENDIAN_TO_HOST_INT32(header->fLanguageOffset) < poolSize
+		&& B_LENDIAN_TO_HOST_INT32(header->fSignatureOffset) < poolSize;
+
+	const IndexedCatSlot *table = IndexedCatTable(fIndex);
+	uint32 usedSlots = 0;
+	for (uint32 i = 0; valid && i < tableSize; ++i) {
+		uint32 keyOffset = B_LENDIAN_TO_HOST_INT32(table[i].fKeyOffset);
+		if (keyOffset == kEmptySlot)
+			continue;
+		usedSlots++;
+		valid = keyOffset < poolSize
+			&& B_LENDIAN_TO_HOST_INT32(table[i].fValueOffset) < poolSize;
+	}
+	if (!valid || usedSlots != B_LENDIAN_TO_HOST_INT32(header->fCount)
+		|| usedSlots == tableSize) {
+		log_team(LOG_WARNING, "indexed catalog-file %s is corrupted, "
+			"so this catalog is skipped.", fPath.String());
+		UnsetIndex();
+		return B_BAD_DATA;
+	}
+
+	fLanguageName = pool + B_LENDIAN_TO_HOST_INT32(header->fLanguageOffset);
+	fSignature = pool + B_LENDIAN_TO_HOST_INT32(header->fSignatureOffset);
+	int32 foundFingerprint = B_LENDIAN_TO_HOST_INT32(header->fFingerprint);
+
+	// same as in Unflatten(): a requested fingerprint has to match 
+	if (foundFingerprint != 0 && fFingerprint != 0 
+		&& foundFingerprint != fFingerprint) {
+		log_team(LOG_INFO, "default-catalog(sig=%s, lang=%s) "
+			"has mismatching fingerprint (%ld instead of the requested %ld), "
+			"so this catalog is skipped.",
+			fSignature.String(), fLanguageName.String(), foundFingerprint,
+			fFingerprint);
+		UnsetIndex();
+		return B_MISMATCHED_VALUES;
+	}
+	fFingerprint = foundFingerprint;
+
+	return B_OK;
+}
+
+
+/*
+ * looks up the given key in the index. The key is either given as a
+ * complete key-string or as its parts (with keyString being NULL).
+ */
+const char *
+DefaultCatalog::GetIndexedString(size_t hashVal, const char *keyString,
+	const char *string, const char *context, const char *comment) const
+{
+	const IndexedCatHeader *header 
+		= reinterpret_cast<const IndexedCatHeader *>(fIndex);
+	uint32 tableSize = B_LENDIAN_TO_HOST_INT32(header->fTableSize);
+	const IndexedCatSlot *table = IndexedCatTable(fIndex);
+	const char *pool = IndexedCatPool(fIndex, tableSize);
+
+	// the table is never full, so we will hit an empty slot eventually
+	uint32 hash = hashVal;
+	for (uint32 slot = hash & (tableSize - 1); ; 
+			slot = (slot + 1) & (tableSize - 1)) {
+		uint32 keyOffset = B_LENDIAN_TO_HOST_INT32(table[slot].fKeyOffset);
+		if (keyOffset == kEmptySlot)
+			return NULL;
+		if (B_LENDIAN_TO_HOST_INT32(table[slot].fHashVal) != hash)
+			continue;
+		bool matches = keyString 
+			? strcmp(pool + keyOffset, keyString) == 0
+			: KeyMatchesParts(pool + keyOffset, string, context, comment);
+		if (matches)
+			return pool + B_LENDIAN_TO_HOST_INT32(table[slot].fValueOffset);
+	}
+}
+
+
+/*
+ * copies the contents of an indexed catalog into fCatMap, such that it can
+ * be changed (or written in another format).
+ */
+void
+DefaultCatalog::MakeMapFromIndex()
+{
+	fWantsIndex = false;
+	if (!fIndex)
+		return;
+
+	const IndexedCatHeader *header 
+		= reinterpret_cast<const IndexedCatHeader *>(fIndex);
+	uint32 tableSize = B_LENDIAN_TO_HOST_INT32(header->fTableSize);
+	const IndexedCatSlot *table = IndexedCatTable(fIndex);
+	const char *pool = IndexedCatPool(fIndex, tableSize);
+
+	fCatMap.clear();
+	CatKey key;
+	for (uint32 i = 0; i < tableSize; ++i) {
+		uint32 keyOffset = B_LENDIAN_TO_HOST_INT32(table[i].fKeyOffset);
+		if (keyOffset == kEmptySlot)
+			continue;
+		key.fKey = pool + keyOffset;
+		key.fHashVal = B_LENDIAN_TO_HOST_INT32(table[i].fHashVal);
+		fCatMap.insert(pair<const BPrivate::CatKey, BString>(key, 
+			pool + B_LENDIAN_TO_HOST_INT32(table[i].fValueOffset)));
+	}
+
+	UnsetIndex();
+}
+
+
+void
+DefaultCatalog::UnsetIndex()
+{
+	if (!fIndex)
+		return;
+
+#ifdef __HAIKU__
+	if (fIndexIsMapped)
+		munmap(const_cast<char *>(fIndex), fIndexSize);
+	else
+#endif
+		free(const_cast<char *>(fIndex));
+
+	fIndex = NULL;
+	fIndexSize = 0;
+	fIndexIsMapped = false;
+}
+
+
 void
 DefaultCatalog::MakeEmpty()
 {
+	fWantsIndex = false;
+	UnsetIndex();
 	fCatMap.clear();
 }
 
@@ -490,6 +945,10 @@ DefaultCatalog::MakeEmpty()
 int32
 DefaultCatalog::CountItems() const
 {
+	if (fIndex) {
+		return B_LENDIAN_TO_HOST_INT32(
+			reinterpret_cast<const IndexedCatHeader *>(fIndex)->fCount);
+	}
 	return fCatMap.size();
 }
 
@@ -498,6 +957,20 @@ const char *
 DefaultCatalog::GetString(const char *string, const char *context, 
 	const char *comment)
 {
+	return GetString(string, context, comment, 
+		CatKey::HashFun(string, context, comment));
+}
+
+
+const char *
+DefaultCatalog::GetString(const char *string, const char *context, 
+	const char *comment, size_t hashVal)
+{
+	if (fWantsIndex)
+		MakeIndexFromMap();
+	if (fIndex)
+		return GetIndexedString(hashVal, NULL, string, context, comment);
+
 	CatKey key(string, context, comment);
 	return GetString(key);
 }
@@ -506,6 +979,9 @@ DefaultCatalog::GetString(const char *string, const char *context,
 const char *
 DefaultCatalog::GetString(uint32 id)
 {
+	if (fIndex)
+		return GetIndexedString(id, "");
+
 	CatKey key(id);
 	return GetString(key);
 }
@@ -514,6 +990,9 @@ DefaultCatalog::GetString(uint32 id)
 const char *
 DefaultCatalog::GetString(const CatKey& key)
 {
+	if (fIndex)
+		return GetIndexedString(key.fHashVal, key.fKey.String());
+
 	CatMap::const_iterator iter = fCatMap.find(key);
 	if (iter != fCatMap.end())
 		return iter->second.String();
@@ -527,6 +1006,7 @@ DefaultCatalog::SetString(const char *string, const char *translated,
 	const char *context, const char *comment)
 {
 	CatKey key(string, context, comment);
+	MakeMapFromIndex();
 	fCatMap[key] = translated;
 		// overwrite existing element
 	return B_OK;
@@ -537,6 +1017,7 @@ status_t
 DefaultCatalog::SetString(int32 id, const char *translated)
 {
 	CatKey key(id);
+	MakeMapFromIndex();
 	fCatMap[key] = translated;
 		// overwrite existing element
 	return B_OK;
@@ -546,6 +1027,7 @@ DefaultCatalog::SetString(int32 id, const char *translated)
 status_t
 DefaultCatalog::SetString(const CatKey& key, const char *translated)
 {
+	MakeMapFromIndex();
 	fCatMap[key] = translated;
 		// overwrite existing element
 	return B_OK;
@@ -576,6 +1058,7 @@ DefaultCatalog::ComputeFingerprint() const
 void
 DefaultCatalog::UpdateFingerprint()
 {
+	MakeMapFromIndex();
 	fFingerprint = ComputeFingerprint();
 }
 
@@ -642,6 +1125,8 @@ DefaultCatalog::Flatten(BDataIO *dataIO)
 status_t
 DefaultCatalog::Unflatten(BDataIO *dataIO)
 {
+	fWantsIndex = false;
+	UnsetIndex();
 	fCatMap.clear();
 	int32 count = 0;
 	int16 version;
@@ -701,6 +1186,11 @@ DefaultCatalog::Unflatten(BDataIO *dataIO)
 			return B_BAD_DATA;
 		}
 	}
+	if (res == B_OK) {
+		// lookups are cheaper in the index, so the first one that can use
+		// it switches to that (as long as nobody changes the catalog):
+		fWantsIndex = count > 0;
+	}
 	return res;
 }
 
@@ -5,10 +5,12 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <typeinfo>
 #include <unistd.h>
 
 #include <Application.h>
+#include <OS.h>
 #include <StopWatch.h>
 
 #include <Catalog.h>
@@ -31,6 +33,9 @@ class CatalogSpeed {
 	public:
 		void TestCreation();
 		void TestLookup();
+		void TestHashedLookup();
+		void TestIndexedCreation();
+		void TestIndexedLookup();
 		void TestIdCreation();
 		void TestIdLookup();
 };
@@ -41,6 +46,19 @@ class CatalogSpeed {
 #define catName catSig".catalog"
 
 
+static size_t
+TeamMemory()
+{
+	// sums up the memory that is actually in use by all areas of this team
+	size_t ramSize = 0;
+	area_info info;
+	int32 cookie = 0;
+	while (get_next_area_info(0, &cookie, &info) == B_OK)
+		ramSize += info.ram_size;
+	return ramSize;
+}
+
+
 void
 CatalogSpeed::TestCreation()
 {
@@ -83,6 +101,7 @@ CatalogSpeed::TestLookup()
 {
 	BStopWatch watch("catalogSpeed", true);
 
+	size_t memoryBefore = TeamMemory();
 	BCatalog *cat = be_catalog = new BCatalog(catSig, "klingon");
 	
 	assert(cat != NULL);
@@ -90,6 +109,8 @@ CatalogSpeed::TestLookup()
 	watch.Suspend();
 	printf("\t%ld strings read from disk in  %9Ld usecs\n", 
 		cat->CountItems(), watch.ElapsedTime());
+	printf("\tcatalog uses                   %9lu bytes\n", 
+		TeamMemory() - memoryBefore);
 
 	watch.Reset();
 	watch.Resume();
@@ -104,6 +125,84 @@ CatalogSpeed::TestLookup()
 }
 
 
+void
+CatalogSpeed::TestHashedLookup()
+{
+	BCatalog *cat = be_catalog = new BCatalog(catSig, "klingon");
+	assert(cat != NULL);
+	assert(cat->InitCheck() == B_OK);
+	BPrivate::DefaultCatalog *defaultCat 
+		= dynamic_cast<BPrivate::DefaultCatalog*>(cat->CatalogAddOn());
+	assert(defaultCat != NULL);
+
+	size_t *hashes = new size_t [kNumStrings];
+	for (uint32 i = 0; i < kNumStrings; i++)
+		hashes[i] = BPrivate::CatKey::HashFun(strs[i].String(), TR_CONTEXT, NULL);
+
+	// the old way of looking up strings, which builds a key-object each time:
+	BStopWatch watch("catalogSpeed", true);
+	for (uint32 i = 0; i < kNumStrings; i++) {
+		BPrivate::CatKey key(strs[i].String(), TR_CONTEXT, NULL);
+		translated = defaultCat->GetString(key);
+	}
+	watch.Suspend();
+	printf("\tlooked up %lu keys in          %9Ld usecs\n", 
+		kNumStrings, watch.ElapsedTime());
+
+	// looking up with precomputed hash-values doesn't allocate anything:
+	watch.Reset();
+	watch.Resume();
+	for (uint32 i = 0; i < kNumStrings; i++) {
+		translated = defaultCat->GetString(strs[i].String(), TR_CONTEXT, NULL,
+			hashes[i]);
+	}
+	watch.Suspend();
+	assert(strcmp(translated, trls[kNumStrings - 1].String()) == 0);
+	printf("\tlooked up %lu hashed strings in%9Ld usecs\n", 
+		kNumStrings, watch.ElapsedTime());
+
+	delete [] hashes;
+	delete cat;
+}
+
+
+void
+CatalogSpeed::TestIndexedCreation()
+{
+	BStopWatch watch("catalogSpeed", true);
+	watch.Suspend();
+
+	status_t res;
+	system("mkdir -p ./locale/catalogs/"catSig);
+
+	BPrivate::EditableCatalog cat1("Default", catSig, "klingon");
+	assert(cat1.InitCheck() == B_OK);
+	for (uint32 i = 0; i < kNumStrings; i++) {
+		cat1.SetString(strs[i].String(), trls[i].String(), ctxs[i].String());
+	}
+
+	watch.Reset();
+	watch.Resume();
+	BPrivate::DefaultCatalog *defaultCat 
+		= dynamic_cast<BPrivate::DefaultCatalog*>(cat1.CatalogAddOn());
+	assert(defaultCat != NULL);
+	res = defaultCat->WriteIndexedToFile(
+		"./locale/catalogs/"catSig"/klingon.catalog");
+	assert(res == B_OK);
+	watch.Suspend();
+	printf("\t%ld strings written to disk in %9Ld usecs\n", 
+		cat1.CountItems(), watch.ElapsedTime());
+}
+
+
+void
+CatalogSpeed::TestIndexedLookup()
+{
+	// the indexed catalog is looked up with exactly the same code:
+	TestLookup();
+}
+
+
 void
 CatalogSpeed::TestIdCreation()
 {
@@ -192,6 +291,12 @@ main(int argc, char **argv)
 	printf("\t------------------------------------------------\n");
 	catSpeed.TestCreation();
 	catSpeed.TestLookup();
+	catSpeed.TestHashedLookup();
+	printf("\t------------------------------------------------\n");
+	printf("\tindexed catalog usage:\n");
+	printf("\t------------------------------------------------\n");
+	catSpeed.TestIndexedCreation();
+	catSpeed.TestIndexedLookup();
 	printf("\t------------------------------------------------\n");
 	printf("\tid-based catalog usage:\n");
 	printf("\t------------------------------------------------\n");
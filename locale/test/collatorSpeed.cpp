@@ -45,6 +45,39 @@ const char *kStrings[] = {
 const uint32 kNumStrings = sizeof(kStrings) / sizeof(kStrings[0]);
 const uint32 kIterations = 50000;
 
+// file names as they are typically found in a large folder
+const char *kAsciiStrings[] = {
+	"IMG_20031104_104512.jpg",
+	"IMG_20031104_104513.jpg",
+	"IMG_20031104_104613.jpg",
+	"img_20031104_104512.JPG",
+	"Makefile",
+	"makefile",
+	"README",
+	"ReadMe.txt",
+	"libtracker.so",
+	"libtranslation.so",
+	"Tracker-Settings",
+	"TrackerSettings",
+};
+const uint32 kNumAsciiStrings = sizeof(kAsciiStrings) / sizeof(kAsciiStrings[0]);
+
+const char *kLatin1Strings[] = {
+	"Übersicht über die Änderungen",
+	"Übersicht über die Anderungen",
+	"übersicht über die Änderungen",
+	"Fußball-Ergebnisse",
+	"Fussball-Ergebnisse",
+	"crème brûlée",
+	"creme brulee",
+	"Crème Brûlée",
+	"señor",
+	"senor",
+	"Ålesund",
+	"Åland",
+};
+const uint32 kNumLatin1Strings = sizeof(kLatin1Strings) / sizeof(kLatin1Strings[0]);
+
 
 void
 test(BCollator *collator, const char *name, int8 strength)
@@ -67,6 +100,40 @@ test(BCollator *collator, const char *name, int8 strength)
 }
 
 
+void
+testCompare(BCollator *collator, const char *name, const char **strings,
+	uint32 numStrings, int8 strength)
+{
+	collator->SetDefaultStrength(strength);
+
+	uint32 iterations = kIterations / 10;
+	BStopWatch watch(name, true);
+
+	for (uint32 j = 0; j < iterations; j++) {
+		for (uint32 a = 0; a < numStrings; a++) {
+			for (uint32 b = 0; b < numStrings; b++)
+				collator->Compare(strings[a], strings[b]);
+		}
+	}
+
+	watch.Suspend();
+	printf("\t%s%9Ld usecs, %6.1f ns/compare\n", name, watch.ElapsedTime(),
+		watch.ElapsedTime() * 1000.0 / (iterations * numStrings * numStrings));
+}
+
+
+void
+testCompare(BCollator *collator, const char *name, int8 strength)
+{
+	printf("  %s\n", name);
+	testCompare(collator, "ascii:     ", kAsciiStrings, kNumAsciiStrings,
+		strength);
+	testCompare(collator, "latin-1:   ", kLatin1Strings, kNumLatin1Strings,
+		strength);
+	testCompare(collator, "mixed:     ", kStrings, kNumStrings, strength);
+}
+
+
 void
 usage()
 {
@@ -133,6 +200,15 @@ main(int argc, char **argv)
 	test(collator, "quaternary:", B_COLLATE_QUATERNARY);
 	test(collator, "identical: ", B_COLLATE_IDENTICAL);
 
+	// test comparison speed
+
+	printf("%s, comparisons:\n", addon);
+	testCompare(collator, "primary:", B_COLLATE_PRIMARY);
+	testCompare(collator, "secondary:", B_COLLATE_SECONDARY);
+	testCompare(collator, "tertiary:", B_COLLATE_TERTIARY);
+	testCompare(collator, "quaternary:", B_COLLATE_QUATERNARY);
+	testCompare(collator, "identical:", B_COLLATE_IDENTICAL);
+
 	return 0;
 }
 
@@ -55,6 +55,8 @@ class Model;
 class BContainerWindow;
 class ModelMenuItem;
 class EntryListBase;
+class NavListing;
+class NavListingEntry;
 
 
 class TrackingHookData {
@@ -115,6 +117,14 @@ class BNavMenu : public BSlowMenu {
 			const BObjectList<BString> *typeslist = NULL,
 			TrackingHookData *hook = NULL);
 
+		static bool SetToVisibleEntry(Model *, const BEntry *, bool hideDotFiles);
+			// sets up the model for one entry of a folder being read; returns
+			// false if nav menus don't show the entry
+		static bool ResolveVisibleLink(Model *);
+			// resolves the model if it is a link that isn't resolved yet;
+			// returns false if the link target doesn't want to be shown,
+			// broken links are shown
+
 		TrackingHookData *InitTrackingHook(bool (*hookfunction)(BMenu *, void *),
 			const BMessenger *target, const BMessage *dragMessage);
 
@@ -127,6 +137,7 @@ class BNavMenu : public BSlowMenu {
 		void BuildVolumeMenu();
 
 		void AddOneItem(Model *);
+		bool AddNextCachedItem();
 		void AddRootItemsIfNeeded();
 		static void SetTrackingHookDeep(BMenu *, bool (*)(BMenu *, void *), void *);
 
@@ -141,6 +152,13 @@ class BNavMenu : public BSlowMenu {
 		EntryListBase *fContainer;
 		bool		fIteratingDesktop;
 
+		BObjectList<NavListingEntry> *fCachedEntries;
+		int32		fCachedIndex;
+			// the entries of a cached listing, already sorted, when the
+			// items are not read from fContainer
+		NavListing	*fPendingListing;
+			// what is read from fContainer, for the listing cache
+
 		const BObjectList<BString> *fTypesList;
 
 		TrackingHookData fTrackingHook;
@@ -0,0 +1,571 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+
+
+#include <AppFileInfo.h>
+#include <Debug.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <NodeMonitor.h>
+#include <Path.h>
+#include <String.h>
+
+#include <string.h>
+
+#include "AddOnRegistry.h"
+#include "AutoLock.h"
+#include "MimeTypes.h"
+#include "Model.h"
+#include "Tracker.h"
+#include "Utilities.h"
+
+
+const directory_which kAddOnDirectories[kAddOnDirectoryCount] = {
+	B_BEOS_ADDONS_DIRECTORY,
+	B_USER_ADDONS_DIRECTORY,
+	B_COMMON_ADDONS_DIRECTORY
+};
+	// in the order add-ons with the same name take precedence
+
+const char *kTrackerAddOnFolder = "Tracker";
+const uint32 kScanAddOns = 'Tsad';
+
+namespace BPrivate {
+
+class AddOnInfo {
+public:
+	AddOnInfo(int32 slot, int32 sequence, const entry_ref *, const node_ref *);
+	~AddOnInfo();
+
+	entry_ref fRef;
+	node_ref fEntryNode;
+		// the entry in the add-on folder, may be a symlink
+	node_ref fTargetNode;
+		// what the entry resolves to, same as fEntryNode unless it is a link
+	Model *fModel;
+		// NULL unless the entry resolves to an executable
+	int32 fSlot;
+	int32 fSequence;
+	char fName[B_FILE_NAME_LENGTH];
+	uint32 fShortcut;
+	bool fAnyType;
+	bool fPrimary;
+		// scratch, used while matching types in EachAddOn
+};
+
+}	// namespace BPrivate
+
+
+AddOnRegistry *AddOnRegistry::sAddOnRegistry = NULL;
+
+
+void
+BPrivate::StripShortcut(const Model *model, char *result, uint32 &shortcut)
+{
+	strcpy(result, model->Name());
+
+	// check if there is a shortcut
+	uint32 length = strlen(result);
+	shortcut = '\0';
+	if (result[length - 2] == '-') {
+		shortcut = result[length - 1];
+		result[length - 2] = '\0';
+	}
+}
+
+
+AddOnInfo::AddOnInfo(int32 slot, int32 sequence, const entry_ref *ref,
+	const node_ref *node)
+	:	fRef(*ref),
+		fEntryNode(*node),
+		fTargetNode(*node),
+		fModel(NULL),
+		fSlot(slot),
+		fSequence(sequence),
+		fShortcut(0),
+		fAnyType(false),
+		fPrimary(false)
+{
+	fName[0] = '\0';
+}
+
+
+AddOnInfo::~AddOnInfo()
+{
+	delete fModel;
+}
+
+
+//	#pragma mark -
+
+
+AddOnRegistry::AddOnRegistry()
+	:	BLooper("AddOnRegistry", B_LOW_PRIORITY),
+		fAddOns(20, true),
+		fAnyTypeAddOns(20, false),
+		fNextSequence(0),
+		fScanned(false)
+{
+	for (int32 slot = 0; slot < kAddOnDirectoryCount; slot++) {
+		fDirectories[slot].device = -1;
+		fParents[slot].device = -1;
+	}
+
+	// get the scan out of the way before the first menu asks for it
+	PostMessage(kScanAddOns);
+}
+
+
+AddOnRegistry::~AddOnRegistry()
+{
+	stop_watching(this);
+}
+
+
+static int
+CompareAddOns(const AddOnInfo *addOn1, const AddOnInfo *addOn2)
+{
+	if (addOn1->fSlot != addOn2->fSlot)
+		return addOn1->fSlot - addOn2->fSlot;
+
+	return addOn1->fSequence - addOn2->fSequence;
+}
+
+
+static void
+AddMatch(BObjectList<AddOnInfo> *matches, AddOnInfo *addOn, bool primary)
+{
+	if (matches->HasItem(addOn)) {
+		addOn->fPrimary |= primary;
+		return;
+	}
+
+	addOn->fPrimary = primary;
+	matches->AddItem(addOn);
+}
+
+
+void
+AddOnRegistry::EachAddOn(const BObjectList<BString> *mimeTypes,
+	bool (*eachAddOn)(const Model *, const char *, uint32, bool, void *),
+	void *passThru)
+{
+	AutoLock<BLooper> lock(this);
+	if (!lock)
+		return;
+
+	if (!fScanned)
+		ScanAll();
+
+	BObjectList<AddOnInfo> matches(20, false);
+
+	int32 count = mimeTypes->CountItems();
+	if (!count) {
+		for (int32 index = 0; index < fAddOns.CountItems(); index++) {
+			AddOnInfo *addOn = fAddOns.ItemAt(index);
+			if (addOn->fModel)
+				AddMatch(&matches, addOn, false);
+		}
+	} else {
+		for (int32 index = 0; index < fAnyTypeAddOns.CountItems(); index++)
+			AddMatch(&matches, fAnyTypeAddOns.ItemAt(index), false);
+
+		for (int32 index = 0; index < count; index++) {
+			// the index is keyed by lower case types, types are not case
+			// sensitive
+			BString type(*mimeTypes->ItemAt(index));
+			type.ToLower();
+
+			for (int32 pass = 0; pass < 2; pass++) {
+				// exact matches make primary add-ons, supertype matches
+				// secondary ones
+				const char *key = FindInternedMimeString(type.String());
+				if (key) {
+					std::pair<TypeIndex::iterator, TypeIndex::iterator> range
+						= fTypeIndex.equal_range(key);
+					for (TypeIndex::iterator iterator = range.first;
+						iterator != range.second; iterator++)
+						AddMatch(&matches, iterator->second, pass == 0);
+				}
+
+				int32 slash = type.FindFirst('/');
+				if (slash <= 0)
+					break;
+				type.Truncate(slash);
+			}
+		}
+	}
+
+	matches.SortItems(CompareAddOns);
+
+	count = matches.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		AddOnInfo *addOn = matches.ItemAt(index);
+
+		// do a uniqueness check
+		int32 earlier = 0;
+		for (; earlier < index; earlier++) {
+			if (!strcmp(matches.ItemAt(earlier)->fName, addOn->fName))
+				break;
+		}
+		if (earlier < index)
+			continue;
+
+		if ((eachAddOn)(addOn->fModel, addOn->fName, addOn->fShortcut,
+				addOn->fPrimary, passThru))
+			break;
+	}
+}
+
+
+void
+AddOnRegistry::MessageReceived(BMessage *message)
+{
+	if (message->what == kScanAddOns) {
+		if (!fScanned)
+			ScanAll();
+		return;
+	}
+
+	if (message->what != B_NODE_MONITOR) {
+		_inherited::MessageReceived(message);
+		return;
+	}
+
+	node_ref node;
+	node_ref directory;
+	const char *name;
+	message->FindInt32("device", &node.device);
+	message->FindInt64("node", &node.node);
+	directory.device = node.device;
+
+	switch (message->FindInt32("opcode")) {
+		case B_ENTRY_MOVED:
+			// a move is a removal from the old folder and an addition
+			// to the new one
+			if (message->FindInt64("from directory", &directory.node) == B_OK)
+				EntryRemoved(&directory, &node);
+
+			if (message->FindInt64("to directory", &directory.node) == B_OK
+				&& message->FindString("name", &name) == B_OK)
+				EntryCreated(&directory, name);
+			break;
+
+		case B_ENTRY_CREATED:
+			if (message->FindInt64("directory", &directory.node) == B_OK
+				&& message->FindString("name", &name) == B_OK)
+				EntryCreated(&directory, name);
+			break;
+
+		case B_ENTRY_REMOVED:
+			if (message->FindInt64("directory", &directory.node) == B_OK)
+				EntryRemoved(&directory, &node);
+			break;
+
+		case B_STAT_CHANGED:
+		case B_ATTR_CHANGED:
+			// the add-on may have been rebuilt or have changed its
+			// supported types
+			Refresh(&node);
+			break;
+	}
+}
+
+
+void
+AddOnRegistry::EntryCreated(const node_ref *directory, const char *name)
+{
+	int32 slot = DirectorySlot(directory);
+	if (slot >= 0) {
+		entry_ref ref(directory->device, directory->node, name);
+		AddAddOn(slot, &ref);
+		return;
+	}
+
+	if (strcmp(name, kTrackerAddOnFolder) != 0)
+		return;
+
+	// a Tracker folder showed up in one of the add-on folders
+	for (slot = 0; slot < kAddOnDirectoryCount; slot++) {
+		if (fParents[slot] == *directory)
+			ScanDirectory(slot);
+	}
+}
+
+
+void
+AddOnRegistry::EntryRemoved(const node_ref *directory, const node_ref *node)
+{
+	bool tracker = false;
+	for (int32 slot = 0; slot < kAddOnDirectoryCount; slot++) {
+		if (fDirectories[slot] == *node) {
+			ForgetDirectory(slot);
+			tracker = true;
+		}
+	}
+	if (tracker)
+		return;
+
+	if (DirectorySlot(directory) >= 0) {
+		AddOnInfo *addOn = FindEntry(node);
+		if (addOn) {
+			RemoveAddOn(addOn);
+			return;
+		}
+	}
+
+	// a link target went away
+	Refresh(node);
+}
+
+
+void
+AddOnRegistry::ScanAll()
+{
+	for (int32 slot = 0; slot < kAddOnDirectoryCount; slot++)
+		ScanDirectory(slot);
+
+	fScanned = true;
+}
+
+
+void
+AddOnRegistry::ScanDirectory(int32 slot)
+{
+	ForgetDirectory(slot);
+
+	BPath path;
+	if (find_directory(kAddOnDirectories[slot], &path) != B_OK)
+		return;
+
+	BDirectory parent(path.Path());
+	if (parent.InitCheck() != B_OK)
+		return;
+
+	// watch the add-on folder too, to find out when a Tracker folder
+	// gets created in there
+	parent.GetNodeRef(&fParents[slot]);
+	TTracker::WatchNode(&fParents[slot], B_WATCH_DIRECTORY, this);
+
+	BDirectory dir(&parent, kTrackerAddOnFolder);
+	if (dir.InitCheck() != B_OK)
+		return;
+
+	dir.GetNodeRef(&fDirectories[slot]);
+	TTracker::WatchNode(&fDirectories[slot], B_WATCH_DIRECTORY, this);
+
+	entry_ref ref;
+	while (dir.GetNextRef(&ref) == B_OK)
+		AddAddOn(slot, &ref);
+}
+
+
+void
+AddOnRegistry::ForgetDirectory(int32 slot)
+{
+	for (int32 index = fAddOns.CountItems() - 1; index >= 0; index--) {
+		AddOnInfo *addOn = fAddOns.ItemAt(index);
+		if (addOn->fSlot == slot)
+			RemoveAddOn(addOn);
+	}
+
+	if (fDirectories[slot].device < 0)
+		return;
+
+	// the user and common folders may be one and the same
+	node_ref directory = fDirectories[slot];
+	fDirectories[slot].device = -1;
+	if (DirectorySlot(&directory) < 0)
+		watch_node(&directory, B_STOP_WATCHING, this);
+}
+
+
+void
+AddOnRegistry::AddAddOn(int32 slot, const entry_ref *ref)
+{
+	BEntry entry(ref);
+	node_ref node;
+	if (entry.GetNodeRef(&node) != B_OK || FindEntry(&node))
+		return;
+
+	AddOnInfo *addOn = new AddOnInfo(slot, fNextSequence++, ref, &node);
+	fAddOns.AddItem(addOn);
+	TTracker::WatchNode(&node, B_WATCH_STAT | B_WATCH_ATTR, this);
+
+	ReadAddOn(addOn);
+}
+
+
+void
+AddOnRegistry::RemoveAddOn(AddOnInfo *addOn)
+{
+	ForgetAddOn(addOn);
+	fAddOns.RemoveItem(addOn, false);
+	StopWatchingIfUnused(&addOn->fEntryNode);
+	delete addOn;
+}
+
+
+void
+AddOnRegistry::ReadAddOn(AddOnInfo *addOn)
+{
+	ASSERT(!addOn->fModel);
+
+	BEntry entry(&addOn->fRef, true);
+	if (entry.GetNodeRef(&addOn->fTargetNode) != B_OK)
+		return;
+
+	if (addOn->fTargetNode != addOn->fEntryNode) {
+		TTracker::WatchNode(&addOn->fTargetNode,
+			B_WATCH_NAME | B_WATCH_STAT | B_WATCH_ATTR, this);
+	}
+
+	Model *model = new Model(&entry);
+	if (model->InitCheck() != B_OK || !model->IsExecutable()) {
+		delete model;
+		return;
+	}
+
+	addOn->fModel = model;
+	StripShortcut(model, addOn->fName, addOn->fShortcut);
+
+	// add-ons that can't tell which types they support get offered for
+	// any type, just like the ones that don't list any
+	bool hasTypes = false;
+	bool anyType = false;
+
+	BFile file(&entry, B_READ_ONLY);
+	BAppFileInfo info(&file);
+	BMessage message;
+	if (file.InitCheck() == B_OK && info.InitCheck() == B_OK
+		&& info.GetSupportedTypes(&message) == B_OK) {
+		const char *type;
+		for (int32 index = 0; message.FindString("types", index, &type) == B_OK;
+				index++) {
+			BString lowerType(type);
+			lowerType.ToLower();
+			if (lowerType == B_FILE_MIMETYPE)
+				anyType = true;
+
+			fTypeIndex.insert(TypeIndex::value_type(
+				InternMimeString(lowerType.String()), addOn));
+			hasTypes = true;
+		}
+	}
+
+	addOn->fAnyType = anyType || !hasTypes;
+	if (addOn->fAnyType)
+		fAnyTypeAddOns.AddItem(addOn);
+}
+
+
+void
+AddOnRegistry::ForgetAddOn(AddOnInfo *addOn)
+{
+	for (TypeIndex::iterator iterator = fTypeIndex.begin();
+			iterator != fTypeIndex.end(); ) {
+		if (iterator->second == addOn)
+			fTypeIndex.erase(iterator++);
+		else
+			iterator++;
+	}
+
+	fAnyTypeAddOns.RemoveItem(addOn);
+	delete addOn->fModel;
+	addOn->fModel = NULL;
+	addOn->fAnyType = false;
+
+	if (addOn->fTargetNode != addOn->fEntryNode) {
+		node_ref target = addOn->fTargetNode;
+		addOn->fTargetNode = addOn->fEntryNode;
+		StopWatchingIfUnused(&target);
+	}
+}
+
+
+void
+AddOnRegistry::Refresh(const node_ref *node)
+{
+	int32 count = fAddOns.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		AddOnInfo *addOn = fAddOns.ItemAt(index);
+		if (addOn->fEntryNode == *node || addOn->fTargetNode == *node) {
+			ForgetAddOn(addOn);
+			ReadAddOn(addOn);
+		}
+	}
+}
+
+
+void
+AddOnRegistry::StopWatchingIfUnused(const node_ref *node)
+{
+	int32 count = fAddOns.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		AddOnInfo *addOn = fAddOns.ItemAt(index);
+		if (addOn->fEntryNode == *node || addOn->fTargetNode == *node)
+			return;
+	}
+
+	watch_node(node, B_STOP_WATCHING, this);
+}
+
+
+AddOnInfo *
+AddOnRegistry::FindEntry(const node_ref *node) const
+{
+	int32 count = fAddOns.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		AddOnInfo *addOn = fAddOns.ItemAt(index);
+		if (addOn->fEntryNode == *node)
+			return addOn;
+	}
+
+	return NULL;
+}
+
+
+int32
+AddOnRegistry::DirectorySlot(const node_ref *directory) const
+{
+	for (int32 slot = 0; slot < kAddOnDirectoryCount; slot++) {
+		if (fDirectories[slot] == *directory)
+			return slot;
+	}
+
+	return -1;
+}
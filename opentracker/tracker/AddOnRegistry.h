@@ -0,0 +1,125 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+
+
+//	AddOnRegistry keeps track of the Tracker add-ons in the system, user
+//	and common add-on folders. The folders are scanned once, node monitoring
+//	keeps the registry up to date from then on; the add-ons are indexed by
+//	the types they support so that building an add-on menu does not have
+//	to touch the disk.
+
+#ifndef _ADD_ON_REGISTRY_H
+#define _ADD_ON_REGISTRY_H
+
+#include <Looper.h>
+#include <Node.h>
+
+#include <map>
+
+#include "ObjectList.h"
+
+class BString;
+
+namespace BPrivate {
+
+class Model;
+class AddOnInfo;
+
+const int32 kAddOnDirectoryCount = 3;
+
+class AddOnRegistry : public BLooper {
+public:
+	AddOnRegistry();
+	virtual ~AddOnRegistry();
+
+	void EachAddOn(const BObjectList<BString> *mimeTypes,
+		bool (*)(const Model *, const char *, uint32 shortcut, bool primary,
+			void *), void *passThru);
+		// calls the function for every add-on that supports one of
+		// <mimeTypes> (primary), one of their supertypes or any type until
+		// it returns true; add-ons with the same name as one found earlier
+		// in the system, user, common folder order are skipped. With no
+		// <mimeTypes>, every add-on is passed
+
+	static AddOnRegistry *sAddOnRegistry;
+		// NULL unless running inside Tracker itself
+
+protected:
+	virtual void MessageReceived(BMessage *);
+
+private:
+	void EntryCreated(const node_ref *directory, const char *name);
+	void EntryRemoved(const node_ref *directory, const node_ref *node);
+
+	void ScanAll();
+	void ScanDirectory(int32 slot);
+	void ForgetDirectory(int32 slot);
+	void AddAddOn(int32 slot, const entry_ref *);
+	void RemoveAddOn(AddOnInfo *);
+	void ReadAddOn(AddOnInfo *);
+	void ForgetAddOn(AddOnInfo *);
+		// drops the model and the type index entries of an add-on
+	void Refresh(const node_ref *);
+		// re-reads every add-on that is or links to <node>
+	void StopWatchingIfUnused(const node_ref *);
+
+	AddOnInfo *FindEntry(const node_ref *) const;
+	int32 DirectorySlot(const node_ref *) const;
+
+	typedef std::multimap<const char *, AddOnInfo *> TypeIndex;
+		// keyed by interned, lower case types
+
+	node_ref fDirectories[kAddOnDirectoryCount];
+	node_ref fParents[kAddOnDirectoryCount];
+		// the Tracker sub folders and the add-on folders they live in,
+		// device is -1 if one does not exist
+	BObjectList<AddOnInfo> fAddOns;
+	TypeIndex fTypeIndex;
+	BObjectList<AddOnInfo> fAnyTypeAddOns;
+		// add-ons that do not list any types or that take any file
+	int32 fNextSequence;
+	bool fScanned;
+
+	typedef BLooper _inherited;
+};
+
+void StripShortcut(const Model *, char *result, uint32 &shortcut);
+	// splits the "-<key>" suffix off an add-on name
+
+} // namespace BPrivate
+
+using namespace BPrivate;
+
+#endif
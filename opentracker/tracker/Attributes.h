@@ -55,6 +55,9 @@ namespace BPrivate {
 #define	kAttrWindowFrame				"_trk/windframe"
 #define	kAttrWindowWorkspace			"_trk/windwkspc"
 #define	kAttrWindowDecor				"_trk/winddecor"
+#define	kAttrWindowState				"_trk/windstate"
+	// frame, workspaces, view state and columns in one; tagged with the
+	// byte order it was written in, so there is no foreign variant
 
 #define	kAttrQueryString				"_trk/qrystr"
 #define	kAttrQueryVolume				"_trk/qryvol1"
@@ -67,6 +70,7 @@ namespace BPrivate {
 
 #define	kAttrDisksFrame					"_trk/d_windframe"
 #define	kAttrDisksWorkspace				"_trk/d_windwkspc"
+#define	kAttrDisksWindowState			"_trk/d_windstate"
 
 #define	kAttrOpenWindows				"_trk/_windows_to_open_"
 
@@ -105,6 +105,7 @@ const uint32 kContextMenuDragNDrop = '_dnd';
 const uint32 kSwitchToHome = 'Tswh';
 
 const uint32 kTestIconCache = 'TicC';
+const uint32 kRunPoseViewBenchmarks = 'Tbnc';
 
 // Observers and Notifiers:
 
@@ -58,6 +58,7 @@ All rights reserved.
 
 #include <memory>
 
+#include "AddOnRegistry.h"
 #include "Attributes.h"
 #include "AttributeStream.h"
 #include "AutoLock.h"
@@ -157,21 +158,6 @@ ActivateWindowFilter(BMessage *, BHandler **target, BMessageFilter *)
 }
 
 
-static void
-StripShortcut(const Model *model, char *result, uint32 &shortcut)
-{
-	strcpy(result, model->Name());
-
-	// check if there is a shortcut
-	uint32 length = strlen(result);
-	shortcut = '\0';
-	if (result[length - 2] == '-') {
-		shortcut = result[length - 1];
-		result[length - 2] = '\0';
-	}
-}
-
-
 static const Model *
 MatchOne(const Model *model, void *castToName)
 {
@@ -276,6 +262,16 @@ NodeHasSavedState(const BNode *node)
 }
 
 
+static const char *
+WindowStateAttributeName(const Model *model)
+{
+	if (model && model->IsRoot())
+		return kAttrDisksWindowState;
+
+	return kAttrWindowState;
+}
+
+
 static bool
 OffsetFrameOne(const char *DEBUG_ONLY(name), uint32, off_t, void *castToRect,
 	void *castToParams)
@@ -975,8 +971,23 @@ BContainerWindow::RestoreState()
 	UpdateTitle();
 
 	WindowStateNodeOpener opener(this, false);
-	RestoreWindowState(opener.StreamNode());
-	fPoseView->Init(opener.StreamNode());
+
+	// the whole state comes in one attribute read if it was saved by us,
+	// otherwise use the separate attributes; whatever writes only those
+	// here removes the record, except for older Trackers
+	WindowStateArchive archive;
+	if (opener.Node()
+		&& archive.ReadFrom(opener.Node(),
+			WindowStateAttributeName(TargetModel())) == B_OK) {
+		RestoreWindowState(archive);
+#if __HAIKU__
+		RestoreWindowDecor(opener.StreamNode());
+#endif
+		fPoseView->Init(archive);
+	} else {
+		RestoreWindowState(opener.StreamNode());
+		fPoseView->Init(opener.StreamNode());
+	}
 
 	RestoreStateCommon();
 }
@@ -1147,12 +1158,22 @@ BContainerWindow::SaveState(bool hide)
 {
 	if (SaveStateIsEnabled()) {
 		WindowStateNodeOpener opener(this, true);
-		if (opener.StreamNode())
+		WindowStateArchive archive;
+		if (opener.StreamNode()) {
 			SaveWindowState(opener.StreamNode());
+			SaveWindowState(archive);
+		}
 		if (hide)
 			Hide();
-		if (opener.StreamNode())
+		if (opener.StreamNode()) {
 			fPoseView->SaveState(opener.StreamNode());
+			fPoseView->SaveState(archive);
+
+			// the separate attributes are still written for older
+			// Trackers and for the default state and layout copying
+			archive.WriteTo(opener.Node(),
+				WindowStateAttributeName(TargetModel()));
+		}
 
 		fStateNeedsSaving = false;
 	}
@@ -1195,6 +1216,7 @@ BContainerWindow::GetLayoutState(BNode *node, BMessage *message)
 		// and column resizing
 		// more can be added as needed
 		if (strcmp(attrName, kAttrWindowFrame) != 0
+			&& strcmp(attrName, kAttrWindowState) != 0
 			&& strcmp(attrName, kAttrColumns) != 0
 			&& strcmp(attrName, kAttrViewState) != 0
 			&& strcmp(attrName, kAttrColumnsForeign) != 0
@@ -1217,6 +1239,11 @@ BContainerWindow::SetLayoutState(BNode *node, const BMessage *message)
 	if (result != B_OK)
 		return result;
 
+	// a layout without the window state record must not be shadowed by
+	// the one the node had so far
+	if (!message->HasData(kAttrWindowState, B_RAW_TYPE))
+		node->RemoveAttr(kAttrWindowState);
+
 	for (int32 globalIndex = 0; ;) {
 #if B_BEOS_VERSION_DANO
  		const char *name;
@@ -2626,6 +2653,8 @@ BContainerWindow::AddWindowContextMenus(BMenu *menu)
 	menu->AddSeparatorItem();
 	BMenuItem *testing = new BMenuItem("Test Icon Cache", new BMessage(kTestIconCache));
 	menu->AddItem(testing);
+	menu->AddItem(new BMenuItem("Run Pose View Benchmarks",
+		new BMessage(kRunPoseViewBenchmarks)));
 #endif
 
 	// target items as needed
@@ -2651,24 +2680,48 @@ void
 BContainerWindow::EachAddon(bool (*eachAddon)(const Model *, const char *,
 	uint32 shortcut, bool primary, void *context), void *passThru)
 {
+	// build a list of the MIME types of the selected items
+
+	BObjectList<BString> mimeTypes(10, true);
+
+	int32 count = PoseView()->SelectionList()->CountItems();
+	if (!count) {
+		// just add the type of the current directory
+		AddMimeTypeString(mimeTypes, TargetModel());
+	} else {
+		for (int32 index = 0; index < count; index++) {
+			BPose *pose = PoseView()->SelectionList()->ItemAt(index);
+			AddMimeTypeString(mimeTypes, pose->TargetModel());
+		}
+	}
+
+	if (AddOnRegistry::sAddOnRegistry) {
+		// running inside Tracker, the registry knows all the add-ons
+		// already
+		AddOnRegistry::sAddOnRegistry->EachAddOn(&mimeTypes, eachAddon,
+			passThru);
+		return;
+	}
+
 	BObjectList<Model> uniqueList(10, true);
 	BPath path;
 	bool bail = false;
 	if (find_directory(B_BEOS_ADDONS_DIRECTORY, &path) == B_OK)
-		bail = EachAddon(path, eachAddon, &uniqueList, passThru);
+		bail = EachAddon(path, eachAddon, &uniqueList, &mimeTypes, passThru);
 
 	if (!bail && find_directory(B_USER_ADDONS_DIRECTORY, &path) == B_OK)
-		bail = EachAddon(path, eachAddon, &uniqueList, passThru);
+		bail = EachAddon(path, eachAddon, &uniqueList, &mimeTypes, passThru);
 
 	if (!bail && find_directory(B_COMMON_ADDONS_DIRECTORY, &path) == B_OK)
-		EachAddon(path, eachAddon, &uniqueList, passThru);
+		EachAddon(path, eachAddon, &uniqueList, &mimeTypes, passThru);
 }
 
 
 bool
 BContainerWindow::EachAddon(BPath &path, bool (*eachAddon)(const Model *,
 	const char *, uint32 shortcut, bool primary, void *),
-	BObjectList<Model> *uniqueList, void *params)
+	BObjectList<Model> *uniqueList, BObjectList<BString> *mimeTypes,
+	void *params)
 {
 	path.Append("Tracker");
 
@@ -2678,21 +2731,6 @@ BContainerWindow::EachAddon(BPath &path, bool (*eachAddon)(const Model *,
 	if (dir.SetTo(path.Path()) != B_OK)
 		return false;
 
-	// build a list of the MIME types of the selected items
-
-	BObjectList<BString> mimeTypes(10, true);
-
-	int32 count = PoseView()->SelectionList()->CountItems();
-	if (!count) {
-		// just add the type of the current directory
-		AddMimeTypeString(mimeTypes, TargetModel());
-	} else {
-		for (int32 index = 0; index < count; index++) {
-			BPose *pose = PoseView()->SelectionList()->ItemAt(index);
-			AddMimeTypeString(mimeTypes, pose->TargetModel());
-		}
-	}
-
 	dir.Rewind();
 	while (dir.GetNextEntry(&entry) == B_OK) {
 		bool primary = false;
@@ -2712,7 +2750,7 @@ BContainerWindow::EachAddon(BPath &path, bool (*eachAddon)(const Model *,
 
 		// check if it supports at least one of the selected entries
 
-		if (mimeTypes.CountItems()) {
+		if (mimeTypes->CountItems()) {
 			BFile file(&entry, B_READ_ONLY);
 			if (file.InitCheck() == B_OK) {
 				BAppFileInfo info(&file);
@@ -2730,8 +2768,8 @@ BContainerWindow::EachAddon(BPath &path, bool (*eachAddon)(const Model *,
 
 					// check all supported types if it has some set
 					if (!secondary) {
-						for (int32 i = mimeTypes.CountItems(); !primary && i-- > 0;) {
-							BString *type = mimeTypes.ItemAt(i);
+						for (int32 i = mimeTypes->CountItems(); !primary && i-- > 0;) {
+							BString *type = mimeTypes->ItemAt(i);
 							if (info.IsSupportedType(type->String())) {
 								BMimeType mimeType(type->String());
 								if (info.Supports(&mimeType))
@@ -2893,7 +2931,7 @@ BContainerWindow::LoadAddOn(BMessage *message)
 	// add selected refs to message
 	BMessage *refs = new BMessage(B_REFS_RECEIVED);
 
-	BObjectList<BPose> *list = PoseView()->SelectionList();
+	PoseList *list = PoseView()->SelectionList();
 
 	int32 index = 0;
 	BPose *pose;
@@ -3321,6 +3359,11 @@ BContainerWindow::SetUpDefaultState()
 		0
 	};
 	
+	// the copied attributes must not be shadowed by a record left over
+	// on the node
+	if (opener.Node())
+		opener.Node()->RemoveAttr(WindowStateAttributeName(TargetModel()));
+
 	// copy over attributes that apply; transform them properly, stripping
 	// parts that do not apply, adding a window stagger, etc.
 
@@ -3375,6 +3418,41 @@ BContainerWindow::RestoreWindowState(AttributeStreamNode *node)
 		Minimize(true);
 
 #if __HAIKU__
+	RestoreWindowDecor(node);
+#endif // __HAIKU__
+}
+
+
+void 
+BContainerWindow::RestoreWindowState(const WindowStateArchive &archive)
+{
+	if (dynamic_cast<BDeskWindow *>(this))
+		// don't restore any window state if we are a desktop window
+		return;
+
+	BRect frame;
+	if (archive.GetFrame(&frame)) {
+		MoveTo(frame.LeftTop());
+		ResizeTo(frame.Width(), frame.Height());
+	} else
+		sNewWindRect.OffsetBy(kWindowStaggerBy, kWindowStaggerBy);
+
+	fPreviousBounds = Bounds();
+
+	uint32 workspace;
+	if ((fContainerWindowFlags & kRestoreWorkspace)
+		&& archive.GetWorkspaces(&workspace))
+		SetWorkspaces(workspace);
+
+	if (fContainerWindowFlags & kIsHidden)
+		Minimize(true);
+}
+
+
+#if __HAIKU__
+void 
+BContainerWindow::RestoreWindowDecor(AttributeStreamNode *node)
+{
 	// restore window decor settings
 	int32 size = node->Contains(kAttrWindowDecor, B_RAW_TYPE);
 	if (size > 0) {
@@ -3386,8 +3464,8 @@ BContainerWindow::RestoreWindowState(AttributeStreamNode *node)
 				SetDecoratorSettings(decorSettings);
 		}
 	}
-#endif // __HAIKU__
 }
+#endif // __HAIKU__
 
 
 void 
@@ -3468,6 +3546,14 @@ BContainerWindow::SaveWindowState(AttributeStreamNode *node)
 }
 
 
+void 
+BContainerWindow::SaveWindowState(WindowStateArchive &archive) const
+{
+	archive.SetFrame(Frame());
+	archive.SetWorkspaces(Workspaces());
+}
+
+
 void 
 BContainerWindow::SaveWindowState(BMessage &message) const
 {
@@ -55,6 +55,7 @@ class BackgroundImage;
 class Model;
 class ModelNodeLazyOpener;
 class SelectionWindow;
+class WindowStateArchive;
 
 #define kDefaultFolderTemplate "DefaultFolderTemplate"
 
@@ -190,8 +191,13 @@ class BContainerWindow : public BWindow {
 
 		virtual void RestoreWindowState(AttributeStreamNode *);
 		virtual void RestoreWindowState(const BMessage &);
+		virtual void RestoreWindowState(const WindowStateArchive &);
 		virtual void SaveWindowState(AttributeStreamNode *);
 		virtual void SaveWindowState(BMessage &) const;
+		virtual void SaveWindowState(WindowStateArchive &) const;
+#if __HAIKU__
+		void RestoreWindowDecor(AttributeStreamNode *);
+#endif
 
 		virtual bool NeedsDefaultStateSetup();
 		virtual void SetUpDefaultState();
@@ -240,7 +246,7 @@ class BContainerWindow : public BWindow {
 			const char *);
 
 		bool EachAddon(BPath &path, bool(*)(const Model *, const char *, uint32, bool, void *),
-			BObjectList<Model> *, void *);
+			BObjectList<Model> *, BObjectList<BString> *mimeTypes, void *);
 		void LoadAddOn(BMessage *);
 
 		BPopUpMenu *fFileContextMenu;
@@ -49,6 +49,8 @@ All rights reserved.
 #include <string.h>
 #include <unistd.h>
 
+#include <new>
+
 #include <Alert.h>
 #include <Application.h>
 #include <Debug.h>
@@ -108,7 +110,6 @@ status_t DuplicateTask(BObjectList<entry_ref> *srcList);
 static status_t MoveTask(BObjectList<entry_ref> *, BEntry *, BList *, uint32);
 static status_t _DeleteTask(BObjectList<entry_ref> *, bool);
 static status_t _RestoreTask(BObjectList<entry_ref> *);
-status_t CalcItemsAndSize(BObjectList<entry_ref> *refList, int32 *totalCount, off_t *totalSize);
 status_t MoveItem(BEntry *entry, BDirectory *destDir, BPoint *loc,
 	uint32 moveMode, const char *newName, Undo &undo);
 ConflictCheckResult PreFlightNameCheck(BObjectList<entry_ref> *srcList, const BDirectory *destDir,
@@ -192,11 +193,16 @@ TrackerCopyLoopControl::FileError(const char *message, const char *name,
 
 void 
 TrackerCopyLoopControl::UpdateStatus(const char *name, entry_ref, int32 count, 
-	bool optional)
+	bool)
 {
-	if (gStatusWindow && gStatusWindow->HasStatus(fThread))
-		gStatusWindow->UpdateStatus(fThread, const_cast<char *>(name),  
-			count, optional);
+	// the status view samples the progress at its own rate, so there is
+	// no need to tell optional updates apart; the progress is looked up
+	// once, it stays around until our thread removes its status item
+	if (!fProgress && gStatusWindow)
+		fProgress = gStatusWindow->StatusProgressFor(fThread);
+
+	if (fProgress)
+		fProgress->Add(name, count);
 }
 
 
@@ -535,10 +541,285 @@ ConfirmChangeIfWellKnownDirectory(const BEntry *entry, const char *action,
 }
 
 
+// The totals for the progress bar used to be added up before an operation
+// could even start; now the operation starts right away and a few threads
+// walk the items in the background, refining the totals in the status
+// window as they go. A copy doesn't wait for them either, it is canceled
+// as soon as the running total no longer fits on the destination.
+
+const int32 kSizeCalculatorThreads = 3;
+const bigtime_t kSizeCalculatorUpdateInterval = 250000;
+
+
+class SizeCalculator {
+	public:
+		SizeCalculator(thread_id thread, bool countOnly);
+		~SizeCalculator();
+			// stops the walkers if they aren't done yet
+
+		void Add(const entry_ref *ref, bool countItself = true);
+			// a folder gets queued for the walkers
+		void Start(const entry_ref *destDir = NULL, BVolume *destVolume = NULL);
+			// inits the status item with what is known so far and starts
+			// walking; with <destVolume> set the operation is canceled
+			// should it turn out not to fit in the space free right now
+		void Stop();
+			// called once the operation is over, the totals don't matter
+			// anymore
+
+	private:
+		static status_t WalkerEntry(void *);
+		void Walk();
+		void Walk(const entry_ref *folder);
+		void UpdateStatus(bool done);
+
+		thread_id fThread;
+		bool fCountOnly;
+		BVolume *fDestVolume;
+		off_t fFreeBytes;
+
+		Benaphore fLock;
+		BObjectList<entry_ref> fFolders;
+		sem_id fFoldersSem;
+		int32 fBusy;
+		int32 fFileCount;
+		int32 fDirCount;
+		off_t fSize;
+		bigtime_t fLastUpdate;
+
+		thread_id fWalkers[kSizeCalculatorThreads];
+		int32 fWalkerCount;
+		volatile bool fQuitting;
+};
+
+
+SizeCalculator::SizeCalculator(thread_id thread, bool countOnly)
+	:	fThread(thread),
+		fCountOnly(countOnly),
+		fDestVolume(NULL),
+		fFreeBytes(0),
+		fLock("size calculator"),
+		fFolders(20, true),
+		fFoldersSem(-1),
+		fBusy(0),
+		fFileCount(0),
+		fDirCount(0),
+		fSize(0),
+		fLastUpdate(0),
+		fWalkerCount(0),
+		fQuitting(false)
+{
+}
+
+
+SizeCalculator::~SizeCalculator()
+{
+	Stop();
+
+	if (fFoldersSem >= B_OK)
+		delete_sem(fFoldersSem);
+}
+
+
+void
+SizeCalculator::Stop()
+{
+	// once we hold the lock, no walker is going to cancel the operation
+	// anymore
+	fLock.Lock();
+	fQuitting = true;
+	fLock.Unlock();
+
+	if (fWalkerCount)
+		release_sem_etc(fFoldersSem, fWalkerCount, 0);
+
+	for (int32 index = 0; index < fWalkerCount; index++) {
+		status_t result;
+		wait_for_thread(fWalkers[index], &result);
+	}
+	fWalkerCount = 0;
+}
+
+
+void
+SizeCalculator::Add(const entry_ref *ref, bool countItself)
+{
+	BEntry entry(ref);
+	StatStruct statbuf;
+	if (entry.GetStat(&statbuf) != B_OK)
+		return;
+
+	if (!S_ISDIR(statbuf.st_mode)) {
+		fFileCount++;
+		fSize += statbuf.st_size + 1024;
+		return;
+	}
+
+	if (countItself) {
+		fDirCount++;
+		fSize += 1024;
+	}
+
+	fFolders.AddItem(new entry_ref(*ref));
+}
+
+
+void
+SizeCalculator::Start(const entry_ref *destDir, BVolume *destVolume)
+{
+	fDestVolume = destVolume;
+	if (destVolume)
+		fFreeBytes = destVolume->FreeBytes();
+
+	if (gStatusWindow) {
+		int32 totalItems = fFileCount + fDirCount;
+		gStatusWindow->InitStatusItem(fThread, totalItems,
+			fCountOnly ? totalItems : fSize, destDir);
+	}
+
+	int32 count = fFolders.CountItems();
+	if (count == 0) {
+		UpdateStatus(true);
+		return;
+	}
+
+	fFoldersSem = create_sem(count, "size calculator folders");
+	if (fFoldersSem < B_OK)
+		return;
+
+	fLastUpdate = system_time();
+	for (int32 index = 0; index < kSizeCalculatorThreads; index++) {
+		thread_id walker = spawn_thread(&SizeCalculator::WalkerEntry,
+			"size calculator", B_LOW_PRIORITY, this);
+		if (walker < B_OK)
+			break;
+
+		fWalkers[fWalkerCount++] = walker;
+		resume_thread(walker);
+	}
+}
+
+
+status_t
+SizeCalculator::WalkerEntry(void *castToCalculator)
+{
+	((SizeCalculator *)castToCalculator)->Walk();
+	return B_OK;
+}
+
+
+void
+SizeCalculator::Walk()
+{
+	while (acquire_sem(fFoldersSem) == B_OK && !fQuitting) {
+		fLock.Lock();
+		entry_ref *folder = fFolders.RemoveItemAt(fFolders.CountItems() - 1);
+		if (folder != NULL)
+			fBusy++;
+		fLock.Unlock();
+
+		if (folder == NULL)
+			// we are done, the semaphore was released to wake us up
+			break;
+
+		Walk(folder);
+		delete folder;
+	}
+}
+
+
+void
+SizeCalculator::Walk(const entry_ref *folder)
+{
+	int32 fileCount = 0;
+	int32 dirCount = 0;
+	off_t size = 0;
+	BObjectList<entry_ref> subFolders(20, false);
+
+	BDirectory dir(folder);
+	BEntry entry;
+	while (!fQuitting && dir.GetNextEntry(&entry) == B_OK) {
+		StatStruct statbuf;
+		if (entry.GetStat(&statbuf) != B_OK)
+			continue;
+
+		if (S_ISDIR(statbuf.st_mode)) {
+			dirCount++;
+			size += 1024;
+
+			entry_ref *ref = new entry_ref;
+			if (entry.GetRef(ref) == B_OK)
+				subFolders.AddItem(ref);
+			else
+				delete ref;
+		} else {
+			fileCount++;
+			size += statbuf.st_size + 1024;
+				// add to compensate for attributes
+		}
+	}
+
+	fLock.Lock();
+
+	fFileCount += fileCount;
+	fDirCount += dirCount;
+	fSize += size;
+
+	// the queue takes over the sub folders
+	int32 subFolderCount = subFolders.CountItems();
+	for (int32 index = 0; index < subFolderCount; index++)
+		fFolders.AddItem(subFolders.ItemAt(index));
+
+	fBusy--;
+	bool done = fBusy == 0 && fFolders.IsEmpty();
+	if (done) {
+		// wake up the other walkers so that they can quit
+		release_sem_etc(fFoldersSem, fWalkerCount, 0);
+	} else if (subFolderCount > 0)
+		release_sem_etc(fFoldersSem, subFolderCount, 0);
+
+	fLock.Unlock();
+
+	UpdateStatus(done);
+}
+
+
+void
+SizeCalculator::UpdateStatus(bool done)
+{
+	bigtime_t now = system_time();
+
+	// holding the lock keeps the walkers from passing on their totals
+	// out of order
+	fLock.Lock();
+	if (!fQuitting && (done || now - fLastUpdate >= kSizeCalculatorUpdateInterval)) {
+		fLastUpdate = now;
+
+		int32 totalItems = fFileCount + fDirCount;
+		if (gStatusWindow)
+			gStatusWindow->SetStatusTotals(fThread, totalItems,
+				fCountOnly ? totalItems : fSize);
+
+		if (fDestVolume && fSize + 4 * kKBSize >= fFreeBytes) {
+			// won't fit, the operation stops at its next check for the
+			// user canceling
+			fDestVolume = NULL;
+			if (gStatusWindow)
+				gStatusWindow->CancelStatusItem(fThread);
+
+			(new BAlert("", kNoFreeSpace, "Cancel", 0, 0,
+				B_WIDTH_AS_USUAL, B_WARNING_ALERT))->Go(NULL);
+		}
+	}
+	fLock.Unlock();
+}
+
+
 static status_t
 InitCopy(uint32 moveMode, BObjectList<entry_ref> *srcList, thread_id thread, 
 	BVolume *dstVol, BDirectory *destDir, entry_ref *destRef,
-	bool preflightNameCheck, int32 *collisionCount, ConflictCheckResult *preflightResult)
+	bool preflightNameCheck, int32 *collisionCount, ConflictCheckResult *preflightResult,
+	SizeCalculator *sizeCalculator)
 {
 	if (dstVol->IsReadOnly()) {
 		if (gStatusWindow)
@@ -553,7 +834,7 @@ InitCopy(uint32 moveMode, BObjectList<entry_ref> *srcList, thread_id thread,
 	int32 askOnceOnly = kNotConfirmed;
 	for (int32 index = 0; index < numItems; index++) {
 		// we could check for this while iterating through items in each of the copy
-		// loops, except it takes forever to call CalcItemsAndSize
+		// loops, except it takes forever to walk all the folders
 		BEntry entry((entry_ref *)srcList->ItemAt(index));
 		if (IsDisksWindowIcon(&entry)) {
 
@@ -592,21 +873,12 @@ InitCopy(uint32 moveMode, BObjectList<entry_ref> *srcList, thread_id thread,
 				if (gStatusWindow)
 					gStatusWindow->CreateStatusItem(thread, kCopyState);
 
-				int32 totalItems = 0;
-				off_t totalSize = 0;
-				if (CalcItemsAndSize(srcList, &totalItems, &totalSize) != B_OK)
-					return B_ERROR;
-
-				// check for free space before starting copy
-				if ((totalSize + (4 * kKBSize)) >= dstVol->FreeBytes()) {
-					(new BAlert("", kNoFreeSpace, "Cancel", 0, 0,
-						B_WIDTH_AS_USUAL, B_WARNING_ALERT))->Go();
-					return B_ERROR;
-				}
+				// the sizes are added up while the status window is up
+				// already and the copy is under way
+				for (int32 index = 0; index < numItems; index++)
+					sizeCalculator->Add(srcList->ItemAt(index));
 
-				if (gStatusWindow)
-					gStatusWindow->InitStatusItem(thread, totalItems, totalSize,
-						destRef);
+				sizeCalculator->Start(destRef, dstVol);
 				break;
 			}
 
@@ -719,8 +991,10 @@ MoveTask(BObjectList<entry_ref> *srcList, BEntry *destEntry, BList *pointList, u
 	thread_id thread = find_thread(NULL);
 	ConflictCheckResult conflictCheckResult = kPrompt;
 	int32 collisionCount = 0;
+	SizeCalculator sizeCalculator(thread, false);
 	status_t result = InitCopy(moveMode, srcList, thread, &volume, destDirToCheck,
-		&destRef, needPreflightNameCheck, &collisionCount, &conflictCheckResult);
+		&destRef, needPreflightNameCheck, &collisionCount, &conflictCheckResult,
+		&sizeCalculator);
 	
 	int32 count = srcList->CountItems();
 	if (result == B_OK) {
@@ -787,7 +1061,7 @@ MoveTask(BObjectList<entry_ref> *srcList, BEntry *destEntry, BList *pointList, u
 
 				// update the status because item got skipped and the status
 				// will not get updated by the move call
-				if (gStatusWindow && gStatusWindow->HasStatus(thread))
+				if (gStatusWindow)
 					gStatusWindow->UpdateStatus(thread, srcRef->name, 1);
 
 				continue;
@@ -828,6 +1102,9 @@ MoveTask(BObjectList<entry_ref> *srcList, BEntry *destEntry, BList *pointList, u
 		delete pointList;
 	}
 
+	// a copy that made it is not to be canceled after the fact
+	sizeCalculator.Stop();
+
 	if (gStatusWindow)
 		gStatusWindow->RemoveStatusItem(thread);
 
@@ -870,13 +1147,11 @@ class MoveError {
 };
 
 
-void
-CopyFile(BEntry *srcFile, StatStruct *srcStat, BDirectory *destDir,
+static void
+CopyUnskippedFile(BEntry *srcFile, StatStruct *srcStat, BDirectory *destDir,
 	CopyLoopControl *loopControl, BPoint *loc, bool makeOriginalName, Undo &undo)
 {
-	if (loopControl->SkipEntry(srcFile, true))
-		return;
-
+	// CopyFile() for files the loop control has already been asked about
 	node_ref node;
 	destDir->GetNodeRef(&node);
 	BVolume volume(node.device);
@@ -939,6 +1214,18 @@ CopyFile(BEntry *srcFile, StatStruct *srcStat, BDirectory *destDir,
 }
 
 
+void
+CopyFile(BEntry *srcFile, StatStruct *srcStat, BDirectory *destDir,
+	CopyLoopControl *loopControl, BPoint *loc, bool makeOriginalName, Undo &undo)
+{
+	if (loopControl->SkipEntry(srcFile, true))
+		return;
+
+	CopyUnskippedFile(srcFile, srcStat, destDir, loopControl, loc,
+		makeOriginalName, undo);
+}
+
+
 #ifdef _SILENTLY_CORRECT_FILE_NAMES
 static bool
 CreateFileSystemCompatibleName(const BDirectory *destDir, char *destName)
@@ -977,6 +1264,405 @@ CreateFileSystemCompatibleName(const BDirectory *destDir, char *destName)
 #endif
 
 
+// The data portion of a file is copied through fixed size buffers that are
+// shared by all copy operations; files that don't fit into two of them are
+// read ahead by a second thread, so reading the next chunk overlaps with
+// writing out the current one.
+// BeOS has no zero-copy (sendfile(), copy_file_range()) API, the large,
+// reused buffers are the closest we get.
+
+const size_t kCopyBufferSize = 512 * 1024;
+const int32 kMaxPooledCopyBuffers = 4;
+const bigtime_t kCopyStatusInterval = 50000;
+const int32 kMaxPendingCopyStatus = 64 * 1024 * 1024;
+
+#if DEBUG
+bool gUseLegacyCopyLoop = false;
+	// set by the copy benchmarks to compare against the old copy loop,
+	// also turns off batching small files
+#endif
+
+
+class CopyBufferPool {
+	public:
+		CopyBufferPool();
+		~CopyBufferPool();
+
+		char *Acquire();
+		void Release(char *buffer);
+
+	private:
+		Benaphore fLock;
+		char *fBuffers[kMaxPooledCopyBuffers];
+		int32 fCount;
+};
+
+
+CopyBufferPool::CopyBufferPool()
+	:	fLock("copy buffer pool"),
+		fCount(0)
+{
+}
+
+
+CopyBufferPool::~CopyBufferPool()
+{
+	for (int32 index = 0; index < fCount; index++)
+		delete [] fBuffers[index];
+}
+
+
+char *
+CopyBufferPool::Acquire()
+{
+	char *buffer = NULL;
+
+	fLock.Lock();
+	if (fCount > 0)
+		buffer = fBuffers[--fCount];
+	fLock.Unlock();
+
+	if (buffer == NULL) {
+		buffer = new (std::nothrow) char [kCopyBufferSize];
+		if (buffer == NULL)
+			throw (status_t)B_NO_MEMORY;
+	}
+
+	return buffer;
+}
+
+
+void
+CopyBufferPool::Release(char *buffer)
+{
+	if (buffer == NULL)
+		return;
+
+	fLock.Lock();
+	if (fCount < kMaxPooledCopyBuffers) {
+		fBuffers[fCount++] = buffer;
+		buffer = NULL;
+	}
+	fLock.Unlock();
+
+	delete [] buffer;
+}
+
+
+static CopyBufferPool sCopyBufferPool;
+
+
+class PooledCopyBuffer {
+	// hands a buffer from the pool out on demand and returns it when done
+	public:
+		PooledCopyBuffer()
+			:	fBuffer(NULL)
+		{
+		}
+
+		~PooledCopyBuffer()
+		{
+			sCopyBufferPool.Release(fBuffer);
+		}
+
+		char *Buffer()
+		{
+			if (fBuffer == NULL)
+				fBuffer = sCopyBufferPool.Acquire();
+
+			return fBuffer;
+		}
+
+	private:
+		char *fBuffer;
+};
+
+
+class CopyStatusThrottle {
+	// the status window samples the progress every 0.1 seconds anyway,
+	// collect the number of bytes copied and only pass them on every
+	// kCopyStatusInterval
+	public:
+		CopyStatusThrottle(CopyLoopControl *loopControl, const entry_ref &ref)
+			:	fLoopControl(loopControl),
+				fRef(ref),
+				fPending(0),
+				fLastUpdate(0)
+		{
+		}
+
+		void Add(ssize_t bytes)
+		{
+			fPending += bytes;
+
+			bigtime_t now = system_time();
+			if (now - fLastUpdate >= kCopyStatusInterval
+				|| fPending >= kMaxPendingCopyStatus) {
+				Flush();
+				fLastUpdate = now;
+			}
+		}
+
+		void Flush()
+		{
+			if (fPending > 0)
+				fLoopControl->UpdateStatus(NULL, fRef, fPending, true);
+			fPending = 0;
+		}
+
+	private:
+		CopyLoopControl *fLoopControl;
+		entry_ref fRef;
+		int32 fPending;
+		bigtime_t fLastUpdate;
+};
+
+
+class CopyReader {
+	// hands out the source file chunk by chunk; with <readAhead> set a
+	// reader thread fills the two buffers in turn while the caller is busy
+	// writing out the other one
+	public:
+		CopyReader(BFile *source, PooledCopyBuffer &buffer, bool readAhead);
+		~CopyReader();
+
+		ssize_t NextChunk(char **chunk);
+			// returns the size of the next chunk, 0 at the end of the file
+			// or a negative error code
+		void ChunkDone();
+			// the chunk returned by NextChunk() may be reused
+
+	private:
+		static status_t ReadThread(void *castToReader);
+		void ReadAhead();
+		void Stop();
+
+		BFile *fSource;
+		char *fBuffers[2];
+		PooledCopyBuffer fSecondBuffer;
+		ssize_t fSizes[2];
+		int32 fNext;
+		sem_id fEmpty;
+		sem_id fFull;
+		thread_id fThread;
+		volatile bool fQuit;
+};
+
+
+CopyReader::CopyReader(BFile *source, PooledCopyBuffer &buffer, bool readAhead)
+	:	fSource(source),
+		fNext(0),
+		fEmpty(-1),
+		fFull(-1),
+		fThread(-1),
+		fQuit(false)
+{
+	fBuffers[0] = buffer.Buffer();
+	fBuffers[1] = NULL;
+
+	if (!readAhead)
+		return;
+
+	fBuffers[1] = fSecondBuffer.Buffer();
+	fEmpty = create_sem(2, "copy buffers empty");
+	fFull = create_sem(0, "copy buffers full");
+	if (fEmpty >= B_OK && fFull >= B_OK)
+		fThread = spawn_thread(&CopyReader::ReadThread, "copy read ahead",
+			B_NORMAL_PRIORITY, this);
+
+	if (fThread < B_OK || resume_thread(fThread) != B_OK) {
+		// just read synchronously
+		if (fThread >= B_OK)
+			kill_thread(fThread);
+		fThread = -1;
+	}
+}
+
+
+CopyReader::~CopyReader()
+{
+	Stop();
+
+	if (fEmpty >= B_OK)
+		delete_sem(fEmpty);
+	if (fFull >= B_OK)
+		delete_sem(fFull);
+}
+
+
+void
+CopyReader::Stop()
+{
+	if (fThread < B_OK)
+		return;
+
+	// wake the reader up if it is waiting for a buffer
+	fQuit = true;
+	release_sem(fEmpty);
+
+	status_t result;
+	wait_for_thread(fThread, &result);
+	fThread = -1;
+}
+
+
+status_t
+CopyReader::ReadThread(void *castToReader)
+{
+	static_cast<CopyReader *>(castToReader)->ReadAhead();
+	return B_OK;
+}
+
+
+void
+CopyReader::ReadAhead()
+{
+	for (int32 index = 0; ; index ^= 1) {
+		if (acquire_sem(fEmpty) != B_OK || fQuit)
+			return;
+
+		ssize_t bytes = fSource->Read(fBuffers[index], kCopyBufferSize);
+		fSizes[index] = bytes;
+		release_sem(fFull);
+
+		if (bytes <= 0)
+			return;
+	}
+}
+
+
+ssize_t
+CopyReader::NextChunk(char **chunk)
+{
+	*chunk = fBuffers[fNext];
+
+	if (fThread < B_OK)
+		return fSource->Read(fBuffers[fNext], kCopyBufferSize);
+
+	status_t result = acquire_sem(fFull);
+	if (result != B_OK)
+		return result;
+
+	ssize_t bytes = fSizes[fNext];
+	if (bytes <= 0)
+		// the reader is done, make sure it is gone before the buffers
+		// are used for anything else
+		Stop();
+
+	return bytes;
+}
+
+
+void
+CopyReader::ChunkDone()
+{
+	if (fThread >= B_OK)
+		release_sem(fEmpty);
+
+	if (fBuffers[1] != NULL)
+		fNext ^= 1;
+}
+
+
+static bool
+CopyFileData(BFile *srcFile, BFile *destFile, StatStruct *srcStat,
+	const entry_ref &ref, CopyLoopControl *loopControl, PooledCopyBuffer &buffer)
+{
+	// returns false if the user canceled the copy
+	CopyReader reader(srcFile, buffer,
+		srcStat->st_size > (off_t)(2 * kCopyBufferSize));
+	CopyStatusThrottle status(loopControl, ref);
+
+	while (true) {
+		if (loopControl->CheckUserCanceled())
+			return false;
+
+		char *chunk;
+		ssize_t bytes = reader.NextChunk(&chunk);
+		if (bytes < 0)
+			// read error
+			throw (status_t)bytes;
+		if (bytes == 0)
+			// we are done
+			break;
+
+		loopControl->ChecksumChunk(chunk, (size_t)bytes);
+
+		ssize_t result = destFile->Write(chunk, (size_t)bytes);
+		if (result != bytes)
+			throw (status_t)B_ERROR;
+
+		reader.ChunkDone();
+		status.Add(bytes);
+	}
+
+	status.Flush();
+	return true;
+}
+
+
+#if DEBUG
+static bool
+LegacyCopyFileData(BFile *srcFile, BFile *destFile, StatStruct *srcStat,
+	const entry_ref &ref, CopyLoopControl *loopControl)
+{
+	// the copy loop as it was before the buffer pool and the read ahead
+	// thread, kept around for the benchmarks
+	const size_t kMinBufferSize = 1024 * 128; 
+	const size_t kMaxBufferSize = 1024 * 1024; 
+ 
+	size_t bufsize = kMinBufferSize;
+	if (bufsize < srcStat->st_size) {
+		system_info sinfo; 
+		get_system_info(&sinfo); 
+		size_t freesize = static_cast<size_t>((sinfo.max_pages - sinfo.used_pages) * B_PAGE_SIZE);
+		bufsize = freesize / 4;
+		bufsize -= bufsize % (16 * 1024);
+		if (bufsize < kMinBufferSize)
+			bufsize = kMinBufferSize; 
+		else if (bufsize > kMaxBufferSize)
+			bufsize = kMaxBufferSize; 
+	} 
+
+	char *buffer = new char[bufsize];
+	try {
+		while (true) {
+			if (loopControl->CheckUserCanceled()) {
+				delete [] buffer;
+				return false;
+			}
+
+			ssize_t bytes = srcFile->Read(buffer, bufsize);
+			if (bytes > 0) {
+				ssize_t updateBytes = 0; 
+				if (bytes > 32 * 1024) { 
+					updateBytes = bytes / 2; 
+					loopControl->UpdateStatus(NULL, ref, updateBytes, true); 
+				} 
+
+				loopControl->ChecksumChunk(buffer, (size_t)bytes); 
+
+				ssize_t result = destFile->Write(buffer, (size_t)bytes); 
+				if (result != bytes)  
+					throw (status_t)B_ERROR; 
+
+				loopControl->UpdateStatus(NULL, ref, bytes - updateBytes, true); 
+			} else if (bytes < 0) 
+				throw (status_t)bytes;
+			else
+				break;
+		}
+	} catch (...) {
+		delete [] buffer;
+		throw;
+	}
+
+	delete [] buffer;
+	return true;
+}
+#endif
+
+
 static void
 LowLevelCopy(BEntry *srcEntry, StatStruct *srcStat, BDirectory *destDir,
 	char *destName, CopyLoopControl *loopControl, BPoint *loc)
@@ -1010,166 +1696,545 @@ LowLevelCopy(BEntry *srcEntry, StatStruct *srcStat, BDirectory *destDir,
 		newLink.SetModificationTime(srcStat->st_mtime);
 		newLink.SetCreationTime(srcStat->st_crtime);
 
-		return;
+		return;
+	}
+
+	BFile srcFile(srcEntry, O_RDONLY);
+	ThrowOnInitCheckError(&srcFile);
+
+	BFile destFile(destDir, destName, O_RDWR | O_CREAT);
+#ifdef _SILENTLY_CORRECT_FILE_NAMES
+	if ((destFile.InitCheck() == B_BAD_VALUE || destFile.InitCheck() == B_NOT_ALLOWED)
+		&& CreateFileSystemCompatibleName(destDir, destName))
+		destFile.SetTo(destDir, destName, B_CREATE_FILE | B_READ_WRITE);
+#endif
+
+	ThrowOnInitCheckError(&destFile);
+
+	node_ref destNodeRef;
+	destDir->GetNodeRef(&destNodeRef);
+	// copy or write new pose location as a first thing
+	SetUpPoseLocation(ref.directory, destNodeRef.node, &srcFile,
+		&destFile, loc);
+
+	// copy data portion of file
+	PooledCopyBuffer buffer;
+	bool completed;
+#if DEBUG
+	if (gUseLegacyCopyLoop)
+		completed = LegacyCopyFileData(&srcFile, &destFile, srcStat, ref,
+			loopControl);
+	else
+#endif
+		completed = CopyFileData(&srcFile, &destFile, srcStat, ref,
+			loopControl, buffer);
+
+	if (!completed) {
+		// if copy was canceled, remove partial destination file
+		destFile.Unset();
+
+		BEntry destEntry;
+		if (destDir->FindEntry(destName, &destEntry) == B_OK)
+			destEntry.Remove();
+
+		throw (status_t)kCopyCanceled;
+	}
+
+	CopyAttributes(loopControl, &srcFile, &destFile, buffer.Buffer(),
+		kCopyBufferSize);
+
+	destFile.SetPermissions(srcStat->st_mode);
+	destFile.SetOwner(srcStat->st_uid);
+	destFile.SetGroup(srcStat->st_gid);
+	destFile.SetModificationTime(srcStat->st_mtime);
+	destFile.SetCreationTime(srcStat->st_crtime);
+
+	if (!loopControl->ChecksumFile(&ref)) {
+		// File no good.  Remove and quit.
+		destFile.Unset();
+
+		BEntry destEntry;
+		if (destDir->FindEntry(destName, &destEntry) == B_OK)
+			destEntry.Remove();
+		throw (status_t)kUserCanceled;
+	}
+}
+
+
+void
+CopyAttributes(CopyLoopControl *control, BNode *srcNode, BNode *destNode, void *buffer,
+	size_t bufsize)
+{
+	// ToDo:
+	// Add error checking
+	// prior to coyping attributes, make sure indices are installed
+
+	// When calling CopyAttributes on files, have to make sure destNode
+	// is a BFile opened R/W
+	
+	srcNode->RewindAttrs();
+	char name[256];
+	while (srcNode->GetNextAttrName(name) == B_OK) {
+		// Check to see if this attribute should be skipped.
+		if (control->SkipAttribute(name))
+			continue;
+
+		attr_info info;
+		if (srcNode->GetAttrInfo(name, &info) != B_OK)
+			continue;
+
+		// Check to see if this attribute should be overwritten when it
+		// already exists.
+		if (control->PreserveAttribute(name)) {
+			attr_info dest_info;
+			if (destNode->GetAttrInfo(name, &dest_info) == B_OK)
+				continue;
+		}
+
+		ssize_t bytes;
+		ssize_t numToRead = (ssize_t)info.size;
+		for (off_t offset = 0; numToRead > 0; offset += bytes) {
+			size_t chunkSize = (size_t)numToRead;
+			if (chunkSize > bufsize)
+				chunkSize = bufsize;
+
+			bytes = srcNode->ReadAttr(name, info.type, offset,
+				buffer, chunkSize);
+
+			if (bytes <= 0) 
+				break;
+			
+			destNode->WriteAttr(name, info.type, offset, buffer, (size_t)bytes);
+
+			numToRead -= bytes;
+		}
+	}
+}
+
+
+// Copying lots of tiny files is dominated by the per file overhead rather
+// than by the data; regular files up to kSmallFileSize that go into a
+// freshly created folder are collected in batches instead. A few threads
+// read the data, attributes and pose location of a whole batch into one
+// arena, then the copy thread creates and writes the copies in one go.
+
+const off_t kSmallFileSize = 16 * 1024;
+const int32 kSmallFileBatchCount = 64;
+const int32 kSmallFileArenaSize = 2 * kSmallFileBatchCount * kSmallFileSize;
+const int32 kSmallFileReaderCount = 4;
+const int32 kMinParallelSmallFileRead = 4;
+	// not worth waking up the readers for fewer files
+
+
+struct SmallFileItem {
+	entry_ref ref;
+	StatStruct stat;
+	status_t status;
+		// anything but B_OK makes the file go through CopyFile()
+	char *data;
+	char *attributes;
+	size_t attributesSize;
+	bool hasLocation;
+	BPoint location;
+};
+
+
+struct SmallFileAttribute {
+	// precedes every attribute in SmallFileItem::attributes, followed by
+	// the name and the data
+	type_code type;
+	uint32 nameLength;
+	uint32 size;
+};
+
+
+class SmallFileCopier {
+	public:
+		SmallFileCopier(CopyLoopControl *loopControl, Undo &undo);
+		~SmallFileCopier();
+
+		static bool IsSmallFile(const StatStruct *stat);
+
+		bool Add(const entry_ref *ref, const StatStruct *stat,
+			BDirectory *destDir);
+			// returns false if the file has to be copied by CopyFile();
+			// the loop control must have been asked about skipping it
+		void Flush();
+			// copies all files added so far
+
+	private:
+		void StartReaders();
+		static status_t ReaderEntry(void *);
+		void Read();
+		void Read(SmallFileItem &item);
+		char *Allocate(size_t size);
+
+		bool Write(SmallFileItem &item, uid_t owner, gid_t group);
+
+		CopyLoopControl *fLoopControl;
+		Undo &fUndo;
+		BDirectory *fDestDir;
+		ino_t fDestDirNode;
+		SmallFileItem fItems[kSmallFileBatchCount];
+		int32 fCount;
+		off_t fSize;
+		int32 fReadCount;
+		char *fArena;
+		int32 fArenaUsed;
+		int32 fNext;
+		sem_id fStartSem;
+		sem_id fDoneSem;
+		thread_id fReaders[kSmallFileReaderCount - 1];
+		int32 fReaderCount;
+		bool fReadersStarted;
+		volatile bool fQuitting;
+};
+
+
+SmallFileCopier::SmallFileCopier(CopyLoopControl *loopControl, Undo &undo)
+	:	fLoopControl(loopControl),
+		fUndo(undo),
+		fDestDir(NULL),
+		fDestDirNode(0),
+		fCount(0),
+		fSize(0),
+		fReadCount(0),
+		fArena(NULL),
+		fArenaUsed(0),
+		fNext(0),
+		fStartSem(-1),
+		fDoneSem(-1),
+		fReaderCount(0),
+		fReadersStarted(false),
+		fQuitting(false)
+{
+}
+
+
+SmallFileCopier::~SmallFileCopier()
+{
+	fQuitting = true;
+	if (fReaderCount)
+		release_sem_etc(fStartSem, fReaderCount, 0);
+
+	for (int32 index = 0; index < fReaderCount; index++) {
+		status_t result;
+		wait_for_thread(fReaders[index], &result);
+	}
+
+	if (fStartSem >= B_OK)
+		delete_sem(fStartSem);
+	if (fDoneSem >= B_OK)
+		delete_sem(fDoneSem);
+
+	free(fArena);
+}
+
+
+bool
+SmallFileCopier::IsSmallFile(const StatStruct *stat)
+{
+	return S_ISREG(stat->st_mode) && stat->st_size <= kSmallFileSize;
+}
+
+
+bool
+SmallFileCopier::Add(const entry_ref *ref, const StatStruct *stat,
+	BDirectory *destDir)
+{
+	if (fArena == NULL) {
+		fArena = (char *)malloc(kSmallFileArenaSize);
+		if (fArena == NULL)
+			return false;
+	}
+
+	if (destDir != fDestDir || fCount == kSmallFileBatchCount
+		|| fSize + stat->st_size > kSmallFileArenaSize / 2)
+		Flush();
+
+	if (fCount == 0) {
+		node_ref node;
+		if (destDir->GetNodeRef(&node) != B_OK)
+			return false;
+
+		fDestDir = destDir;
+		fDestDirNode = node.node;
+	}
+
+	SmallFileItem &item = fItems[fCount++];
+	item.ref = *ref;
+	item.stat = *stat;
+	fSize += stat->st_size;
+
+	return true;
+}
+
+
+void
+SmallFileCopier::StartReaders()
+{
+	fReadersStarted = true;
+
+	fStartSem = create_sem(0, "small file readers start");
+	fDoneSem = create_sem(0, "small file readers done");
+	if (fStartSem < B_OK || fDoneSem < B_OK)
+		return;
+
+	for (int32 index = 0; index < kSmallFileReaderCount - 1; index++) {
+		thread_id reader = spawn_thread(&SmallFileCopier::ReaderEntry,
+			"small file reader", B_NORMAL_PRIORITY, this);
+		if (reader < B_OK)
+			break;
+
+		fReaders[fReaderCount++] = reader;
+		resume_thread(reader);
+	}
+}
+
+
+status_t
+SmallFileCopier::ReaderEntry(void *castToCopier)
+{
+	SmallFileCopier *copier = (SmallFileCopier *)castToCopier;
+	while (acquire_sem(copier->fStartSem) == B_OK && !copier->fQuitting) {
+		copier->Read();
+		release_sem(copier->fDoneSem);
+	}
+
+	return B_OK;
+}
+
+
+char *
+SmallFileCopier::Allocate(size_t size)
+{
+	int32 offset = atomic_add(&fArenaUsed, (int32)size);
+	if (offset + (int32)size > kSmallFileArenaSize)
+		return NULL;
+
+	return fArena + offset;
+}
+
+
+void
+SmallFileCopier::Read()
+{
+	for (;;) {
+		int32 index = atomic_add(&fNext, 1);
+		if (index >= fReadCount)
+			break;
+
+		Read(fItems[index]);
+	}
+}
+
+
+void
+SmallFileCopier::Read(SmallFileItem &item)
+{
+	// any failure here just sends the file down the regular path, which
+	// does the proper error reporting
+	item.status = B_ERROR;
+	item.attributes = NULL;
+	item.attributesSize = 0;
+
+	BFile file(&item.ref, O_RDONLY);
+	if (file.InitCheck() != B_OK)
+		return;
+
+	size_t size = (size_t)item.stat.st_size;
+	item.data = Allocate(size);
+	if (item.data == NULL || file.Read(item.data, size) != (ssize_t)size)
+		return;
+
+	item.hasLocation = FSGetPoseLocation(&file, &item.location);
+
+	// find out how much room the attributes need, then read them
+	char name[256];
+	attr_info info;
+	size_t attributesSize = 0;
+	file.RewindAttrs();
+	while (file.GetNextAttrName(name) == B_OK) {
+		if (file.GetAttrInfo(name, &info) != B_OK)
+			continue;
+
+		attributesSize += sizeof(SmallFileAttribute) + strlen(name) + 1
+			+ (size_t)info.size;
 	}
 
-	BFile srcFile(srcEntry, O_RDONLY);
-	ThrowOnInitCheckError(&srcFile);
+	if (attributesSize > 0) {
+		item.attributes = Allocate(attributesSize);
+		if (item.attributes == NULL)
+			return;
+	}
 
-	const size_t kMinBufferSize = 1024 * 128; 
-	const size_t kMaxBufferSize = 1024 * 1024; 
- 
-	size_t bufsize = kMinBufferSize;
-	if (bufsize < srcStat->st_size) {
-		//	File bigger than the buffer size: determine an optimal buffer size 
-		system_info sinfo; 
-		get_system_info(&sinfo); 
-		size_t freesize = static_cast<size_t>((sinfo.max_pages - sinfo.used_pages) * B_PAGE_SIZE);
-		bufsize = freesize / 4;					// take 1/4 of RAM max 
-		bufsize -= bufsize % (16 * 1024);		// Round to 16 KB boundaries 
-		if (bufsize < kMinBufferSize)			// at least kMinBufferSize 
-			bufsize = kMinBufferSize; 
-		else if (bufsize > kMaxBufferSize)		// no more than kMaxBufferSize 
-			bufsize = kMaxBufferSize; 
-	} 
+	char *attribute = item.attributes;
+	char *end = item.attributes + attributesSize;
+	file.RewindAttrs();
+	while (file.GetNextAttrName(name) == B_OK) {
+		if (file.GetAttrInfo(name, &info) != B_OK)
+			continue;
 
-	BFile destFile(destDir, destName, O_RDWR | O_CREAT);
-#ifdef _SILENTLY_CORRECT_FILE_NAMES
-	if ((destFile.InitCheck() == B_BAD_VALUE || destFile.InitCheck() == B_NOT_ALLOWED)
-		&& CreateFileSystemCompatibleName(destDir, destName))
-		destFile.SetTo(destDir, destName, B_CREATE_FILE | B_READ_WRITE);
-#endif
+		SmallFileAttribute header;
+		header.type = info.type;
+		header.nameLength = strlen(name) + 1;
+		header.size = (uint32)info.size;
 
-	ThrowOnInitCheckError(&destFile);
+		size_t attributeSize = sizeof(header) + header.nameLength + header.size;
+		if (attribute + attributeSize > end)
+			// attributes were added behind our back
+			return;
 
-	node_ref destNodeRef;
-	destDir->GetNodeRef(&destNodeRef);
-	// copy or write new pose location as a first thing
-	SetUpPoseLocation(ref.directory, destNodeRef.node, &srcFile,
-		&destFile, loc);
+		memcpy(attribute, &header, sizeof(header));
+		memcpy(attribute + sizeof(header), name, header.nameLength);
+		if (file.ReadAttr(name, info.type, 0,
+				attribute + sizeof(header) + header.nameLength, header.size)
+				!= (ssize_t)header.size)
+			return;
 
-	char *buffer = new char[bufsize];
-	try {
-		// copy data portion of file
-		while (true) {
-			if (loopControl->CheckUserCanceled()) {
-				// if copy was canceled, remove partial destination file
-				destFile.Unset();
-	
-				BEntry destEntry;
-				if (destDir->FindEntry(destName, &destEntry) == B_OK)
-					destEntry.Remove();
+		attribute += attributeSize;
+	}
 
-				throw (status_t)kCopyCanceled;
-			}
-	
-			ASSERT(buffer);
-			ssize_t bytes = srcFile.Read(buffer, bufsize);
+	item.attributesSize = attribute - item.attributes;
+	item.status = B_OK;
+}
 
-			if (bytes > 0) {
-				ssize_t updateBytes = 0; 
-				if (bytes > 32 * 1024) { 
-					// when copying large chunks, update after read and after write
-					// to get better update granularity
-					updateBytes = bytes / 2; 
-					loopControl->UpdateStatus(NULL, ref, updateBytes, true); 
-				} 
- 
-				loopControl->ChecksumChunk(buffer, (size_t)bytes); 
-	 
-				ssize_t result = destFile.Write(buffer, (size_t)bytes); 
-				if (result != bytes)  
-					throw (status_t)B_ERROR; 
-	 
-				loopControl->UpdateStatus(NULL, ref, bytes - updateBytes, true); 
-			} else if (bytes < 0) 
-				// read error
-				throw (status_t)bytes;
-			else
-				// we are done
-				break;
-		}
 
-		CopyAttributes(loopControl, &srcFile, &destFile, buffer, bufsize);
-	} catch (...) {
-		delete [] buffer;
-		throw;
+void
+SmallFileCopier::Flush()
+{
+	if (fCount == 0)
+		return;
+
+	// reset the batch before anything can throw
+	int32 count = fCount;
+	fCount = 0;
+	fSize = 0;
+
+	off_t totalSize = 0;
+	for (int32 index = 0; index < count; index++)
+		totalSize += fItems[index].stat.st_size + kKBSize;
+
+	node_ref destNode;
+	fDestDir->GetNodeRef(&destNode);
+	BVolume volume(destNode.device);
+	if (totalSize >= volume.FreeBytes()) {
+		fLoopControl->FileError(kNoFreeSpace, "", B_DEVICE_FULL, false);
+		throw (status_t)B_DEVICE_FULL;
 	}
 
-	destFile.SetPermissions(srcStat->st_mode);
-	destFile.SetOwner(srcStat->st_uid);
-	destFile.SetGroup(srcStat->st_gid);
-	destFile.SetModificationTime(srcStat->st_mtime);
-	destFile.SetCreationTime(srcStat->st_crtime);
+	// read the whole batch
+	fReadCount = count;
+	fNext = 0;
+	fArenaUsed = 0;
 
-	delete [] buffer;
+	if (!fReadersStarted && count >= kMinParallelSmallFileRead)
+		StartReaders();
 
-	if (!loopControl->ChecksumFile(&ref)) {
-		// File no good.  Remove and quit.
-		destFile.Unset();
+	if (fReaderCount && count >= kMinParallelSmallFileRead) {
+		release_sem_etc(fStartSem, fReaderCount, 0);
+		Read();
+		acquire_sem_etc(fDoneSem, fReaderCount, 0, 0);
+	} else
+		Read();
+
+	// the copies are created by us, they only need a new owner if we are
+	// copying somebody else's files
+	uid_t owner = getuid();
+	gid_t group = getgid();
+
+	for (int32 index = 0; index < count; index++) {
+		SmallFileItem &item = fItems[index];
+		bool written = false;
+		try {
+			if (item.status == B_OK)
+				written = Write(item, owner, group);
+		} catch (status_t err) {
+			if (err == kCopyCanceled)
+				throw (status_t)err;
 
-		BEntry destEntry;
-		if (destDir->FindEntry(destName, &destEntry) == B_OK)
-			destEntry.Remove();
-		throw (status_t)kUserCanceled;
+			if (!fLoopControl->FileError(kFileErrorString, item.ref.name, err,
+					true))
+				throw (status_t)err;
+
+			// user selected continue in spite of error, the file still
+			// counts as done
+			written = true;
+		}
+
+		if (written) {
+			fLoopControl->UpdateStatus(item.ref.name, item.ref,
+				1024 + item.stat.st_size, true);
+		} else {
+			// let CopyFile() deal with it, and with reporting any errors;
+			// SkipEntry() was already called for it
+			BEntry entry(&item.ref);
+			CopyUnskippedFile(&entry, &item.stat, fDestDir, fLoopControl, NULL,
+				false, fUndo);
+		}
 	}
 }
 
 
-void
-CopyAttributes(CopyLoopControl *control, BNode *srcNode, BNode *destNode, void *buffer,
-	size_t bufsize)
+bool
+SmallFileCopier::Write(SmallFileItem &item, uid_t owner, gid_t group)
 {
-	// ToDo:
-	// Add error checking
-	// prior to coyping attributes, make sure indices are installed
+	// returns false if the file could not be created
+	const char *name = item.ref.name;
+	BFile destFile(fDestDir, name, B_CREATE_FILE | B_FAIL_IF_EXISTS
+		| B_READ_WRITE);
+	if (destFile.InitCheck() != B_OK)
+		return false;
 
-	// When calling CopyAttributes on files, have to make sure destNode
-	// is a BFile opened R/W
-	
-	srcNode->RewindAttrs();
-	char name[256];
-	while (srcNode->GetNextAttrName(name) == B_OK) {
-		// Check to see if this attribute should be skipped.
-		if (control->SkipAttribute(name))
-			continue;
+	// the destination folder is always a different one
+	if (item.hasLocation)
+		FSSetPoseLocation(fDestDirNode, &destFile, item.location);
 
-		attr_info info;
-		if (srcNode->GetAttrInfo(name, &info) != B_OK)
-			continue;
+	size_t size = (size_t)item.stat.st_size;
+	if (size > 0) {
+		fLoopControl->ChecksumChunk(item.data, size);
+		if (destFile.Write(item.data, size) != (ssize_t)size)
+			throw (status_t)B_ERROR;
+	}
 
-		// Check to see if this attribute should be overwritten when it
-		// already exists.
-		if (control->PreserveAttribute(name)) {
-			attr_info dest_info;
-			if (destNode->GetAttrInfo(name, &dest_info) == B_OK)
-				continue;
-		}
+	for (char *attribute = item.attributes;
+			attribute < item.attributes + item.attributesSize; ) {
+		SmallFileAttribute header;
+		memcpy(&header, attribute, sizeof(header));
+		const char *attributeName = attribute + sizeof(header);
+		if (!fLoopControl->SkipAttribute(attributeName))
+			destFile.WriteAttr(attributeName, header.type, 0,
+				attributeName + header.nameLength, header.size);
 
-		ssize_t bytes;
-		ssize_t numToRead = (ssize_t)info.size;
-		for (off_t offset = 0; numToRead > 0; offset += bytes) {
-			size_t chunkSize = (size_t)numToRead;
-			if (chunkSize > bufsize)
-				chunkSize = bufsize;
+		attribute += sizeof(header) + header.nameLength + header.size;
+	}
 
-			bytes = srcNode->ReadAttr(name, info.type, offset,
-				buffer, chunkSize);
+	destFile.SetPermissions(item.stat.st_mode);
+	if (item.stat.st_uid != owner)
+		destFile.SetOwner(item.stat.st_uid);
+	if (item.stat.st_gid != group)
+		destFile.SetGroup(item.stat.st_gid);
+	destFile.SetModificationTime(item.stat.st_mtime);
+	destFile.SetCreationTime(item.stat.st_crtime);
 
-			if (bytes <= 0) 
-				break;
-			
-			destNode->WriteAttr(name, info.type, offset, buffer, (size_t)bytes);
+	if (!fLoopControl->ChecksumFile(&item.ref)) {
+		// File no good.  Remove and quit.
+		destFile.Unset();
 
-			numToRead -= bytes;
-		}
+		BEntry destEntry;
+		if (fDestDir->FindEntry(name, &destEntry) == B_OK)
+			destEntry.Remove();
+		throw (status_t)kUserCanceled;
 	}
+
+	return true;
 }
 
 
 static void
 CopyFolder(BEntry *srcEntry, BDirectory *destDir, CopyLoopControl *loopControl,
-	BPoint *loc, bool makeOriginalName, Undo &undo)
+	BPoint *loc, bool makeOriginalName, Undo &undo,
+	SmallFileCopier *smallFiles = NULL)
 {
 	BDirectory newDir;
 	BEntry entry;
@@ -1264,25 +2329,60 @@ CopyFolder(BEntry *srcEntry, BDirectory *destDir, CopyLoopControl *loopControl,
 	SetUpPoseLocation(ref.directory, destNodeRef.node, &srcDir,
 		&newDir, loc);
 
-	while (srcDir.GetNextEntry(&entry) == B_OK) {
+	// the whole copy shares one small file copier; only files going into
+	// a folder we just created are batched, there can't be any conflicts
+	SmallFileCopier *ownSmallFiles = NULL;
+	if (smallFiles == NULL
+#if DEBUG
+		&& !gUseLegacyCopyLoop
+#endif
+		)
+		smallFiles = ownSmallFiles = new SmallFileCopier(loopControl, undo);
+
+	try {
+		while (srcDir.GetNextEntry(&entry) == B_OK) {
 
-		if (loopControl->CheckUserCanceled())
-			throw (status_t)kUserCanceled;
+			if (loopControl->CheckUserCanceled())
+				throw (status_t)kUserCanceled;
 
-		entry.GetStat(&statbuf);
+			entry.GetStat(&statbuf);
 				
-		if (S_ISDIR(statbuf.st_mode)) {
+			if (S_ISDIR(statbuf.st_mode)) {
+
+				// entry is a mount point, do not copy it
+				if (statbuf.st_dev != sourceDeviceID) {
+					PRINT(("Avoiding mount point %d, %d	\n", statbuf.st_dev, sourceDeviceID));
+					continue;
+				}
+			
+				if (smallFiles)
+					smallFiles->Flush();
 
-			// entry is a mount point, do not copy it
-			if (statbuf.st_dev != sourceDeviceID) {
-				PRINT(("Avoiding mount point %d, %d	\n", statbuf.st_dev, sourceDeviceID));
+				CopyFolder(&entry, &newDir, loopControl, 0, false, undo,
+					smallFiles);
 				continue;
 			}
-			
-			CopyFolder(&entry, &newDir, loopControl, 0, false, undo);
-		} else
+
+			entry_ref entryRef;
+			if (createDirectory && smallFiles
+				&& SmallFileCopier::IsSmallFile(&statbuf)
+				&& entry.GetRef(&entryRef) == B_OK) {
+				if (loopControl->SkipEntry(&entry, true)
+					|| smallFiles->Add(&entryRef, &statbuf, &newDir))
+					continue;
+			}
+
 			CopyFile(&entry, &statbuf, &newDir, loopControl, 0, false, undo);
+		}
+
+		if (smallFiles)
+			smallFiles->Flush();
+	} catch (...) {
+		delete ownSmallFiles;
+		throw;
 	}
+
+	delete ownSmallFiles;
 }
 
 
@@ -1405,7 +2505,7 @@ MoveItem(BEntry *entry, BDirectory *destDir, BPoint *loc, uint32 moveMode,
 			// size is irrelevant when simply moving to a new folder
 
 			thread_id thread = find_thread(NULL);
-			if (gStatusWindow && gStatusWindow->HasStatus(thread))
+			if (gStatusWindow)
 				gStatusWindow->UpdateStatus(thread, ref.name, 1);
 
 			MoveError::FailOnError(entry->MoveTo(destDir, newName));
@@ -1449,6 +2549,45 @@ FSDuplicate(BObjectList<entry_ref> *srcList, BList *pointList)
 }
 
 
+#if DEBUG
+class BenchmarkUndo : public Undo {
+	public:
+		BenchmarkUndo()
+		{
+			fUndo = NULL;
+		}
+};
+
+
+status_t
+FSBenchmarkCopy(BEntry *srcEntry, BDirectory *destDir,
+	CopyLoopControl *loopControl, bool legacyCopyLoop)
+{
+	// copies a file or folder synchronously, without status window
+	// or undo; used by the benchmarks in Tests.cpp
+	StatStruct statbuf;
+	status_t result = srcEntry->GetStat(&statbuf);
+	if (result != B_OK)
+		return result;
+
+	gUseLegacyCopyLoop = legacyCopyLoop;
+
+	BenchmarkUndo undo;
+	try {
+		if (S_ISDIR(statbuf.st_mode))
+			CopyFolder(srcEntry, destDir, loopControl, NULL, false, undo);
+		else
+			CopyFile(srcEntry, &statbuf, destDir, loopControl, NULL, false, undo);
+	} catch (status_t error) {
+		result = error;
+	}
+
+	gUseLegacyCopyLoop = false;
+	return result;
+}
+#endif
+
+
 #if 0
 status_t
 FSCopyFolder(BEntry *srcEntry, BDirectory *destDir, CopyLoopControl *loopControl,
@@ -2041,43 +3180,6 @@ FSRecursiveCalcSize(BInfoWindow *wind, BDirectory *dir, off_t *running_size,
 }
 
 
-status_t
-CalcItemsAndSize(BObjectList<entry_ref> *refList, int32 *totalCount, off_t *totalSize)
-{
-	int32 fileCount = 0;
-	int32 dirCount = 0;
-
-	thread_id tid = find_thread(NULL);
-
-	int32 num_items = refList->CountItems();
-	for (int32 i = 0; i < num_items; i++) {
-		entry_ref *ref = refList->ItemAt(i);
-		BEntry entry(ref);
-		StatStruct statbuf;
-		entry.GetStat(&statbuf);
-
-		if (gStatusWindow && gStatusWindow->CheckCanceledOrPaused(tid))
-			return kUserCanceled;
-
-		if (S_ISDIR(statbuf.st_mode)) {
-			BDirectory dir(&entry);
-			dirCount++;
-			(*totalSize) += 1024;
-			status_t result;
-			if ((result = FSRecursiveCalcSize(NULL, &dir, totalSize, &fileCount,
-				&dirCount)) != B_OK)
-				return result;
-		} else {
-			fileCount++;
-			(*totalSize) += statbuf.st_size + 1024;
-		}
-	}
-
-	*totalCount += (fileCount + dirCount);
-	return B_OK;
-}
-
-
 status_t
 FSGetTrashDir(BDirectory *trash_dir, dev_t dev)
 {
@@ -2383,10 +3485,9 @@ empty_trash(void *)
 	if (gStatusWindow)
 		gStatusWindow->CreateStatusItem(thread, kTrashState);
 
-	// calculate the sum total of all items on all volumes in trash
-	BObjectList<entry_ref> srcList;
-	int32 totalCount = 0;
-	off_t totalSize = 0;
+	// the sum total of all items on all volumes in trash is calculated
+	// while we are already deleting them
+	SizeCalculator sizeCalculator(thread, true);
 
 	BVolumeRoster volumeRoster;
 	BVolume volume;
@@ -2403,36 +3504,27 @@ empty_trash(void *)
 
 		entry_ref ref;
 		entry.GetRef(&ref);
-		srcList.AddItem(&ref);
-		err = CalcItemsAndSize(&srcList, &totalCount, &totalSize);
-		if (err != B_OK)
-			break;
-
-		srcList.MakeEmpty();
 
 		// don't count trash directory itself
-		totalCount--;
+		sizeCalculator.Add(&ref, false);
 	}
 
-	if (err == B_OK) {
-		if (gStatusWindow)
-			gStatusWindow->InitStatusItem(thread, totalCount, totalCount);
+	sizeCalculator.Start();
 
-		volumeRoster.Rewind();
-		while (volumeRoster.GetNextVolume(&volume) == B_OK) {
-			TrackerCopyLoopControl loopControl(thread);
+	volumeRoster.Rewind();
+	while (volumeRoster.GetNextVolume(&volume) == B_OK) {
+		TrackerCopyLoopControl loopControl(thread);
 
-			if (volume.IsReadOnly() || !volume.IsPersistent())
-				continue;
+		if (volume.IsReadOnly() || !volume.IsPersistent())
+			continue;
 
-			BDirectory trashDirectory;
-			if (FSGetTrashDir(&trashDirectory, volume.Device()) != B_OK)
-				continue;
+		BDirectory trashDirectory;
+		if (FSGetTrashDir(&trashDirectory, volume.Device()) != B_OK)
+			continue;
 
-			BEntry entry;
-			trashDirectory.GetEntry(&entry);
-			err = FSDeleteFolder(&entry, &loopControl, true, false);
-		}
+		BEntry entry;
+		trashDirectory.GetEntry(&entry);
+		err = FSDeleteFolder(&entry, &loopControl, true, false);
 	}
 
 	if (err != B_OK && err != kTrashCanceled && err != kUserCanceled) {
@@ -2489,31 +3581,31 @@ _DeleteTask(BObjectList<entry_ref> *list, bool confirm)
 	if (gStatusWindow)
 		gStatusWindow->CreateStatusItem(thread, kDeleteState);
 
-	// calculate the sum total of all items on all volumes in trash
-	int32 totalItems = 0;
-	int64 totalSize = 0;
+	// the sum total of all items is calculated while we are already
+	// deleting them
+	int32 count = list->CountItems();
+	SizeCalculator sizeCalculator(thread, true);
+	for (int32 index = 0; index < count; index++)
+		sizeCalculator.Add(list->ItemAt(index));
 
-	status_t err = CalcItemsAndSize(list, &totalItems, &totalSize);
-	if (err == B_OK) {
-		if (gStatusWindow)
-			gStatusWindow->InitStatusItem(thread, totalItems, totalItems);
-		
-		int32 count = list->CountItems();
-		TrackerCopyLoopControl loopControl(thread);
-		for (int32 index = 0; index < count; index++) {
-			entry_ref ref(*list->ItemAt(index));
-			BEntry entry(&ref);
-			loopControl.UpdateStatus(ref.name, ref, 1, true);
-			if (entry.IsDirectory())
-				err = FSDeleteFolder(&entry, &loopControl, true, true, true);
-			else 
-				err = entry.Remove();
-		}
+	sizeCalculator.Start();
 
-		if (err != kTrashCanceled && err != kUserCanceled && err != B_OK) 
-			(new BAlert("", "Error Deleting items", "OK", NULL, NULL,
-				B_WIDTH_AS_USUAL, B_WARNING_ALERT))->Go();
+	status_t err = B_OK;
+	TrackerCopyLoopControl loopControl(thread);
+	for (int32 index = 0; index < count; index++) {
+		entry_ref ref(*list->ItemAt(index));
+		BEntry entry(&ref);
+		loopControl.UpdateStatus(ref.name, ref, 1, true);
+		if (entry.IsDirectory())
+			err = FSDeleteFolder(&entry, &loopControl, true, true, true);
+		else 
+			err = entry.Remove();
 	}
+
+	if (err != kTrashCanceled && err != kUserCanceled && err != B_OK) 
+		(new BAlert("", "Error Deleting items", "OK", NULL, NULL,
+			B_WIDTH_AS_USUAL, B_WARNING_ALERT))->Go();
+
 	if (gStatusWindow)
 		gStatusWindow->RemoveStatusItem(find_thread(NULL));
 
@@ -2559,59 +3651,54 @@ _RestoreTask(BObjectList<entry_ref> *list)
 	if (gStatusWindow)
 		gStatusWindow->CreateStatusItem(thread, kRestoreFromTrashState);
 
-	// calculate the sum total of all items that will be restored
-	int32 totalItems = 0;
-	int64 totalSize = 0;
-
-	status_t err = CalcItemsAndSize(list, &totalItems, &totalSize);
-	if (err == B_OK) {
-		if (gStatusWindow)
-			gStatusWindow->InitStatusItem(thread, totalItems, totalItems);
+	// only the items themselves are reported, no need to walk them
+	int32 count = list->CountItems();
+	if (gStatusWindow)
+		gStatusWindow->InitStatusItem(thread, count, count);
 
-		int32 count = list->CountItems();
-		TrackerCopyLoopControl loopControl(thread);
-		for (int32 index = 0; index < count; index++) {
-			entry_ref ref(*list->ItemAt(index));
-			BEntry entry(&ref);
-			BPath originalPath;
+	status_t err = B_OK;
+	TrackerCopyLoopControl loopControl(thread);
+	for (int32 index = 0; index < count; index++) {
+		entry_ref ref(*list->ItemAt(index));
+		BEntry entry(&ref);
+		BPath originalPath;
 
-			loopControl.UpdateStatus(ref.name, ref, 1, true);
+		loopControl.UpdateStatus(ref.name, ref, 1, true);
 
-			if (FSGetOriginalPath(&entry, &originalPath) != B_OK)
-				continue;
+		if (FSGetOriginalPath(&entry, &originalPath) != B_OK)
+			continue;
 
-			BEntry originalEntry(originalPath.Path());
-			BPath parentPath;
-			err = originalPath.GetParent(&parentPath);
-			if (err != B_OK)
-				continue;
-			BEntry parentEntry(parentPath.Path());
+		BEntry originalEntry(originalPath.Path());
+		BPath parentPath;
+		err = originalPath.GetParent(&parentPath);
+		if (err != B_OK)
+			continue;
+		BEntry parentEntry(parentPath.Path());
 
-			if (parentEntry.InitCheck() != B_OK || !parentEntry.Exists()) {
-				if (FSRecursiveCreateFolder(parentPath) == B_OK) {
-					originalEntry.SetTo(originalPath.Path());
-					if (entry.InitCheck() != B_OK)
-						continue;
-				}
+		if (parentEntry.InitCheck() != B_OK || !parentEntry.Exists()) {
+			if (FSRecursiveCreateFolder(parentPath) == B_OK) {
+				originalEntry.SetTo(originalPath.Path());
+				if (entry.InitCheck() != B_OK)
+					continue;
 			}
+		}
 	
-			if (!originalEntry.Exists()) {
-				BDirectory dir(parentPath.Path());
-				if (dir.InitCheck() == B_OK) {
-					char leafName[B_FILE_NAME_LENGTH];
-					originalEntry.GetName(leafName);
-					if (entry.MoveTo(&dir, leafName) == B_OK) {
-						BNode node(&entry);
-						if (node.InitCheck() == B_OK)
-							node.RemoveAttr(kAttrOriginalPath);
-					}
+		if (!originalEntry.Exists()) {
+			BDirectory dir(parentPath.Path());
+			if (dir.InitCheck() == B_OK) {
+				char leafName[B_FILE_NAME_LENGTH];
+				originalEntry.GetName(leafName);
+				if (entry.MoveTo(&dir, leafName) == B_OK) {
+					BNode node(&entry);
+					if (node.InitCheck() == B_OK)
+						node.RemoveAttr(kAttrOriginalPath);
 				}
 			}
-
-			err = loopControl.CheckUserCanceled();
-			if (err != B_OK)
-				break;
 		}
+
+		err = loopControl.CheckUserCanceled();
+		if (err != B_OK)
+			break;
 	}
 	if (gStatusWindow)
 		gStatusWindow->RemoveStatusItem(find_thread(NULL));
@@ -56,6 +56,7 @@ class BFile;
 namespace BPrivate {
 
 class BInfoWindow;
+class StatusProgress;
 
 class CopyLoopControl {
 	// controls the copy engine; may be overriden to specify how conflicts are
@@ -134,12 +135,14 @@ class TrackerCopyLoopControl : public CopyLoopControl {
 
 	private:
 		thread_id fThread;
+		StatusProgress *fProgress;
 };
 
 
 inline 
 TrackerCopyLoopControl::TrackerCopyLoopControl(thread_id thread)
-	: fThread(thread)
+	:	fThread(thread),
+		fProgress(NULL)
 {
 }
 
@@ -197,6 +200,12 @@ status_t FSGetBootDeskDir(BDirectory *deskDir);
 
 status_t FSGetOriginalPath(BEntry *entry, BPath *path);
 
+#if DEBUG
+status_t FSBenchmarkCopy(BEntry *srcEntry, BDirectory *destDir,
+	CopyLoopControl *loopControl, bool legacyCopyLoop);
+	// synchronous copy for the benchmarks, optionally using the old copy loop
+#endif
+
 enum ReadAttrResult {
 	kReadAttrFailed,
 	kReadAttrNativeOK,
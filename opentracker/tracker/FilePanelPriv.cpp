@@ -505,7 +505,7 @@ TFilePanel::AdjustButton()
 		return;
 
 	BTextControl *textControl = dynamic_cast<BTextControl *>(FindView("text view"));
-	BObjectList<BPose> *selectionList = fPoseView->SelectionList();
+	PoseList *selectionList = fPoseView->SelectionList();
 	const char *buttonText = fButtonText.String();
 	bool enabled = false;
 
@@ -1261,7 +1261,7 @@ TFilePanel::MessageReceived(BMessage *message)
 void 
 TFilePanel::OpenDirectory()
 {
-	BObjectList<BPose> *list = PoseView()->SelectionList();
+	PoseList *list = PoseView()->SelectionList();
 	if (list->CountItems() != 1)
 		return;
 
@@ -1491,7 +1491,7 @@ void
 TFilePanel::HandleOpenButton()
 {
 	PoseView()->CommitActivePose();
-	BObjectList<BPose> *selection = PoseView()->SelectionList();
+	PoseList *selection = PoseView()->SelectionList();
 
 	// if we have only one directory and we're not opening dirs, enter.
 	if ((fNodeFlavors & B_DIRECTORY_NODE) == 0
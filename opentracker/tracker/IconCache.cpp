@@ -64,10 +64,14 @@ All rights reserved.
 
 
 #include <Debug.h>
+#include <Message.h>
+#include <Messenger.h>
 #include <Screen.h>
 #include <Volume.h>
 #include <fs_info.h>
 
+#include <string.h>
+
 #include "Bitmaps.h"
 #include "FSUtils.h"
 #include "IconCache.h"
@@ -98,6 +102,200 @@ All rights reserved.
 #undef NODE_CACHE_ASYNC_DRAWS
 
 
+namespace BPrivate {
+
+const int32 kIconLoaderThreads = 2;
+	// loading an icon is mostly waiting on the disk, a second thread
+	// keeps the next read queued up
+const int32 kMaxPendingIconLoads = 256;
+	// scrolling quickly through a big folder requests icons that are out
+	// of sight again long before they are loaded; the oldest requests get
+	// dropped, a pose that gets drawn again asks again
+
+struct IconLoadRequest {
+	entry_ref entry;
+	node_ref node;
+	IconDrawMode mode;
+	icon_size size;
+	const BHandler *target;
+	BMessenger messenger;
+};
+
+class IconLoader {
+	// loads icons for IconCache::Draw on a couple of background threads;
+	// the newest request goes first, its pose is the most likely one to
+	// still be visible
+public:
+	IconLoader(IconCache *);
+	~IconLoader();
+
+	bool Load(const Model *, IconDrawMode, icon_size, BHandler *target);
+		// fails if there are no threads to load the icon with
+	void Cancel(const BHandler *target);
+
+private:
+	void StartWorkers();
+	static status_t WorkerEntry(void *);
+	void Work();
+
+	IconCache *fIconCache;
+	Benaphore fLock;
+	BObjectList<IconLoadRequest> fRequests;
+	sem_id fRequestSem;
+	thread_id fWorkers[kIconLoaderThreads];
+	int32 fWorkerCount;
+	bool fStarted;
+	volatile bool fQuitting;
+};
+
+} // namespace BPrivate
+
+
+IconLoader::IconLoader(IconCache *iconCache)
+	:	fIconCache(iconCache),
+		fLock("icon loader"),
+		fRequests(kMaxPendingIconLoads, true),
+		fRequestSem(-1),
+		fWorkerCount(0),
+		fStarted(false),
+		fQuitting(false)
+{
+}
+
+
+IconLoader::~IconLoader()
+{
+	fQuitting = true;
+	if (fRequestSem >= B_OK)
+		delete_sem(fRequestSem);
+			// gets the workers out of acquire_sem
+
+	for (int32 index = 0; index < fWorkerCount; index++) {
+		status_t result;
+		wait_for_thread(fWorkers[index], &result);
+	}
+}
+
+
+void
+IconLoader::StartWorkers()
+{
+	fStarted = true;
+
+	fRequestSem = create_sem(0, "icon loader requests");
+	if (fRequestSem < B_OK)
+		return;
+
+	for (int32 index = 0; index < kIconLoaderThreads; index++) {
+		thread_id worker = spawn_thread(&IconLoader::WorkerEntry,
+			"icon loader", B_NORMAL_PRIORITY, this);
+		if (worker < B_OK)
+			break;
+
+		fWorkers[fWorkerCount++] = worker;
+		resume_thread(worker);
+	}
+}
+
+
+bool
+IconLoader::Load(const Model *model, IconDrawMode mode, icon_size size,
+	BHandler *target)
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	if (!fStarted)
+		StartWorkers();
+
+	if (!fWorkerCount)
+		return false;
+
+	// a pose may get drawn a few times before its icon arrives
+	for (int32 index = fRequests.CountItems() - 1; index >= 0; index--) {
+		IconLoadRequest *request = fRequests.ItemAt(index);
+		if (request->node == *model->NodeRef() && request->target == target
+			&& request->size == size)
+			return true;
+	}
+
+	IconLoadRequest *request = new IconLoadRequest;
+	request->entry = *model->EntryRef();
+	request->node = *model->NodeRef();
+	request->mode = mode;
+	request->size = size;
+	request->target = target;
+	request->messenger = BMessenger(target);
+
+	if (fRequests.CountItems() >= kMaxPendingIconLoads) {
+		// the semaphore already counts the dropped request
+		delete fRequests.RemoveItemAt(0);
+		fRequests.AddItem(request);
+	} else {
+		fRequests.AddItem(request);
+		release_sem_etc(fRequestSem, 1, B_DO_NOT_RESCHEDULE);
+	}
+
+	return true;
+}
+
+
+void
+IconLoader::Cancel(const BHandler *target)
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	for (int32 index = fRequests.CountItems() - 1; index >= 0; index--) {
+		if (fRequests.ItemAt(index)->target == target)
+			delete fRequests.RemoveItemAt(index);
+	}
+}
+
+
+status_t
+IconLoader::WorkerEntry(void *castToLoader)
+{
+	((IconLoader *)castToLoader)->Work();
+	return B_OK;
+}
+
+
+void
+IconLoader::Work()
+{
+	while (acquire_sem(fRequestSem) == B_OK && !fQuitting) {
+		IconLoadRequest *request;
+		{
+			AutoLock<Benaphore> lock(fLock);
+			request = fRequests.RemoveItemAt(fRequests.CountItems() - 1);
+		}
+
+		if (!request)
+			// canceled
+			continue;
+
+		Model model(&request->entry);
+		if (model.InitCheck() == B_OK) {
+			fIconCache->Preload(&model, request->mode, request->size);
+
+			BMessage message(kIconLoaded);
+			message.AddInt32("device", request->node.device);
+			message.AddInt64("node", request->node.node);
+			message.AddInt32("source", model.IconFrom());
+			request->messenger.SendMessage(&message);
+
+			// a node icon is looked after by the model of the view from
+			// now on, keep this temporary one from removing it again
+			model.SetIconFrom(kUnknownSource);
+		}
+
+		delete request;
+	}
+}
+
+
+//	#pragma mark -
+
+
 IconCacheEntry::IconCacheEntry()
 	:	fLargeIcon(NULL),
 		fMiniIcon(NULL),
@@ -128,7 +326,7 @@ IconCacheEntry::~IconCacheEntry()
 
 
 void 
-IconCacheEntry::SetAliasFor(const SharedIconCache *sharedCache,
+IconCacheEntry::SetAliasFor(SharedIconCache *sharedCache,
 	const SharedCacheEntry *entry)
 {
 	sharedCache->SetAliasFor(this, entry);
@@ -277,9 +475,17 @@ IconCacheEntry::SetIcon(BBitmap *bitmap, IconDrawMode mode, icon_size size,
 
 
 IconCache::IconCache()
-	:	fInitHiliteTable(true)
+	:	fLoader(NULL),
+		fInitHiliteTable(true)
 {
 	InitHiliteTable();
+	fLoader = new IconLoader(this);
+}
+
+
+IconCache::~IconCache()
+{
+	delete fLoader;
 }
 
 
@@ -524,8 +730,11 @@ IconCache::GetVolumeIcon(AutoLock<SimpleIconCache> *nodeCacheLocker,
 				sharedCacheLocker->Lock();
 			}
 
-			if (entry->HaveIconBitmap(mode, size)) 
+			if (entry->HaveIconBitmap(mode, size)) {
+				if (*resultingOpenCache == nodeCacheLocker)
+					fNodeCache.Touch((NodeCacheEntry *)entry);
 				return entry;
+			}
 		}
 	}
 
@@ -571,6 +780,9 @@ IconCache::GetVolumeIcon(AutoLock<SimpleIconCache> *nodeCacheLocker,
 		entry->ConstructBitmap(mode, size, lazyBitmap);
 		entry->SetIcon(lazyBitmap->Adopt(), mode, size);
 	}
+
+	if (*resultingOpenCache == nodeCacheLocker)
+		fNodeCache.Touch((NodeCacheEntry *)entry);
 	return entry;
 }
 
@@ -741,9 +953,12 @@ IconCache::GetNodeIcon(ModelNodeLazyOpener *modelOpener,
 			// node has it's own icon, use it
 
 			BBitmap *bitmap = lazyBitmap->Adopt();
-			PRINT_ADD_ITEM(("File %s; Line %d # adding entry for model %s\n",
-				__FILE__, __LINE__, model->Name()));
-			entry = fNodeCache.AddItem(model->NodeRef(), permanent);
+			// an entry that only lacks this size gets it added
+			if (!entry) {
+				PRINT_ADD_ITEM(("File %s; Line %d # adding entry for model %s\n",
+					__FILE__, __LINE__, model->Name()));
+				entry = fNodeCache.AddItem(model->NodeRef(), permanent);
+			}
 			ASSERT(entry);
 			entry->SetIcon(bitmap, kNormalIcon, size);
 			if (mode != kNormalIcon) {
@@ -757,13 +972,17 @@ IconCache::GetNodeIcon(ModelNodeLazyOpener *modelOpener,
 	if (!entry) {
 		(*resultingOpenCache)->Unlock();
 		*resultingOpenCache = NULL;
-	} else if (!entry->HaveIconBitmap(mode, size)
+		return NULL;
+	}
+
+	if (!entry->HaveIconBitmap(mode, size)
 		&& entry->HaveIconBitmap(NORMAL_ICON_ONLY, size)) {
 		entry->ConstructBitmap(mode, size, lazyBitmap);
 		entry->SetIcon(lazyBitmap->Adopt(), mode, size);
 		ASSERT(entry->HaveIconBitmap(mode, size));
 	}
 
+	fNodeCache.Touch((NodeCacheEntry *)entry);
 	return entry;
 }
 
@@ -1010,10 +1229,75 @@ IconCache::Preload(AutoLock<SimpleIconCache> *nodeCacheLocker,
 }
 
 
+bool
+IconCache::NeedsLoading(const Model *model, icon_size size, bool *evicted)
+{
+	if (evicted)
+		*evicted = false;
+
+	// once the icon source is known, Preload takes shortcuts that stay
+	// within the caches for all but icons that got flushed
+	if ((model->IconFrom() != kUnknownSource && model->IconFrom() != kNode)
+		|| model->IsVolume() || model->IsRoot())
+		return false;
+
+	// otherwise the node has to be checked for an icon of its own first
+	AutoLock<SimpleIconCache> nodeCacheLocker(&fNodeCache);
+	NodeCacheEntry *entry = fNodeCache.FindItem(model->NodeRef());
+	if (evicted)
+		*evicted = entry == NULL;
+
+	return !entry || !entry->HaveIconBitmap(NORMAL_ICON_ONLY, size);
+}
+
+
+bool
+IconCache::DrawPlaceholder(Model *model, BView *view, BPoint where,
+	IconDrawMode mode, icon_size size, bool async)
+{
+	AutoLock<SimpleIconCache> sharedCacheLocker(&fSharedCache);
+
+	// most nodes end up with the icon of their type, try that first
+	IconCacheEntry *entry = fSharedCache.FindItem(model->MimeType());
+	if (entry)
+		entry = fSharedCache.ResolveIfAlias(entry);
+
+	if (!entry || !entry->HaveIconBitmap(NORMAL_ICON_ONLY, size)) {
+		entry = fSharedCache.FindItem(B_FILE_MIMETYPE);
+		if (entry)
+			entry = fSharedCache.ResolveIfAlias(entry);
+	}
+
+	if (!entry || !entry->HaveIconBitmap(NORMAL_ICON_ONLY, size))
+		return false;
+
+	if (!entry->HaveIconBitmap(mode, size)) {
+		LazyBitmapAllocator lazyBitmap(size);
+		entry->ConstructBitmap(mode, size, &lazyBitmap);
+		entry->SetIcon(lazyBitmap.Adopt(), mode, size);
+	}
+
+	fSharedCache.Draw(entry, view, where, mode, size, async);
+	return true;
+}
+
+
 void
 IconCache::Draw(Model *model, BView *view, BPoint where, IconDrawMode mode,
-	icon_size size, bool async)
-{
+	icon_size size, bool async, BHandler *loadTarget)
+{
+	bool evicted;
+	if (loadTarget && NeedsLoading(model, size, &evicted)) {
+		// a node icon that got evicted is looked up from scratch in the
+		// background, one that only lacks this size gets it added to
+		// its entry
+		if (evicted)
+			model->SetIconFrom(kUnknownSource);
+		if (fLoader->Load(model, mode, size, loadTarget)
+			&& DrawPlaceholder(model, view, where, mode, size, async))
+			return;
+	}
+
 	// the following does not actually lock the caches, we are using the
 	// lockLater mode; we will decide which of the two to lock down depending
 	// on where we get the icon from
@@ -1072,6 +1356,19 @@ IconCache::Preload(Model *model, IconDrawMode mode, icon_size size, bool permane
 }
 
 
+void
+IconCache::Preload(const BObjectList<Model> *models, IconDrawMode mode,
+	icon_size size)
+{
+	int32 count = models->CountItems();
+	for (int32 index = 0; index < count; index++) {
+		Model *model = models->ItemAt(index);
+		if (!NeedsLoading(model, size))
+			Preload(model, mode, size, false);
+	}
+}
+
+
 status_t 
 IconCache::Preload(const char *fileType, IconDrawMode mode, icon_size size)
 {
@@ -1133,6 +1430,8 @@ IconCache::Removing(const Model *model)
 void 
 IconCache::Deleting(const BView *view)
 {
+	fLoader->Cancel(view);
+
 	AutoLock<SimpleIconCache> lock(&fNodeCache);
 	fNodeCache.Deleting(view);
 }
@@ -1158,24 +1457,49 @@ IconCache::IconChanged(const char *mimeType, const char *appSignature)
 	if (!entry) 
 		return;
 
-	AutoLock<SimpleIconCache> nodeLock(&fNodeCache);
-	
 	entry = (SharedCacheEntry *)fSharedCache.ResolveIfAlias(entry);
 	ASSERT(entry);
 	int32 index = fSharedCache.EntryIndex(entry);
-	
-	fNodeCache.RemoveAliasesTo(index);
+
+	// node cache entries are never aliased to shared ones, only the
+	// shared cache needs to be cleaned up
 	fSharedCache.RemoveAliasesTo(index);
 
 	fSharedCache.IconChanged(entry);
 }
 
 
+bool
+IconCache::IsIconFrom(const Model *model, const char *mimeType,
+	const char *) const
+{
+	// <mimeType> has to be interned, just like the type the model holds,
+	// so this boils down to comparing their keys
+	ASSERT(mimeType == FindInternedMimeString(mimeType));
+
+	switch (model->IconFrom()) {
+		case kNode:
+		case kUnknownSource:
+		case kUnknownNotFromNode:
+			// icon doesn't come from the metamime or isn't known yet
+			return false;
+
+		default:
+			break;
+	}
+
+	// ToDo:
+	// add supertype compare
+	return MimeStringKey(model->MimeType()) == MimeStringKey(mimeType);
+}
+
+
 BBitmap * 
 IconCache::MakeSelectedIcon(const BBitmap *normal, icon_size size,
 	LazyBitmapAllocator *lazyBitmap)
 {
-	return MakeTransformedIcon(normal, size, fHiliteTable, lazyBitmap);
+	return MakeTransformedIcon(normal, size, fHiliteTable, fHiliteChannelTable,
+		lazyBitmap);
 }
 
 #if xDEBUG
@@ -1215,6 +1539,11 @@ IconCache::InitHiliteTable()
 	for (int32 index = 0; index < kColorTransformTableSize; index++) {
 		color = screen.ColorForIndex((uchar)index);
 		fHiliteTable[index] = screen.IndexForColor(tint_color(color, 1.3f));
+
+		// tinting works on each channel separately, a gray ramp is enough
+		// to get the table for 32 bit icons
+		color.red = color.green = color.blue = (uint8)index;
+		fHiliteChannelTable[index] = tint_color(color, 1.3f).red;
 	}
 
 	fHiliteTable[B_TRANSPARENT_8_BIT] = B_TRANSPARENT_8_BIT;
@@ -1222,21 +1551,92 @@ IconCache::InitHiliteTable()
 }
 
 
+static void
+TransformBits8(const uint8 *src, uint8 *dest, int32 length,
+	const uint8 table[])
+{
+	// BBitmap bits are long aligned; look up eight pixels per round trip
+	// to memory. The bytes go back to where they came from in the word, so
+	// this works the same on either endianness
+	const uint32 *srcLongs = (const uint32 *)src;
+	uint32 *destLongs = (uint32 *)dest;
+	for (; length >= 8; length -= 8) {
+		uint32 first = *srcLongs++;
+		uint32 second = *srcLongs++;
+		*destLongs++ = (uint32)table[first & 0xff]
+			| ((uint32)table[(first >> 8) & 0xff] << 8)
+			| ((uint32)table[(first >> 16) & 0xff] << 16)
+			| ((uint32)table[first >> 24] << 24);
+		*destLongs++ = (uint32)table[second & 0xff]
+			| ((uint32)table[(second >> 8) & 0xff] << 8)
+			| ((uint32)table[(second >> 16) & 0xff] << 16)
+			| ((uint32)table[second >> 24] << 24);
+	}
+
+	src = (const uint8 *)srcLongs;
+	dest = (uint8 *)destLongs;
+	for (; length > 0; length--)
+		*dest++ = table[*src++];
+}
+
+
+static void
+TransformBits32(const uint8 *src, uint8 *dest, int32 length,
+	const uint8 channelTable[])
+{
+	// B_RGB32/B_RGBA32 are stored as blue, green, red, alpha in memory;
+	// alpha and the transparent magic color are left alone
+	const uint32 *srcLongs = (const uint32 *)src;
+	for (; length >= 4; length -= 4, src += 4, dest += 4) {
+		if (*srcLongs++ == B_TRANSPARENT_MAGIC_RGBA32) {
+			*(uint32 *)dest = B_TRANSPARENT_MAGIC_RGBA32;
+			continue;
+		}
+		dest[0] = channelTable[src[0]];
+		dest[1] = channelTable[src[1]];
+		dest[2] = channelTable[src[2]];
+		dest[3] = src[3];
+	}
+}
+
+
 BBitmap * 
 IconCache::MakeTransformedIcon(const BBitmap *src, icon_size /*size*/,
-	int32 colorTransformTable[], LazyBitmapAllocator *lazyBitmap)
+	const uint8 colorTransformTable[], const uint8 channelTransformTable[],
+	LazyBitmapAllocator *lazyBitmap)
 {
 	if (fInitHiliteTable)
 		InitHiliteTable();
 
 	BBitmap *result = lazyBitmap->Get();
 	int32 bitsLength = result->BitsLength();
-	// Do I need a SetBits here? could just copy/transform straight from src
-	result->SetBits(src->Bits(), bitsLength, 0, kDefaultIconDepth);
 
-	uchar *bits = (uchar *)result->Bits();
-	for (int32 index = 0; index < bitsLength; index++) 
-		bits[index] = (uchar)colorTransformTable[(uchar)bits[index]];
+	const uint8 *srcBits = (const uint8 *)src->Bits();
+	if (src->ColorSpace() != result->ColorSpace()
+		|| src->BitsLength() != bitsLength) {
+		// have the bitmap convert the source first, then transform in place
+		result->SetBits(src->Bits(), src->BitsLength(), 0, src->ColorSpace());
+		srcBits = (const uint8 *)result->Bits();
+	}
+
+	switch (result->ColorSpace()) {
+		case B_CMAP8:
+			TransformBits8(srcBits, (uint8 *)result->Bits(), bitsLength,
+				colorTransformTable);
+			break;
+
+		case B_RGB32:
+		case B_RGBA32:
+			TransformBits32(srcBits, (uint8 *)result->Bits(), bitsLength,
+				channelTransformTable);
+			break;
+
+		default:
+			TRESPASS();
+			if (srcBits != result->Bits())
+				memcpy(result->Bits(), srcBits, bitsLength);
+			break;
+	}
 
 	return result;
 }
@@ -1262,32 +1662,78 @@ IconCache::IconHitTest(BPoint where, const Model *model, IconDrawMode mode,
 }
 
 
+void
+IconCache::SetNodeIconBudget(size_t bytes)
+{
+	AutoLock<SimpleIconCache> lock(&fNodeCache);
+	fNodeCache.SetBudget(bytes);
+}
+
+
+void
+IconCache::GetStats(icon_cache_stats *nodeCacheStats,
+	icon_cache_stats *sharedCacheStats)
+{
+	if (nodeCacheStats) {
+		AutoLock<SimpleIconCache> lock(&fNodeCache);
+		fNodeCache.GetStats(nodeCacheStats);
+	}
+	if (sharedCacheStats) {
+		AutoLock<SimpleIconCache> lock(&fSharedCache);
+		fSharedCache.GetStats(sharedCacheStats);
+	}
+}
+
+
 void 
-IconCacheEntry::RetireIcons(BObjectList<BBitmap> *retiredBitmapList)
+IconCacheEntry::RetireIcons(BObjectList<RetiredBitmap> *retiredBitmapList)
 {
 	if (fLargeIcon) {
-		retiredBitmapList->AddItem(fLargeIcon);
+		retiredBitmapList->AddItem(new RetiredBitmap(fLargeIcon));
 		fLargeIcon = NULL;
 	}
 	if (fMiniIcon) {
-		retiredBitmapList->AddItem(fMiniIcon);
+		retiredBitmapList->AddItem(new RetiredBitmap(fMiniIcon));
 		fMiniIcon = NULL;
 	}
 	if (fHilitedLargeIcon) {
-		retiredBitmapList->AddItem(fHilitedLargeIcon);
+		retiredBitmapList->AddItem(new RetiredBitmap(fHilitedLargeIcon));
 		fHilitedLargeIcon = NULL;
 	}
 	if (fHilitedMiniIcon) {
-		retiredBitmapList->AddItem(fHilitedMiniIcon);
+		retiredBitmapList->AddItem(new RetiredBitmap(fHilitedMiniIcon));
 		fHilitedMiniIcon = NULL;
 	}
-	
-	int32 count = retiredBitmapList->CountItems();
-	if (count > 10 * 1024) {
-		PRINT(("nuking old icons from the retired bitmap list\n"));
-		for (count = 512; count > 0; count--)
-			delete retiredBitmapList->RemoveItemAt(0);
-	}
+}
+
+
+size_t
+IconCacheEntry::IconBytes() const
+{
+	size_t result = 0;
+	if (fLargeIcon)
+		result += fLargeIcon->BitsLength();
+	if (fMiniIcon)
+		result += fMiniIcon->BitsLength();
+	if (fHilitedLargeIcon)
+		result += fHilitedLargeIcon->BitsLength();
+	if (fHilitedMiniIcon)
+		result += fHilitedMiniIcon->BitsLength();
+
+	return result;
+}
+
+
+RetiredBitmap::RetiredBitmap(BBitmap *bitmap)
+	:	fBitmap(bitmap),
+		fRetiredAt(system_time())
+{
+}
+
+
+RetiredBitmap::~RetiredBitmap()
+{
+	delete fBitmap;
 }
 
 
@@ -1319,6 +1765,9 @@ void
 SharedIconCache::Draw(IconCacheEntry *entry, BView *view, BPoint where,
 	IconDrawMode mode, icon_size size, bool async)
 {
+	if (fRetiredBitmaps.CountItems())
+		ReclaimRetiredBitmaps();
+
 	((SharedCacheEntry *)entry)->Draw(view, where, mode, size, async);
 }
 
@@ -1340,15 +1789,28 @@ SharedIconCache::FindItem(const char *fileType, const char *appSignature) const
 	if (!fileType)
 		fileType = B_FILE_MIMETYPE;
 
+	// entries only ever hold interned strings, if either one hasn't been
+	// interned yet there can't be a matching entry
+	fileType = FindInternedMimeString(fileType);
+	appSignature = FindInternedMimeString(appSignature);
+	if (!fileType || !appSignature) {
+		fStats.misses++;
+		return NULL;
+	}
+
 	SharedCacheEntry *result = fHashTable.FindFirst(SharedCacheEntry::Hash(fileType,
 		appSignature));
 
-	if (!result)
+	if (!result) {
+		fStats.misses++;
 		return NULL;
+	}
 	
 	for(;;) {
-		if (result->fFileType == fileType && result->fAppSignature == appSignature) 
+		if (result->fFileType == fileType && result->fAppSignature == appSignature) {
+			fStats.hits++;
 			return result;
+		}
 		
 		if (result->fNext < 0)
 			break;
@@ -1356,6 +1818,7 @@ SharedIconCache::FindItem(const char *fileType, const char *appSignature) const
 		result = const_cast<SharedCacheEntry *>(&fElementArray.At(result->fNext));
 	}
 
+	fStats.misses++;
 	return NULL;
 }
 
@@ -1367,6 +1830,9 @@ SharedIconCache::AddItem(const char *fileType, const char *appSignature)
 	if (!fileType)
 		fileType = B_FILE_MIMETYPE;
 
+	fileType = InternMimeString(fileType);
+	appSignature = InternMimeString(appSignature);
+
 	SharedCacheEntry *result = &fHashTable.Add(SharedCacheEntry::Hash(fileType,
 		appSignature));
 	result->SetTo(fileType, appSignature);
@@ -1385,6 +1851,9 @@ SharedIconCache::AddItem(SharedCacheEntry **outstandingEntry, const char *fileTy
 	if (!fileType)
 		fileType = B_FILE_MIMETYPE;
 
+	fileType = InternMimeString(fileType);
+	appSignature = InternMimeString(appSignature);
+
 	SharedCacheEntry *result = &fHashTable.Add(SharedCacheEntry::Hash(fileType,
 		appSignature));
 	result->SetTo(fileType, appSignature);
@@ -1400,6 +1869,8 @@ SharedIconCache::IconChanged(SharedCacheEntry *entry)
 	// by now there should be no aliases to entry, just remove entry
 	// itself
 	ASSERT(entry->fAliasForIndex == -1);
+	ASSERT(entry->fFirstAlias == -1);
+	ReclaimRetiredBitmaps();
 	entry->RetireIcons(&fRetiredBitmaps);
 	fHashTable.Remove(entry);
 }
@@ -1408,32 +1879,87 @@ SharedIconCache::IconChanged(SharedCacheEntry *entry)
 void 
 SharedIconCache::RemoveAliasesTo(int32 aliasIndex)
 {
-	int32 count = fHashTable.VectorSize();
-	for (int32 index = 0; index < count; index++) {
-		SharedCacheEntry *entry = fHashTable.ElementAt(index);
-		if (entry->fAliasForIndex == aliasIndex)
-			fHashTable.Remove(entry);
+	SharedCacheEntry *original = fHashTable.ElementAt(aliasIndex);
+	int32 index = original->fFirstAlias;
+	original->fFirstAlias = -1;
+
+	while (index >= 0) {
+		SharedCacheEntry *alias = fHashTable.ElementAt(index);
+		ASSERT(alias->fAliasForIndex == aliasIndex);
+		index = alias->fNextAlias;
+		fHashTable.Remove(alias);
 	}
 }
 
 
 void 
-SharedIconCache::SetAliasFor(IconCacheEntry *alias, const SharedCacheEntry *original) const
+SharedIconCache::SetAliasFor(IconCacheEntry *alias, const SharedCacheEntry *original)
 {
+	// only shared cache entries get aliased; chain the alias up with
+	// the others of <original> so that RemoveAliasesTo can find them
+	SharedCacheEntry *sharedAlias = (SharedCacheEntry *)alias;
+	int32 index = fHashTable.ElementIndex(sharedAlias);
+	ASSERT(index >= 0);
+	ASSERT(alias->fAliasForIndex == -1);
+
 	alias->fAliasForIndex = fHashTable.ElementIndex(original);
+	SharedCacheEntry *target = fHashTable.ElementAt(alias->fAliasForIndex);
+	sharedAlias->fNextAlias = target->fFirstAlias;
+	target->fFirstAlias = index;
+}
+
+
+const bigtime_t kRetiredBitmapDelay = 1000000;
+	// async draws get flushed long before a retired bitmap gets this old
+
+
+void
+SharedIconCache::ReclaimRetiredBitmaps()
+{
+	// bitmaps are retired in order, the oldest ones are up front
+	bigtime_t now = system_time();
+	while (fRetiredBitmaps.CountItems() > 0
+		&& now - fRetiredBitmaps.FirstItem()->fRetiredAt > kRetiredBitmapDelay)
+		delete fRetiredBitmaps.RemoveItemAt(0);
+}
+
+
+void
+SharedIconCache::GetStats(icon_cache_stats *stats) const
+{
+	*stats = fStats;
+	stats->bytes = 0;
+
+	int32 count = fHashTable.VectorSize();
+	for (int32 index = 0; index < count; index++) {
+		// aliases do not own any bitmaps, unused slots do not have any
+		const SharedCacheEntry *entry = fHashTable.ElementAt(index);
+		if (entry->fAliasForIndex < 0)
+			stats->bytes += entry->IconBytes();
+	}
+
+	count = fRetiredBitmaps.CountItems();
+	for (int32 index = 0; index < count; index++)
+		stats->bytes += fRetiredBitmaps.ItemAt(index)->fBitmap->BitsLength();
 }
 
 
 SharedCacheEntry::SharedCacheEntry()
-	:	fNext(-1)
+	:	fNext(-1),
+		fFileType(InternMimeString(NULL)),
+		fAppSignature(InternMimeString(NULL)),
+		fFirstAlias(-1),
+		fNextAlias(-1)
 {
 }
 
 
 SharedCacheEntry::SharedCacheEntry(const char *fileType, const char *appSignature)
 	:	fNext(-1),
-		fFileType(fileType),
-		fAppSignature(appSignature)
+		fFileType(InternMimeString(fileType)),
+		fAppSignature(InternMimeString(appSignature)),
+		fFirstAlias(-1),
+		fNextAlias(-1)
 {
 }
 
@@ -1464,9 +1990,11 @@ SharedCacheEntry::Draw(BView *view, BPoint where, IconDrawMode mode, icon_size s
 uint32 
 SharedCacheEntry::Hash(const char *fileType, const char *appSignature)
 {
-	uint32 hash = HashString(fileType, 0);
+	// the strings are interned, so their addresses are enough to tell
+	// them apart; no need to walk the characters
+	uint32 hash = (uint32)(size_t)fileType >> 3;
 	if (appSignature && appSignature[0])
-		hash = HashString(appSignature, hash);
+		hash ^= ((uint32)(size_t)appSignature >> 3) * 31;
 
 	return hash;
 }
@@ -1475,11 +2003,7 @@ SharedCacheEntry::Hash(const char *fileType, const char *appSignature)
 uint32 
 SharedCacheEntry::Hash() const
 {
-	uint32 hash = HashString(fFileType.String(), 0);
-	if (fAppSignature.Length())
-		hash = HashString(fAppSignature.String(), hash);
-
-	return hash;
+	return Hash(fFileType, fAppSignature);
 }
 
 
@@ -1493,6 +2017,9 @@ SharedCacheEntry::operator==(const SharedCacheEntry &entry) const
 void 
 SharedCacheEntry::SetTo(const char *fileType, const char *appSignature)
 {
+	ASSERT(fileType == FindInternedMimeString(fileType));
+	ASSERT(appSignature == FindInternedMimeString(appSignature));
+
 	fFileType = fileType;
 	fAppSignature = appSignature;
 }
@@ -1516,7 +2043,10 @@ SharedCacheEntryArray::Add()
 
 NodeCacheEntry::NodeCacheEntry(bool permanent)
 	:	fNext(-1),
-		fPermanent(permanent)
+		fPermanent(permanent),
+		fOlder(-1),
+		fNewer(-1),
+		fBytes(0)
 {
 }
 
@@ -1524,7 +2054,10 @@ NodeCacheEntry::NodeCacheEntry(bool permanent)
 NodeCacheEntry::NodeCacheEntry(const node_ref *node, bool permanent)
 	:	fNext(-1),
 		fRef(*node),
-		fPermanent(permanent)
+		fPermanent(permanent),
+		fOlder(-1),
+		fNewer(-1),
+		fBytes(0)
 {
 }
 
@@ -1604,16 +2137,24 @@ NodeCacheEntry::MakePermanent()
 //	#pragma mark -
 
 
+const size_t kDefaultNodeIconBudget = 8 * 1024 * 1024;
+	// TrackerSettings overrides this, see NodeIconCacheSize()
+
+
 NodeIconCache::NodeIconCache()
 #if DEBUG
 	:	SimpleIconCache("Node Icon cache aka \"The Dead-Locker\""),
 		fHashTable(20),
-		fElementArray(20)
+		fElementArray(20),
 #else
 	:	SimpleIconCache("Tracker node icon cache"),
 		fHashTable(100),
-		fElementArray(100)
+		fElementArray(100),
 #endif
+		fNewest(-1),
+		fOldest(-1),
+		fUsedBytes(0),
+		fBudget(kDefaultNodeIconBudget)
 {
 	fHashTable.SetElementVector(&fElementArray);
 }
@@ -1643,12 +2184,16 @@ NodeIconCache::FindItem(const node_ref *node) const
 {
 	NodeCacheEntry *result = fHashTable.FindFirst(NodeCacheEntry::Hash(node));
 
-	if (!result)
+	if (!result) {
+		fStats.misses++;
 		return NULL;
+	}
 	
 	for(;;) {
-		if (*result->Node() == *node)
+		if (*result->Node() == *node) {
+			fStats.hits++;
 			return result;
+		}
 		
 		if (result->fNext < 0)
 			break;
@@ -1656,6 +2201,7 @@ NodeIconCache::FindItem(const node_ref *node) const
 		result = const_cast<NodeCacheEntry *>(&fElementArray.At(result->fNext));
 	}
 
+	fStats.misses++;
 	return NULL;
 }
 
@@ -1667,6 +2213,8 @@ NodeIconCache::AddItem(const node_ref *node, bool permanent)
 	result->SetTo(node);
 	if (permanent)
 		result->MakePermanent();
+	else
+		Link(fHashTable.ElementIndex(result));
 
 	return result;
 }
@@ -1679,6 +2227,7 @@ NodeIconCache::AddItem(NodeCacheEntry **outstandingEntry, const node_ref *node)
 
 	NodeCacheEntry *result = &fHashTable.Add(NodeCacheEntry::Hash(node));
 	result->SetTo(node);
+	Link(fHashTable.ElementIndex(result));
 	*outstandingEntry = fHashTable.ElementAt(entryToken);
 
 	return result;
@@ -1688,12 +2237,12 @@ NodeIconCache::AddItem(NodeCacheEntry **outstandingEntry, const node_ref *node)
 void 
 NodeIconCache::Deleting(const node_ref *node)
 {
+	// the entry may have been evicted already
 	NodeCacheEntry *entry = FindItem(node);
-	ASSERT(entry);
 	if (!entry || entry->Permanent())
 		return;
 	
-	fHashTable.Remove(entry);
+	Remove(entry);
 }
 
 
@@ -1701,11 +2250,97 @@ void
 NodeIconCache::Removing(const node_ref *node)
 {
 	NodeCacheEntry *entry = FindItem(node);
-	ASSERT(entry);
 	if (!entry)
 		return;
 	
+	Remove(entry);
+}
+
+
+void
+NodeIconCache::Touch(NodeCacheEntry *entry)
+{
+	size_t bytes = entry->IconBytes();
+	fUsedBytes = fUsedBytes - entry->fBytes + bytes;
+	entry->fBytes = bytes;
+
+	int32 index = fHashTable.ElementIndex(entry);
+	if (!entry->Permanent() && index != fNewest) {
+		Unlink(index);
+		Link(index);
+	}
+
+	while (fUsedBytes > fBudget && fOldest >= 0 && fOldest != index) {
+		Remove(fHashTable.ElementAt(fOldest));
+		fStats.evictions++;
+	}
+}
+
+
+void
+NodeIconCache::SetBudget(size_t bytes)
+{
+	fBudget = bytes;
+	while (fUsedBytes > fBudget && fOldest >= 0) {
+		Remove(fHashTable.ElementAt(fOldest));
+		fStats.evictions++;
+	}
+}
+
+
+void
+NodeIconCache::GetStats(icon_cache_stats *stats) const
+{
+	*stats = fStats;
+	stats->bytes = (int64)fUsedBytes;
+}
+
+
+void
+NodeIconCache::Remove(NodeCacheEntry *entry)
+{
+	if (!entry->Permanent())
+		Unlink(fHashTable.ElementIndex(entry));
+
+	fUsedBytes -= entry->fBytes;
 	fHashTable.Remove(entry);
+		// node icons are always drawn synchronously, the bitmaps can go
+		// right away
+}
+
+
+void
+NodeIconCache::Link(int32 index)
+{
+	// make <index> the most recently used entry
+	NodeCacheEntry *entry = fHashTable.ElementAt(index);
+	entry->fNewer = -1;
+	entry->fOlder = fNewest;
+	if (fNewest >= 0)
+		fHashTable.ElementAt(fNewest)->fNewer = index;
+	else
+		fOldest = index;
+
+	fNewest = index;
+}
+
+
+void
+NodeIconCache::Unlink(int32 index)
+{
+	NodeCacheEntry *entry = fHashTable.ElementAt(index);
+	if (entry->fNewer >= 0)
+		fHashTable.ElementAt(entry->fNewer)->fOlder = entry->fOlder;
+	else
+		fNewest = entry->fOlder;
+
+	if (entry->fOlder >= 0)
+		fHashTable.ElementAt(entry->fOlder)->fNewer = entry->fNewer;
+	else
+		fOldest = entry->fNewer;
+
+	entry->fOlder = -1;
+	entry->fNewer = -1;
 }
 
 
@@ -1725,18 +2360,6 @@ NodeIconCache::IconChanged(const Model *model)
 }
 
 
-void 
-NodeIconCache::RemoveAliasesTo(int32 aliasIndex)
-{
-	int32 count = fHashTable.VectorSize();
-	for (int32 index = 0; index < count; index++) {
-		NodeCacheEntry *entry = fHashTable.ElementAt(index);
-		if (entry->fAliasForIndex == aliasIndex)
-			fHashTable.Remove(entry);
-	}
-}
-
-
 //	#pragma mark -
 
 
@@ -1759,6 +2382,7 @@ NodeCacheEntryArray::Add()
 SimpleIconCache::SimpleIconCache(const char *name)
 	:	fLock(name)
 {
+	memset(&fStats, 0, sizeof(fStats));
 }
 
 
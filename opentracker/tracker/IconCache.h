@@ -39,6 +39,7 @@ All rights reserved.
 #define __NU_ICON_CACHE__
 
 #include <Bitmap.h>
+#include <Handler.h>
 #include <Mime.h>
 #include <String.h>
 
@@ -53,11 +54,17 @@ All rights reserved.
 // icon use the node cache;
 // Entries are only deleted from the shared cache if an icon for a mime type changes,
 // this makes async icon drawing easier. Node cache deletes it's entries whenever a
-// file gets deleted.
+// file gets deleted, and the least recently used ones once they take up more
+// memory than the node icon budget allows.
 
 // if a view ever uses the cache to draw in async mode, it needs to call
 // it when it is being destroyed
 
+// A view that passes a load target to Draw does not wait for icons that are
+// not cached yet; those get loaded by a couple of background threads while
+// a placeholder is drawn, then the target gets a kIconLoaded message and
+// can invalidate the pose.
+
 namespace BPrivate {
 
 class Model;
@@ -65,6 +72,12 @@ class ModelNodeLazyOpener;
 class LazyBitmapAllocator;
 class SharedIconCache;
 class SharedCacheEntry;
+class IconLoader;
+
+const uint32 kIconLoaded = 'Ticl';
+	// sent to the load target of IconCache::Draw; "device" and "node" are
+	// the node_ref of the model that was drawn, "source" is the IconSource
+	// the icon ended up coming from
 
 enum IconDrawMode {
 	// Difrent states of icon drawing
@@ -110,6 +123,24 @@ enum IconSource {
 	kNode
 };
 
+struct icon_cache_stats {
+	int64 hits;			// lookups that found an entry
+	int64 misses;		// lookups that did not
+	int64 evictions;	// entries dropped to stay within the budget
+	int64 bytes;		// bitmap memory held, including retired bitmaps
+};
+
+class RetiredBitmap {
+	// a bitmap that is no longer used by the cache but may still be
+	// referenced by an async draw that has not been flushed yet
+public:
+	RetiredBitmap(BBitmap *);
+	~RetiredBitmap();
+
+	BBitmap *fBitmap;
+	bigtime_t fRetiredAt;
+};
+
 class IconCacheEntry {
 	// aliased entries don't own their icons, just point
 	// to some other entry that does
@@ -122,7 +153,7 @@ public:
 	IconCacheEntry();
 	~IconCacheEntry();
 	
-	void SetAliasFor(const SharedIconCache *, const SharedCacheEntry *);
+	void SetAliasFor(SharedIconCache *, const SharedCacheEntry *);
 	static IconCacheEntry *ResolveIfAlias(const SharedIconCache *, IconCacheEntry *);
 	IconCacheEntry *ResolveIfAlias(const SharedIconCache *);
 	
@@ -143,14 +174,13 @@ public:
 	bool IconHitTest(BPoint, IconDrawMode , icon_size) const;
 		// given a point, returns true if a non-transparent pixel was hit
 
-	void RetireIcons(BObjectList<BBitmap> *retiredBitmapList);
+	void RetireIcons(BObjectList<RetiredBitmap> *retiredBitmapList);
 		// can't just delete icons, they may be still drawing
-		// async; instead, put them on the retired list and
-		// only delete the list if it grows too much, way after
-		// the icon finishes drawing
-		// 
-		// This could fail if we retire a lot of icons (10 * 1024)
-		// while we are drawing them, shouldn't be a practical problem
+		// async; instead, put them on the retired list, they get
+		// deleted once they have been there for a while
+
+	size_t IconBytes() const;
+		// memory used by the bitmaps the entry owns
 
 protected:
 
@@ -183,7 +213,11 @@ public:
 	bool Lock();
 	void Unlock();
 	bool IsLocked() const;
-	
+
+protected:
+	mutable icon_cache_stats fStats;
+		// updated with the cache locked
+
 private:
 	Benaphore fLock;
 };
@@ -207,11 +241,16 @@ public:
 	static uint32 Hash(const char *fileType, const char *appSignature = 0);
 	bool operator==(const SharedCacheEntry &) const;
 	void SetTo(const char *fileType, const char *appSignature = 0);
+		// expects interned strings
 
 	int32 fNext;
 private:
-	BString fFileType;
-	BString fAppSignature;
+	const char *fFileType;
+	const char *fAppSignature;
+		// both interned, see InternMimeString()
+	int32 fFirstAlias;
+	int32 fNextAlias;
+		// entries aliased to this one are chained up through fNextAlias
 
 	friend class SharedIconCache;
 };
@@ -242,19 +281,23 @@ public:
 		// adding to the hash table makes any pending pointer invalid
 	void IconChanged(SharedCacheEntry *);
 
-	void SetAliasFor(IconCacheEntry *alias, const SharedCacheEntry *original) const;
+	void SetAliasFor(IconCacheEntry *alias, const SharedCacheEntry *original);
 	IconCacheEntry *ResolveIfAlias(IconCacheEntry *entry) const;
 	int32 EntryIndex(const SharedCacheEntry *entry) const;
 
 	void RemoveAliasesTo(int32 index);
 
+	void GetStats(icon_cache_stats *) const;
+
 private:
+	void ReclaimRetiredBitmaps();
+
 	OpenHashTable<SharedCacheEntry, SharedCacheEntryArray> fHashTable;
 	SharedCacheEntryArray fElementArray;
-	BObjectList<BBitmap> fRetiredBitmaps;
+	BObjectList<RetiredBitmap> fRetiredBitmaps;
 		// icons are drawn asynchronously, can't just delete them
 		// right away, instead have to place them onto the retired bitmap list
-		// and wait for the next sync to delete them
+		// and wait until any draw using them is long done
 };
 
 class NodeCacheEntry : public IconCacheEntry {
@@ -281,6 +324,11 @@ private:
 	node_ref fRef;
 	bool fPermanent;
 		// special cache entry that has to be deleted explicitly
+	int32 fOlder;
+	int32 fNewer;
+		// LRU chain, permanent entries are not part of it
+	size_t fBytes;
+		// bitmap memory accounted for the entry when last touched
 
 	friend class NodeIconCache;
 };
@@ -316,12 +364,25 @@ public:
 	void Deleting(const BView *);
 	void IconChanged(const Model *);
 
-
-	void RemoveAliasesTo(int32 index);
+	void Touch(NodeCacheEntry *);
+		// entry got used and may have picked up new bitmaps; makes it the
+		// most recently used one and evicts the least recently used ones
+		// if that puts the cache over budget. Any entry pointer other than
+		// the touched one may be invalid after the call
+	void SetBudget(size_t bytes);
+	void GetStats(icon_cache_stats *) const;
 
 private:
+	void Remove(NodeCacheEntry *);
+	void Link(int32 index);
+	void Unlink(int32 index);
+
 	OpenHashTable<NodeCacheEntry, NodeCacheEntryArray> fHashTable;
 	NodeCacheEntryArray fElementArray;
+	int32 fNewest;
+	int32 fOldest;
+	size_t fUsedBytes;
+	size_t fBudget;
 };
 
 const int32 kColorTransformTableSize = 256;
@@ -329,11 +390,14 @@ const int32 kColorTransformTableSize = 256;
 class IconCache {
 public:
 	IconCache();
+	~IconCache();
 	
 	void Draw(Model *, BView *, BPoint where, IconDrawMode mode,
-		icon_size size, bool async = false);
+		icon_size size, bool async = false, BHandler *loadTarget = NULL);
 		// draw an icon for a model, load the icon from the appropriate
-		// location if not cached already
+		// location if not cached already; with a <loadTarget>, icons that
+		// would have to be read from disk get loaded in the background
+		// and a placeholder is drawn in the meantime
 
 	void SyncDraw(Model *, BView *, BPoint , IconDrawMode ,
 		icon_size , void (*)(BView *, BPoint, BBitmap *, void *), 
@@ -346,6 +410,10 @@ public:
 	// icon, used for common tracker types, etc; Not calling these should only
 	// cause a slowdown
 	void Preload(Model *, IconDrawMode mode, icon_size size, bool permanent = false);
+	void Preload(const BObjectList<Model> *, IconDrawMode mode, icon_size size);
+		// builds the <mode> variants for a batch of models up front, so that
+		// drawing them afterwards only blits; models whose icons are not
+		// cached yet are skipped
 	status_t Preload(const char *mimeType, IconDrawMode mode, icon_size size);
 
 	void Deleting(const Model *);
@@ -370,6 +438,12 @@ public:
 
 	bool IconHitTest(BPoint, const Model *, IconDrawMode , icon_size );
 
+	void SetNodeIconBudget(size_t bytes);
+		// icons nodes define themselves are dropped least recently used
+		// first once they take up more than <bytes>; permanent ones stay
+	void GetStats(icon_cache_stats *nodeCacheStats,
+		icon_cache_stats *sharedCacheStats);
+
 	// utility calls for building specialized icons
 	BBitmap *MakeSelectedIcon(const BBitmap *normal, icon_size,
 		LazyBitmapAllocator *);
@@ -382,6 +456,14 @@ public:
 private:
 	
 	// shared calls
+	bool NeedsLoading(const Model *, icon_size, bool *evicted = NULL);
+		// true if drawing the icon for the model would hit the disk;
+		// <evicted> tells if its node icon entry is gone altogether
+	bool DrawPlaceholder(Model *, BView *, BPoint where, IconDrawMode mode,
+		icon_size size, bool async);
+		// draws the cached icon of the model's type or the generic icon;
+		// fails if neither one is cached
+
 	IconCacheEntry *Preload(AutoLock<SimpleIconCache> *nodeCache,
 		AutoLock<SimpleIconCache> *sharedCache,
 		AutoLock<SimpleIconCache> **resultingLockedCache,
@@ -430,14 +512,20 @@ private:
 		LazyBitmapAllocator *lazyBitmap, IconCacheEntry *entry);
 
 	BBitmap *MakeTransformedIcon(const BBitmap *, icon_size,
-		int32 colorTransformTable [], LazyBitmapAllocator *);
+		const uint8 colorTransformTable[], const uint8 channelTransformTable[],
+		LazyBitmapAllocator *);
+		// transforms straight from <src> into the new bitmap; 8 bit icons
+		// are mapped through <colorTransformTable>, 32 bit ones through
+		// <channelTransformTable> one channel at a time
 
 	NodeIconCache fNodeCache;
 	SharedIconCache fSharedCache;
+	IconLoader *fLoader;
 
 	void InitHiliteTable();
 
-	int32 fHiliteTable[kColorTransformTableSize];
+	uint8 fHiliteTable[kColorTransformTableSize];
+	uint8 fHiliteChannelTable[kColorTransformTableSize];
 	bool fInitHiliteTable;
 		// on if we still need to initialize the hilite table
 };
@@ -465,13 +553,13 @@ private:
 inline const char *
 SharedCacheEntry::FileType() const
 {
-	return fFileType.String();
+	return fFileType;
 }
 
 inline const char *
 SharedCacheEntry::AppSignature() const
 {
-	return fAppSignature.String();
+	return fAppSignature;
 }
 
 inline bool 
@@ -44,9 +44,9 @@ All rights reserved.
 
 ModelMenuItem::ModelMenuItem(const Model *model, const char *title,
 		BMessage *message, char shortcut, uint32 modifiers,
-		bool drawText, bool extraPad)
+		bool drawText, bool extraPad, bool reopenModel)
 	: BMenuItem(title, message, shortcut, modifiers),
-	fModel(*model),
+	fModel(*model, reopenModel),
 	fHeightDelta(0),
 	fDrawText(drawText),
 	fExtraPad(extraPad)
@@ -68,9 +68,9 @@ ModelMenuItem::ModelMenuItem(const Model *model, const char *title,
 
 
 ModelMenuItem::ModelMenuItem(const Model *model, BMenu *menu, bool drawText,
-	bool extraPad)
+	bool extraPad, bool reopenModel)
 	:	BMenuItem(menu),
-		fModel(*model),
+		fModel(*model, reopenModel),
 		fHeightDelta(0),
 		fDrawText(drawText),
 		fExtraPad(extraPad)
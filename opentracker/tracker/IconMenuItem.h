@@ -68,8 +68,12 @@ class IconMenuItem : public PositionPassingMenuItem {
 class ModelMenuItem : public BMenuItem {
 	public:
 		ModelMenuItem(const Model *, const char *title, BMessage *, char shortcut = '\0',
-			uint32 modifiers = 0, bool drawText = true, bool extraPad = false);
-		ModelMenuItem(const Model *, BMenu *, bool drawText = true, bool extraPad = false);
+			uint32 modifiers = 0, bool drawText = true, bool extraPad = false,
+			bool reopenModel = true);
+		ModelMenuItem(const Model *, BMenu *, bool drawText = true, bool extraPad = false,
+			bool reopenModel = true);
+			// with <reopenModel> false the item copies the model without
+			// opening its node again, see Model(const Model &, bool)
 		virtual ~ModelMenuItem();
 
 		virtual	status_t SetEntry(const BEntry *);
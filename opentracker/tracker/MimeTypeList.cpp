@@ -34,21 +34,22 @@ All rights reserved.
 
 #include <Mime.h>
 
+#include <string.h>
+
 #include "AutoLock.h"
 #include "MimeTypeList.h"
 #include "Thread.h"
 
 
 ShortMimeInfo::ShortMimeInfo(const BMimeType &mimeType)
-	:	fCommonMimeType(true)
+	:	fPrivateName(InternMimeString(mimeType.Type())),
+		fCommonMimeType(true)
 {
-	fPrivateName = mimeType.Type();
-
 	char buffer[B_MIME_TYPE_LENGTH];
 
 	// weed out apps - their preferred handler is themselves
 	if (mimeType.GetPreferredApp(buffer) == B_OK
-		&& fPrivateName.ICompare(buffer) == 0)
+		&& strcasecmp(buffer, fPrivateName) == 0)
 		fCommonMimeType = false;
 
 	// weed out metamimes without a short description
@@ -60,14 +61,15 @@ ShortMimeInfo::ShortMimeInfo(const BMimeType &mimeType)
 
 
 ShortMimeInfo::ShortMimeInfo(const char *shortDescription)
-	:	fShortDescription(shortDescription)
+	:	fPrivateName(InternMimeString(NULL)),
+		fShortDescription(shortDescription)
 {
 }
 
 const char *
 ShortMimeInfo::InternalName() const
 {
-	return fPrivateName.String();
+	return fPrivateName;
 }
 
 const char *
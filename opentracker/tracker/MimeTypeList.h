@@ -56,7 +56,8 @@ public:
 private:
 	ShortMimeInfo(const char *shortDescription);
 
-	BString fPrivateName;
+	const char *fPrivateName;
+		// interned, see InternMimeString()
 	BString fShortDescription;
 	bool fCommonMimeType;
 
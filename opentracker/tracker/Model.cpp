@@ -67,6 +67,8 @@ All rights reserved.
 #include "FSUtils.h"
 #include "MimeTypes.h"
 #include "IconCache.h"
+#include "NodeAttributes.h"
+#include "SlabAllocator.h"
 #include "Tracker.h"
 #include "Utilities.h"
 
@@ -84,8 +86,26 @@ bool CheckNodeIconHintPrivate(const BNode *, bool);
 }
 
 
+static SlabAllocator sModelAllocator("model allocator", sizeof(Model));
+
+
+void *
+Model::operator new(size_t size)
+{
+	return sModelAllocator.Allocate(size);
+}
+
+
+void
+Model::operator delete(void *model)
+{
+	sModelAllocator.Free(model);
+}
+
+
 Model::Model()
 	:
+	fMimeType(InternMimeString(NULL)),
 	fPreferredAppName(NULL),
 	fBaseType(kUnknownNode),
 	fIconFrom(kUnknownSource),
@@ -106,6 +126,39 @@ Model::Model(const Model &cloneThis)
 	fWritable(false),
 	fNode(NULL)
 {
+	CloneFrom(cloneThis, true);
+}
+
+
+Model::Model(const Model &cloneThis, bool reopen)
+	:
+	fEntryRef(cloneThis.fEntryRef),
+	fMimeType(cloneThis.fMimeType),
+	fPreferredAppName(NULL),
+	fBaseType(cloneThis.fBaseType),
+	fIconFrom(cloneThis.fIconFrom),
+	fWritable(false),
+	fNode(NULL)
+{
+	CloneFrom(cloneThis, reopen);
+}
+
+
+void
+Model::CloneFrom(const Model &cloneThis, bool reopen)
+{
+	if (!reopen) {
+		fStatBuf = cloneThis.fStatBuf;
+		fStatus = cloneThis.fStatus;
+
+		if (cloneThis.IsSymLink() && cloneThis.LinkTo())
+			fLinkTo = new Model(*cloneThis.LinkTo(), false);
+		else if (cloneThis.IsVolume() && cloneThis.fVolumeName)
+			fVolumeName = strdup(cloneThis.fVolumeName);
+
+		return;
+	}
+
 	fStatBuf.st_dev = cloneThis.NodeRef()->device;
 	fStatBuf.st_ino = cloneThis.NodeRef()->node;
 	
@@ -125,18 +178,20 @@ Model::Model(const Model &cloneThis)
 
 
 Model::Model(const node_ref *dirNode, const node_ref *node, const char *name,
-	bool open, bool writable)
+	bool open, bool writable, NodeAttributes *attributes)
 	:
+	fMimeType(InternMimeString(NULL)),
 	fPreferredAppName(NULL),
 	fWritable(false),
 	fNode(NULL)
 {
-	SetTo(dirNode, node, name, open, writable);
+	SetTo(dirNode, node, name, open, writable, attributes);
 }
 
 
 Model::Model(const BEntry *entry, bool open, bool writable)
 	:
+	fMimeType(InternMimeString(NULL)),
 	fPreferredAppName(NULL),
 	fWritable(false),
 	fNode(NULL)
@@ -147,6 +202,7 @@ Model::Model(const BEntry *entry, bool open, bool writable)
 
 Model::Model(const entry_ref *ref, bool traverse, bool open, bool writable)
 	:
+	fMimeType(InternMimeString(NULL)),
 	fPreferredAppName(NULL),
 	fBaseType(kUnknownNode),
 	fIconFrom(kUnknownSource),
@@ -160,6 +216,55 @@ Model::Model(const entry_ref *ref, bool traverse, bool open, bool writable)
 }
 
 
+Model::Model(const entry_ref *ref, const node_ref *node, mode_t mode,
+	const char *mimeType, IconSource iconFrom)
+	:
+	fEntryRef(*ref),
+	fMimeType(mimeType),
+	fPreferredAppName(NULL),
+		// clears fLinkTo and fVolumeName as well, SetLinkTo relies on it
+	fBaseType(kUnknownNode),
+	fIconFrom(IconCache::NeedsDeletionNotification(iconFrom)
+		? kUnknownSource : iconFrom),
+	fWritable(false),
+	fNode(NULL),
+	fStatus(B_OK)
+{
+	memset(&fStatBuf, 0, sizeof(fStatBuf));
+	fStatBuf.st_dev = node->device;
+	fStatBuf.st_ino = node->node;
+	fStatBuf.st_mode = mode;
+
+	SetupBaseType();
+
+	// mirror the promotions OpenNodeCommon and FinishSettingUpType
+	// do once they get to look at the node
+	switch (fBaseType) {
+		case kPlainNode:
+		case kExecutableNode:
+			if (strcmp(fMimeType, B_QUERY_MIMETYPE) == 0)
+				fBaseType = kQueryNode;
+			else if (strcmp(fMimeType, B_QUERY_TEMPLATE_MIMETYPE) == 0)
+				fBaseType = kQueryTemplateNode;
+			break;
+
+		case kDirectoryNode:
+			if (strcmp(fMimeType, B_ROOT_MIMETYPE) == 0)
+				fBaseType = kRootNode;
+			else if (strcmp(fMimeType, B_VOLUME_MIMETYPE) == 0) {
+				fBaseType = kVolumeNode;
+
+				// the volume name does not need the node
+				char name[B_FILE_NAME_LENGTH];
+				BVolume volume(NodeRef()->device);
+				if (volume.InitCheck() == B_OK && volume.GetName(name) == B_OK)
+					fVolumeName = strdup(name);
+			}
+			break;
+	}
+}
+
+
 void 
 Model::DeletePreferredAppVolumeNameLinkTo()
 {
@@ -171,8 +276,6 @@ Model::DeletePreferredAppVolumeNameLinkTo()
 
 	} else if (IsVolume())
 		free(fVolumeName);
-	else
-		free(fPreferredAppName);
 
 	fPreferredAppName = NULL;
 }
@@ -209,7 +312,7 @@ Model::SetTo(const BEntry *entry, bool open, bool writable)
 	DeletePreferredAppVolumeNameLinkTo();
 	fIconFrom = kUnknownSource;
 	fBaseType = kUnknownNode;
-	fMimeType = "";
+	fMimeType = InternMimeString(NULL);
 
 	fStatus = entry->GetRef(&fEntryRef);
 	if (fStatus != B_OK)
@@ -235,7 +338,7 @@ Model::SetTo(const entry_ref *newRef, bool traverse, bool open, bool writable)
 	DeletePreferredAppVolumeNameLinkTo();
 	fIconFrom = kUnknownSource;
 	fBaseType = kUnknownNode;
-	fMimeType = "";
+	fMimeType = InternMimeString(NULL);
 
 	BEntry tmpEntry(newRef, traverse);
 	fStatus = tmpEntry.InitCheck();
@@ -261,14 +364,14 @@ Model::SetTo(const entry_ref *newRef, bool traverse, bool open, bool writable)
 
 status_t 
 Model::SetTo(const node_ref *dirNode, const node_ref *nodeRef, const char *name,
-	bool open, bool writable)
+	bool open, bool writable, NodeAttributes *attributes)
 {
 	delete fNode;
 	fNode = NULL;
 	DeletePreferredAppVolumeNameLinkTo();
 	fIconFrom = kUnknownSource;
 	fBaseType = kUnknownNode;
-	fMimeType = "";
+	fMimeType = InternMimeString(NULL);
 
 	fStatBuf.st_dev = nodeRef->device;
 	fStatBuf.st_ino = nodeRef->node;
@@ -285,7 +388,7 @@ Model::SetTo(const node_ref *dirNode, const node_ref *nodeRef, const char *name,
 	if (fStatus != B_OK)
 		return fStatus;
 
-	fStatus = OpenNode(writable);
+	fStatus = OpenNodeCommon(writable, attributes);
 
 	if (!open)
 		CloseNode();
@@ -374,7 +477,7 @@ Model::UpdateStatAndOpenNode(bool writable)
 
 
 status_t
-Model::OpenNodeCommon(bool writable)
+Model::OpenNodeCommon(bool writable, NodeAttributes *attributes)
 {
 #if xDEBUG
 	PRINT(("opening node for %s\n", Name()));
@@ -443,8 +546,8 @@ Model::OpenNodeCommon(bool writable)
 
 	fWritable = writable;
 
-	if (!fMimeType.Length())
-		FinishSettingUpType();
+	if (!fMimeType[0])
+		FinishSettingUpType(attributes);
 
 #ifdef CHECK_OPEN_MODEL_LEAKS
 	if (fWritable) {
@@ -532,58 +635,85 @@ Model::SetupBaseType()
 
 
 void
-Model::FinishSettingUpType()
+Model::FinishSettingUpType(NodeAttributes *attributes)
 {
-	char mimeString[B_MIME_TYPE_LENGTH];
-
-	// while we are reading the node, do a little
-	// snooping to see if it even makes sense to look for a node-based
-	// icon
-	// This serves as a hint to the icon cache, allowing it to not hit the
-	// disk again for models that do not have an icon defined by the node
-	if (IsNodeOpen()
-		&& fBaseType != kLinkNode
-		&& !CheckNodeIconHintPrivate(fNode, dynamic_cast<TTracker *>(be_app) == NULL)) {
+	// read everything needed below, plus whatever the caller asked for,
+	// in one go while the node is open
+	NodeAttributes localAttributes;
+	if (attributes == NULL)
+		attributes = &localAttributes;
+
+	if (IsNodeOpen()) {
+		uint32 wanted = 0;
+		switch (fBaseType) {
+			case kDirectoryNode:
+				wanted = kTypeAttribute;
+				break;
+
+			case kVolumeNode:
+			case kLinkNode:
+				break;
+
+			case kExecutableNode:
+				wanted = kTypeAttribute | kPreferredAppAttribute
+					| kAppSignatureAttribute;
+				break;
+
+			default:
+				wanted = kTypeAttribute | kPreferredAppAttribute;
+				break;
+		}
+
+		// while we are reading the node, do a little
+		// snooping to see if it even makes sense to look for a node-based
+		// icon
+		// This serves as a hint to the icon cache, allowing it to not hit the
+		// disk again for models that do not have an icon defined by the node
+		if (fBaseType != kLinkNode)
+			wanted |= kIconAttributes;
+
+		attributes->Read(fNode, wanted, dynamic_cast<TTracker *>(be_app) == NULL);
 			// when checking for the node icon hint, if we are libtracker, only check
 			// for small icons - checking for the large icons is a little more
 			// work for the filesystem and this will speed up the test.
 			// This makes node icons only work if there is a small and a large node
 			// icon on a file - for libtracker that is not a problem though
-		fIconFrom = kUnknownNotFromNode;
+
+		if (fBaseType != kLinkNode && !attributes->HasIcon())
+			fIconFrom = kUnknownNotFromNode;
 	}
 
 	if (fBaseType != kDirectoryNode
 		&& fBaseType != kVolumeNode
 		&& fBaseType != kLinkNode
 		&& IsNodeOpen()) {
-		BNodeInfo info(fNode);
-
 		// check if a specific mime type is set
-		if (info.GetType(mimeString) == B_OK) {
+		const char *mimeString = attributes->Type();
+		if (mimeString != NULL) {
 			// node has a specific mime type
-			fMimeType = mimeString;
+			fMimeType = InternMimeString(mimeString);
 			if (strcmp(mimeString, B_QUERY_MIMETYPE) == 0)
 				fBaseType = kQueryNode;
 			else if (strcmp(mimeString, B_QUERY_TEMPLATE_MIMETYPE) == 0)
 				fBaseType = kQueryTemplateNode;
 
-			if (info.GetPreferredApp(mimeString) == B_OK) {
+			const char *preferredApp = attributes->PreferredApp();
+			if (preferredApp != NULL) {
 				if (fPreferredAppName)
 					DeletePreferredAppVolumeNameLinkTo();
 
-				if (mimeString[0])
-					fPreferredAppName = strdup(mimeString); 
+				if (preferredApp[0])
+					fPreferredAppName = InternMimeString(preferredApp);
 			}
 		}
 	}
 
 	switch (fBaseType) {
 		case kDirectoryNode:
-			fMimeType = B_DIR_MIMETYPE;	// should use a shared string here
+			fMimeType = InternMimeString(B_DIR_MIMETYPE);
 			if (IsNodeOpen()) {
-				BNodeInfo info(fNode);
-				if (info.GetType(mimeString) == B_OK)
-					fMimeType = mimeString;
+				if (attributes->Type() != NULL)
+					fMimeType = InternMimeString(attributes->Type());
 
 				if (fIconFrom == kUnknownNotFromNode
 					&& WellKnowEntryList::Match(NodeRef()) > (directory_which)-1)
@@ -598,12 +728,12 @@ Model::FinishSettingUpType()
 				&& NodeRef()->device == fEntryRef.device) {
 				// promote from volume to file system root
 				fBaseType = kRootNode;
-				fMimeType = B_ROOT_MIMETYPE;
+				fMimeType = InternMimeString(B_ROOT_MIMETYPE);
 				break;
 			}
 
 			// volumes have to have a B_VOLUME_MIMETYPE type
-			fMimeType = B_VOLUME_MIMETYPE;
+			fMimeType = InternMimeString(B_VOLUME_MIMETYPE);
 			if (fIconFrom == kUnknownNotFromNode) {
 				if (WellKnowEntryList::Match(NodeRef()) > (directory_which)-1)
 					fIconFrom = kTrackerSupplied;
@@ -627,29 +757,27 @@ Model::FinishSettingUpType()
 		}
 
 		case kLinkNode:
-			fMimeType = B_LINK_MIMETYPE;	// should use a shared string here
+			fMimeType = InternMimeString(B_LINK_MIMETYPE);
 			break;
 
 		case kExecutableNode:
 			if (IsNodeOpen()) {
-				char signature[B_MIME_TYPE_LENGTH];
-				if (GetAppSignatureFromAttr(dynamic_cast<BFile *>(fNode), signature)
-					== B_OK) {
-
+				const char *signature = attributes->AppSignature();
+				if (signature != NULL) {
 					if (fPreferredAppName)
 						DeletePreferredAppVolumeNameLinkTo();
 
 					if (signature[0])
-						fPreferredAppName = strdup(signature); 
+						fPreferredAppName = InternMimeString(signature);
 				}
 			}
-			if (!fMimeType.Length())
-				fMimeType = B_APP_MIME_TYPE;	// should use a shared string here
+			if (!fMimeType[0])
+				fMimeType = InternMimeString(B_APP_MIME_TYPE);
 			break;
 
 		default:
-			if (!fMimeType.Length())
-				fMimeType = B_FILE_MIMETYPE;
+			if (!fMimeType[0])
+				fMimeType = InternMimeString(B_FILE_MIMETYPE);
 			break;
 	}
 }
@@ -681,10 +809,10 @@ Model::ResetIconFrom()
 const char *
 Model::PreferredAppSignature() const
 {
-	if (IsVolume() || IsSymLink())
-		return "";
+	if (IsVolume() || IsSymLink() || !fPreferredAppName)
+		return InternMimeString(NULL);
 
-	return fPreferredAppName ? fPreferredAppName : "";
+	return fPreferredAppName;
 }
 
 
@@ -692,12 +820,9 @@ void
 Model::SetPreferredAppSignature(const char *signature)
 {
 	ASSERT(!IsVolume() && !IsSymLink());
-	ASSERT(signature != fPreferredAppName);
-		// self assignment should not be an option
 
-	free(fPreferredAppName);
-	if (signature)
-		fPreferredAppName = strdup(signature);
+	if (signature && signature[0])
+		fPreferredAppName = InternMimeString(signature);
 	else
 		fPreferredAppName = NULL;
 }
@@ -823,10 +948,10 @@ Model::AttrChanged(const char *attrName)
 		char mimeString[B_MIME_TYPE_LENGTH];
 		BNodeInfo info(fNode);
 		if (info.GetType(mimeString) != B_OK)
-			fMimeType = "";
+			fMimeType = InternMimeString(NULL);
 		else {
 			// node has a specific mime type
-			fMimeType = mimeString;				
+			fMimeType = InternMimeString(mimeString);
 			if (!IsVolume()
 				&& !IsSymLink()
 				&& info.GetPreferredApp(mimeString) == B_OK)
@@ -1007,6 +1132,8 @@ Model::SupportsMimeType(const char *type, const BObjectList<BString> *list,
 	if (handlerInfo.GetSupportedTypes(&message) != B_OK) 
 		return kDoesNotSupportType;
 
+	BString typeString(type);
+
 	for (int32 index = 0; ; index++) {
 
 		// check if this model lists the type of dropped document as supported
@@ -1027,10 +1154,9 @@ Model::SupportsMimeType(const char *type, const BObjectList<BString> *list,
 		
 		int32 match;
 
-		if (type) {
-			BString typeString(type);
+		if (type)
 			match = MatchMimeTypeString(&typeString, mimeSignature);
-		} else
+		else
 			match = WhileEachListItem(const_cast<BObjectList<BString> *>(list),
 				MatchMimeTypeString, mimeSignature);
 				// const_cast shouldnt be here, have to have it until MW cleans up
@@ -1114,7 +1240,7 @@ Model::GetPath(BPath *path) const
 bool 
 Model::Mimeset(bool force)
 {
-	BString oldType = MimeType();
+	const char *oldType = fMimeType;
 	ModelNodeLazyOpener opener(this);
 	BPath path;
 	GetPath(&path);
@@ -1129,7 +1255,7 @@ Model::Mimeset(bool force)
 
 	AttrChanged(0);
 
-	return !oldType.ICompare(MimeType());
+	return MimeStringKey(oldType) == MimeStringKey(fMimeType);
 }
 
 
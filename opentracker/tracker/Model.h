@@ -63,6 +63,8 @@ typedef struct stat StatStruct;
 
 namespace BPrivate {
 
+class NodeAttributes;
+
 enum {
 	kDoesNotSupportType,
 	kSuperhandlerModel,
@@ -75,22 +77,38 @@ class Model {
 	public:
 		Model();
 		Model(const Model &);
+		Model(const Model &, bool reopen);
+			// with <reopen> false the copy takes what the other model found
+			// out as it is instead of opening the node again; it stays closed
 		Model(const BEntry *entry, bool open = false, bool writable = false);
 		Model(const entry_ref *, bool traverse = false, bool open = false,
 			bool writable = false);
 		Model(const node_ref *dirNode, const node_ref *node, const char *name,
-			bool open = false, bool writable = false);
+			bool open = false, bool writable = false,
+			NodeAttributes *attributes = NULL);
+			// if <attributes> are passed, what they ask for is read in the
+			// same go as the type and left in there
+		Model(const entry_ref *, const node_ref *, mode_t, const char *mimeType,
+			IconSource);
+			// sets up a closed model from what an earlier model of the same
+			// entry found out, without going to the disk; <mimeType> has to
+			// be interned
 		~Model();
 
 		Model& operator=(const Model &);
 
+		void *operator new(size_t);
+		void operator delete(void *);
+			// models come from a slab allocator, there are lots of them
+
 		status_t InitCheck() const;
 
 		status_t SetTo(const BEntry *, bool open = false, bool writable = false);
 		status_t SetTo(const entry_ref *, bool traverse = false, bool open = false,
 			bool writable = false);
 		status_t SetTo(const node_ref *dirNode, const node_ref *node, const char *name,
-			bool open = false, bool writable = false);
+			bool open = false, bool writable = false,
+			NodeAttributes *attributes = NULL);
 
 		int CompareFolderNamesFirst(const Model *compareModel) const;
 
@@ -119,6 +137,7 @@ class Model {
 		const char *MimeType() const;
 		const char *PreferredAppSignature() const;
 			// only not-null if not default for type and not self for app
+			// both strings are interned, see InternMimeString()
 		void SetPreferredAppSignature(const char *);
 
 		void GetPreferredAppForBrokenSymLink(BString &result);
@@ -202,9 +221,10 @@ class Model {
 		bool Mimeset(bool force);
 			// returns true if mime type changed
 	private:
-		status_t OpenNodeCommon(bool writable);
+		void CloneFrom(const Model &, bool reopen);
+		status_t OpenNodeCommon(bool writable, NodeAttributes * = NULL);
 		void SetupBaseType();
-		void FinishSettingUpType();
+		void FinishSettingUpType(NodeAttributes *);
 		void DeletePreferredAppVolumeNameLinkTo();
 
 		status_t FetchOneQuery(const BQuery *, BHandler *target,
@@ -232,11 +252,11 @@ class Model {
 
 		entry_ref fEntryRef;
 		StatStruct fStatBuf;
-		BString fMimeType;		// should use string that may be shared for common types
+		const char *fMimeType;	// interned, shared by all models of a type
 
 		// bit of overloading hackery here to save on footprint
 		union {
-			char *fPreferredAppName;	// used if we are neither a volume nor a symlink
+			const char *fPreferredAppName;	// used if we are neither a volume nor a symlink
 			char *fVolumeName;			// used if we are a volume
 			Model *fLinkTo;				// used if we are a symlink
 		};
@@ -302,7 +322,7 @@ void InitOpenModelDumping();
 inline const char *
 Model::MimeType() const
 {
-	return fMimeType.String();
+	return fMimeType;
 }
 
 inline const entry_ref *
@@ -0,0 +1,746 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+#include <Debug.h>
+#include <Directory.h>
+#include <NodeMonitor.h>
+
+#include <string.h>
+
+#include "AutoLock.h"
+#include "FSUtils.h"
+#include "FunctionObject.h"
+#include "Model.h"
+#include "NavListingCache.h"
+#include "NavMenu.h"
+#include "Thread.h"
+#include "Tracker.h"
+#include "TrackerSettings.h"
+
+
+const int32 kMaxListings = 64;
+const int32 kMaxListingEntries = 4096;
+	// entries in all listings together, each one costs a node monitor
+const int32 kMaxListingSize = 501;
+	// nav menus stop adding items after that
+const int32 kMaxPrefetchQueue = 32;
+const int32 kMaxPrefetchSubfolders = 16;
+
+enum {
+	kSortVolume,
+	kSortFolder,
+	kSortOther
+};
+
+namespace BPrivate {
+
+class NavListing {
+public:
+	NavListing(const node_ref *directory);
+
+	node_ref fDirectory;
+	BObjectList<NavListingEntry> fEntries;
+	bigtime_t fLastUsed;
+	bool fHideDotFiles;
+		// the setting the entries were filtered with
+	bool fWatchFailed;
+	bool fStale;
+		// changed while it was being read
+	bool fPrefetched;
+		// read in the background and not used since
+};
+
+NavListingCache *NavListingCache::sNavListingCache = NULL;
+
+}	// namespace BPrivate
+
+
+NavListingEntry::NavListingEntry(const Model *model)
+	:	fRef(*model->EntryRef()),
+		fNode(*model->NodeRef()),
+		fMimeType(model->MimeType()),
+		fMode(model->StatBuf()->st_mode),
+		fIconFrom(model->IconFrom()),
+		fTarget(NULL)
+{
+	if (model->IsSymLink() && model->LinkTo() != NULL)
+		fTarget = new NavListingEntry(model->LinkTo());
+
+	const Model *resolved = model->ResolveIfLink();
+	if (resolved->IsVolume())
+		fSortKind = kSortVolume;
+	else if (resolved->IsDirectory())
+		fSortKind = kSortFolder;
+	else
+		fSortKind = kSortOther;
+}
+
+
+NavListingEntry::NavListingEntry(const NavListingEntry &cloneThis)
+	:	fRef(cloneThis.fRef),
+		fNode(cloneThis.fNode),
+		fMimeType(cloneThis.fMimeType),
+		fMode(cloneThis.fMode),
+		fIconFrom(cloneThis.fIconFrom),
+		fSortKind(cloneThis.fSortKind),
+		fTarget(NULL)
+{
+	if (cloneThis.fTarget != NULL)
+		fTarget = new NavListingEntry(*cloneThis.fTarget);
+}
+
+
+NavListingEntry::~NavListingEntry()
+{
+	delete fTarget;
+}
+
+
+Model *
+NavListingEntry::NewModel() const
+{
+	Model *model = new Model(&fRef, &fNode, fMode, fMimeType,
+		(IconSource)fIconFrom);
+
+	if (fTarget != NULL)
+		model->SetLinkTo(fTarget->NewModel());
+
+	return model;
+}
+
+
+const entry_ref *
+NavListingEntry::ResolvedRef() const
+{
+	return fTarget != NULL ? &fTarget->fRef : &fRef;
+}
+
+
+bool
+NavListingEntry::IsFolder() const
+{
+	const NavListingEntry *resolved = fTarget != NULL ? fTarget : this;
+	return S_ISDIR(resolved->fMode);
+}
+
+
+int
+NavListingEntry::CompareNames(const NavListingEntry *entry1,
+	const NavListingEntry *entry2)
+{
+	return strcasecmp(entry1->fRef.name, entry2->fRef.name);
+}
+
+
+int
+NavListingEntry::CompareFolderNamesFirst(const NavListingEntry *entry1,
+	const NavListingEntry *entry2)
+{
+	if (entry1->fSortKind != entry2->fSortKind)
+		return entry1->fSortKind < entry2->fSortKind ? -1 : 1;
+
+	return strcasecmp(entry1->fRef.name, entry2->fRef.name);
+}
+
+
+//	#pragma mark -
+
+
+NavListing::NavListing(const node_ref *directory)
+	:	fDirectory(*directory),
+		fEntries(50, true),
+		fLastUsed(system_time()),
+		fHideDotFiles(TrackerSettings().HideDotFiles()),
+		fWatchFailed(false),
+		fStale(false),
+		fPrefetched(false)
+{
+}
+
+
+//	#pragma mark -
+
+
+bool
+NavListingCache::NodeRefLess::operator()(const node_ref &node1,
+	const node_ref &node2) const
+{
+	if (node1.device != node2.device)
+		return node1.device < node2.device;
+
+	return node1.node < node2.node;
+}
+
+
+NavListingCache::NodeWatch::NodeWatch()
+	:	refs(0),
+		flags(0)
+{
+}
+
+
+NavListingCache *
+NavListingCache::InstallNavListingCache(const char *name, BLooper *host)
+{
+	NavListingCache *result = new NavListingCache(name);
+	{
+		AutoLock<BLooper> lock(host);
+		if (!lock) {
+			delete result;
+			return NULL;
+		}
+		host->AddHandler(result);
+	}
+	TTracker::WatchNode(0, B_WATCH_MOUNT, result);
+	sNavListingCache = result;
+	return result;
+}
+
+
+NavListingCache::NavListingCache(const char *name)
+	:	BHandler(name),
+		fListings(20, true),
+		fPendingListings(5, false),
+		fEntryCount(0),
+		fPrefetchQueue(kMaxPrefetchQueue, true),
+		fPrefetching(false),
+		fPrefetchThreadSem(create_sem(1, "nav listing prefetch")),
+		fQuitRequested(false)
+{
+	memset(&fStats, 0, sizeof(fStats));
+}
+
+
+NavListingCache::~NavListingCache()
+{
+	{
+		AutoLock<Benaphore> lock(fLock);
+		fQuitRequested = true;
+	}
+	// wait for the prefetch thread to notice
+	acquire_sem(fPrefetchThreadSem);
+	delete_sem(fPrefetchThreadSem);
+
+	stop_watching(this);
+	if (Looper() != NULL)
+		Looper()->RemoveHandler(this);
+}
+
+
+bool
+NavListingCache::GetListing(const node_ref *directory,
+	BObjectList<NavListingEntry> *result)
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	NavListing *listing = FindListing(directory);
+	if (listing != NULL
+		&& listing->fHideDotFiles != TrackerSettings().HideDotFiles()) {
+		RemoveListing(listing);
+		listing = NULL;
+	}
+
+	if (listing == NULL) {
+		fStats.misses++;
+		return false;
+	}
+
+	fStats.hits++;
+	if (listing->fPrefetched) {
+		fStats.prefetchHits++;
+		listing->fPrefetched = false;
+	}
+	listing->fLastUsed = system_time();
+
+	int32 count = listing->fEntries.CountItems();
+	for (int32 index = 0; index < count; index++)
+		result->AddItem(new NavListingEntry(*listing->fEntries.ItemAt(index)));
+
+	QueueSubfolders(listing);
+	return true;
+}
+
+
+NavListing *
+NavListingCache::BeginListing(const node_ref *directory)
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	if (fQuitRequested || FindListing(directory) != NULL)
+		return NULL;
+
+	NavListing *listing = new NavListing(directory);
+	if (!Watch(directory, B_WATCH_DIRECTORY))
+		listing->fWatchFailed = true;
+
+	fPendingListings.AddItem(listing);
+
+	return listing;
+}
+
+
+void
+NavListingCache::AddToListing(NavListing *listing, const Model *model)
+{
+	NavListingEntry *entry = new NavListingEntry(model);
+
+	// notifications look at the entries of pending listings too
+	AutoLock<Benaphore> lock(fLock);
+	listing->fEntries.AddItem(entry);
+
+	// the entry attributes hold the type, the icon and whether the
+	// entry is visible; a link also needs to know if its target goes away
+	if (!Watch(&entry->fNode, B_WATCH_ATTR))
+		listing->fWatchFailed = true;
+
+	if (entry->fTarget != NULL
+		&& !Watch(&entry->fTarget->fNode, B_WATCH_NAME | B_WATCH_ATTR))
+		listing->fWatchFailed = true;
+}
+
+
+void
+NavListingCache::CommitListing(NavListing *listing, bool prefetchSubfolders)
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	fPendingListings.RemoveItem(listing);
+	if (listing->fWatchFailed || listing->fStale
+		|| FindListing(&listing->fDirectory) != NULL) {
+		UnwatchListing(listing);
+		delete listing;
+		return;
+	}
+
+	listing->fEntries.SortItems(&NavListingEntry::CompareNames);
+	listing->fPrefetched = !prefetchSubfolders;
+	listing->fLastUsed = system_time();
+
+	MakeRoom(listing->fEntries.CountItems());
+	fListings.AddItem(listing);
+	fEntryCount += listing->fEntries.CountItems();
+
+	if (prefetchSubfolders)
+		QueueSubfolders(listing);
+}
+
+
+void
+NavListingCache::AbortListing(NavListing *listing)
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	fPendingListings.RemoveItem(listing);
+	UnwatchListing(listing);
+	delete listing;
+}
+
+
+void
+NavListingCache::Forget(const node_ref *directory)
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	NavListing *listing = FindListing(directory);
+	if (listing != NULL) {
+		fStats.invalidations++;
+		RemoveListing(listing);
+	}
+}
+
+
+void
+NavListingCache::Prefetch(const entry_ref *directory)
+{
+	AutoLock<Benaphore> lock(fLock);
+	QueuePrefetch(directory);
+}
+
+
+void
+NavListingCache::GetStats(nav_listing_cache_stats *stats) const
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	*stats = fStats;
+	stats->listings = fListings.CountItems();
+	stats->entries = fEntryCount;
+}
+
+
+void
+NavListingCache::MessageReceived(BMessage *message)
+{
+	if (message->what != B_NODE_MONITOR) {
+		_inherited::MessageReceived(message);
+		return;
+	}
+
+	AutoLock<Benaphore> lock(fLock);
+
+	node_ref node;
+	switch (message->FindInt32("opcode")) {
+		case B_ENTRY_CREATED:
+		case B_ENTRY_REMOVED:
+			if (message->FindInt32("device", &node.device) != B_OK)
+				break;
+
+			if (message->FindInt64("directory", &node.node) == B_OK)
+				Invalidate(&node);
+			if (message->FindInt64("node", &node.node) == B_OK)
+				Invalidate(&node);
+			break;
+
+		case B_ENTRY_MOVED:
+			if (message->FindInt32("device", &node.device) != B_OK)
+				break;
+
+			if (message->FindInt64("from directory", &node.node) == B_OK)
+				Invalidate(&node);
+			if (message->FindInt64("to directory", &node.node) == B_OK)
+				Invalidate(&node);
+			if (message->FindInt64("node", &node.node) == B_OK)
+				Invalidate(&node);
+			break;
+
+		case B_STAT_CHANGED:
+		case B_ATTR_CHANGED:
+			if (message->FindInt32("device", &node.device) == B_OK
+				&& message->FindInt64("node", &node.node) == B_OK)
+				Invalidate(&node);
+			break;
+
+		case B_DEVICE_UNMOUNTED:
+		{
+			dev_t device;
+			if (message->FindInt32("device", &device) == B_OK)
+				InvalidateDevice(device);
+			break;
+		}
+	}
+}
+
+
+void
+NavListingCache::PrefetchPending()
+{
+	for (;;) {
+		entry_ref ref;
+		{
+			AutoLock<Benaphore> lock(fLock);
+
+			entry_ref *next = fPrefetchQueue.RemoveItemAt(0);
+			if (next == NULL || fQuitRequested) {
+				delete next;
+				fPrefetching = false;
+				break;
+			}
+			ref = *next;
+			delete next;
+		}
+
+		ReadListing(&ref);
+	}
+
+	release_sem(fPrefetchThreadSem);
+}
+
+
+void
+NavListingCache::ReadListing(const entry_ref *ref)
+{
+	// the same checks BNavMenu does before it reads a folder itself
+	BEntry entry(ref);
+	Model directoryModel(&entry, true);
+	if (directoryModel.InitCheck() != B_OK || !directoryModel.IsDirectory()
+		|| directoryModel.IsRoot() || FSIsDeskDir(&entry)
+		|| FSIsTrashDir(&entry))
+		return;
+
+	BDirectory *directory = dynamic_cast<BDirectory *>(directoryModel.Node());
+	if (directory == NULL)
+		return;
+
+	NavListing *listing = BeginListing(directoryModel.NodeRef());
+	if (listing == NULL)
+		return;
+
+	bool hideDotFiles = listing->fHideDotFiles;
+
+	directory->Rewind();
+	while (!fQuitRequested
+		&& listing->fEntries.CountItems() < kMaxListingSize) {
+		if (directory->GetNextEntry(&entry) != B_OK)
+			break;
+
+		// the same filtering BNavMenu does when it reads a folder itself
+		Model model;
+		if (!BNavMenu::SetToVisibleEntry(&model, &entry, hideDotFiles)
+			|| !BNavMenu::ResolveVisibleLink(&model))
+			continue;
+
+		AddToListing(listing, &model);
+	}
+
+	if (fQuitRequested) {
+		AbortListing(listing);
+		return;
+	}
+
+	{
+		AutoLock<Benaphore> lock(fLock);
+		fStats.prefetches++;
+	}
+	CommitListing(listing, false);
+}
+
+
+void
+NavListingCache::QueuePrefetch(const entry_ref *ref)
+{
+	ASSERT(fLock.IsLocked());
+
+	if (fQuitRequested || fPrefetchQueue.CountItems() >= kMaxPrefetchQueue)
+		return;
+
+	int32 count = fPrefetchQueue.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		if (*fPrefetchQueue.ItemAt(index) == *ref)
+			return;
+	}
+
+	fPrefetchQueue.AddItem(new entry_ref(*ref));
+
+	if (!fPrefetching) {
+		fPrefetching = true;
+		acquire_sem(fPrefetchThreadSem);
+		Thread::Launch(NewMemberFunctionObject(
+			&NavListingCache::PrefetchPending, this));
+	}
+}
+
+
+void
+NavListingCache::QueueSubfolders(const NavListing *listing)
+{
+	int32 queued = 0;
+	int32 count = listing->fEntries.CountItems();
+	for (int32 index = 0; index < count
+		&& queued < kMaxPrefetchSubfolders; index++) {
+		const NavListingEntry *entry = listing->fEntries.ItemAt(index);
+		if (!entry->IsFolder())
+			continue;
+
+		// don't bother with folders that are listed already; the
+		// entry node is the listed one unless it is a link
+		const NavListingEntry *resolved = entry->fTarget != NULL
+			? entry->fTarget : entry;
+		if (FindListing(&resolved->fNode) != NULL)
+			continue;
+
+		QueuePrefetch(entry->ResolvedRef());
+		queued++;
+	}
+}
+
+
+NavListing *
+NavListingCache::FindListing(const node_ref *directory) const
+{
+	int32 count = fListings.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		NavListing *listing = fListings.ItemAt(index);
+		if (listing->fDirectory == *directory)
+			return listing;
+	}
+	return NULL;
+}
+
+
+bool
+NavListingCache::ListingAffected(const NavListing *listing,
+	const node_ref *node)
+{
+	if (listing->fDirectory == *node)
+		return true;
+
+	int32 count = listing->fEntries.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		const NavListingEntry *entry = listing->fEntries.ItemAt(index);
+		if (entry->fNode == *node
+			|| (entry->fTarget != NULL && entry->fTarget->fNode == *node))
+			return true;
+	}
+	return false;
+}
+
+
+bool
+NavListingCache::ListingAffected(const NavListing *listing, dev_t device)
+{
+	if (listing->fDirectory.device == device)
+		return true;
+
+	int32 count = listing->fEntries.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		const NavListingEntry *entry = listing->fEntries.ItemAt(index);
+		if (entry->fTarget != NULL && entry->fTarget->fNode.device == device)
+			return true;
+	}
+	return false;
+}
+
+
+void
+NavListingCache::Invalidate(const node_ref *node)
+{
+	for (int32 index = fListings.CountItems() - 1; index >= 0; index--) {
+		NavListing *listing = fListings.ItemAt(index);
+		if (ListingAffected(listing, node)) {
+			fStats.invalidations++;
+			RemoveListing(listing);
+		}
+	}
+
+	int32 count = fPendingListings.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		NavListing *listing = fPendingListings.ItemAt(index);
+		if (ListingAffected(listing, node))
+			listing->fStale = true;
+	}
+}
+
+
+void
+NavListingCache::InvalidateDevice(dev_t device)
+{
+	for (int32 index = fListings.CountItems() - 1; index >= 0; index--) {
+		NavListing *listing = fListings.ItemAt(index);
+		if (ListingAffected(listing, device)) {
+			fStats.invalidations++;
+			RemoveListing(listing);
+		}
+	}
+
+	int32 count = fPendingListings.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		NavListing *listing = fPendingListings.ItemAt(index);
+		if (ListingAffected(listing, device))
+			listing->fStale = true;
+	}
+}
+
+
+void
+NavListingCache::RemoveListing(NavListing *listing)
+{
+	ASSERT(fListings.HasItem(listing));
+
+	UnwatchListing(listing);
+	fEntryCount -= listing->fEntries.CountItems();
+	fListings.RemoveItem(listing);
+}
+
+
+void
+NavListingCache::UnwatchListing(const NavListing *listing)
+{
+	Unwatch(&listing->fDirectory);
+
+	int32 count = listing->fEntries.CountItems();
+	for (int32 index = 0; index < count; index++) {
+		const NavListingEntry *entry = listing->fEntries.ItemAt(index);
+		Unwatch(&entry->fNode);
+		if (entry->fTarget != NULL)
+			Unwatch(&entry->fTarget->fNode);
+	}
+}
+
+
+void
+NavListingCache::MakeRoom(int32 entryCount)
+{
+	while (fListings.CountItems() > 0
+		&& (fListings.CountItems() >= kMaxListings
+			|| fEntryCount + entryCount > kMaxListingEntries)) {
+		NavListing *oldest = fListings.FirstItem();
+		int32 count = fListings.CountItems();
+		for (int32 index = 1; index < count; index++) {
+			NavListing *listing = fListings.ItemAt(index);
+			if (listing->fLastUsed < oldest->fLastUsed)
+				oldest = listing;
+		}
+
+		fStats.evictions++;
+		RemoveListing(oldest);
+	}
+}
+
+
+bool
+NavListingCache::Watch(const node_ref *node, uint32 flags)
+{
+	ASSERT(fLock.IsLocked());
+
+	WatchMap::iterator found = fWatches.find(*node);
+	if (found == fWatches.end())
+		found = fWatches.insert(WatchMap::value_type(*node, NodeWatch())).first;
+
+	NodeWatch &watch = found->second;
+	watch.refs++;
+	if ((watch.flags & flags) == flags)
+		return true;
+
+	if (TTracker::WatchNode(node, watch.flags | flags, this) != B_OK)
+		return false;
+
+	watch.flags |= flags;
+	return true;
+}
+
+
+void
+NavListingCache::Unwatch(const node_ref *node)
+{
+	ASSERT(fLock.IsLocked());
+
+	WatchMap::iterator found = fWatches.find(*node);
+	if (found == fWatches.end() || --found->second.refs > 0)
+		return;
+
+	if (found->second.flags != 0)
+		watch_node(node, B_STOP_WATCHING, this);
+
+	fWatches.erase(found);
+}
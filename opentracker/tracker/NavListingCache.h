@@ -0,0 +1,195 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+//	NavListingCache keeps the contents of the folders nav menus have shown,
+//	boiled down to what it takes to build the menu items, so that opening
+//	the same submenu again does not have to read the folder, open every
+//	entry and sort the result. Listings are dropped as soon as node
+//	monitoring reports a change to the folder or one of its entries.
+//	Showing a listing queues up its subfolders to be read ahead of time
+//	on a background thread, they are the ones the user hovers over next.
+
+#ifndef _NAV_LISTING_CACHE_H
+#define _NAV_LISTING_CACHE_H
+
+#include <Entry.h>
+#include <Handler.h>
+#include <Node.h>
+
+#include <map>
+
+#include "ObjectList.h"
+#include "Utilities.h"
+
+namespace BPrivate {
+
+class Model;
+
+struct nav_listing_cache_stats {
+	int64 hits;
+	int64 misses;
+	int64 prefetches;
+	int64 prefetchHits;
+		// listings read in the background, and how many of those got used
+	int64 invalidations;
+	int64 evictions;
+	int32 listings;
+	int32 entries;
+};
+
+class NavListingEntry {
+	// what a nav menu needs to know about one entry of a folder
+public:
+	NavListingEntry(const Model *);
+	NavListingEntry(const NavListingEntry &);
+	~NavListingEntry();
+
+	Model *NewModel() const;
+		// a closed model set up without going to the disk, with the link
+		// resolved if it is one
+	const entry_ref *ResolvedRef() const;
+		// what a submenu for the entry should list
+	bool IsFolder() const;
+
+	static int CompareNames(const NavListingEntry *, const NavListingEntry *);
+	static int CompareFolderNamesFirst(const NavListingEntry *,
+		const NavListingEntry *);
+		// same order as the Model based versions in BNavMenu
+
+	entry_ref fRef;
+	node_ref fNode;
+	const char *fMimeType;
+		// interned
+	mode_t fMode;
+	uint8 fIconFrom;
+		// the icon source the entry's model started out with, lets the
+		// icon cache skip looking for a node icon where there is none
+	uint8 fSortKind;
+		// volume, folder or anything else, after resolving links
+	NavListingEntry *fTarget;
+		// the resolved link target, NULL for broken links and non-links
+};
+
+class NavListing;
+
+class NavListingCache : public BHandler {
+public:
+	static NavListingCache *InstallNavListingCache(const char *name,
+		BLooper *host);
+	virtual ~NavListingCache();
+
+	bool GetListing(const node_ref *directory,
+		BObjectList<NavListingEntry> *result);
+		// adds copies of the cached entries of <directory> to <result>,
+		// sorted by name; returns false if there is no listing yet
+
+	NavListing *BeginListing(const node_ref *directory);
+		// used by a menu reading the folder itself to fill the cache as it
+		// goes; returns NULL if the folder is listed already
+	void AddToListing(NavListing *, const Model *);
+	void CommitListing(NavListing *, bool prefetchSubfolders = true);
+		// drops the listing if anything changed since BeginListing
+	void AbortListing(NavListing *);
+
+	void Forget(const node_ref *directory);
+
+	void Prefetch(const entry_ref *directory);
+		// queues up a folder to be read in the background
+
+	void GetStats(nav_listing_cache_stats *) const;
+
+	static NavListingCache *sNavListingCache;
+		// NULL unless running inside Tracker or the Deskbar
+
+protected:
+	NavListingCache(const char *name);
+	virtual void MessageReceived(BMessage *);
+
+private:
+	void PrefetchPending();
+	void ReadListing(const entry_ref *);
+
+	void QueuePrefetch(const entry_ref *);
+	void QueueSubfolders(const NavListing *);
+	NavListing *FindListing(const node_ref *) const;
+	void Invalidate(const node_ref *);
+	void InvalidateDevice(dev_t);
+	static bool ListingAffected(const NavListing *, const node_ref *);
+	static bool ListingAffected(const NavListing *, dev_t);
+	void RemoveListing(NavListing *);
+	void UnwatchListing(const NavListing *);
+	void MakeRoom(int32 entryCount);
+
+	bool Watch(const node_ref *, uint32 flags);
+	void Unwatch(const node_ref *);
+
+	struct NodeRefLess {
+		bool operator()(const node_ref &, const node_ref &) const;
+	};
+	struct NodeWatch {
+		NodeWatch();
+
+		int32 refs;
+		uint32 flags;
+			// 0 if watch_node failed
+	};
+	typedef std::map<node_ref, NodeWatch, NodeRefLess> WatchMap;
+		// several listings may watch the same node, a folder may be an
+		// entry in one listing and listed itself in another
+
+	BObjectList<NavListing> fListings;
+	BObjectList<NavListing> fPendingListings;
+		// still being read; a change to their folder or one of their
+		// entries marks them stale, only those are dropped on commit
+	int32 fEntryCount;
+	WatchMap fWatches;
+
+	BObjectList<entry_ref> fPrefetchQueue;
+	bool fPrefetching;
+	sem_id fPrefetchThreadSem;
+		// acquired when the prefetch thread is launched, released by the
+		// thread when it is done
+	volatile bool fQuitRequested;
+
+	mutable Benaphore fLock;
+	mutable nav_listing_cache_stats fStats;
+
+	typedef BHandler _inherited;
+};
+
+} // namespace BPrivate
+
+using namespace BPrivate;
+
+#endif
@@ -57,6 +57,7 @@ All rights reserved.
 #include "FSUtils.h"
 #include "IconMenuItem.h"
 #include "MimeTypes.h"
+#include "NavListingCache.h"
 #include "NavMenu.h"
 #include "PoseView.h"
 #include "Thread.h"
@@ -253,6 +254,9 @@ BNavMenu::BNavMenu(const char *title, uint32 message, const BHandler *target,
 		fFlags(0),
 		fItemList(0),
 		fContainer(0),
+		fCachedEntries(NULL),
+		fCachedIndex(0),
+		fPendingListing(NULL),
 		fTypesList(list)
 {
 	InitIconPreloader();
@@ -280,6 +284,9 @@ BNavMenu::BNavMenu(const char *title, uint32 message, const BMessenger &messenge
 		fFlags(0),
 		fItemList(0),
 		fContainer(0),
+		fCachedEntries(NULL),
+		fCachedIndex(0),
+		fPendingListing(NULL),
 		fTypesList(list)
 {
 	InitIconPreloader();
@@ -369,6 +376,16 @@ BNavMenu::ClearMenuBuildingState()
 	delete fContainer;
 	fContainer = NULL;
 
+	delete fCachedEntries;
+	fCachedEntries = NULL;
+
+	if (fPendingListing != NULL) {
+		// didn't get to read all of it
+		if (NavListingCache::sNavListingCache != NULL)
+			NavListingCache::sNavListingCache->AbortListing(fPendingListing);
+		fPendingListing = NULL;
+	}
+
 	// item list is non-owning, need to delete the items because
 	// they didn't get added to the menu
 	if (fItemList) {
@@ -430,9 +447,28 @@ BNavMenu::StartBuildingItemList()
 				dynamic_cast<EntryIteratorList *>(fContainer)->
 					AddItem(new DirectoryEntryList(trashDir));
 		}
-	} else
+	} else {
+		NavListingCache *cache = NavListingCache::sNavListingCache;
+		if (cache != NULL) {
+			fCachedEntries = new BObjectList<NavListingEntry>(50, true);
+			if (cache->GetListing(startModel.NodeRef(), fCachedEntries)) {
+				if (TrackerSettings().SortFolderNamesFirst())
+					fCachedEntries->SortItems(
+						&NavListingEntry::CompareFolderNamesFirst);
+				fCachedIndex = 0;
+				return true;
+			}
+
+			delete fCachedEntries;
+			fCachedEntries = NULL;
+
+			// read the folder and fill the cache while we are at it
+			fPendingListing = cache->BeginListing(startModel.NodeRef());
+		}
+
 		fContainer = new DirectoryEntryList(*dynamic_cast<BDirectory *>
 			(startModel.Node()));
+	}
 
 	if (fContainer == NULL || fContainer->InitCheck() != B_OK)
 		return false;
@@ -476,23 +512,18 @@ BNavMenu::AddNextItem()
 	if (fItemList->CountItems() > 500)
 		return false;
 
+	if (fCachedEntries != NULL)
+		return AddNextCachedItem();
+
 	BEntry entry;
 	if (fContainer->GetNextEntry(&entry) != B_OK) {
 		// we're finished
 		return false;
 	}
 
-	if (TrackerSettings().HideDotFiles()) {
-		char name[B_FILE_NAME_LENGTH];
-		if (entry.GetName(name) == B_OK && name[0] == '.')
-			return true;
-	}
-
-	Model model(&entry, true);
-	if (model.InitCheck() != B_OK) {
-//		PRINT(("not showing hidden item %s, wouldn't open\n", model->Name()));
+	Model model;
+	if (!SetToVisibleEntry(&model, &entry, TrackerSettings().HideDotFiles()))
 		return true;
-	}
 
 	QueryEntryListCollection *queryContainer
 		= dynamic_cast<QueryEntryListCollection*>(fContainer);
@@ -502,27 +533,22 @@ BNavMenu::AddNextItem()
 		return true;
 	}
 
-	ssize_t size = -1;
-	PoseInfo poseInfo;
-
-	if (model.Node()) 
-		size = model.Node()->ReadAttr(kAttrPoseInfo, B_RAW_TYPE, 0,
-			&poseInfo, sizeof(poseInfo));
-
-	model.CloseNode();
-	
-	// item might be in invisible
 	// ToDo:
 	// use more of PoseView's filtering here
-	if ((size == sizeof(poseInfo)
-			&& !BPoseView::PoseVisible(&model, &poseInfo, false))
-		|| (fIteratingDesktop && !ShouldShowDesktopPose(fNavDir.device,
-			&model, &poseInfo))) {
+	if (fIteratingDesktop && !ShouldShowDesktopPose(fNavDir.device, &model,
+			NULL)) {
 //		PRINT(("not showing hidden item %s\n", model.Name()));
 		return true;
 	}
 
+	int32 count = fItemList->CountItems();
 	AddOneItem(&model);
+
+	if (fPendingListing != NULL && fItemList->CountItems() > count) {
+		// AddOneItem resolved the link if it is one
+		NavListingCache::sNavListingCache->AddToListing(fPendingListing,
+			&model);
+	}
 	return true;
 }
 
@@ -539,61 +565,18 @@ BNavMenu::AddOneItem(Model *model)
 }
 
 
-ModelMenuItem * 
-BNavMenu::NewModelItem(Model *model, const BMessage *invokeMessage,
+static ModelMenuItem *
+NewResolvedModelItem(Model *model, const BMessage *invokeMessage,
 	const BMessenger &target, bool suppressFolderHierarchy,
 	BContainerWindow *parentWindow, const BObjectList<BString> *typeslist,
 	TrackingHookData *hook)
 {
-	if (model->InitCheck() != B_OK)
-		return 0;
-	entry_ref ref;
-	bool container = false;
-	if (model->IsSymLink()) {
-	
-		Model *newResolvedModel = 0;
-		Model *result = model->LinkTo();
-
-		if (!result) {
-			newResolvedModel = new Model(model->EntryRef(), true, true);
-
-			if (newResolvedModel->InitCheck() != B_OK) {
-				// broken link, still can show though, bail
-				delete newResolvedModel;
-				result = 0;
-			} else
-				result = newResolvedModel;
-		}
-
-		if (result) {
-			BModelOpener opener(result);
-				// open the model, if it ain't open already
-					
-			PoseInfo poseInfo;
-			ssize_t size = -1;
-			
-			if (result->Node()) 
-				size = result->Node()->ReadAttr(kAttrPoseInfo, B_RAW_TYPE, 0,
-					&poseInfo, sizeof(poseInfo));
-	
-			result->CloseNode();
-
-			if (size == sizeof(poseInfo) && !BPoseView::PoseVisible(result,
-				&poseInfo, false)) {
-				// link target sez it doesn't want to be visible,
-				// don't show the link
-				PRINT(("not showing hidden item %s\n", model->Name()));
-				delete newResolvedModel;
-				return 0;
-			}
-			ref = *result->EntryRef();
-			container = result->IsContainer();
-		}
-		model->SetLinkTo(result);
-	} else {
-		ref = *model->EntryRef();
-		container = model->IsContainer();
-	}
+	// the link is resolved already if the model is one; either way
+	// the model knows all the item needs, the item copies it without
+	// going to the disk again
+	const Model *resolved = model->ResolveIfLink();
+	entry_ref ref = *resolved->EntryRef();
+	bool container = resolved->IsContainer();
 
 	BMessage *message = new BMessage(*invokeMessage);
 	message->AddRef("refs", model->EntryRef());
@@ -601,11 +584,12 @@ BNavMenu::NewModelItem(Model *model, const BMessage *invokeMessage,
 	// Truncate the name if necessary
 	BString truncatedString(model->Name());
 	be_plain_font->TruncateString(&truncatedString, B_TRUNCATE_END,
-		GetMaxMenuWidth());
+		BNavMenu::GetMaxMenuWidth());
 
 	ModelMenuItem *item = NULL;
 	if (!container || suppressFolderHierarchy) {
-		item = new ModelMenuItem(model, truncatedString.String(), message);
+		item = new ModelMenuItem(model, truncatedString.String(), message,
+			'\0', 0, true, false, false);
 		if (invokeMessage->what != B_REFS_RECEIVED)
 			item->SetEnabled(false);
 			// the above is broken for FavoritesMenu::AddNextItem, which uses a
@@ -619,7 +603,7 @@ BNavMenu::NewModelItem(Model *model, const BMessage *invokeMessage,
 			menu->InitTrackingHook(hook->fTrackingHook, &(hook->fTarget),
 				hook->fDragMessage);
 
-		item = new ModelMenuItem(model, menu);
+		item = new ModelMenuItem(model, menu, true, false, false);
 		item->SetMessage(message);
 	}
 	
@@ -627,6 +611,123 @@ BNavMenu::NewModelItem(Model *model, const BMessage *invokeMessage,
 }
 
 
+ModelMenuItem * 
+BNavMenu::NewModelItem(Model *model, const BMessage *invokeMessage,
+	const BMessenger &target, bool suppressFolderHierarchy,
+	BContainerWindow *parentWindow, const BObjectList<BString> *typeslist,
+	TrackingHookData *hook)
+{
+	if (model->InitCheck() != B_OK)
+		return 0;
+	if (!ResolveVisibleLink(model)) {
+		PRINT(("not showing hidden item %s\n", model->Name()));
+		return 0;
+	}
+
+	return NewResolvedModelItem(model, invokeMessage, target,
+		suppressFolderHierarchy, parentWindow, typeslist, hook);
+}
+
+
+static bool
+PoseInfoVisible(Model *model)
+{
+	// reads the pose info of an open model and closes it
+	PoseInfo poseInfo;
+	ssize_t size = -1;
+	if (model->Node()) 
+		size = model->Node()->ReadAttr(kAttrPoseInfo, B_RAW_TYPE, 0,
+			&poseInfo, sizeof(poseInfo));
+
+	model->CloseNode();
+
+	return size != sizeof(poseInfo)
+		|| BPoseView::PoseVisible(model, &poseInfo, false);
+}
+
+
+bool
+BNavMenu::SetToVisibleEntry(Model *model, const BEntry *entry,
+	bool hideDotFiles)
+{
+	if (hideDotFiles) {
+		char name[B_FILE_NAME_LENGTH];
+		if (entry->GetName(name) == B_OK && name[0] == '.')
+			return false;
+	}
+
+	if (model->SetTo(entry, true) != B_OK) {
+//		PRINT(("not showing hidden item %s, wouldn't open\n", model->Name()));
+		return false;
+	}
+
+	// item might be in invisible
+	return PoseInfoVisible(model);
+}
+
+
+bool
+BNavMenu::ResolveVisibleLink(Model *model)
+{
+	if (!model->IsSymLink())
+		return true;
+
+	Model *result = model->LinkTo();
+	if (result != NULL) {
+		BModelOpener opener(result);
+			// open the model, if it ain't open already
+		return PoseInfoVisible(result);
+	}
+
+	result = new Model(model->EntryRef(), true, true);
+	if (result->InitCheck() != B_OK) {
+		// broken link, still can show though
+		delete result;
+		return true;
+	}
+
+	if (!PoseInfoVisible(result)) {
+		// link target sez it doesn't want to be visible,
+		// don't show the link
+		delete result;
+		return false;
+	}
+
+	model->SetLinkTo(result);
+	return true;
+}
+
+
+bool
+BNavMenu::AddNextCachedItem()
+{
+	const NavListingEntry *entry = fCachedEntries->ItemAt(fCachedIndex++);
+	if (entry == NULL)
+		return false;
+
+	Model *model = entry->NewModel();
+	BMenuItem *item = NULL;
+	try {
+		item = NewResolvedModelItem(model, &fMessage, fMessenger, false,
+			dynamic_cast<BContainerWindow *>(fParentWindow),
+			fTypesList, &fTrackingHook);
+	} catch (status_t) {
+		// the entry went away and the node monitor didn't tell the
+		// cache yet; the menu will be read from disk the next time
+		node_ref directory;
+		directory.device = entry->fRef.device;
+		directory.node = entry->fRef.directory;
+		NavListingCache::sNavListingCache->Forget(&directory);
+	}
+	delete model;
+
+	if (item)
+		fItemList->AddItem(item);
+
+	return true;
+}
+
+
 void
 BNavMenu::BuildVolumeMenu()
 {
@@ -694,11 +795,19 @@ BNavMenu::CompareOne(const BMenuItem *i1, const BMenuItem *i2)
 void
 BNavMenu::DoneBuildingItemList()
 {
-	// add sorted items to menu
-	if (TrackerSettings().SortFolderNamesFirst())
-		fItemList->SortItems(CompareFolderNamesFirstOne);
-	else
-		fItemList->SortItems(CompareOne);
+	if (fPendingListing != NULL) {
+		NavListingCache::sNavListingCache->CommitListing(fPendingListing);
+		fPendingListing = NULL;
+	}
+
+	// add sorted items to menu, the entries of a cached listing
+	// come in order already
+	if (fCachedEntries == NULL) {
+		if (TrackerSettings().SortFolderNamesFirst())
+			fItemList->SortItems(CompareFolderNamesFirstOne);
+		else
+			fItemList->SortItems(CompareOne);
+	}
 
 	// if the parent link should be shown, it will be the first
 	// entry in the menu - but don't add the item if we're already
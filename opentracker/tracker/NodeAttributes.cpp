@@ -0,0 +1,105 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+#include <Node.h>
+
+#include "Attributes.h"
+#include "NodeAttributes.h"
+
+
+namespace BPrivate {
+extern
+#if !B_BEOS_VERSION_DANO
+_IMPEXP_BE
+#endif
+bool CheckNodeIconHintPrivate(const BNode *, bool);
+}
+
+
+NodeAttributes::NodeAttributes(uint32 wanted)
+	:	fWanted(wanted),
+		fRead(0),
+		fFound(0),
+		fPoseInfoResult(kReadAttrFailed)
+{
+}
+
+
+bool
+NodeAttributes::ReadString(const BNode *node, const char *name, char *result)
+{
+	ssize_t size = node->ReadAttr(name, B_MIME_STRING_TYPE, 0, result,
+		B_MIME_TYPE_LENGTH);
+	if (size <= 0)
+		return false;
+
+	if (result[size - 1] != '\0') {
+		// not terminated, either way too long or written without the
+		// terminator
+		if (size == B_MIME_TYPE_LENGTH)
+			return false;
+		result[size] = '\0';
+	}
+	return true;
+}
+
+
+void
+NodeAttributes::Read(const BNode *node, uint32 which, bool miniIconOnly)
+{
+	which = (which | fWanted) & ~fRead;
+	fRead |= which;
+
+	if ((which & kIconAttributes) != 0
+		&& CheckNodeIconHintPrivate(node, miniIconOnly))
+		fFound |= kIconAttributes;
+
+	if ((which & kTypeAttribute) != 0 && ReadString(node, kAttrMIMEType, fType))
+		fFound |= kTypeAttribute;
+
+	if ((which & kPreferredAppAttribute) != 0 && Has(kTypeAttribute)
+		&& ReadString(node, kAttrPreferredApp, fPreferredApp))
+		fFound |= kPreferredAppAttribute;
+
+	if ((which & kAppSignatureAttribute) != 0
+		&& ReadString(node, kAttrAppSignature, fAppSignature))
+		fFound |= kAppSignatureAttribute;
+
+	if ((which & kPoseInfoAttribute) != 0) {
+		fPoseInfoResult = ReadAttr(node, kAttrPoseInfo, kAttrPoseInfoForeign,
+			B_RAW_TYPE, 0, &fPoseInfo, sizeof(fPoseInfo), &PoseInfo::EndianSwap);
+		if (fPoseInfoResult != kReadAttrFailed)
+			fFound |= kPoseInfoAttribute;
+	}
+}
@@ -0,0 +1,171 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+//	NodeAttributes reads the attributes Tracker looks at for about every
+//	node it shows - the pose info, the type, the preferred app, the app
+//	signature and whether there is an icon - in one go while the node is
+//	open. Each of them costs a single call, sized up front; going through
+//	BNodeInfo costs an extra attribute stat for every string. Whoever
+//	opens the node asks for what it needs, the rest of the code consumes
+//	the results instead of opening the node again.
+
+#ifndef _NODE_ATTRIBUTES_H
+#define _NODE_ATTRIBUTES_H
+
+#include <Mime.h>
+
+#include "FSUtils.h"
+#include "Utilities.h"
+
+class BNode;
+
+namespace BPrivate {
+
+enum {
+	kPoseInfoAttribute = 0x01,
+	kTypeAttribute = 0x02,
+	kPreferredAppAttribute = 0x04,
+		// only read if the node has a type, like BNodeInfo does
+	kAppSignatureAttribute = 0x08,
+	kIconAttributes = 0x10
+		// checks for a node icon, the icon bits are not read
+};
+
+class NodeAttributes {
+public:
+	NodeAttributes(uint32 wanted = 0);
+
+	void Want(uint32 which);
+		// adds to what the next Read call reads
+
+	void Read(const BNode *, uint32 which = 0, bool miniIconOnly = false);
+		// reads <which> and what was asked for through the constructor or
+		// Want, minus what was read already; <miniIconOnly> makes the icon
+		// check look for the mini icon only
+
+	bool WasRead(uint32 which) const;
+	bool Has(uint32 which) const;
+		// true if all of <which> were read and found
+
+	const char *Type() const;
+	const char *PreferredApp() const;
+	const char *AppSignature() const;
+		// NULL if not there
+	bool HasIcon() const;
+
+	ReadAttrResult PoseInfoResult() const;
+	const PoseInfo *GetPoseInfo() const;
+		// swapped to host endianness if read from the foreign attribute
+
+private:
+	static bool ReadString(const BNode *, const char *name, char *result);
+
+	uint32 fWanted;
+	uint32 fRead;
+	uint32 fFound;
+	ReadAttrResult fPoseInfoResult;
+	PoseInfo fPoseInfo;
+	char fType[B_MIME_TYPE_LENGTH];
+	char fPreferredApp[B_MIME_TYPE_LENGTH];
+	char fAppSignature[B_MIME_TYPE_LENGTH];
+};
+
+
+inline void
+NodeAttributes::Want(uint32 which)
+{
+	fWanted |= which;
+}
+
+
+inline bool
+NodeAttributes::WasRead(uint32 which) const
+{
+	return (fRead & which) == which;
+}
+
+
+inline bool
+NodeAttributes::Has(uint32 which) const
+{
+	return (fFound & which) == which;
+}
+
+
+inline const char *
+NodeAttributes::Type() const
+{
+	return Has(kTypeAttribute) ? fType : NULL;
+}
+
+
+inline const char *
+NodeAttributes::PreferredApp() const
+{
+	return Has(kPreferredAppAttribute) ? fPreferredApp : NULL;
+}
+
+
+inline const char *
+NodeAttributes::AppSignature() const
+{
+	return Has(kAppSignatureAttribute) ? fAppSignature : NULL;
+}
+
+
+inline bool
+NodeAttributes::HasIcon() const
+{
+	return Has(kIconAttributes);
+}
+
+
+inline ReadAttrResult
+NodeAttributes::PoseInfoResult() const
+{
+	return fPoseInfoResult;
+}
+
+
+inline const PoseInfo *
+NodeAttributes::GetPoseInfo() const
+{
+	return Has(kPoseInfoAttribute) ? &fPoseInfo : NULL;
+}
+
+} // namespace BPrivate
+
+using namespace BPrivate;
+
+#endif
@@ -45,6 +45,7 @@ All rights reserved.
 #include "IconCache.h"
 #include "Pose.h"
 #include "PoseView.h"
+#include "SlabAllocator.h"
 #include "Utilities.h"
 
 
@@ -83,6 +84,23 @@ CalcFreeSpace(dev_t device)
 // everything else, like the attributes, etc. is retrieved directly from the
 // symlink itself
 
+static SlabAllocator sPoseAllocator("pose allocator", sizeof(BPose));
+
+
+void *
+BPose::operator new(size_t size)
+{
+	return sPoseAllocator.Allocate(size);
+}
+
+
+void
+BPose::operator delete(void *pose)
+{
+	sPoseAllocator.Free(pose);
+}
+
+
 BPose::BPose(Model *model, BPoseView *view, bool selected)
 	:	fModel(model),
 		fWidgetList(4, true),
@@ -314,7 +332,13 @@ void
 BPose::UpdateIcon(BPoint poseLoc, BPoseView *poseView)
 {
 	IconCache::sIconCache->IconChanged(ResolvedModel());
+	InvalidateIcon(poseLoc, poseView);
+}
 
+
+void
+BPose::InvalidateIcon(BPoint poseLoc, BPoseView *poseView)
+{
 	BRect rect;
 	if (poseView->ViewMode() == kListMode) {
 		rect = CalcRect(poseLoc, poseView);
@@ -535,7 +559,7 @@ BPose::Draw(BRect rect, BPoseView *poseView, BView *drawView, bool fullDraw,
 		iconRect.top = iconRect.bottom - B_MINI_ICON;
 		if (!updateRgn || updateRgn->Intersects(iconRect)) 
 			DrawIcon(iconRect.LeftTop(), drawView, B_MINI_ICON, directDraw,
-				!windowActive && !showSelectionWhenInactive);
+				!windowActive && !showSelectionWhenInactive, poseView);
 
 		// draw text
 		for (int32 index = 0; ; index++) {
@@ -590,7 +614,8 @@ BPose::Draw(BRect rect, BPoseView *poseView, BView *drawView, bool fullDraw,
 
 		DrawIcon(iconOrigin, drawView, poseView->ViewMode() == kIconMode ?
 			B_LARGE_ICON : B_MINI_ICON, directDraw,
-			!windowActive && !showSelectionWhenInactive && !poseView->IsDesktopWindow());
+			!windowActive && !showSelectionWhenInactive && !poseView->IsDesktopWindow(),
+			poseView);
 		
 		BColumn *column = poseView->FirstColumn();
 		if (!column)
@@ -643,7 +668,7 @@ BPose::DeselectWithoutErasingBackground(BRect, BPoseView *poseView)
 	// draw icon directly
 	if (fPercent == -1)
 		DrawIcon(fLocation, poseView, poseView->ViewMode() == kIconMode ?
-				B_LARGE_ICON : B_MINI_ICON, true);
+				B_LARGE_ICON : B_MINI_ICON, true, false, poseView);
 	else
 		UpdateIcon(fLocation,poseView);
 
@@ -743,7 +768,8 @@ BPose::TestLargeIconPixel(BPoint point) const
 
 
 void
-BPose::DrawIcon(BPoint where, BView *view, icon_size kind, bool direct, bool drawUnselected)
+BPose::DrawIcon(BPoint where, BView *view, icon_size kind, bool direct, bool drawUnselected,
+	BPoseView *loadTarget)
 {
 	if (fClipboardMode == kMoveSelectionTo) {
 		view->SetDrawingMode(B_OP_ALPHA);
@@ -753,7 +779,8 @@ BPose::DrawIcon(BPoint where, BView *view, icon_size kind, bool direct, bool dra
 		view->SetDrawingMode(B_OP_OVER);
 
 	IconCache::sIconCache->Draw(ResolvedModel(), view, where,
-		fIsSelected && !drawUnselected ? kSelectedIcon : kNormalIcon, kind, true);
+		fIsSelected && !drawUnselected ? kSelectedIcon : kNormalIcon, kind, true,
+		loadTarget);
 
 	if (fPercent != -1)
 		DrawBar(where, view, kind);
@@ -57,6 +57,10 @@ class BPose {
 		BPose(Model *adopt, BPoseView *, bool selected = false);
 		virtual ~BPose();
 
+		void *operator new(size_t);
+		void operator delete(void *);
+			// poses come from a slab allocator, see SlabAllocator.h
+
 		BTextWidget *AddWidget(BPoseView *, BColumn *);
 		BTextWidget *AddWidget(BPoseView *, BColumn *, ModelNodeLazyOpener &opener);
 		void RemoveWidget(BPoseView *, BColumn *);
@@ -73,7 +77,10 @@ class BPose {
 
 		void DrawBar(BPoint where,BView *view,icon_size kind);
 
-		void DrawIcon(BPoint, BView *, icon_size, bool direct, bool drawUnselected = false);
+		void DrawIcon(BPoint, BView *, icon_size, bool direct, bool drawUnselected = false,
+				BPoseView *loadTarget = NULL);
+			// with a <loadTarget>, icons that are not cached are loaded in the
+			// background, see IconCache::Draw
 		void DrawToggleSwitch(BRect, BPoseView *);
 		void MouseUp(BPoint poseLoc, BPoseView *, BPoint where, int32 index);
 		Model* TargetModel() const;
@@ -98,6 +105,7 @@ class BPose {
 				uint32 attrType, int32 poseIndex, BPoint poseLoc, BPoseView *view);
 		bool UpdateVolumeSpaceBar(bool enabled);
 		void UpdateIcon(BPoint poseLoc, BPoseView *);
+		void InvalidateIcon(BPoint poseLoc, BPoseView *);
 
 		//void UpdateFixedSymlink(BPoint poseLoc, BPoseView *);	
 		void UpdateBrokenSymLink(BPoint poseLoc, BPoseView *);	
@@ -0,0 +1,323 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+
+#include <Debug.h>
+#include <math.h>
+#include <new>
+#include <stdlib.h>
+
+#include "PoseGrid.h"
+
+
+const float kCellSize = 64;
+	// about the size of a large icon pose, a pose rect touches a
+	// handful of cells at most
+const float kMaxCellCoordinate = 1 << 24;
+const int32 kMinGridBuckets = 256;
+
+namespace BPrivate {
+
+enum {
+	kCellChain,
+	kPoseChain,			// keyed by the pose pointer, used for removal
+	kChainCount
+};
+
+struct PoseGridEntry {
+	BPose *fPose;
+	BPoint fLocation;
+	int32 fCellX;
+	int32 fCellY;
+	uint32 fHash[kChainCount];
+	int32 fNext[kChainCount];
+};
+
+} // namespace BPrivate
+
+
+static inline uint32
+MixHash(uint32 hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+
+PoseGrid::PoseGrid()
+	:	fEntries(NULL),
+		fEntryCapacity(0),
+		fEntryCount(0),
+		fFreeEntry(-1),
+		fUsedCount(0),
+		fBuckets(NULL),
+		fBucketCount(0)
+{
+	Rehash(kMinGridBuckets);
+}
+
+
+PoseGrid::~PoseGrid()
+{
+	free(fEntries);
+	delete [] fBuckets;
+}
+
+
+PoseGrid::Cell
+PoseGrid::CellFor(BPoint point)
+{
+	float x = floorf(point.x / kCellSize);
+	float y = floorf(point.y / kCellSize);
+
+	// keep far off points from overflowing the cell coordinates
+	if (x < -kMaxCellCoordinate)
+		x = -kMaxCellCoordinate;
+	else if (x > kMaxCellCoordinate)
+		x = kMaxCellCoordinate;
+	if (y < -kMaxCellCoordinate)
+		y = -kMaxCellCoordinate;
+	else if (y > kMaxCellCoordinate)
+		y = kMaxCellCoordinate;
+
+	Cell cell;
+	cell.x = (int32)x;
+	cell.y = (int32)y;
+	return cell;
+}
+
+
+uint32
+PoseGrid::Hash(Cell cell)
+{
+	return MixHash((uint32)cell.x * 0x9e3779b1 ^ (uint32)cell.y);
+}
+
+
+uint32
+PoseGrid::Hash(const BPose *pose)
+{
+	return MixHash((uint32)((size_t)pose >> 3));
+}
+
+
+int32 *
+PoseGrid::Bucket(int32 chain, uint32 hash) const
+{
+	return &fBuckets[chain * fBucketCount + (hash & (fBucketCount - 1))];
+}
+
+
+void
+PoseGrid::Link(int32 entryIndex, int32 chain, uint32 hash)
+{
+	PoseGridEntry *entry = &fEntries[entryIndex];
+	int32 *bucket = Bucket(chain, hash);
+
+	entry->fHash[chain] = hash;
+	entry->fNext[chain] = *bucket;
+	*bucket = entryIndex;
+}
+
+
+void
+PoseGrid::Unlink(int32 entryIndex, int32 chain)
+{
+	PoseGridEntry *entry = &fEntries[entryIndex];
+	int32 *link = Bucket(chain, entry->fHash[chain]);
+
+	while (*link >= 0) {
+		if (*link == entryIndex) {
+			*link = entry->fNext[chain];
+			return;
+		}
+		link = &fEntries[*link].fNext[chain];
+	}
+
+	TRESPASS();
+}
+
+
+void
+PoseGrid::Rehash(int32 bucketCount)
+{
+	int32 *buckets = new int32 [bucketCount * kChainCount];
+	delete [] fBuckets;
+	fBuckets = buckets;
+	fBucketCount = bucketCount;
+
+	for (int32 index = 0; index < bucketCount * kChainCount; index++)
+		fBuckets[index] = -1;
+
+	for (int32 index = 0; index < fEntryCount; index++) {
+		PoseGridEntry *entry = &fEntries[index];
+		if (!entry->fPose)
+			continue;
+
+		for (int32 chain = 0; chain < kChainCount; chain++)
+			Link(index, chain, entry->fHash[chain]);
+	}
+}
+
+
+void
+PoseGrid::Add(BPose *pose, BPoint location)
+{
+	ASSERT(pose);
+
+	if (fUsedCount >= fBucketCount)
+		Rehash(fBucketCount << 1);
+
+	int32 entryIndex = fFreeEntry;
+	if (entryIndex >= 0)
+		fFreeEntry = fEntries[entryIndex].fNext[kPoseChain];
+	else {
+		if (fEntryCount == fEntryCapacity) {
+			int32 newCapacity = fEntryCapacity ? fEntryCapacity << 1 : fBucketCount;
+			PoseGridEntry *newEntries = (PoseGridEntry *)realloc(fEntries,
+				newCapacity * sizeof(PoseGridEntry));
+			if (!newEntries)
+				throw std::bad_alloc();
+
+			fEntries = newEntries;
+			fEntryCapacity = newCapacity;
+		}
+		entryIndex = fEntryCount++;
+	}
+
+	fUsedCount++;
+
+	Cell cell = CellFor(location);
+
+	PoseGridEntry *entry = &fEntries[entryIndex];
+	entry->fPose = pose;
+	entry->fLocation = location;
+	entry->fCellX = cell.x;
+	entry->fCellY = cell.y;
+
+	Link(entryIndex, kCellChain, Hash(cell));
+	Link(entryIndex, kPoseChain, Hash(pose));
+}
+
+
+bool
+PoseGrid::Remove(const BPose *pose)
+{
+	int32 entryIndex = *Bucket(kPoseChain, Hash(pose));
+	for (; entryIndex >= 0; entryIndex = fEntries[entryIndex].fNext[kPoseChain]) {
+		if (fEntries[entryIndex].fPose == pose)
+			break;
+	}
+
+	if (entryIndex < 0)
+		return false;
+
+	Unlink(entryIndex, kCellChain);
+	Unlink(entryIndex, kPoseChain);
+
+	PoseGridEntry *entry = &fEntries[entryIndex];
+	entry->fPose = NULL;
+	entry->fNext[kPoseChain] = fFreeEntry;
+	fFreeEntry = entryIndex;
+	fUsedCount--;
+
+	return true;
+}
+
+
+void
+PoseGrid::MakeEmpty()
+{
+	free(fEntries);
+	fEntries = NULL;
+	fEntryCapacity = 0;
+	fEntryCount = 0;
+	fFreeEntry = -1;
+	fUsedCount = 0;
+
+	// drop back to the initial size, a relayout refills the grid right away
+	// while a view that gets emptied should not keep its big bucket array
+	Rehash(kMinGridBuckets);
+}
+
+
+BPose *
+PoseGrid::EachPoseAt(BRect area, BPose *(*eachFunction)(BPose *, void *),
+	void *passThru) const
+{
+	if (!fUsedCount || !area.IsValid())
+		return NULL;
+
+	Cell first = CellFor(area.LeftTop());
+	Cell last = CellFor(area.RightBottom());
+
+	double cellCount = ((double)last.x - first.x + 1) * ((double)last.y - first.y + 1);
+	if (cellCount > fUsedCount) {
+		// there are more cells to look at than poses, walking the entries
+		// is cheaper then
+		for (int32 index = 0; index < fEntryCount; index++) {
+			PoseGridEntry *entry = &fEntries[index];
+			if (entry->fPose && area.Contains(entry->fLocation)) {
+				BPose *result = (eachFunction)(entry->fPose, passThru);
+				if (result)
+					return result;
+			}
+		}
+		return NULL;
+	}
+
+	for (int32 y = first.y; y <= last.y; y++) {
+		for (int32 x = first.x; x <= last.x; x++) {
+			Cell cell;
+			cell.x = x;
+			cell.y = y;
+
+			int32 index = *Bucket(kCellChain, Hash(cell));
+			for (; index >= 0; index = fEntries[index].fNext[kCellChain]) {
+				PoseGridEntry *entry = &fEntries[index];
+				if (entry->fCellX != x || entry->fCellY != y
+					|| !area.Contains(entry->fLocation))
+					continue;
+
+				BPose *result = (eachFunction)(entry->fPose, passThru);
+				if (result)
+					return result;
+			}
+		}
+	}
+
+	return NULL;
+}
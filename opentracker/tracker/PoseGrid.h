@@ -0,0 +1,107 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+
+//	PoseGrid files the poses of an icon mode view into square cells by
+//	their location, so that placement and hit testing only have to look
+//	at the poses near a point instead of scanning the whole view.
+//	BPoseView keeps it in sync with fVSPoseList.
+
+#ifndef _POSE_GRID_H
+#define _POSE_GRID_H
+
+#include <Point.h>
+#include <Rect.h>
+
+namespace BPrivate {
+
+class BPose;
+struct PoseGridEntry;
+
+class PoseGrid {
+public:
+	PoseGrid();
+	~PoseGrid();
+
+	void Add(BPose *, BPoint location);
+	bool Remove(const BPose *);
+		// finds the pose by its pointer, so it does not matter if the
+		// location of the pose changed since it got added
+	void MakeEmpty();
+
+	int32 CountPoses() const;
+
+	BPose *EachPoseAt(BRect area, BPose *(*eachFunction)(BPose *, void *),
+		void *passThru) const;
+		// calls <eachFunction> for every pose whose location lies in
+		// <area> until it returns non-NULL and returns that pose; the
+		// poses are passed in no particular order
+
+private:
+	struct Cell {
+		int32 x;
+		int32 y;
+	};
+
+	static Cell CellFor(BPoint);
+	static uint32 Hash(Cell);
+	static uint32 Hash(const BPose *);
+
+	int32 *Bucket(int32 chain, uint32 hash) const;
+	void Link(int32 entryIndex, int32 chain, uint32 hash);
+	void Unlink(int32 entryIndex, int32 chain);
+	void Rehash(int32 bucketCount);
+
+	PoseGridEntry *fEntries;
+	int32 fEntryCapacity;
+	int32 fEntryCount;
+	int32 fFreeEntry;
+	int32 fUsedCount;
+
+	int32 *fBuckets;
+		// one array of fBucketCount heads for the cells, one for the poses
+	int32 fBucketCount;
+};
+
+inline int32
+PoseGrid::CountPoses() const
+{
+	return fUsedCount;
+}
+
+} // namespace BPrivate
+
+using namespace BPrivate;
+
+#endif
@@ -32,18 +32,841 @@ names are registered trademarks or trademarks of their respective holders.
 All rights reserved.
 */
 
-//	Icon cache is used for drawing node icons; it caches icons
-//	and reuses them for successive draws
+//	PoseList keeps an optional hash index of its poses keyed by node_ref,
+//	entry_ref, symlink target node_ref and volume device. The index is built
+//	the first time a list with more than kMinIndexedPoses items is searched and
+//	is kept up to date by the add/remove calls from then on; small lists, such
+//	as the selection list, are searched linearly.
+//
+//	Index hits are always checked against the pose's Model, a pose that
+//	changed its keys without a PoseChanged call may be missed but is never
+//	returned for the wrong node.
+//
+//	For type-ahead, the index can also keep the poses ordered by their case
+//	folded names. That part is only set up on the first name search; poses
+//	added after that are collected unsorted and merged in by the next search.
 
 #include <Debug.h>
+#include <algorithm>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
 
 #include "PoseList.h"
 #include "Pose.h"
+#include "Utilities.h"
+
+
+const int32 kMinIndexedPoses = 64;
+const int32 kMinIndexBuckets = 256;
+
+namespace BPrivate {
+
+enum {
+	kPoseChain,			// keyed by the pose pointer, used for removal
+	kNodeChain,
+	kEntryChain,
+	kLinkChain,			// symlink target node_ref
+	kVolumeChain,		// device of volume poses
+	kChainCount
+};
+
+struct PoseIndexEntry {
+	BPose *fPose;
+	int32 fIndexHint;
+		// last known position of fPose in the list
+	uint32 fChains;
+		// bit set of chains this entry is linked into
+	uint32 fHash[kChainCount];
+	int32 fNext[kChainCount];
+	int32 fName;
+		// offset of the case folded copy of the name in the name buffer,
+		// -1 unless names are indexed
+	int32 fNamePosition;
+		// position of the entry in the sorted or in the pending name array
+	bool fNamePending;
+};
+
+class PoseListIndex {
+public:
+	PoseListIndex(int32 sizeHint);
+	~PoseListIndex();
+
+	void Add(BPose *, int32 indexHint);
+	bool Remove(BPose *, int32 *indexHint = NULL);
+
+	PoseIndexEntry *First(int32 chain, uint32 hash) const;
+	PoseIndexEntry *Next(int32 chain, const PoseIndexEntry *) const;
+	PoseIndexEntry *Find(const BPose *) const;
+
+	PoseIndexEntry *FindName(const char *foldedName, int32 match);
+		// binary search in the names, sets up the name index as needed
+	const char *NameOf(int32 entryIndex) const;
+
+	static uint32 Hash(const BPose *);
+	static uint32 Hash(const node_ref *);
+	static uint32 Hash(const entry_ref *);
+	static uint32 Hash(dev_t);
+
+private:
+	int32 *Bucket(int32 chain, uint32 hash) const;
+	void Link(int32 entryIndex, int32 chain, uint32 hash);
+	void Unlink(int32 entryIndex, int32 chain);
+	void Rehash(int32 bucketCount);
+
+	void IndexNames();
+	void AddName(int32 entryIndex);
+	void RemoveName(int32 entryIndex);
+	void SortNames();
+	void CompactNames();
+
+	PoseIndexEntry *fEntries;
+	int32 fEntryCapacity;
+	int32 fEntryCount;
+	int32 fFreeEntry;
+	int32 fUsedCount;
+
+	int32 *fBuckets;
+		// kChainCount arrays of fBucketCount heads each
+	int32 fBucketCount;
+
+	bool fNamesIndexed;
+	char *fNameBuffer;
+		// the folded names of all entries, back to back
+	int32 fNameBufferSize;
+	int32 fNameBufferCapacity;
+	int32 fRemovedNameBytes;
+		// left behind in fNameBuffer by removed entries
+	int32 *fSortedNames;
+		// entry indices ordered by name, -1 for removed entries
+	int32 fSortedNameCount;
+	int32 fRemovedNameCount;
+	int32 *fPendingNames;
+		// entry indices added since the last sort, -1 for removed entries
+	int32 fPendingNameCount;
+	int32 fPendingNameCapacity;
+};
+
+
+inline const char *
+PoseListIndex::NameOf(int32 entryIndex) const
+{
+	return fNameBuffer + fEntries[entryIndex].fName;
+}
+
+
+struct PoseNameOrder {
+	PoseNameOrder(const PoseListIndex *index)
+		:	fIndex(index)
+		{}
+
+	bool operator()(int32 entry1, int32 entry2) const
+		{ return strcmp(fIndex->NameOf(entry1), fIndex->NameOf(entry2)) < 0; }
+
+	const PoseListIndex *fIndex;
+};
+
+} // namespace BPrivate
+
+
+static inline uint32
+MixHash(uint32 hash)
+{
+	// the bucket is picked from the low bits, fold the high bits in
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+
+PoseListIndex::PoseListIndex(int32 sizeHint)
+	:	fEntries(NULL),
+		fEntryCapacity(0),
+		fEntryCount(0),
+		fFreeEntry(-1),
+		fUsedCount(0),
+		fBuckets(NULL),
+		fBucketCount(0),
+		fNamesIndexed(false),
+		fNameBuffer(NULL),
+		fNameBufferSize(0),
+		fNameBufferCapacity(0),
+		fRemovedNameBytes(0),
+		fSortedNames(NULL),
+		fSortedNameCount(0),
+		fRemovedNameCount(0),
+		fPendingNames(NULL),
+		fPendingNameCount(0),
+		fPendingNameCapacity(0)
+{
+	int32 bucketCount = kMinIndexBuckets;
+	while (bucketCount < sizeHint)
+		bucketCount <<= 1;
+
+	Rehash(bucketCount);
+}
+
+
+PoseListIndex::~PoseListIndex()
+{
+	free(fEntries);
+	delete [] fBuckets;
+	free(fNameBuffer);
+	free(fSortedNames);
+	free(fPendingNames);
+}
+
+
+uint32
+PoseListIndex::Hash(const BPose *pose)
+{
+	return MixHash((uint32)((size_t)pose >> 3));
+}
+
+
+uint32
+PoseListIndex::Hash(const node_ref *node)
+{
+	return MixHash(node->device ^ ((uint32 *)&node->node)[0]
+		^ ((uint32 *)&node->node)[1]);
+}
+
+
+uint32
+PoseListIndex::Hash(const entry_ref *entry)
+{
+	uint32 hash = entry->device ^ ((uint32 *)&entry->directory)[0]
+		^ ((uint32 *)&entry->directory)[1];
+	if (entry->name)
+		hash = HashString(entry->name, hash);
+
+	return MixHash(hash);
+}
+
+
+uint32
+PoseListIndex::Hash(dev_t device)
+{
+	return MixHash((uint32)device);
+}
+
+
+int32 *
+PoseListIndex::Bucket(int32 chain, uint32 hash) const
+{
+	return &fBuckets[chain * fBucketCount + (hash & (fBucketCount - 1))];
+}
+
+
+void
+PoseListIndex::Link(int32 entryIndex, int32 chain, uint32 hash)
+{
+	PoseIndexEntry *entry = &fEntries[entryIndex];
+	int32 *bucket = Bucket(chain, hash);
+
+	entry->fHash[chain] = hash;
+	entry->fNext[chain] = *bucket;
+	entry->fChains |= 1 << chain;
+	*bucket = entryIndex;
+}
+
+
+void
+PoseListIndex::Unlink(int32 entryIndex, int32 chain)
+{
+	PoseIndexEntry *entry = &fEntries[entryIndex];
+	int32 *link = Bucket(chain, entry->fHash[chain]);
+
+	while (*link >= 0) {
+		if (*link == entryIndex) {
+			*link = entry->fNext[chain];
+			entry->fChains &= ~(1 << chain);
+			return;
+		}
+		link = &fEntries[*link].fNext[chain];
+	}
+
+	TRESPASS();
+}
+
+
+void
+PoseListIndex::Rehash(int32 bucketCount)
+{
+	delete [] fBuckets;
+	fBuckets = new int32 [bucketCount * kChainCount];
+	fBucketCount = bucketCount;
+
+	for (int32 index = 0; index < bucketCount * kChainCount; index++)
+		fBuckets[index] = -1;
+
+	// re-link all the live entries, the hashes are stored with them so
+	// there is no need to touch the poses
+	for (int32 index = 0; index < fEntryCount; index++) {
+		PoseIndexEntry *entry = &fEntries[index];
+		if (!entry->fPose)
+			continue;
+
+		uint32 chains = entry->fChains;
+		entry->fChains = 0;
+		for (int32 chain = 0; chain < kChainCount; chain++) {
+			if (chains & (1 << chain))
+				Link(index, chain, entry->fHash[chain]);
+		}
+	}
+}
+
+
+void
+PoseListIndex::Add(BPose *pose, int32 indexHint)
+{
+	if (fUsedCount >= fBucketCount)
+		Rehash(fBucketCount << 1);
+
+	int32 entryIndex = fFreeEntry;
+	if (entryIndex >= 0)
+		fFreeEntry = fEntries[entryIndex].fNext[kPoseChain];
+	else {
+		if (fEntryCount == fEntryCapacity) {
+			int32 newCapacity = fEntryCapacity ? fEntryCapacity << 1 : fBucketCount;
+			PoseIndexEntry *newEntries = (PoseIndexEntry *)realloc(fEntries,
+				newCapacity * sizeof(PoseIndexEntry));
+			if (!newEntries)
+				throw std::bad_alloc();
+
+			fEntries = newEntries;
+			fEntryCapacity = newCapacity;
+		}
+		entryIndex = fEntryCount++;
+	}
+
+	fUsedCount++;
+
+	PoseIndexEntry *entry = &fEntries[entryIndex];
+	entry->fPose = pose;
+	entry->fIndexHint = indexHint;
+	entry->fChains = 0;
+
+	Model *model = pose->TargetModel();
+	ASSERT(model);
+
+	Link(entryIndex, kPoseChain, Hash(pose));
+	Link(entryIndex, kNodeChain, Hash(model->NodeRef()));
+	Link(entryIndex, kEntryChain, Hash(model->EntryRef()));
+	if (model->IsSymLink() && model->LinkTo())
+		Link(entryIndex, kLinkChain, Hash(model->LinkTo()->NodeRef()));
+	if (model->IsVolume())
+		Link(entryIndex, kVolumeChain, Hash(model->NodeRef()->device));
+
+	entry->fName = -1;
+	if (fNamesIndexed)
+		AddName(entryIndex);
+}
+
+
+bool
+PoseListIndex::Remove(BPose *pose, int32 *indexHint)
+{
+	// only uses the hashes stored in the entry, never the pose itself, so
+	// that it is safe to call with a pose that is about to be deleted
+	PoseIndexEntry *entry = Find(pose);
+	if (!entry)
+		return false;
+
+	if (indexHint)
+		*indexHint = entry->fIndexHint;
+
+	int32 entryIndex = entry - fEntries;
+	for (int32 chain = 0; chain < kChainCount; chain++) {
+		if (entry->fChains & (1 << chain))
+			Unlink(entryIndex, chain);
+	}
+
+	if (fNamesIndexed)
+		RemoveName(entryIndex);
+
+	entry->fPose = NULL;
+	entry->fNext[kPoseChain] = fFreeEntry;
+	fFreeEntry = entryIndex;
+	fUsedCount--;
+
+	return true;
+}
+
+
+PoseIndexEntry *
+PoseListIndex::First(int32 chain, uint32 hash) const
+{
+	int32 index = *Bucket(chain, hash);
+	for (; index >= 0; index = fEntries[index].fNext[chain]) {
+		if (fEntries[index].fHash[chain] == hash)
+			return &fEntries[index];
+	}
+
+	return NULL;
+}
+
+
+PoseIndexEntry *
+PoseListIndex::Next(int32 chain, const PoseIndexEntry *entry) const
+{
+	uint32 hash = entry->fHash[chain];
+	int32 index = entry->fNext[chain];
+	for (; index >= 0; index = fEntries[index].fNext[chain]) {
+		if (fEntries[index].fHash[chain] == hash)
+			return &fEntries[index];
+	}
+
+	return NULL;
+}
+
+
+PoseIndexEntry *
+PoseListIndex::Find(const BPose *pose) const
+{
+	PoseIndexEntry *entry = First(kPoseChain, Hash(pose));
+	for (; entry; entry = Next(kPoseChain, entry)) {
+		if (entry->fPose == pose)
+			return entry;
+	}
+
+	return NULL;
+}
+
+
+void
+PoseListIndex::IndexNames()
+{
+	// the buffer is sized for all names up front, folding doesn't change
+	// their length
+	int32 size = 0;
+	for (int32 index = 0; index < fEntryCount; index++) {
+		if (fEntries[index].fPose)
+			size += strlen(fEntries[index].fPose->TargetModel()->Name()) + 1;
+	}
+
+	fNameBuffer = (char *)malloc(size + 1);
+	if (!fNameBuffer)
+		throw std::bad_alloc();
+	fNameBufferCapacity = size + 1;
+
+	fNamesIndexed = true;
+	for (int32 index = 0; index < fEntryCount; index++) {
+		if (fEntries[index].fPose)
+			AddName(index);
+	}
+}
+
+
+void
+PoseListIndex::AddName(int32 entryIndex)
+{
+	PoseIndexEntry *entry = &fEntries[entryIndex];
+
+	const char *name = entry->fPose->TargetModel()->Name();
+	int32 length = strlen(name);
+	if (fNameBufferSize + length + 1 > fNameBufferCapacity) {
+		int32 newCapacity = max_c(fNameBufferCapacity << 1,
+			fNameBufferSize + length + 1);
+		char *newBuffer = (char *)realloc(fNameBuffer, newCapacity);
+		if (!newBuffer)
+			throw std::bad_alloc();
+
+		fNameBuffer = newBuffer;
+		fNameBufferCapacity = newCapacity;
+	}
+
+	if (fPendingNameCount == fPendingNameCapacity) {
+		int32 newCapacity = fPendingNameCapacity
+			? fPendingNameCapacity << 1 : kMinIndexBuckets;
+		int32 *newPending = (int32 *)realloc(fPendingNames,
+			newCapacity * sizeof(int32));
+		if (!newPending)
+			throw std::bad_alloc();
+
+		fPendingNames = newPending;
+		fPendingNameCapacity = newCapacity;
+	}
+
+	entry->fName = fNameBufferSize;
+	fNameBufferSize += FoldCase(name, fNameBuffer + fNameBufferSize) + 1;
+	entry->fNamePending = true;
+	entry->fNamePosition = fPendingNameCount;
+	fPendingNames[fPendingNameCount++] = entryIndex;
+}
+
+
+void
+PoseListIndex::RemoveName(int32 entryIndex)
+{
+	// the name might have changed already, the entry knows where it was
+	// filed
+	PoseIndexEntry *entry = &fEntries[entryIndex];
+	if (entry->fNamePending)
+		fPendingNames[entry->fNamePosition] = -1;
+	else {
+		fSortedNames[entry->fNamePosition] = -1;
+		fRemovedNameCount++;
+	}
+
+	fRemovedNameBytes += strlen(NameOf(entryIndex)) + 1;
+	entry->fName = -1;
+}
+
+
+void
+PoseListIndex::SortNames()
+{
+	// sorts the pending names and merges them with the sorted ones,
+	// dropping the removed entries along the way
+	if (!fPendingNameCount && !fRemovedNameCount)
+		return;
+
+	int32 pendingCount = 0;
+	for (int32 index = 0; index < fPendingNameCount; index++) {
+		if (fPendingNames[index] >= 0)
+			fPendingNames[pendingCount++] = fPendingNames[index];
+	}
+
+	PoseNameOrder order(this);
+	std::sort(fPendingNames, fPendingNames + pendingCount, order);
+
+	int32 *merged = (int32 *)malloc((fSortedNameCount + pendingCount + 1)
+		* sizeof(int32));
+	if (!merged)
+		throw std::bad_alloc();
+
+	int32 count = 0;
+	int32 sortedIndex = 0;
+	int32 pendingIndex = 0;
+	for (;;) {
+		while (sortedIndex < fSortedNameCount && fSortedNames[sortedIndex] < 0)
+			sortedIndex++;
+
+		int32 next;
+		if (sortedIndex < fSortedNameCount) {
+			if (pendingIndex < pendingCount
+				&& order(fPendingNames[pendingIndex], fSortedNames[sortedIndex]))
+				next = fPendingNames[pendingIndex++];
+			else
+				next = fSortedNames[sortedIndex++];
+		} else if (pendingIndex < pendingCount)
+			next = fPendingNames[pendingIndex++];
+		else
+			break;
+
+		fEntries[next].fNamePending = false;
+		fEntries[next].fNamePosition = count;
+		merged[count++] = next;
+	}
+
+	free(fSortedNames);
+	fSortedNames = merged;
+	fSortedNameCount = count;
+	fRemovedNameCount = 0;
+	fPendingNameCount = 0;
+}
+
+
+void
+PoseListIndex::CompactNames()
+{
+	char *buffer = (char *)malloc(fNameBufferSize - fRemovedNameBytes + 1);
+	if (!buffer)
+		throw std::bad_alloc();
+
+	int32 size = 0;
+	for (int32 index = 0; index < fEntryCount; index++) {
+		PoseIndexEntry *entry = &fEntries[index];
+		if (!entry->fPose || entry->fName < 0)
+			continue;
+
+		int32 length = strlen(NameOf(index)) + 1;
+		memcpy(buffer + size, NameOf(index), length);
+		entry->fName = size;
+		size += length;
+	}
+
+	free(fNameBuffer);
+	fNameBuffer = buffer;
+	fNameBufferSize = size;
+	fNameBufferCapacity = size + 1;
+	fRemovedNameBytes = 0;
+}
+
+
+PoseIndexEntry *
+PoseListIndex::FindName(const char *foldedName, int32 match)
+{
+	if (!fNamesIndexed)
+		IndexNames();
+
+	// the names of removed entries pile up in the buffer until there
+	// are as many of them as there are names in use
+	if (fRemovedNameBytes > fNameBufferSize / 2)
+		CompactNames();
+
+	SortNames();
+
+	// find the first name that is not less than (or, for kNameAfter,
+	// not less or equal to) <foldedName>
+	int32 low = 0;
+	int32 high = fSortedNameCount;
+	while (low < high) {
+		int32 middle = (low + high) / 2;
+		int result = strcmp(NameOf(fSortedNames[middle]), foldedName);
+		if (result < 0 || (result == 0 && match == kNameAfter))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (match == kNameBefore)
+		low--;
+
+	if (low < 0 || low >= fSortedNameCount)
+		return NULL;
+
+	return &fEntries[fSortedNames[low]];
+}
+
+
+// #pragma mark -
+
+
+PoseList::PoseList(int32 itemsPerBlock, bool owning)
+	:	BObjectList<BPose>(itemsPerBlock, owning),
+		fIndex(NULL)
+{
+}
+
+
+PoseList::PoseList(const PoseList &list)
+	:	BObjectList<BPose>(list),
+		fIndex(NULL)
+{
+}
+
+
+PoseList::~PoseList()
+{
+	delete fIndex;
+}
+
+
+PoseList &
+PoseList::operator=(const PoseList &list)
+{
+	delete fIndex;
+	fIndex = NULL;
+
+	BObjectList<BPose>::operator=(list);
+	return *this;
+}
+
+
+bool
+PoseList::AddItem(BPose *pose)
+{
+	if (!BObjectList<BPose>::AddItem(pose))
+		return false;
+
+	if (fIndex)
+		fIndex->Add(pose, CountItems() - 1);
+
+	return true;
+}
+
+
+bool
+PoseList::AddItem(BPose *pose, int32 atIndex)
+{
+	if (!BObjectList<BPose>::AddItem(pose, atIndex))
+		return false;
+
+	if (fIndex)
+		fIndex->Add(pose, atIndex);
+
+	return true;
+}
+
+
+bool
+PoseList::AddList(const PoseList *list)
+{
+	int32 count = list->CountItems();
+	for (int32 index = 0; index < count; index++) {
+		if (!AddItem(list->ItemAt(index)))
+			return false;
+	}
+
+	return true;
+}
+
+
+bool
+PoseList::RemoveItem(BPose *pose, bool deleteIfOwning)
+{
+	// unindex first, an owning list deletes the pose
+	if (fIndex)
+		fIndex->Remove(pose);
+
+	return BObjectList<BPose>::RemoveItem(pose, deleteIfOwning);
+}
+
+
+BPose *
+PoseList::RemoveItemAt(int32 index)
+{
+	BPose *pose = BObjectList<BPose>::RemoveItemAt(index);
+	if (pose && fIndex)
+		fIndex->Remove(pose);
+
+	return pose;
+}
+
+
+void
+PoseList::MakeEmpty()
+{
+	delete fIndex;
+	fIndex = NULL;
+
+	BObjectList<BPose>::MakeEmpty();
+}
+
+
+void
+PoseList::SortItems(CompareFunction function)
+{
+	BObjectList<BPose>::SortItems(function);
+	UpdateIndexHints();
+}
+
+
+void
+PoseList::SortItems(CompareFunctionWithState function, void *state)
+{
+	BObjectList<BPose>::SortItems(function, state);
+	UpdateIndexHints();
+}
+
+
+void
+PoseList::SetOrder(BPose *const *poses)
+{
+	int32 count = CountItems();
+	for (int32 index = 0; index < count; index++)
+		SwapWithItem(index, poses[index]);
+
+	UpdateIndexHints();
+}
+
+
+void
+PoseList::InsertItems(BPose *const *poses, const int32 *indices, int32 count)
+{
+	if (count <= 0)
+		return;
+
+	// make room at the end, then move the items up from the back, dropping
+	// the new ones in on the way
+	int32 oldCount = CountItems();
+	for (int32 index = 0; index < count; index++)
+		BObjectList<BPose>::AddItem(poses[index]);
+
+	int32 dest = oldCount + count - 1;
+	int32 source = oldCount - 1;
+	for (int32 index = count - 1; index >= 0; index--) {
+		ASSERT(index == 0 || indices[index - 1] <= indices[index]);
+		while (source >= indices[index])
+			SwapWithItem(dest--, ItemAt(source--));
+
+		SwapWithItem(dest--, poses[index]);
+	}
+
+	if (fIndex) {
+		for (int32 index = 0; index < count; index++)
+			fIndex->Add(poses[index], indices[index] + index);
+
+		UpdateIndexHints(indices[0]);
+	}
+}
+
+
+void
+PoseList::UpdateIndexHints(int32 from)
+{
+	if (!fIndex)
+		return;
+
+	// poses are indexed by pointer, only the position hints need
+	// refreshing
+	int32 count = CountItems();
+	for (int32 index = from; index < count; index++) {
+		PoseIndexEntry *entry = fIndex->Find(ItemAt(index));
+		if (entry)
+			entry->fIndexHint = index;
+	}
+}
+
+
+void
+PoseList::PoseChanged(BPose *pose)
+{
+	int32 indexHint;
+	if (fIndex && fIndex->Remove(pose, &indexHint))
+		fIndex->Add(pose, indexHint);
+}
+
+
+PoseListIndex *
+PoseList::Index() const
+{
+	if (!fIndex && CountItems() > kMinIndexedPoses) {
+		int32 count = CountItems();
+		fIndex = new PoseListIndex(count);
+		for (int32 index = 0; index < count; index++)
+			fIndex->Add(ItemAt(index), index);
+	}
+
+	return fIndex;
+}
+
+
+int32
+PoseList::ResultIndex(BPose *pose, int32 indexHint) const
+{
+	// poses added or removed in front of <pose> shift it around, only
+	// fall back to a full IndexOf if the hint went stale
+	if (indexHint >= 0 && indexHint < CountItems() && ItemAt(indexHint) == pose)
+		return indexHint;
+
+	return IndexOf(pose);
+}
 
 
 BPose *
 PoseList::FindPose(const node_ref *node, int32 *resultingIndex) const
 {
+	PoseListIndex *poseIndex = Index();
+	if (poseIndex) {
+		PoseIndexEntry *entry = poseIndex->First(kNodeChain,
+			PoseListIndex::Hash(node));
+		for (; entry; entry = poseIndex->Next(kNodeChain, entry)) {
+			BPose *pose = entry->fPose;
+			if (*pose->TargetModel()->NodeRef() == *node) {
+				if (resultingIndex) {
+					entry->fIndexHint = ResultIndex(pose, entry->fIndexHint);
+					*resultingIndex = entry->fIndexHint;
+				}
+				return pose;
+			}
+		}
+		return NULL;
+	}
+
 	int32 count = CountItems();
 	for (int32 index = 0; index < count; index++) {
 		BPose *pose = ItemAt(index);
@@ -60,6 +883,24 @@ PoseList::FindPose(const node_ref *node, int32 *resultingIndex) const
 BPose *
 PoseList::FindPose(const entry_ref *entry, int32 *resultingIndex) const
 {
+	PoseListIndex *poseIndex = Index();
+	if (poseIndex) {
+		PoseIndexEntry *indexEntry = poseIndex->First(kEntryChain,
+			PoseListIndex::Hash(entry));
+		for (; indexEntry; indexEntry = poseIndex->Next(kEntryChain, indexEntry)) {
+			BPose *pose = indexEntry->fPose;
+			if (*pose->TargetModel()->EntryRef() == *entry) {
+				if (resultingIndex) {
+					indexEntry->fIndexHint = ResultIndex(pose,
+						indexEntry->fIndexHint);
+					*resultingIndex = indexEntry->fIndexHint;
+				}
+				return pose;
+			}
+		}
+		return NULL;
+	}
+
 	int32 count = CountItems();
 	for (int32 index = 0; index < count; index++) {
 		BPose *pose = ItemAt(index);
@@ -82,6 +923,30 @@ PoseList::FindPose(const Model *model, int32 *resultingIndex) const
 BPose *
 PoseList::DeepFindPose(const node_ref *node, int32 *resultingIndex) const
 {
+	PoseListIndex *poseIndex = Index();
+	if (poseIndex) {
+		// a pose for the node itself wins over a symlink pointing to it
+		BPose *pose = FindPose(node, resultingIndex);
+		if (pose)
+			return pose;
+
+		PoseIndexEntry *entry = poseIndex->First(kLinkChain,
+			PoseListIndex::Hash(node));
+		for (; entry; entry = poseIndex->Next(kLinkChain, entry)) {
+			pose = entry->fPose;
+			Model *model = pose->TargetModel();
+			if (model->IsSymLink() && model->LinkTo()
+				&& *model->LinkTo()->NodeRef() == *node) {
+				if (resultingIndex) {
+					entry->fIndexHint = ResultIndex(pose, entry->fIndexHint);
+					*resultingIndex = entry->fIndexHint;
+				}
+				return pose;
+			}
+		}
+		return NULL;
+	}
+
 	int32 count = CountItems();
 	for (int32 index = 0; index < count; index++) {
 		BPose *pose = ItemAt(index);
@@ -109,6 +974,24 @@ PoseList::DeepFindPose(const node_ref *node, int32 *resultingIndex) const
 BPose *
 PoseList::FindVolumePose(const dev_t device, int32 *resultingIndex) const
 {
+	PoseListIndex *poseIndex = Index();
+	if (poseIndex) {
+		PoseIndexEntry *entry = poseIndex->First(kVolumeChain,
+			PoseListIndex::Hash(device));
+		for (; entry; entry = poseIndex->Next(kVolumeChain, entry)) {
+			BPose *pose = entry->fPose;
+			Model *model = pose->TargetModel();
+			if (model->IsVolume() && model->NodeRef()->device == device) {
+				if (resultingIndex) {
+					entry->fIndexHint = ResultIndex(pose, entry->fIndexHint);
+					*resultingIndex = entry->fIndexHint;
+				}
+				return pose;
+			}
+		}
+		return NULL;
+	}
+
 	int32 count = CountItems();
 	for (int32 index = 0; index < count; index++) {
 		BPose *pose = ItemAt(index);
@@ -122,3 +1005,69 @@ PoseList::FindVolumePose(const dev_t device, int32 *resultingIndex) const
 	}
 	return NULL;
 }
+
+
+static void
+FoldName(const char *name, char *buffer)
+{
+	strncpy(buffer, name, B_FILE_NAME_LENGTH - 1);
+	buffer[B_FILE_NAME_LENGTH - 1] = '\0';
+	FoldCase(buffer, buffer);
+}
+
+
+BPose *
+PoseList::FindName(const char *name, int32 match, int32 *resultingIndex) const
+{
+	char folded[B_FILE_NAME_LENGTH];
+	FoldName(name, folded);
+
+	PoseListIndex *poseIndex = Index();
+	if (poseIndex) {
+		PoseIndexEntry *entry = poseIndex->FindName(folded, match);
+		if (!entry)
+			return NULL;
+
+		entry->fIndexHint = ResultIndex(entry->fPose, entry->fIndexHint);
+		if (resultingIndex)
+			*resultingIndex = entry->fIndexHint;
+		return entry->fPose;
+	}
+
+	// the same search FindBestMatch and FindNextMatch used to do, folded
+	// the same way as the name index
+	BPose *bestPose = NULL;
+	char bestName[B_FILE_NAME_LENGTH];
+	char poseName[B_FILE_NAME_LENGTH];
+	int32 count = CountItems();
+	for (int32 index = 0; index < count; index++) {
+		BPose *pose = ItemAt(index);
+		FoldName(pose->TargetModel()->Name(), poseName);
+		int result = strcmp(poseName, folded);
+
+		bool matches;
+		switch (match) {
+			case kNameAfter:
+				matches = result > 0
+					&& (!bestPose || strcmp(poseName, bestName) <= 0);
+				break;
+			case kNameBefore:
+				matches = result < 0
+					&& (!bestPose || strcmp(poseName, bestName) >= 0);
+				break;
+			default:
+				matches = result >= 0
+					&& (!bestPose || strcmp(poseName, bestName) <= 0);
+				break;
+		}
+
+		if (matches) {
+			bestPose = pose;
+			strcpy(bestName, poseName);
+			if (resultingIndex)
+				*resultingIndex = index;
+		}
+	}
+
+	return bestPose;
+}
@@ -47,16 +47,59 @@ struct entry_ref;
 namespace BPrivate {
 
 class Model;
+class PoseListIndex;
+
+// kinds of name searches for PoseList::FindName
+enum {
+	kNameAtOrAfter,
+		// the first name that is equal to or sorts after the given one
+	kNameAfter,
+		// the first name that sorts after the given one
+	kNameBefore
+		// the last name that sorts before the given one
+};
 
-class PoseList : public BObjectList<BPose> {
+class PoseList : private BObjectList<BPose> {
+	// the BObjectList is a private base so that nothing can change the
+	// list behind the back of the lookup index; its read-only calls are
+	// passed on as they are
 public:
-	PoseList(int32 itemsPerBlock = 20, bool owning = false)
-		:	BObjectList<BPose>(itemsPerBlock, owning)
-		{}
-
-	PoseList(const PoseList &list)
-		:	BObjectList<BPose>(list)
-		{}
+	typedef BObjectList<BPose>::CompareFunction CompareFunction;
+	typedef BObjectList<BPose>::CompareFunctionWithState
+		CompareFunctionWithState;
+
+	PoseList(int32 itemsPerBlock = 20, bool owning = false);
+	PoseList(const PoseList &list);
+	virtual ~PoseList();
+
+	PoseList &operator=(const PoseList &list);
+
+	using BObjectList<BPose>::ItemAt;
+	using BObjectList<BPose>::FirstItem;
+	using BObjectList<BPose>::LastItem;
+	using BObjectList<BPose>::IndexOf;
+	using BObjectList<BPose>::HasItem;
+	using BObjectList<BPose>::IsEmpty;
+	using BObjectList<BPose>::CountItems;
+	using BObjectList<BPose>::EachElement;
+
+	// the calls that change the list keep the lookup index in sync
+	bool AddItem(BPose *);
+	bool AddItem(BPose *, int32);
+	bool AddList(const PoseList *);
+	bool RemoveItem(BPose *, bool deleteIfOwning = true);
+	BPose *RemoveItemAt(int32);
+	void MakeEmpty();
+	void SortItems(CompareFunction);
+	void SortItems(CompareFunctionWithState, void *state);
+
+	void SetOrder(BPose *const *poses);
+		// rearranges the list to the order of <poses>, which has to hold
+		// the same poses as the list does
+	void InsertItems(BPose *const *poses, const int32 *indices, int32 count);
+		// inserts all of <poses> in one pass, each one in front of the
+		// item that is at the corresponding index in the list as it is
+		// now; <indices> has to be in ascending order
 
 	BPose *FindPose(const node_ref *node, int32 *index = NULL) const;
 	BPose *FindPose(const entry_ref *entry, int32 *index = NULL) const;
@@ -65,6 +108,22 @@ public:
 		// same as FindPose, node can be a target of the actual
 		// pose if the pose is a symlink
 	BPose *FindVolumePose(const dev_t device, int32 *index = NULL) const;
+	BPose *FindName(const char *name, int32 match, int32 *index) const;
+		// case-insensitive search by name, used for type-ahead; large
+		// lists keep a sorted name index for it
+
+	void PoseChanged(BPose *);
+		// call after the entry_ref or the symlink target of a pose in
+		// the list changed, re-files the pose in the lookup index
+
+private:
+	PoseListIndex *Index() const;
+	int32 ResultIndex(BPose *, int32 indexHint) const;
+	void UpdateIndexHints(int32 from = 0);
+
+	mutable PoseListIndex *fIndex;
+		// hash index used by the Find calls; built lazily on the
+		// first lookup in a large list, NULL until then
 };
 
 // iteration glue, add permutations as needed
@@ -38,7 +38,9 @@ All rights reserved.
 #include <fs_info.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <map>
+#include <new>
 #include <string.h>
 
 #include <Alert.h>
@@ -78,9 +80,12 @@ All rights reserved.
 #include "MimeTypes.h"
 #include "Navigator.h"
 #include "NavMenu.h"
+#include "NodeAttributes.h"
 #include "Pose.h"
+#include "PoseGrid.h"
 #include "PoseView.h"
 #include "InfoWindow.h"
+#include "SlabAllocator.h"
 #include "Utilities.h"
 #include "Tests.h"
 #include "TextViewSupport.h"
@@ -98,7 +103,24 @@ const float kDoubleClickTresh = 6;
 const float kCountViewWidth = 62;
 
 const uint32 kAddNewPoses = 'Tanp';
-const int32 kMaxAddPosesChunk = 10;
+
+const size_t kAddPosesDirentBufferSize = 64 * 1024;
+const int32 kMinAddPosesDirents = 16;
+const int32 kMaxAddPosesDirents = 128;
+	// AddPosesTask starts out reading a few entries at a time to get the
+	// first poses up quickly, then ramps up to large batches
+const int32 kMaxAddPosesChunk = 128;
+const int32 kMaxAddPosesOpenNodes = 256;
+	// models keep their node open until the window gets to them; this
+	// limits the nodes held open by the batch being built and the chunks
+	// still waiting in the window's queue, it has to leave room for a
+	// full batch on top of an almost full chunk
+const bigtime_t kMaxAddPosesLockTime = 20000;
+	// longest time AddPosesTask holds the window lock in one go
+const bigtime_t kMinAddPosesChunkInterval = 50000;
+const bigtime_t kMaxAddPosesChunkInterval = 400000;
+	// the first chunk of poses is handed to the window right away,
+	// subsequent ones at increasing intervals
 
 namespace BPrivate {
 extern bool delete_point(void *);
@@ -137,31 +159,122 @@ const char *kNoCopyToRootStr = "You must drop items on one of the disk icons "
 const char *kOkToMoveStr = "Are you sure you want to move or copy the selected "
 	"item(s) to this folder?";
 
+struct AddPosesNodes {
+	// the semaphore AddPosesTask counts the open nodes of its models with;
+	// the chunks it sends off may outlive the task, the last one to let go
+	// deletes it
+	AddPosesNodes();
+	~AddPosesNodes();
+	AddPosesNodes *Acquire();
+	void Release();
+
+	sem_id fSem;
+	int32 fRefCount;
+};
+
+
+AddPosesNodes::AddPosesNodes()
+	:	fSem(create_sem(kMaxAddPosesOpenNodes, "add poses nodes")),
+		fRefCount(1)
+{
+}
+
+
+AddPosesNodes::~AddPosesNodes()
+{
+	if (fSem >= B_OK)
+		delete_sem(fSem);
+}
+
+
+AddPosesNodes *
+AddPosesNodes::Acquire()
+{
+	atomic_add(&fRefCount, 1);
+	return this;
+}
+
+
+void
+AddPosesNodes::Release()
+{
+	if (atomic_add(&fRefCount, -1) == 1)
+		delete this;
+}
+
+
 struct AddPosesResult {
+	AddPosesResult(AddPosesNodes *openNodes);
 	~AddPosesResult();
 	void ReleaseModels();
+	void MakeRoomFor(int32 count);
 	
-	Model *fModels[kMaxAddPosesChunk]; 
-	PoseInfo fPoseInfos[kMaxAddPosesChunk]; 
+	Model **fModels; 
+	PoseInfo *fPoseInfos; 
 	int32 fCount; 
+	int32 fCapacity;
+	AddPosesNodes *fOpenNodes;
+		// gets the nodes of our models back once they are closed
 };
 
 
+AddPosesResult::AddPosesResult(AddPosesNodes *openNodes)
+	:	fModels(NULL),
+		fPoseInfos(NULL),
+		fCount(0),
+		fCapacity(0),
+		fOpenNodes(openNodes->Acquire())
+{
+}
+
+
 AddPosesResult::~AddPosesResult(void)
 {
 	for (int32 i = 0; i < fCount; i++)
 		delete fModels[i];
+
+	delete [] fModels;
+	delete [] fPoseInfos;
+
+	// CreatePoses closed the nodes of released models, the others are
+	// closed now
+	if (fCount)
+		release_sem_etc(fOpenNodes->fSem, fCount, 0);
+	fOpenNodes->Release();
 }
 
 
 void
 AddPosesResult::ReleaseModels(void)
 {
-	for (int32 i = 0; i < kMaxAddPosesChunk; i++)
+	for (int32 i = 0; i < fCount; i++)
 		fModels[i] = NULL;
 }
 
 
+void
+AddPosesResult::MakeRoomFor(int32 count)
+{
+	// chunks are sized by time, not by count; grow as needed
+	if (fCount + count <= fCapacity)
+		return;
+
+	int32 capacity = max(fCapacity * 2, fCount + count);
+	Model **models = new Model * [capacity];
+	PoseInfo *poseInfos = new PoseInfo [capacity];
+	for (int32 index = 0; index < fCount; index++) {
+		models[index] = fModels[index];
+		poseInfos[index] = fPoseInfos[index];
+	}
+
+	delete [] fModels;
+	delete [] fPoseInfos;
+	fModels = models;
+	fPoseInfos = poseInfos;
+	fCapacity = capacity;
+}
+
+
 // #pragma mark -
 
 
@@ -175,11 +288,12 @@ BPoseView::BPoseView(Model *model, BRect bounds, uint32 viewMode, uint32 resizeM
 	fExtent(LONG_MAX, LONG_MAX, LONG_MIN, LONG_MIN),
 	fPoseList(new PoseList(40, true)),
 	fVSPoseList(new PoseList()),
+	fPoseGrid(new PoseGrid()),
 	fSelectionList(new PoseList()),
 	fMimeTypesInSelectionCache(20, true),
 	fZombieList(new BObjectList<Model>(10, true)),
 	fColumnList(new BObjectList<BColumn>(4, true)),
-	fMimeTypeList(new BObjectList<BString>(10, true)),
+	fMimeTypeList(new BObjectList<const char>(10, false)),
 	fMimeTypeListIsDirty(false),
 	fViewState(new BViewState),
 	fStateNeedsSaving(false),
@@ -227,6 +341,7 @@ BPoseView::~BPoseView()
 {
 	delete fPoseList;
 	delete fVSPoseList;
+	delete fPoseGrid;
 	delete fColumnList;
 	delete fSelectionList;
 	delete fMimeTypeList;
@@ -237,6 +352,9 @@ BPoseView::~BPoseView()
 	delete fKeyRunner;
 	
 	IconCache::sIconCache->Deleting(this);
+
+	// hand the slabs our poses lived in back to the heap
+	SlabAllocator::ReleaseAllUnusedSlabs();
 }
 
 
@@ -256,6 +374,14 @@ BPoseView::Init(const BMessage &message)
 }	
 
 
+void
+BPoseView::Init(const WindowStateArchive &archive)
+{
+	RestoreState(archive);
+	InitCommon();
+}
+
+
 void
 BPoseView::InitCommon()
 {
@@ -414,6 +540,26 @@ BPoseView::RestoreColumnState(const BMessage &message)
 }
 
 
+void 
+BPoseView::RestoreColumnState(const WindowStateArchive &archive)
+{
+	fColumnList->MakeEmpty();
+
+	BObjectList<BColumn> tempSortedList;
+	archive.InstantiateColumns(&tempSortedList);
+	AddColumnList(&tempSortedList);
+
+	SetUpDefaultColumnsIfNeeded();
+	if (!ColumnFor(PrimarySort())) {
+		fViewState->SetPrimarySort(FirstColumn()->AttrHash());
+		fViewState->SetPrimarySortType(FirstColumn()->AttrType());
+	}
+
+	if (PrimarySort() == SecondarySort())
+		fViewState->SetSecondarySort(0);
+}
+
+
 void
 BPoseView::AddColumnList(BObjectList<BColumn> *list)
 {
@@ -509,6 +655,24 @@ BPoseView::RestoreState(const BMessage &message)
 }
 
 
+void 
+BPoseView::RestoreState(const WindowStateArchive &archive)
+{
+	RestoreColumnState(archive);
+
+	BViewState *viewstate = archive.InstantiateViewState();
+	if (viewstate) {
+		delete fViewState;
+		fViewState = viewstate;
+	}
+
+	if (IsDesktopWindow() && ViewMode() == kListMode) {
+		// recover if desktop window view state set wrong
+		fViewState->SetViewMode(kIconMode);
+	}
+}
+
+
 namespace BPrivate {
 
 bool
@@ -647,6 +811,32 @@ BPoseView::SaveState(BMessage &message) const
 }
 
 
+void 
+BPoseView::SaveColumnState(WindowStateArchive &archive) const
+{
+	for (int32 index = 0; ; index++) {
+		const BColumn *column = ColumnAt(index);
+		if (!column)
+			break;
+		archive.AddColumn(column);
+	}
+}
+
+
+void 
+BPoseView::SaveState(WindowStateArchive &archive) const
+{
+	SaveColumnState(archive);
+
+	if (ViewMode() == kListMode)
+		fViewState->SetListOrigin(LeftTop());
+	else
+		fViewState->SetIconOrigin(LeftTop());
+
+	archive.SetViewState(fViewState);
+}
+
+
 float 
 BPoseView::StringWidth(const char *str) const
 {
@@ -1177,14 +1367,224 @@ class AutoLockingMessenger {
 };
 
 
+struct ModelBuildItem {
+	node_ref dirNode;
+	node_ref itemNode;
+	const char *name;
+	Model *model;
+	bool poseInfoRead;
+	ReadAttrResult poseInfoResult;
+	PoseInfo poseInfo;
+		// read along with the type while the model was built
+};
+
+
+class ModelBuilder {
+	// builds the models for a batch of directory entries; constructing a
+	// model means a stat, opening the node and reading its type and
+	// preferred app, so on slow volumes it pays to have a few threads
+	// waiting on the disk at the same time
+	public:
+		ModelBuilder(int32 workerCount);
+		~ModelBuilder();
+
+		void Build(ModelBuildItem *items, int32 count);
+			// returns once all the items have their model; the calling
+			// thread helps out
+
+	private:
+		void StartWorkers();
+		static status_t WorkerEntry(void *);
+		void Work();
+
+		ModelBuildItem *fItems;
+		int32 fCount;
+		int32 fNext;
+		sem_id fStartSem;
+		sem_id fDoneSem;
+		thread_id *fWorkers;
+		int32 fWorkerCount;
+		int32 fWantedWorkerCount;
+		volatile bool fQuitting;
+};
+
+
+const int32 kMinParallelModelBuild = 8;
+	// small folders are not worth starting any threads for
+
+
+ModelBuilder::ModelBuilder(int32 workerCount)
+	:	fItems(NULL),
+		fCount(0),
+		fNext(0),
+		fStartSem(-1),
+		fDoneSem(-1),
+		fWorkers(NULL),
+		fWorkerCount(0),
+		fWantedWorkerCount(workerCount - 1),
+			// the thread calling Build is one of the workers
+		fQuitting(false)
+{
+}
+
+
+void
+ModelBuilder::StartWorkers()
+{
+	fStartSem = create_sem(0, "model builder start");
+	fDoneSem = create_sem(0, "model builder done");
+	if (fStartSem < B_OK || fDoneSem < B_OK)
+		return;
+
+	fWorkers = new thread_id [fWantedWorkerCount];
+	for (int32 index = 0; index < fWantedWorkerCount; index++) {
+		thread_id worker = spawn_thread(&ModelBuilder::WorkerEntry,
+			"model builder", B_DISPLAY_PRIORITY, this);
+		if (worker < B_OK)
+			break;
+
+		fWorkers[fWorkerCount++] = worker;
+		resume_thread(worker);
+	}
+}
+
+
+ModelBuilder::~ModelBuilder()
+{
+	fQuitting = true;
+	if (fWorkerCount)
+		release_sem_etc(fStartSem, fWorkerCount, 0);
+
+	for (int32 index = 0; index < fWorkerCount; index++) {
+		status_t result;
+		wait_for_thread(fWorkers[index], &result);
+	}
+
+	delete [] fWorkers;
+	if (fStartSem >= B_OK)
+		delete_sem(fStartSem);
+	if (fDoneSem >= B_OK)
+		delete_sem(fDoneSem);
+}
+
+
+void
+ModelBuilder::Build(ModelBuildItem *items, int32 count)
+{
+	fItems = items;
+	fCount = count;
+	fNext = 0;
+
+	if (fWantedWorkerCount > 0 && count >= kMinParallelModelBuild) {
+		StartWorkers();
+		fWantedWorkerCount = 0;
+	}
+
+	if (fWorkerCount && count > 1) {
+		// every worker checks in when done so that none of them is still
+		// looking at this batch when the next one gets set up
+		release_sem_etc(fStartSem, fWorkerCount, 0);
+		Work();
+		acquire_sem_etc(fDoneSem, fWorkerCount, 0, 0);
+	} else
+		Work();
+}
+
+
+status_t
+ModelBuilder::WorkerEntry(void *castToBuilder)
+{
+	ModelBuilder *builder = (ModelBuilder *)castToBuilder;
+	while (acquire_sem(builder->fStartSem) == B_OK && !builder->fQuitting) {
+		builder->Work();
+		release_sem(builder->fDoneSem);
+	}
+
+	return B_OK;
+}
+
+
+void
+ModelBuilder::Work()
+{
+	for (;;) {
+		int32 index = atomic_add(&fNext, 1);
+		if (index >= fCount)
+			break;
+
+		ModelBuildItem &item = fItems[index];
+		NodeAttributes attributes(kPoseInfoAttribute);
+		item.model = new Model(&item.dirNode, &item.itemNode, item.name, true,
+			false, &attributes);
+
+		item.poseInfoRead = attributes.WasRead(kPoseInfoAttribute);
+		item.poseInfoResult = attributes.PoseInfoResult();
+		if (attributes.GetPoseInfo() != NULL)
+			item.poseInfo = *attributes.GetPoseInfo();
+	}
+}
+
+
 class failToLock { /* exception in AddPoses*/ };
 
 
+static void
+LockAddPosesTarget(AutoLockingMessenger &lock, BPoseView *view,
+	thread_id threadID)
+{
+	if (!lock.Lock()) {
+		PRINT(("failed to lock\n"));
+		throw failToLock();
+	}
+
+	if (!view->IsValidAddPosesThread(threadID)) {
+		// this handles the case of a file panel when the directory is switched
+		// and and old AddPosesTask needs to die.
+		// we might no longer be the current async thread
+		// for this view - if not then we're done
+		view->HideBarberPole();
+
+		// for now use the same cleanup as failToLock does
+		throw failToLock();
+	}
+}
+
+
+static void
+AcquireAddPosesNodes(sem_id openNodesSem, int32 count,
+	AutoLockingMessenger &lock, BPoseView *view, thread_id threadID)
+{
+	// waits for the window to close enough of the nodes of earlier chunks
+	status_t result;
+	do {
+		result = acquire_sem_etc(openNodesSem, count, B_RELATIVE_TIMEOUT,
+			100000);
+		if (result == B_TIMED_OUT) {
+			// make sure we are still wanted while we wait
+			LockAddPosesTarget(lock, view, threadID);
+			lock.Unlock();
+		}
+	} while (result == B_TIMED_OUT || result == B_INTERRUPTED);
+}
+
+
+static inline dirent *
+NextDirent(dirent *ent)
+{
+	// the entries returned by one GetNextDirents call are packed back
+	// to back, d_reclen is the size of the whole record
+	return (dirent *)((char *)ent + ent->d_reclen);
+}
+
+
 status_t
 BPoseView::AddPosesTask(void *castToParams)
 {
-	// AddPosesTask reeds a bunch of models and passes them off to
-	// the pose placing and drawing routine.
+	// AddPosesTask reads batches of directory entries and has a
+	// ModelBuilder build their models without holding the window lock,
+	// keeping their order; it then locks the window
+	// once per batch to filter the models and passes them off in
+	// time-sized chunks to the pose placing and drawing routine.
 	//
 	AddPosesParams *params = (AddPosesParams *)castToParams;
 	BMessenger target(params->target);
@@ -1215,83 +1615,91 @@ BPoseView::AddPosesTask(void *castToParams)
 		return B_ERROR;
 	}
 
-	AddPosesResult *posesResult = new AddPosesResult;
-	posesResult->fCount = 0;
-	int32 modelChunkIndex = 0;
+	AddPosesNodes *openNodes = new AddPosesNodes;
+	AddPosesResult *posesResult = new AddPosesResult(openNodes);
 	bigtime_t nextChunkTime = 0;
+	bigtime_t chunkInterval = kMinAddPosesChunkInterval;
 	uint32 watchMask = view->WatchNewNodeMask();
 
 	bool hideDotFiles = TrackerSettings().HideDotFiles();
 
-#if DEBUG
-	for (int32 index = 0; index < kMaxAddPosesChunk; index++)
-		posesResult->fModels[index] = (Model *)0xdeadbeef;
-#endif
+	char *direntBuffer = new char [kAddPosesDirentBufferSize];
+	int32 direntCount = kMinAddPosesDirents;
+	ModelBuildItem *batch = new ModelBuildItem [kMaxAddPosesDirents];
+	int32 batchCount = 0;
+	int32 batchIndex = 0;
+	ModelBuilder builder(TrackerSettings().ModelWorkerCount());
 
 	try {
 		for (;;) {
 			lock.Unlock();
 
-			status_t result = B_OK;
-			char entBuf[1024];
-			dirent *eptr = (dirent *)entBuf;
-			Model *model = 0;
-			node_ref dirNode;
-			node_ref itemNode;
+			// read a batch of entries and build the models in parallel,
+			// this is the expensive part and does not need the window
 
-			posesResult->fModels[modelChunkIndex] = 0;
-				// ToDo - redo this so that modelChunkIndex increments right before
-				// a new model is added to the array; start with modelChunkIndex = -1
+			int32 acquiredNodes = direntCount;
+			AcquireAddPosesNodes(openNodes->fSem, acquiredNodes, lock, view,
+				threadID);
 
-			int32 count = container->GetNextDirents(eptr, 1024, 1);
-			if (count <= 0 && !modelChunkIndex) 
-				break;
-
-			if (count) {
-				ASSERT(count == 1);
+			int32 count = container->GetNextDirents((dirent *)direntBuffer,
+				kAddPosesDirentBufferSize, direntCount);
+			direntCount = min(direntCount * 2, kMaxAddPosesDirents);
 
+			batchCount = 0;
+			batchIndex = 0;
+			dirent *eptr = (dirent *)direntBuffer;
+			for (int32 index = 0; index < count; index++, eptr = NextDirent(eptr)) {
 				if ((!hideDotFiles && (!strcmp(eptr->d_name, ".") || !strcmp(eptr->d_name, "..")))
 					|| (hideDotFiles && eptr->d_name[0] == '.'))
 					continue;
 
-				dirNode.device = eptr->d_pdev;
-				dirNode.node = eptr->d_pino;
-				itemNode.device = eptr->d_dev;
-				itemNode.node = eptr->d_ino;
+				ModelBuildItem &item = batch[batchCount++];
+				item.dirNode.device = eptr->d_pdev;
+				item.dirNode.node = eptr->d_pino;
+				item.itemNode.device = eptr->d_dev;
+				item.itemNode.node = eptr->d_ino;
+				item.name = eptr->d_name;
 
-				BPoseView::WatchNewNode(&itemNode, watchMask, lock.Target());
+				BPoseView::WatchNewNode(&item.itemNode, watchMask, lock.Target());
 					// have to node monitor ahead of time because Model will
 					// cache up the file type and preferred app
 					// OK to call when poseView is not locked
-				model = new Model(&dirNode, &itemNode, eptr->d_name, true);
-				result = model->InitCheck();
-				posesResult->fModels[modelChunkIndex] = model;
 			}
+			builder.Build(batch, batchCount);
 
-			// before we access the pose view, lock down the window
+			// the models that don't make it into the chunk are closed or
+			// deleted right here
+			int32 chunkCount = posesResult->fCount;
+
+			if (count <= 0 && !posesResult->fCount) {
+				release_sem_etc(openNodes->fSem, acquiredNodes, 0);
+				break;
+			}
 
-			if (!lock.Lock()) {
-				PRINT(("failed to lock\n"));
-				posesResult->fCount = modelChunkIndex + 1;
-				throw failToLock();
+			if (count > 0 && !batchCount) {
+				// nothing but filtered out entries
+				release_sem_etc(openNodes->fSem, acquiredNodes, 0);
+				continue;
 			}
 
-			if (!view->IsValidAddPosesThread(threadID)) {
-				// this handles the case of a file panel when the directory is switched
-				// and and old AddPosesTask needs to die.
-				// we might no longer be the current async thread
-				// for this view - if not then we're done
-				view->HideBarberPole();
+			// before we access the pose view, lock down the window
 
-				// for now use the same cleanup as failToLock does
-				posesResult->fCount = modelChunkIndex + 1;
-				throw failToLock();
-			}
+			LockAddPosesTarget(lock, view, threadID);
+			bigtime_t lockTime = system_time();
 
-			if (count) {		
+			posesResult->MakeRoomFor(batchCount);
+			for (; batchIndex < batchCount; batchIndex++) {
+				if (system_time() - lockTime > kMaxAddPosesLockTime) {
+					// give the window a chance to handle other messages
+					lock.Unlock();
+					LockAddPosesTarget(lock, view, threadID);
+					lockTime = system_time();
+				}
+
+				Model *model = batch[batchIndex].model;
 					// try to watch the model, no matter what
 
-				if (result != B_OK) {
+				if (model->InitCheck() != B_OK) {
 					// failed to init pose, model is a zombie, add to zombie list
 					PRINT(("1 adding model %s to zombie list, error %s\n", model->Name(),
 						strerror(model->InitCheck())));
@@ -1299,14 +1707,20 @@ BPoseView::AddPosesTask(void *castToParams)
 					continue;
 				}
 
-				view->ReadPoseInfo(model, &(posesResult->fPoseInfos[modelChunkIndex]));
-				if (!view->ShouldShowPose(model, &(posesResult->fPoseInfos[modelChunkIndex]))
+				PoseInfo *poseInfo = &posesResult->fPoseInfos[posesResult->fCount];
+				if (batch[batchIndex].poseInfoRead) {
+					*poseInfo = batch[batchIndex].poseInfo;
+					view->ReadPoseInfo(model, poseInfo,
+						&batch[batchIndex].poseInfoResult);
+				} else
+					view->ReadPoseInfo(model, poseInfo);
+
+				if (!view->ShouldShowPose(model, poseInfo)
 					// filter out models we do not want to show
 					|| model->IsSymLink() && !view->CreateSymlinkPoseTarget(model)) {
 					// filter out symlinks whose target models we do not
 					// want to show
 
-					posesResult->fModels[modelChunkIndex] = 0;
 					delete model;
 					continue;
 				}
@@ -1315,34 +1729,33 @@ BPoseView::AddPosesTask(void *castToParams)
 					// EntryCreated watches everything, which is probably more correct
 					// clean this up
 
-				modelChunkIndex++;
+				posesResult->fModels[posesResult->fCount++] = model;
 			}
 
-			bigtime_t now = system_time();
-
-			if (!count || modelChunkIndex >= kMaxAddPosesChunk || now > nextChunkTime) {
-				// keep getting models until we get <kMaxAddPosesChunk> of them
-				// or until 300000 runs out
+			// the chunk gives back the nodes of its models
+			acquiredNodes -= posesResult->fCount - chunkCount;
+			if (acquiredNodes > 0)
+				release_sem_etc(openNodes->fSem, acquiredNodes, 0);
 
-				ASSERT(modelChunkIndex > 0);
+			bigtime_t now = system_time();
 
+			if (posesResult->fCount && (count <= 0 || now > nextChunkTime
+					|| posesResult->fCount >= kMaxAddPosesChunk)) {
 				// send of the created poses
 
-				posesResult->fCount = modelChunkIndex;
 				BMessage creationData(kAddNewPoses);
 				creationData.AddPointer("currentPoses", posesResult);
 				creationData.AddRef("ref", &ref);
 
 				lock.Target().SendMessage(&creationData);
 
-				modelChunkIndex = 0;
-				nextChunkTime = now + 300000;
+				nextChunkTime = now + chunkInterval;
+				chunkInterval = min(chunkInterval * 2, kMaxAddPosesChunkInterval);
 
-				posesResult = new AddPosesResult;
-				posesResult->fCount = 0;
+				posesResult = new AddPosesResult(openNodes);
 			}
 
-			if (!count)
+			if (count <= 0)
 				break;
 		}
 	} catch (failToLock) {
@@ -1351,16 +1764,25 @@ BPoseView::AddPosesTask(void *castToParams)
 
 		PRINT(("add_poses cleanup \n"));
 		// failed to lock window, bail
+		for (; batchIndex < batchCount; batchIndex++)
+			delete batch[batchIndex].model;
+
+		delete [] batch;
+		delete [] direntBuffer;
 		delete posesResult;
 		delete container;
+		openNodes->Release();
 
 		return B_ERROR;
 	}
 
-	ASSERT(!modelChunkIndex);
+	ASSERT(!posesResult->fCount);
 
+	delete [] batch;
+	delete [] direntBuffer;
 	delete posesResult;
 	delete container;
+	openNodes->Release();
 	// build attributes menu based on mime types we've added
 
  	if (lock.Lock()) { 
@@ -1541,6 +1963,93 @@ BPoseView::CreatePose(Model *model, PoseInfo *poseInfo, bool insertionSort,
 }
 
 
+BPose *
+BPoseView::NewPose(Model *model, PoseInfo *poseInfo)
+{
+	// pose adopts model and deletes it when done
+	BPose *pose = new BPose(model, this);
+
+	AddMimeType(model->MimeType());
+	// set location from poseinfo if saved loc was for this dir
+	if (poseInfo->fInitedDirectory != -1LL) {
+		PinPointToValidRange(poseInfo->fLocation);
+		pose->SetLocation(poseInfo->fLocation);
+		AddToVSList(pose);
+	}
+
+	return pose;
+}
+
+
+void
+BPoseView::CreatePosesSorted(Model **models, PoseInfo *poseInfoArray,
+	int32 count, BPose **resultingPoses, int32 *lastPoseIndexPtr,
+	BRect viewBounds, bool forceDraw)
+{
+	PoseList newPoses(count);
+	BPose *lastPose = NULL;
+	for (int32 modelIndex = 0; modelIndex < count; modelIndex++) {
+		Model *model = models[modelIndex];
+
+		if (FindPose(model) || FindZombie(model->NodeRef())
+			|| newPoses.FindPose(model)) {
+			// we already have this pose, don't add it
+			watch_node(model->NodeRef(), B_STOP_WATCHING, this);
+			delete model;
+			if (resultingPoses)
+				resultingPoses[modelIndex] = NULL;
+			continue;
+		}
+
+		ASSERT(model->IsNodeOpen());
+		BPose *pose = NewPose(model, &poseInfoArray[modelIndex]);
+		newPoses.AddItem(pose);
+		lastPose = pose;
+
+		if (resultingPoses)
+			resultingPoses[modelIndex] = pose;
+	}
+
+	int32 newCount = newPoses.CountItems();
+	if (!newCount) {
+		if (lastPoseIndexPtr)
+			*lastPoseIndexPtr = 0;
+		return;
+	}
+
+	// the nodes stay open while sorting, just like they do while the
+	// poses are being added one by one
+	BPose *lastOldPose = fPoseList->LastItem();
+	int32 firstIndex = MergePoseList(fPoseList, &newPoses);
+	fMimeTypeListIsDirty = true;
+
+	// everything from the first new pose down to the last old one moved,
+	// redraw that in one go; new poses past the old ones only get drawn
+	// if we were asked to
+	int32 lastIndex = fPoseList->CountItems() - 1;
+	if (!forceDraw)
+		lastIndex = lastOldPose ? fPoseList->IndexOf(lastOldPose) : -1;
+
+	BRect invalidRect(viewBounds);
+	invalidRect.top = max(invalidRect.top, firstIndex * fListElemHeight);
+	invalidRect.bottom = min(invalidRect.bottom,
+		(lastIndex + 1) * fListElemHeight - 1);
+	if (invalidRect.IsValid())
+		Invalidate(invalidRect);
+
+	for (int32 index = 0; index < newCount; index++) {
+		Model *model = newPoses.ItemAt(index)->TargetModel();
+		if (model->IsSymLink())
+			model->ResolveIfLink()->CloseNode();
+
+		model->CloseNode();
+	}
+
+	if (lastPoseIndexPtr)
+		*lastPoseIndexPtr = fPoseList->IndexOf(lastPose);
+}
+
+
 void
 BPoseView::FinishPendingScroll(float &listViewScrollBy, BRect bounds)
 {
@@ -1577,6 +2086,12 @@ BPoseView::CreatePoses(Model **models, PoseInfo *poseInfoArray, int32 count,
 	else
 		viewBounds = Bounds();
 
+	if (insertionSort && ViewMode() == kListMode && count > 1) {
+		CreatePosesSorted(models, poseInfoArray, count, resultingPoses,
+			lastPoseIndexPtr, viewBounds, forceDraw);
+		return;
+	}
+
 	int32 poseIndex = 0;
 	float listViewScrollBy = 0;
 	for (int32 modelIndex = 0; modelIndex < count; modelIndex++) {
@@ -1594,20 +2109,11 @@ BPoseView::CreatePoses(Model **models, PoseInfo *poseInfoArray, int32 count,
 		ASSERT(model->IsNodeOpen());
 		PoseInfo *poseInfo = &poseInfoArray[modelIndex];
 
-		// pose adopts model and deletes it when done
-		BPose *pose = new BPose(model, this);
+		BPose *pose = NewPose(model, poseInfo);
 
 		if (resultingPoses)
 			resultingPoses[modelIndex] = pose;
 
-		AddMimeType(model->MimeType());
-		// set location from poseinfo if saved loc was for this dir
-		if (poseInfo->fInitedDirectory != -1LL) {
-			PinPointToValidRange(poseInfo->fLocation);
-			pose->SetLocation(poseInfo->fLocation);
-			AddToVSList(pose);
-		}
-
 		BRect poseBounds;
 
 		switch (ViewMode()) {
@@ -1756,7 +2262,7 @@ BPoseView::MimeTypeAt(int32 index)
 	if (fMimeTypeListIsDirty)
 		RefreshMimeTypeList();
 
-	return fMimeTypeList->ItemAt(index)->String();
+	return fMimeTypeList->ItemAt(index);
 }
 
 
@@ -1776,13 +2282,15 @@ BPoseView::AddMimeType(const char *mimeType)
 	if (fMimeTypeListIsDirty)
 		RefreshMimeTypeList();
 
+	// all the types come from models and are interned, comparing the
+	// pointers is enough
 	int32 count = fMimeTypeList->CountItems();
 	for (int32 index = 0; index < count; index++) {
-		if (*fMimeTypeList->ItemAt(index) == mimeType)
+		if (fMimeTypeList->ItemAt(index) == mimeType)
 			return;
 	}
 
-	fMimeTypeList->AddItem(new BString(mimeType));
+	fMimeTypeList->AddItem(mimeType);
 }
 
 
@@ -1955,6 +2463,10 @@ BPoseView::MessageReceived(BMessage *message)
 				CreatePoses(currentPoses->fModels, currentPoses->fPoseInfos,
 					currentPoses->fCount, NULL, true, 0, 0, true);
 				currentPoses->ReleaseModels();
+#if DEBUG
+				if (fAddPosesHook)
+					(fAddPosesHook)(this, currentPoses->fCount);
+#endif
 			} 
 			delete currentPoses;
 			break;
@@ -2222,6 +2734,10 @@ BPoseView::MessageReceived(BMessage *message)
 			RunIconCacheTests();
 			break;
 
+		case kRunPoseViewBenchmarks:
+			RunPoseViewBenchmarks(this);
+			break;
+
 		case 'dbug':
 		{
 			int32 count = fSelectionList->CountItems();
@@ -2241,6 +2757,36 @@ BPoseView::MessageReceived(BMessage *message)
 #endif
 #endif
 
+		case kIconLoaded:
+		{
+			node_ref node;
+			int32 source;
+			if (message->FindInt32("device", &node.device) != B_OK
+				|| message->FindInt64("node", &node.node) != B_OK
+				|| message->FindInt32("source", &source) != B_OK)
+				break;
+
+			int32 index;
+			BPose *pose = fPoseList->DeepFindPose(&node, &index);
+			if (!pose)
+				break;
+
+			// with the icon source known, the next draw finds the icon in
+			// the cache; if it already is known, a draw beat us to it and
+			// there is nothing to update, unless it is a node icon that
+			// got the missing size added
+			Model *model = pose->ResolvedModel();
+			if ((model->IconFrom() != kUnknownSource
+					&& model->IconFrom() != kNode)
+				|| source == kUnknownSource || source == kUnknownNotFromNode)
+				break;
+
+			if (model->IconFrom() == kUnknownSource)
+				model->SetIconFrom((IconSource)source);
+			pose->InvalidateIcon(BPoint(0, index * fListElemHeight), this);
+			break;
+		}
+
 		case kCheckTypeahead:
 		{
 			bigtime_t doubleClickSpeed;
@@ -2513,7 +3059,8 @@ const int32 kSanePoseLocation = 50000;
 
 
 void
-BPoseView::ReadPoseInfo(Model *model, PoseInfo *poseInfo)
+BPoseView::ReadPoseInfo(Model *model, PoseInfo *poseInfo,
+	const ReadAttrResult *prefetched)
 {
 	BModelOpener opener(model);
 	if (!model->Node())
@@ -2537,8 +3084,15 @@ BPoseView::ReadPoseInfo(Model *model, PoseInfo *poseInfo)
 			if (!model->Node())
 				break;
 
-			result = ReadAttr(model->Node(), kAttrPoseInfo, kAttrPoseInfoForeign,
-				B_RAW_TYPE, 0, poseInfo, sizeof(*poseInfo), &PoseInfo::EndianSwap);
+			if (prefetched != NULL) {
+				// <poseInfo> already holds what the caller read, only
+				// go to the disk again if we have to retry
+				result = *prefetched;
+				prefetched = NULL;
+			} else {
+				result = ReadAttr(model->Node(), kAttrPoseInfo, kAttrPoseInfoForeign,
+					B_RAW_TYPE, 0, poseInfo, sizeof(*poseInfo), &PoseInfo::EndianSwap);
+			}
 
 			if (result != kReadAttrFailed) {
 				// got it, bail
@@ -2700,6 +3254,17 @@ BPoseView::SetViewMode(uint32 newMode)
 			else if (mapIcons)
 				MapToNewIconMode(pose, oldGrid, oldOffset);
 		}
+
+		if (mapIcons) {
+			// the mapped poses moved, file them under their new location;
+			// the mapping keeps their order by y so fVSPoseList stays sorted
+			fPoseGrid->MakeEmpty();
+			count = fVSPoseList->CountItems();
+			for (int32 index = 0; index < count; index++) {
+				BPose *pose = fVSPoseList->ItemAt(index);
+				fPoseGrid->Add(pose, pose->Location());
+			}
+		}
 	}
 
 	// save the current origin and get origin for new view mode
@@ -3042,6 +3607,7 @@ BPoseView::Cleanup(bool doAll)
 
 		// relocate all poses in list (reset vs list)
 		fVSPoseList->MakeEmpty();
+		fPoseGrid->MakeEmpty();
 		int32 count = fPoseList->CountItems();
 		for (int32 index = 0; index < count; index++) {
 			BPose *pose = fPoseList->ItemAt(index);
@@ -3236,6 +3802,26 @@ BPoseView::CheckPoseVisibility(BRect *newFrame)
 }
 
 
+struct SlotOccupiedParams {
+	const BPoseView *poseView;
+	BRect rect;
+};
+
+
+static BPose *
+PoseInSlot(BPose *pose, void *castToParams)
+{
+	SlotOccupiedParams *params = (SlotOccupiedParams *)castToParams;
+
+	// poses that start at the bottom of the slot don't count
+	if (pose->Location().y >= params->rect.bottom
+		|| !params->rect.Intersects(pose->CalcRect(params->poseView)))
+		return NULL;
+
+	return pose;
+}
+
+
 bool
 BPoseView::SlotOccupied(BRect poseRect, BRect viewBounds) const
 {
@@ -3251,21 +3837,12 @@ BPoseView::SlotOccupied(BRect poseRect, BRect viewBounds) const
 			return true;
 	}
 	
-	// search only nearby poses (vertically)
-	int32 index = FirstIndexAtOrBelow((int32)(poseRect.top - IconPoseHeight()));
-	int32 numPoses = fVSPoseList->CountItems();
-
-	while (index < numPoses && fVSPoseList->ItemAt(index)->Location().y
-		< poseRect.bottom) {
-		
-		BRect rect(fVSPoseList->ItemAt(index)->CalcRect(this));
-		if (poseRect.Intersects(rect))
-			return true;
-		
-		index++;
-	}
+	// search only nearby poses
+	SlotOccupiedParams params;
+	params.poseView = this;
+	params.rect = poseRect;
 
-	return false;
+	return fPoseGrid->EachPoseAt(PoseGridArea(poseRect), PoseInSlot, &params) != NULL;
 }
 
 
@@ -3335,12 +3912,15 @@ BPoseView::AddToVSList(BPose *pose)
 {
 	int32 index = FirstIndexAtOrBelow((int32)pose->Location().y, false);
 	fVSPoseList->AddItem(pose, index);
+	fPoseGrid->Add(pose, pose->Location());
 }
 
 
 int32
 BPoseView::RemoveFromVSList(const BPose *pose)
 {
+	fPoseGrid->Remove(pose);
+
 	int32 index = FirstIndexAtOrBelow((int32)pose->Location().y);
 
 	int32 count = fVSPoseList->CountItems();
@@ -3360,6 +3940,49 @@ BPoseView::RemoveFromVSList(const BPose *pose)
 }
 
 
+BRect
+BPoseView::PoseGridArea(BRect rect) const
+{
+	// a pose extends IconPoseHeight() down from its location; the name is
+	// truncated to the first column so a pose is never wider than that
+	// plus the icon, whether it is centered below a large icon or next to
+	// a mini icon
+	float width = B_LARGE_ICON + kMiniIconSeparator + 2;
+	if (FirstColumn())
+		width += FirstColumn()->Width();
+
+	return BRect(rect.left - width, rect.top - IconPoseHeight(),
+		rect.right + width, rect.bottom);
+}
+
+
+static BPose *
+AddPoseModel(BPose *pose, void *castToModelList)
+{
+	((BObjectList<Model> *)castToModelList)->AddItem(pose->ResolvedModel());
+	return NULL;
+}
+
+
+void
+BPoseView::PreloadVisibleIcons(IconDrawMode mode)
+{
+	BRect bounds(Bounds());
+	BObjectList<Model> models(100, false);
+
+	if (ViewMode() == kListMode) {
+		int32 count = fPoseList->CountItems();
+		for (int32 index = (int32)(bounds.top / fListElemHeight);
+			index < count && index * fListElemHeight <= bounds.bottom; index++)
+			models.AddItem(fPoseList->ItemAt(index)->ResolvedModel());
+	} else
+		fPoseGrid->EachPoseAt(PoseGridArea(bounds), AddPoseModel, &models);
+
+	IconCache::sIconCache->Preload(&models, mode,
+		ViewMode() == kIconMode ? B_LARGE_ICON : B_MINI_ICON);
+}
+
+
 BPoint
 BPoseView::PinToGrid(BPoint point, BPoint grid, BPoint offset) const
 {
@@ -4586,15 +5209,6 @@ BPoseView::MoveSelectionTo(BPoint dropPt, BPoint clickPt,
 }
 
 
-inline void
-UpdateWasBrokenSymlinkBinder(BPose *pose, Model *, BPoseView *poseView,
-	BPoint *loc)
-{
-	pose->UpdateWasBrokenSymlink(*loc, poseView);
-	loc->y += poseView->ListElemHeight();
-}
-
-
 void
 BPoseView::TryUpdatingBrokenLinks()
 {
@@ -4603,8 +5217,19 @@ BPoseView::TryUpdatingBrokenLinks()
 		return;
 
 	// try fixing broken symlinks		
-	BPoint loc;
-	EachPoseAndModel(fPoseList, &UpdateWasBrokenSymlinkBinder, this, &loc);
+	int32 count = fPoseList->CountItems();
+	for (int32 index = 0; index < count; index++) {
+		BPose *pose = fPoseList->ItemAt(index);
+		Model *model = pose->TargetModel();
+		if (!model->IsSymLink() || model->LinkTo())
+			continue;
+
+		BPoint loc(0, index * fListElemHeight);
+		pose->UpdateWasBrokenSymlink(loc, this);
+		if (model->LinkTo())
+			// link got resolved, file the target with the pose list
+			fPoseList->PoseChanged(pose);
+	}
 }
 
 
@@ -4638,15 +5263,10 @@ BPoseView::PoseHandleDeviceUnmounted(BPose *pose, Model *model, int32 index,
 
 static void
 OneMetaMimeChanged(BPose *pose, Model *model, int32 index,
-	BPoseView *poseView, const char *type)
+	BPoseView *poseView, const char *type, const char *preferredApp)
 {
 	ASSERT(model);
-	if (model->IconFrom() != kNode
-		&& model->IconFrom() != kUnknownSource
-		&& model->IconFrom() != kUnknownNotFromNode
-		// ToDo:
-		// add supertype compare
-		&& strcasecmp(model->MimeType(), type) == 0) {
+	if (IconCache::sIconCache->IsIconFrom(model, type, preferredApp)) {
 		// metamime change very likely affected the documents icon
 
 		BPoint poseLoc(0, index * poseView->ListElemHeight());
@@ -4659,11 +5279,19 @@ void
 BPoseView::MetaMimeChanged(const char *type, const char *preferredApp)
 {	
 	IconCache::sIconCache->IconChanged(type, preferredApp);
+
+	// models only hold interned types, if no spelling of <type> ever got
+	// interned none of our poses can be affected
+	type = FindMimeStringKey(type);
+	if (!type)
+		return;
+
 	// wait for other windows to do the same before we start
 	// updating poses which causes icon recaching
 	snooze(200000);
 	
-	EachPoseAndResolvedModel(fPoseList, &OneMetaMimeChanged, this, type);
+	EachPoseAndResolvedModel(fPoseList, &OneMetaMimeChanged, this, type,
+		preferredApp);
 }
 
 
@@ -5033,6 +5661,7 @@ BPoseView::EntryMoved(const BMessage *message)
 
 		if (pose) {
 			pose->TargetModel()->UpdateEntryRef(&dirNode, name);
+			fPoseList->PoseChanged(pose);
 			// for queries we check for move to trash and remove item if so
 			if (TargetModel()->IsQuery()) {
 				PoseInfo poseInfo;
@@ -5388,15 +6017,6 @@ CopyOneTrashedRefAsEntry(const entry_ref *ref, BObjectList<entry_ref> *trashList
 }
 
 
-static void
-CopyPoseOneAsEntry(BPose *pose, BObjectList<entry_ref> *trashList,
-	BObjectList<entry_ref> *noTrashList, std::map<int32, bool> *deviceHasTrash)
-{
-	CopyOneTrashedRefAsEntry(pose->TargetModel()->EntryRef(), trashList,
-		noTrashList, deviceHasTrash);
-}
-
-
 void
 BPoseView::MoveSelectionOrEntryToTrash(const entry_ref *ref, bool selectNext)
 {
@@ -5410,8 +6030,12 @@ BPoseView::MoveSelectionOrEntryToTrash(const entry_ref *ref, bool selectNext)
 		CopyOneTrashedRefAsEntry(ref, entriesToTrash, entriesToDeleteOnTheSpot,
 			&deviceHasTrash);	
 	} else {
-		EachListItem(fSelectionList, CopyPoseOneAsEntry, entriesToTrash,
-			entriesToDeleteOnTheSpot, &deviceHasTrash);
+		int32 count = fSelectionList->CountItems();
+		for (int32 index = 0; index < count; index++) {
+			CopyOneTrashedRefAsEntry(
+				fSelectionList->ItemAt(index)->TargetModel()->EntryRef(),
+				entriesToTrash, entriesToDeleteOnTheSpot, &deviceHasTrash);
+		}
 	}
 
 	if (entriesToDeleteOnTheSpot->CountItems()) {
@@ -5584,6 +6208,8 @@ BPoseView::SelectAll()
 {
 	BRect bounds(Bounds());
 
+	PreloadVisibleIcons(kSelectedIcon);
+
 	// clear selection list
 	fSelectionList->MakeEmpty();
 	fMimeTypesInSelectionCache.MakeEmpty();
@@ -5633,6 +6259,8 @@ BPoseView::InvertSelection()
 	// then call InvertSelection()
 
 	BRect bounds(Bounds());
+
+	PreloadVisibleIcons(kSelectedIcon);
 	
 	int32 startIndex = 0;
 	BPoint loc(0, 0);
@@ -5964,59 +6592,37 @@ BPoseView::KeyDown(const char *bytes, int32 count)
 BPose *
 BPoseView::FindNextMatch(int32 *matchingIndex, bool reverse)
 {
-	char bestSoFar[B_FILE_NAME_LENGTH] = { 0 };
-	BPose *poseToSelect = NULL;
-
-	// loop through all poses to find match
-	int32 count = fPoseList->CountItems();
-	for (int32 index = 0; index < count; index++) {
-		BPose *pose = fPoseList->ItemAt(index);
-
-		if (reverse) {
-			if (strcasecmp(pose->TargetModel()->Name(), fMatchString) < 0)
-				if (strcasecmp(pose->TargetModel()->Name(), bestSoFar) >= 0
-					|| !bestSoFar[0]) {
-					strcpy(bestSoFar, pose->TargetModel()->Name());
-					poseToSelect = pose;
-					*matchingIndex = index;
-				}
-		} else if (strcasecmp(pose->TargetModel()->Name(), fMatchString) > 0)
-			if (strcasecmp(pose->TargetModel()->Name(), bestSoFar) <= 0
-				|| !bestSoFar[0]) {
-				strcpy(bestSoFar, pose->TargetModel()->Name());
-				poseToSelect = pose;
-				*matchingIndex = index;
-			}
-
-	}
-
-	return poseToSelect;
+	return fPoseList->FindName(fMatchString, reverse ? kNameBefore : kNameAfter,
+		matchingIndex);
 }
 
 
 BPose *
 BPoseView::FindBestMatch(int32 *index)
 {
+	BColumn *firstColumn = FirstColumn();
+
+	// the pose list can look up names quickly, that's what is shown in
+	// list mode and usually in the first column as well
+	if (ViewMode() == kListMode || !firstColumn
+		|| firstColumn->AttrHash() == AttrHashString(kAttrStatName,
+			B_STRING_TYPE))
+		return fPoseList->FindName(fMatchString, kNameAtOrAfter, index);
+
 	char bestSoFar[B_FILE_NAME_LENGTH] = { 0 };
 	BPose *poseToSelect = NULL;
 
-	BColumn *firstColumn = FirstColumn();
-
 	// loop through all poses to find match
 	int32 count = fPoseList->CountItems();
 	for (int32 i = 0; i < count; i++) {
 		BPose *pose = fPoseList->ItemAt(i);
 		const char * text;
-		if (ViewMode() == kListMode)
+		ModelNodeLazyOpener modelOpener(pose->TargetModel());
+		BTextWidget *widget = pose->WidgetFor(firstColumn, this, modelOpener);
+		if (widget)				 
+			text = widget->Text();
+		else
 			text = pose->TargetModel()->Name();
-		else {
-			ModelNodeLazyOpener modelOpener(pose->TargetModel());
-			BTextWidget *widget = pose->WidgetFor(firstColumn, this, modelOpener);
-			if (widget)				 
-				text = widget->Text();
-			else
-				text = pose->TargetModel()->Name();
-		}
 
 		if (strcasecmp(text, fMatchString) >= 0)
 			if (strcasecmp(text, bestSoFar) <= 0 || !bestSoFar[0]) {
@@ -6699,14 +7305,6 @@ BPoseView::GetDragRect(int32 clickedPoseIndex)
 }
 
 
-static void
-AddIfPoseSelected(BPose *pose, PoseList *list)
-{
-	if (pose->IsSelected())
-		list->AddItem(pose);
-}
-
-
 void
 BPoseView::DragSelectionRect(BPoint startPoint, bool shouldExtend)
 {
@@ -6741,6 +7339,8 @@ BPoseView::DragSelectionRect(BPoint startPoint, bool shouldExtend)
 	}
 
 	BList *selectionList = new BList;
+	int32 firstSelectedRow = 0;
+	int32 lastSelectedRow = -1;
 
 	BPoint oldMousePoint(startPoint);
 	while (button) {
@@ -6766,7 +7366,8 @@ BPoseView::DragSelectionRect(BPoint startPoint, bool shouldExtend)
 
 			// use current selection rectangle to scan poses
 			if (ViewMode() == kListMode)
-				SelectPosesListMode(fSelectionRect, &selectionList);
+				SelectPosesListMode(fSelectionRect, &firstSelectedRow,
+					&lastSelectedRow);
 			else
 				SelectPosesIconMode(fSelectionRect, &selectionList);
 
@@ -6825,7 +7426,12 @@ BPoseView::DragSelectionRect(BPoint startPoint, bool shouldExtend)
 	fSelectionList->MakeEmpty();
 	fMimeTypesInSelectionCache.MakeEmpty();
 
-	EachListItem(fPoseList, AddIfPoseSelected, fSelectionList);
+	int32 count = fPoseList->CountItems();
+	for (int32 index = 0; index < count; index++) {
+		BPose *pose = fPoseList->ItemAt(index);
+		if (pose->IsSelected())
+			fSelectionList->AddItem(pose);
+	}
 
 	// and now make sure that the pivot point is in sync
 	if (fSelectionPivotPose && !fSelectionList->HasItem(fSelectionPivotPose))
@@ -6834,68 +7440,71 @@ BPoseView::DragSelectionRect(BPoint startPoint, bool shouldExtend)
 		fRealPivotPose = NULL;
 }
 
-// ToDo:
-// SelectPosesListMode and SelectPosesIconMode are terrible and share most code
 
 void
-BPoseView::SelectPosesListMode(BRect selectionRect, BList **oldList)
+BPoseView::SelectPosesListMode(BRect selectionRect, int32 *firstRow,
+	int32 *lastRow)
 {
 	ASSERT(ViewMode() == kListMode);
 
-	// collect all the poses which are enclosed inside the selection rect
-	BList *newList = new BList;
-	BRect bounds(Bounds());
-	SetDrawingMode(B_OP_COPY);
+	// all rows are the same height and span the same columns, so the poses
+	// enclosed by the selection rect always are a range of rows; only the
+	// rows entering or leaving that range since the last call have to be
+	// looked at, not every enclosed one
+	int32 first = 0;
+	int32 last = -1;
 
-	int32 startIndex = (int32)(selectionRect.top / fListElemHeight);
-	if (startIndex < 0)
-		startIndex = 0;
+	int32 count = fPoseList->CountItems();
+	if (count && selectionRect.bottom >= 0) {
+		BRect rowRect(fPoseList->ItemAt(0)->CalcRect(BPoint(0, 0), this));
+		if (selectionRect.left <= rowRect.right
+			&& selectionRect.right >= rowRect.left) {
+			first = (int32)(selectionRect.top / fListElemHeight);
+			if (first < 0)
+				first = 0;
 
-	BPoint loc(0, startIndex * fListElemHeight);
+			last = (int32)(selectionRect.bottom / fListElemHeight);
+			if (last >= count)
+				last = count - 1;
+		}
+	}
 
-	int32 count = fPoseList->CountItems();
-	for (int32 index = startIndex; index < count; index++) {
-		BPose *pose = fPoseList->ItemAt(index);
-		BRect poseRect(pose->CalcRect(loc, this));
+	SetDrawingMode(B_OP_COPY);
 
-		if (selectionRect.Intersects(poseRect)) {
-			bool selected = pose->IsSelected();
-			pose->Select(!fSelectionList->HasItem(pose));
-			newList->AddItem((void *)index); // this sucks, need to clean up
-										// using a vector class instead of BList
+	// rows leaving the rect go back to the state they had before the drag,
+	// rows entering it get inverted; outside the rect the state of a pose
+	// always matches the selection list, so both just flip the pose
+	InvertSelectedRows(*firstRow, std::min(*lastRow, first - 1), false);
+	InvertSelectedRows(std::max(*firstRow, last + 1), *lastRow, false);
+	InvertSelectedRows(first, std::min(last, *firstRow - 1), true);
+	InvertSelectedRows(std::max(first, *lastRow + 1), last, true);
 
-			if ((selected != pose->IsSelected()) && poseRect.Intersects(bounds))
-				pose->Draw(poseRect, this, false);
-				
-			// First Pose selected gets to be the pivot.
-			if ((fSelectionPivotPose == NULL) && (selected == false))
-				fSelectionPivotPose = pose;
-		}
+	*firstRow = first;
+	*lastRow = last;
+}
 
-		loc.y += fListElemHeight;
-		if (loc.y > selectionRect.bottom)
-			break;
-	}
 
-	// take the old set of enclosed poses and invert selection state
-	// on those which are no longer enclosed
-	count = (*oldList)->CountItems();
-	for (int32 index = 0; index < count; index++) {
-		int32 oldIndex = (int32)(*oldList)->ItemAt(index);
+void
+BPoseView::InvertSelectedRows(int32 first, int32 last, bool entering)
+{
+	BRect bounds(Bounds());
+	BPoint loc(0, first * fListElemHeight);
 
-		if (!newList->HasItem((void *)oldIndex)) {
-			BPose *pose = fPoseList->ItemAt(oldIndex);
-			pose->Select(!pose->IsSelected());
-			loc.Set(0, oldIndex * fListElemHeight);
-			BRect poseRect(pose->CalcRect(loc, this));
+	for (int32 index = first; index <= last; index++) {
+		BPose *pose = fPoseList->ItemAt(index);
+		bool selected = pose->IsSelected();
+		pose->Select(!selected);
 
-			if (poseRect.Intersects(bounds))
-				pose->Draw(poseRect, this, false);
-		}
-	}
+		BRect poseRect(pose->CalcRect(loc, this));
+		if (poseRect.Intersects(bounds))
+			pose->Draw(poseRect, this, false);
 
-	delete *oldList;
-	*oldList = newList;
+		// First Pose selected gets to be the pivot.
+		if (entering && fSelectionPivotPose == NULL && !selected)
+			fSelectionPivotPose = pose;
+
+		loc.y += fListElemHeight;
+	}
 }
 
 
@@ -6913,6 +7522,11 @@ BPoseView::SelectPosesIconMode(BRect selectionRect, BList **oldList)
 	if (startIndex < 0)
 		startIndex = 0;
 
+	// both the old and the new list are in fVSPoseList order, so finding
+	// out which poses were enclosed before is a simple merge
+	int32 oldCount = (*oldList)->CountItems();
+	int32 oldPosition = 0;
+
 	int32 count = fPoseList->CountItems();
 	for (int32 index = startIndex; index < count; index++) {
 		BPose *pose = fVSPoseList->ItemAt(index);
@@ -6921,14 +7535,26 @@ BPoseView::SelectPosesIconMode(BRect selectionRect, BList **oldList)
 
 			if (selectionRect.Intersects(poseRect)) {
 				bool selected = pose->IsSelected();
-				pose->Select(!fSelectionList->HasItem(pose));
 				newList->AddItem((void *)index);
 
-				if ((selected != pose->IsSelected()) && poseRect.Intersects(bounds))
-					if (pose->IsSelected() || EraseWidgetTextBackground())
-						pose->Draw(poseRect, this, false);
-					else
-						Invalidate(poseRect);
+				while (oldPosition < oldCount
+					&& (int32)(*oldList)->ItemAt(oldPosition) < index)
+					oldPosition++;
+
+				// poses that were enclosed already had their selection
+				// inverted, the others still are just as they were when
+				// the drag started
+				if (oldPosition == oldCount
+					|| (int32)(*oldList)->ItemAt(oldPosition) != index) {
+					pose->Select(!selected);
+
+					if (poseRect.Intersects(bounds)) {
+						if (pose->IsSelected() || EraseWidgetTextBackground())
+							pose->Draw(poseRect, this, false);
+						else
+							Invalidate(poseRect);
+					}
+				}
 
 				// First Pose selected gets to be the pivot.
 				if ((fSelectionPivotPose == NULL) && (selected == false))
@@ -6942,11 +7568,17 @@ BPoseView::SelectPosesIconMode(BRect selectionRect, BList **oldList)
 
 	// take the old set of enclosed poses and invert selection state
 	// on those which are no longer enclosed
-	count = (*oldList)->CountItems();
-	for (int32 index = 0; index < count; index++) {
+	int32 newCount = newList->CountItems();
+	int32 newPosition = 0;
+	for (int32 index = 0; index < oldCount; index++) {
 		int32 oldIndex = (int32)(*oldList)->ItemAt(index);
 
-		if (!newList->HasItem((void *)oldIndex)) {
+		while (newPosition < newCount
+			&& (int32)newList->ItemAt(newPosition) < oldIndex)
+			newPosition++;
+
+		if (newPosition == newCount
+			|| (int32)newList->ItemAt(newPosition) != oldIndex) {
 			BPose *pose = fVSPoseList->ItemAt(oldIndex);
 			pose->Select(!pose->IsSelected());
 			BRect poseRect(pose->CalcRect(this));
@@ -7111,6 +7743,7 @@ BPoseView::DeleteSymLinkPoseTarget(const node_ref *itemNode, BPose *pose,
 	watch_node(itemNode, B_STOP_WATCHING, this);
 	BPoint loc(0, index * fListElemHeight);
 	pose->TargetModel()->SetLinkTo(0);
+	fPoseList->PoseChanged(pose);
 	pose->UpdateBrokenSymLink(loc, this);
 }
 
@@ -7213,7 +7846,37 @@ BPoseView::FindZombie(const node_ref *itemNode, int32 *resultingIndex)
 	return NULL;
 }
 
-// return pose at location h,v (search list starting from bottom so
+struct FindPoseParams {
+	const BPoseView *poseView;
+	const PoseList *poseList;
+	BPoint point;
+	BPose *pose;
+	int32 index;
+};
+
+
+static BPose *
+PoseAtPoint(BPose *pose, void *castToParams)
+{
+	FindPoseParams *params = (FindPoseParams *)castToParams;
+	if (!pose->PointInPose(params->poseView, params->point))
+		return NULL;
+
+	int32 index;
+	if (params->poseList->FindPose(pose->TargetModel(), &index) != pose)
+		index = params->poseList->IndexOf(pose);
+
+	if (index > params->index) {
+		params->pose = pose;
+		params->index = index;
+	}
+
+	// keep going, poses may overlap
+	return NULL;
+}
+
+
+// return pose at location h,v (the last pose in the list wins so
 // drawing and hit detection reflect the same pose ordering)
 
 BPose *
@@ -7229,15 +7892,20 @@ BPoseView::FindPose(BPoint point, int32 *poseIndex) const
 		if (pose && pose->PointInPose(loc, this, point))
 			return pose;
 	} else {
-		int32 count = fPoseList->CountItems();
-		for (int32 index = count - 1; index >= 0; index--) {
-			BPose *pose = fPoseList->ItemAt(index);
-			if (pose->PointInPose(this, point)) {
-				if (poseIndex)
-					*poseIndex = index;
-				return pose;
-			}
-		}
+		// of the poses near the point, the one that comes last in
+		// fPoseList is drawn on top
+		FindPoseParams params;
+		params.poseView = this;
+		params.poseList = fPoseList;
+		params.point = point;
+		params.pose = NULL;
+		params.index = -1;
+		fPoseGrid->EachPoseAt(PoseGridArea(BRect(point, point)), PoseAtPoint,
+			&params);
+
+		if (params.pose && poseIndex)
+			*poseIndex = params.index;
+		return params.pose;
 	}
 
 	return NULL;
@@ -7395,11 +8063,16 @@ BPoseView::ClearPoses()
 	fPoseList->MakeEmpty();
 	fMimeTypeListIsDirty = true;
 	fVSPoseList->MakeEmpty();
+	fPoseGrid->MakeEmpty();
 	fZombieList->MakeEmpty();
 	fSelectionList->MakeEmpty();
 	fSelectionPivotPose = NULL;
 	fRealPivotPose = NULL;
 	fMimeTypesInSelectionCache.MakeEmpty();
+
+	// the poses, their models and widgets are gone, slabs that are
+	// empty now go back to the heap in one go
+	SlabAllocator::ReleaseAllUnusedSlabs();
 	
 	DisableScrollBars();
 	ScrollTo(BPoint(0, 0));
@@ -8372,6 +9045,71 @@ BPoseView::BSearchList(const BPose *pose, int32 *resultingIndex)
 }
 
 
+static int32
+InsertionIndex(PoseList *list, const BPose *pose, int32 from, BPoseView *view)
+{
+	// returns the index of the first pose at or after <from> that does not
+	// sort before <pose>, the same spot BSearchList picks
+	int32 to = list->CountItems();
+	while (from < to) {
+		int32 index = (from + to) / 2;
+		if (PoseCompareAddWidget(pose, list->ItemAt(index), view) > 0)
+			from = index + 1;
+		else
+			to = index;
+	}
+
+	return from;
+}
+
+
+struct PoseAddWidgetOrder {
+	PoseAddWidgetOrder(BPoseView *view)
+		:	fView(view)
+		{}
+
+	bool operator()(const BPose *pose1, const BPose *pose2) const
+		{ return PoseCompareAddWidget(pose1, pose2, fView) < 0; }
+
+	BPoseView *fView;
+};
+
+
+int32
+BPoseView::MergePoseList(PoseList *list, PoseList *poses)
+{
+	int32 count = poses->CountItems();
+	if (!count)
+		return list->CountItems();
+
+	// the new poses are sorted with the same comparison InsertionIndex
+	// uses; the sort keys of SortPoseList might order ties differently
+	// and leave the merged list out of order
+	BPose **newPoses = new BPose * [count];
+	for (int32 index = 0; index < count; index++)
+		newPoses[index] = poses->ItemAt(index);
+
+	std::stable_sort(newPoses, newPoses + count, PoseAddWidgetOrder(this));
+
+	// with the new poses in order, each search for an insertion spot can
+	// start off where the previous one ended
+	int32 *indices = new int32 [count];
+	int32 from = 0;
+	for (int32 index = 0; index < count; index++) {
+		from = InsertionIndex(list, newPoses[index], from, this);
+		indices[index] = from;
+	}
+
+	list->InsertItems(newPoses, indices, count);
+	int32 result = indices[0];
+
+	delete [] newPoses;
+	delete [] indices;
+
+	return result;
+}
+
+
 void
 BPoseView::SetPrimarySort(uint32 attrHash)
 {
@@ -8406,10 +9144,118 @@ BPoseView::SetReverseSort(bool reverse)
 }
 
 
-inline int
-PoseCompareAddWidgetBinder(const BPose *p1, const BPose *p2, void *castToPoseView)
+struct PoseSortKey {
+	// one attribute of a pose, as returned by BTextWidget::SortKey;
+	// the widget is used for comparing kNoSortKey attributes
+	int64 scalar;
+	const char *string;
+	BTextWidget *widget;
+};
+
+
+struct PoseSortEntry {
+	PoseSortKey primary;
+	PoseSortKey secondary;
+	BPose *pose;
+};
+
+
+class PoseSortKeyCompare {
+	// orders PoseSortEntries the same way PoseCompareAddWidget orders
+	// the poses; string keys are collation keys that compare with strcmp
+	public:
+		PoseSortKeyCompare(uint32 primaryKind, bool hasSecondary,
+				uint32 secondaryKind, bool reverse, BPoseView *view)
+			:	fPrimaryKind(primaryKind),
+				fHasSecondary(hasSecondary),
+				fSecondaryKind(secondaryKind),
+				fReverse(reverse),
+				fView(view)
+			{}
+
+		bool operator()(const PoseSortEntry &entry1,
+			const PoseSortEntry &entry2) const
+		{
+			if (fReverse)
+				return Compare(entry2, entry1) < 0;
+			return Compare(entry1, entry2) < 0;
+		}
+
+	private:
+		int Compare(const PoseSortEntry &entry1,
+			const PoseSortEntry &entry2) const
+		{
+			int result = CompareKeys(fPrimaryKind, entry1.primary,
+				entry2.primary);
+			if (result == 0 && fHasSecondary)
+				result = CompareKeys(fSecondaryKind, entry1.secondary,
+					entry2.secondary);
+			return result;
+		}
+
+		int CompareKeys(uint32 kind, const PoseSortKey &key1,
+			const PoseSortKey &key2) const
+		{
+			switch (kind) {
+				case kScalarSortKey:
+					if (key1.scalar == key2.scalar)
+						return 0;
+					return key1.scalar > key2.scalar ? -1 : 1;
+
+				case kRankedStringSortKey:
+					if (key1.scalar != key2.scalar)
+						return key1.scalar < key2.scalar ? -1 : 1;
+					// fall thru
+
+				case kStringSortKey:
+					return strcmp(key1.string, key2.string);
+			}
+
+			if (!key1.widget || !key2.widget)
+				return 0;
+
+			return key1.widget->Compare(*key2.widget, fView);
+		}
+
+		uint32 fPrimaryKind;
+		bool fHasSecondary;
+		uint32 fSecondaryKind;
+		bool fReverse;
+		BPoseView *fView;
+};
+
+
+static uint32
+ExtractSortKeys(PoseSortEntry *entries, int32 count, BColumn *column,
+	PoseSortKey PoseSortEntry::*member, BPoseView *view)
 {
-	return PoseCompareAddWidget(p1, p2, (BPoseView *)castToPoseView);
+	// fills in the keys for one column, adding the widgets as needed;
+	// returns the kind of keys the column has
+
+	uint32 kind = kNoSortKey;
+	for (int32 index = 0; index < count; index++) {
+		BPose *pose = entries[index].pose;
+		PoseSortKey &key = entries[index].*member;
+
+		key.scalar = 0;
+		key.string = NULL;
+		key.widget = pose->WidgetFor(column->AttrHash());
+		if (!key.widget)
+			key.widget = pose->AddWidget(view, column);
+
+		uint32 poseKind = kNoSortKey;
+		if (key.widget)
+			poseKind = key.widget->SortKey(&key.scalar, &key.string);
+
+		// all poses should have the same kind of widget text in a column,
+		// fall back to Compare if they don't for some reason
+		if (index == 0)
+			kind = poseKind;
+		else if (poseKind != kind)
+			kind = kNoSortKey;
+	}
+
+	return kind;
 }
 
 
@@ -8433,7 +9279,62 @@ BPoseView::SortPoses()
 	PRINT(("===================\n"));
 #endif
 	
-	fPoseList->SortItems(PoseCompareAddWidgetBinder, this);
+	SortPoseList(fPoseList);
+}
+
+
+void
+BPoseView::SortPoseList(PoseList *list)
+{
+	// Extract the sort attributes of every pose once, then sort those;
+	// comparing the poses directly would have to find the columns and
+	// widgets on every single comparison
+
+	int32 count = list->CountItems();
+	if (count < 2)
+		return;
+
+	BColumn *primaryColumn = ColumnFor(PrimarySort());
+	if (!primaryColumn)
+		return;
+
+	BColumn *secondaryColumn = NULL;
+	if (SecondarySort())
+		secondaryColumn = ColumnFor(SecondarySort());
+
+	PoseSortEntry *entries = new (std::nothrow) PoseSortEntry [count];
+	if (!entries)
+		return;
+
+	for (int32 index = 0; index < count; index++)
+		entries[index].pose = list->ItemAt(index);
+
+	uint32 primaryKind = ExtractSortKeys(entries, count, primaryColumn,
+		&PoseSortEntry::primary, this);
+
+	uint32 secondaryKind = kNoSortKey;
+	if (secondaryColumn)
+		secondaryKind = ExtractSortKeys(entries, count, secondaryColumn,
+			&PoseSortEntry::secondary, this);
+	else {
+		for (int32 index = 0; index < count; index++)
+			entries[index].secondary.widget = NULL;
+	}
+
+	std::sort(entries, entries + count,
+		PoseSortKeyCompare(primaryKind, secondaryColumn != NULL, secondaryKind,
+			ReverseSort(), this));
+
+	BPose **poses = new (std::nothrow) BPose * [count];
+	if (poses) {
+		for (int32 index = 0; index < count; index++)
+			poses[index] = entries[index].pose;
+
+		list->SetOrder(poses);
+		delete [] poses;
+	}
+
+	delete [] entries;
 }
 
 
@@ -9273,5 +10174,8 @@ bigtime_t BPoseView::fLastKeyTime = 0;
 _BWidthBuffer_* BPoseView::fWidthBuf = new _BWidthBuffer_;
 BFont BPoseView::fCurrentFont;
 OffscreenBitmap *BPoseView::fOffscreen = new OffscreenBitmap;
+#if DEBUG
+void (*BPoseView::fAddPosesHook)(BPoseView *, int32) = NULL;
+#endif
 char BPoseView::fMatchString[] = "";
 
@@ -44,6 +44,7 @@ All rights reserved.
 
 #include "AttributeStream.h"
 #include "ContainerWindow.h"
+#include "FSUtils.h"
 #include "Model.h"
 #include "PendingNodeMonitorCache.h"
 #include "PoseList.h"
@@ -71,6 +72,7 @@ class BCountView;
 class BContainerWindow;
 class BHScrollBar;
 class EntryListBase;
+class PoseGrid;
 
 
 const int32 kSmallStep = 10;
@@ -90,6 +92,7 @@ class BPoseView : public BView {
 		// setup, teardown
 		virtual void Init(AttributeStreamNode *);
 		virtual void Init(const BMessage &);
+		virtual void Init(const WindowStateArchive &);
 		void InitCommon();
 		virtual	void DetachedFromWindow();
 
@@ -119,6 +122,11 @@ class BPoseView : public BView {
 		virtual void RestoreColumnState(const BMessage &);
 		virtual void SaveColumnState(BMessage &) const;
 
+		virtual	void SaveState(WindowStateArchive &) const;
+		virtual void RestoreState(const WindowStateArchive &);
+		virtual void RestoreColumnState(const WindowStateArchive &);
+		virtual void SaveColumnState(WindowStateArchive &) const;
+
 		bool StateNeedsSaving();
 
 		// switch between mini icon mode, icon mode and list mode
@@ -175,6 +183,13 @@ class BPoseView : public BView {
 
 		// sorting
 		virtual void SortPoses();
+		void SortPoseList(PoseList *);
+			// sorts any list of poses of this view by the current sort
+			// columns
+		int32 MergePoseList(PoseList *list, PoseList *poses);
+			// merges <poses> into the already sorted <list> where
+			// BSearchList would put them, returns the index of the first
+			// pose that got moved
 		void SetPrimarySort(uint32 attrHash);
 		void SetSecondarySort(uint32 attrHash);
 		void SetReverseSort(bool reverse);
@@ -405,7 +420,10 @@ class BPoseView : public BView {
 			// remove all the current poses from the view
 
 		// pose info read/write calls
-		void ReadPoseInfo(Model *, PoseInfo *);
+		void ReadPoseInfo(Model *, PoseInfo *,
+			const ReadAttrResult *prefetched = NULL);
+			// <prefetched> is the result of reading the pose info into
+			// <poseInfo> beforehand
 		ExtendedPoseInfo *ReadExtendedPoseInfo(Model *);
 
 		// pose creation
@@ -477,6 +495,12 @@ class BPoseView : public BView {
 		int32 FirstIndexAtOrBelow(int32 y, bool constrainIndex = true) const;
 		void AddToVSList(BPose *);
 		int32 RemoveFromVSList(const BPose *);
+		BRect PoseGridArea(BRect rect) const;
+			// the area that holds the locations of all the icon mode poses
+			// that could overlap <rect>
+		void PreloadVisibleIcons(IconDrawMode);
+			// builds the <mode> icons of all the visible poses in one batch
+			// before they get drawn one by one
 		BPose *FindNearbyPose(char arrow, int32 *index);
 		BPose *FindBestMatch(int32 *index);
 		BPose *FindNextMatch(int32 *index, bool reverse = false);
@@ -531,8 +555,16 @@ class BPoseView : public BView {
 		int32 WaitForMouseUpOrDrag(BPoint start);
 
 		// selection
-		void SelectPosesListMode(BRect, BList **);
+		void SelectPosesListMode(BRect, int32 *firstRow, int32 *lastRow);
+			// <firstRow> and <lastRow> track the rows that are inside the
+			// selection rect, start out with an empty range (0, -1)
+		void InvertSelectedRows(int32 first, int32 last, bool entering);
 		void SelectPosesIconMode(BRect, BList **);
+#if DEBUG
+		friend class PoseViewBenchmarkAccess;
+			// lets the benchmarks in Tests.cpp run the selection code
+			// on their own poses
+#endif
 		void AddRemoveSelectionRange(BPoint where, bool extendSelection, BPose *);
 
 		// view drawing
@@ -552,6 +584,7 @@ class BPoseView : public BView {
 		virtual void AddCountView();
 
 		void AddMimeType(const char *);
+			// takes an interned type, as returned by Model::MimeType()
 		void HandleAttrMenuItemSelected(BMessage *);
 		void TryUpdatingBrokenLinks();
 			// ran a little after a volume gets mounted
@@ -564,6 +597,12 @@ class BPoseView : public BView {
 
 		void FinishPendingScroll(float &listViewScrollBy, BRect bounds);
 			// utility call for CreatePoses
+		BPose *NewPose(Model *, PoseInfo *);
+		void CreatePosesSorted(Model **models, PoseInfo *poseInfoArray,
+			int32 count, BPose **resultingPoses, int32 *lastPoseIndexPtr,
+			BRect viewBounds, bool forceDraw);
+			// list mode CreatePoses, sorts the new poses and merges them
+			// into the pose list in one pass
 
 		// background AddPoses task calls
 		static status_t AddPosesTask(void *);
@@ -595,13 +634,17 @@ class BPoseView : public BView {
 		// the following should probably be just member lists, not pointers
 		PoseList *fPoseList;
 		PoseList *fVSPoseList;
+		PoseGrid *fPoseGrid;
+			// the poses of fVSPoseList filed by location, for icon mode
+			// placement and hit testing
 		PoseList *fSelectionList;
 		BObjectList<BString> fMimeTypesInSelectionCache;
 			// used for mime string based icon highliting during a drag
 		BObjectList<Model> *fZombieList;
 		PendingNodeMonitorCache pendingNodeMonitorCache;
 		BObjectList<BColumn> *fColumnList;
-		BObjectList<BString> *fMimeTypeList;
+		BObjectList<const char> *fMimeTypeList;
+			// interned types, see InternMimeString()
 	  	bool fMimeTypeListIsDirty;
 		BViewState *fViewState;
 		bool fStateNeedsSaving;
@@ -662,6 +705,12 @@ class BPoseView : public BView {
 
 		static OffscreenBitmap *fOffscreen;
 
+#if DEBUG
+		static void (*fAddPosesHook)(BPoseView *, int32 poseCount);
+			// called with every chunk of new poses that gets added, the
+			// benchmarks time opening a folder with it
+#endif
+
 		typedef BView _inherited;
 };
 
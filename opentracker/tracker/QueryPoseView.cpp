@@ -145,6 +145,14 @@ BQueryPoseView::RestoreState(const BMessage &message)
 }
 
 
+void 
+BQueryPoseView::RestoreState(const WindowStateArchive &archive)
+{
+	_inherited::RestoreState(archive);
+	fViewState->SetViewMode(kListMode);
+}
+
+
 void 
 BQueryPoseView::SavePoseLocations(BRect *)
 {
@@ -66,6 +66,7 @@ protected:
 	virtual void AttachedToWindow();
 	virtual void RestoreState(AttributeStreamNode *);
 	virtual void RestoreState(const BMessage &);
+	virtual void RestoreState(const WindowStateArchive &);
 	virtual void SavePoseLocations(BRect * = NULL);
 	virtual void SetUpDefaultColumnsIfNeeded();
 	virtual void SetViewMode(uint32);
@@ -0,0 +1,433 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+#include <malloc.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Debug.h>
+#include <OS.h>
+#include <TLS.h>
+
+#include "AutoLock.h"
+#include "SlabAllocator.h"
+
+
+const size_t kSlabSize = 16 * 1024;
+const int32 kMinBlocksPerSlab = 16;
+const size_t kBlockAlignment = sizeof(double);
+	// same as malloc
+const int32 kThreadCacheBatch = 16;
+	// blocks a thread trades with the slabs at a time, it keeps up to
+	// twice as many
+
+
+static inline size_t
+AlignBlockSize(size_t size)
+{
+	return (size + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment;
+}
+
+
+struct SlabAllocator::Block {
+	// every block starts with the slab it belongs to, NULL if it came
+	// from malloc, the object follows; while a block is free the object
+	// space links up the slab's free list
+	union {
+		Slab *slab;
+		double alignment;
+	};
+
+	void *Data()
+		{ return this + 1; }
+	Block *&NextFree()
+		{ return *(Block **)Data(); }
+	static Block *FromData(void *data)
+		{ return (Block *)data - 1; }
+};
+
+
+struct SlabAllocator::Slab {
+	Slab *next;
+	Slab *previous;
+	Block *freeBlocks;
+	int32 usedBlocks;
+	bool partial;
+		// true while linked into fPartialSlabs
+
+	Block *FirstBlock()
+		{ return (Block *)((char *)this + AlignBlockSize(sizeof(Slab))); }
+};
+
+
+struct SlabAllocator::ThreadCache {
+	Block *blocks;
+		// linked up like the free list of a slab
+	int32 count;
+	int32 allocations;
+	int32 frees;
+		// not yet added to the allocator's numbers
+	thread_id thread;
+	ThreadCache *next;
+};
+
+
+SlabAllocator *SlabAllocator::sFirstAllocator = NULL;
+slab_allocator_hook SlabAllocator::sInstrumentationHook = NULL;
+
+
+SlabAllocator::SlabAllocator(const char *name, size_t blockSize)
+	:	fName(name),
+		fBlockSize(blockSize),
+		fPartialSlabs(NULL),
+		fLock(name),
+		fThreadCacheIndex(tls_allocate()),
+		fThreadCaches(NULL),
+		fNextAllocator(sFirstAllocator)
+{
+	fBlockStride = sizeof(Block) + AlignBlockSize(blockSize);
+	fBlocksPerSlab = (int32)(kSlabSize / fBlockStride);
+	if (fBlocksPerSlab < kMinBlocksPerSlab)
+		fBlocksPerSlab = kMinBlocksPerSlab;
+
+	fSlabSize = AlignBlockSize(sizeof(Slab)) + fBlocksPerSlab * fBlockStride;
+
+	memset(&fInfo, 0, sizeof(fInfo));
+	fInfo.name = name;
+	fInfo.block_size = blockSize;
+
+	// allocators are static objects, this runs before there are any
+	// other threads
+	sFirstAllocator = this;
+}
+
+
+void *
+SlabAllocator::Allocate(size_t size)
+{
+	if (size != fBlockSize) {
+		Block *block = (Block *)malloc(sizeof(Block) + size);
+		if (!block)
+			throw std::bad_alloc();
+
+		block->slab = NULL;
+
+		AutoLock<Benaphore> lock(fLock);
+		fInfo.allocations++;
+		if (++fInfo.used_blocks > fInfo.peak_used_blocks)
+			fInfo.peak_used_blocks = fInfo.used_blocks;
+
+		return block->Data();
+	}
+
+	ThreadCache *cache = CurrentThreadCache();
+	if (!cache) {
+		AutoLock<Benaphore> lock(fLock);
+		fInfo.allocations++;
+		return AllocateBlock()->Data();
+	}
+
+	if (!cache->blocks)
+		Refill(cache);
+
+	Block *block = cache->blocks;
+	cache->blocks = block->NextFree();
+	cache->count--;
+	cache->allocations++;
+
+	return block->Data();
+}
+
+
+void
+SlabAllocator::Free(void *data)
+{
+	if (!data)
+		return;
+
+	Block *block = Block::FromData(data);
+	ThreadCache *cache = block->slab ? CurrentThreadCache() : NULL;
+	if (!cache) {
+		AutoLock<Benaphore> lock(fLock);
+		fInfo.frees++;
+		FreeBlock(block);
+		return;
+	}
+
+	block->NextFree() = cache->blocks;
+	cache->blocks = block;
+	cache->count++;
+	cache->frees++;
+
+	if (cache->count > 2 * kThreadCacheBatch) {
+		AutoLock<Benaphore> lock(fLock);
+		Drain(cache, kThreadCacheBatch);
+	}
+}
+
+
+SlabAllocator::Block *
+SlabAllocator::AllocateBlock()
+{
+	Slab *slab = fPartialSlabs;
+	if (!slab)
+		slab = NewSlab();
+
+	Block *block = slab->freeBlocks;
+	slab->freeBlocks = block->NextFree();
+	block->slab = slab;
+
+	if (++slab->usedBlocks == fBlocksPerSlab)
+		// slab is full now, forget about it until a block gets freed
+		UnlinkPartialSlab(slab);
+
+	if (++fInfo.used_blocks > fInfo.peak_used_blocks)
+		fInfo.peak_used_blocks = fInfo.used_blocks;
+
+	return block;
+}
+
+
+void
+SlabAllocator::FreeBlock(Block *block)
+{
+	fInfo.used_blocks--;
+
+	Slab *slab = block->slab;
+	if (!slab) {
+		free(block);
+		return;
+	}
+
+	ASSERT(slab->usedBlocks > 0);
+	block->NextFree() = slab->freeBlocks;
+	slab->freeBlocks = block;
+	slab->usedBlocks--;
+
+	if (!slab->partial)
+		LinkPartialSlab(slab);
+}
+
+
+SlabAllocator::ThreadCache *
+SlabAllocator::CurrentThreadCache()
+{
+	if (fThreadCacheIndex < 0)
+		return NULL;
+
+	ThreadCache *cache = (ThreadCache *)tls_get(fThreadCacheIndex);
+	if (cache)
+		return cache;
+
+	cache = (ThreadCache *)malloc(sizeof(ThreadCache));
+	if (!cache)
+		return NULL;
+
+	cache->blocks = NULL;
+	cache->count = 0;
+	cache->allocations = 0;
+	cache->frees = 0;
+	cache->thread = find_thread(NULL);
+
+	// listed so that the blocks of a thread that is gone can be taken back
+	AutoLock<Benaphore> lock(fLock);
+	cache->next = fThreadCaches;
+	fThreadCaches = cache;
+	tls_set(fThreadCacheIndex, cache);
+
+	return cache;
+}
+
+
+void
+SlabAllocator::Refill(ThreadCache *cache)
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	fInfo.allocations += cache->allocations;
+	fInfo.frees += cache->frees;
+	cache->allocations = 0;
+	cache->frees = 0;
+
+	for (; cache->count < kThreadCacheBatch; cache->count++) {
+		Block *block = AllocateBlock();
+		block->NextFree() = cache->blocks;
+		cache->blocks = block;
+	}
+}
+
+
+void
+SlabAllocator::Drain(ThreadCache *cache, int32 keep)
+{
+	fInfo.allocations += cache->allocations;
+	fInfo.frees += cache->frees;
+	cache->allocations = 0;
+	cache->frees = 0;
+
+	for (; cache->count > keep; cache->count--) {
+		Block *block = cache->blocks;
+		cache->blocks = block->NextFree();
+		FreeBlock(block);
+	}
+}
+
+
+void
+SlabAllocator::ReleaseUnusedSlabs()
+{
+	AutoLock<Benaphore> lock(fLock);
+
+	// the blocks kept by the calling thread and by threads that are gone
+	// go back to their slabs
+	if (fThreadCacheIndex >= 0) {
+		ThreadCache *cache = (ThreadCache *)tls_get(fThreadCacheIndex);
+		if (cache)
+			Drain(cache, 0);
+	}
+
+	for (ThreadCache **link = &fThreadCaches; *link; ) {
+		ThreadCache *cache = *link;
+		thread_info info;
+		if (get_thread_info(cache->thread, &info) == B_OK) {
+			link = &cache->next;
+			continue;
+		}
+
+		*link = cache->next;
+		Drain(cache, 0);
+		free(cache);
+	}
+
+	for (Slab *slab = fPartialSlabs; slab; ) {
+		Slab *next = slab->next;
+		if (slab->usedBlocks == 0) {
+			UnlinkPartialSlab(slab);
+			free(slab);
+			fInfo.slabs--;
+			fInfo.heap_size -= fSlabSize;
+		}
+		slab = next;
+	}
+}
+
+
+void
+SlabAllocator::GetInfo(slab_allocator_info *info) const
+{
+	AutoLock<Benaphore> lock(fLock);
+	*info = fInfo;
+}
+
+
+void
+SlabAllocator::ReleaseAllUnusedSlabs()
+{
+	for (SlabAllocator *allocator = sFirstAllocator; allocator;
+			allocator = allocator->fNextAllocator) {
+		allocator->ReleaseUnusedSlabs();
+
+		if (sInstrumentationHook) {
+			slab_allocator_info info;
+			allocator->GetInfo(&info);
+			(sInstrumentationHook)(&info);
+		}
+	}
+}
+
+
+void
+SlabAllocator::SetInstrumentationHook(slab_allocator_hook hook)
+{
+	sInstrumentationHook = hook;
+}
+
+
+SlabAllocator::Slab *
+SlabAllocator::NewSlab()
+{
+	Slab *slab = (Slab *)malloc(fSlabSize);
+	if (!slab)
+		throw std::bad_alloc();
+
+	slab->freeBlocks = NULL;
+	slab->usedBlocks = 0;
+	slab->partial = false;
+
+	// link up the free list back to front so that blocks get handed out
+	// in address order
+	char *firstBlock = (char *)slab->FirstBlock();
+	for (int32 index = fBlocksPerSlab; index-- > 0; ) {
+		Block *block = (Block *)(firstBlock + index * fBlockStride);
+		block->NextFree() = slab->freeBlocks;
+		slab->freeBlocks = block;
+	}
+
+	LinkPartialSlab(slab);
+
+	fInfo.slabs++;
+	fInfo.heap_size += fSlabSize;
+	if (fInfo.heap_size > fInfo.peak_heap_size)
+		fInfo.peak_heap_size = fInfo.heap_size;
+
+	return slab;
+}
+
+
+void
+SlabAllocator::LinkPartialSlab(Slab *slab)
+{
+	slab->previous = NULL;
+	slab->next = fPartialSlabs;
+	if (fPartialSlabs)
+		fPartialSlabs->previous = slab;
+	fPartialSlabs = slab;
+	slab->partial = true;
+}
+
+
+void
+SlabAllocator::UnlinkPartialSlab(Slab *slab)
+{
+	if (slab->previous)
+		slab->previous->next = slab->next;
+	else
+		fPartialSlabs = slab->next;
+
+	if (slab->next)
+		slab->next->previous = slab->previous;
+
+	slab->partial = false;
+}
@@ -0,0 +1,133 @@
+/*
+Open Tracker License
+
+Terms and Conditions
+
+Copyright (c) 1991-2000, Be Incorporated. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice applies to all licensees
+and shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF TITLE, MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+BE INCORPORATED BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF, OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+Except as contained in this notice, the name of Be Incorporated shall not be
+used in advertising or otherwise to promote the sale, use or other dealings in
+this Software without prior written authorization from Be Incorporated.
+
+Tracker(TM), Be(R), BeOS(R), and BeIA(TM) are trademarks or registered trademarks
+of Be Incorporated in the United States and other countries. Other brand product
+names are registered trademarks or trademarks of their respective holders.
+All rights reserved.
+*/
+
+//	SlabAllocator hands out fixed size blocks for the objects Tracker keeps
+//	one of per entry - Model, BPose and BTextWidget. Opening a big folder
+//	would otherwise do several mallocs per entry and leave the heap
+//	fragmented once the window is closed again.
+//
+//	Blocks are carved out of slabs of a few dozen blocks; a slab goes
+//	back to the heap as soon as all of its blocks are free and
+//	ReleaseUnusedSlabs() gets called, which the pose view does whenever
+//	it throws away all its poses.
+//
+//	Every thread keeps a few free blocks of each allocator to itself and
+//	only takes the lock to trade a batch of them with the slabs, so that
+//	the model builder threads don't line up on it. Blocks kept by threads
+//	count as used; those of threads that are gone are given back by
+//	ReleaseUnusedSlabs().
+
+#ifndef __SLAB_ALLOCATOR__
+#define __SLAB_ALLOCATOR__
+
+#include <SupportDefs.h>
+
+#include "Utilities.h"
+
+namespace BPrivate {
+
+struct slab_allocator_info {
+	const char *name;
+	size_t block_size;
+	int32 allocations;
+		// total number of blocks handed out so far
+	int32 frees;
+	int32 used_blocks;
+	int32 peak_used_blocks;
+	int32 slabs;
+	size_t heap_size;
+		// bytes currently held in slabs, used or not
+	size_t peak_heap_size;
+};
+
+typedef void (*slab_allocator_hook)(const slab_allocator_info *);
+
+class SlabAllocator {
+public:
+	SlabAllocator(const char *name, size_t blockSize);
+		// allocators are meant to be static objects, they are never
+		// unregistered and keep their slabs until the team goes away
+
+	void *Allocate(size_t size);
+		// <size> may differ from the block size for subclasses, those
+		// get a plain malloc; throws bad_alloc just like operator new
+	void Free(void *);
+
+	void ReleaseUnusedSlabs();
+	void GetInfo(slab_allocator_info *) const;
+
+	static void ReleaseAllUnusedSlabs();
+		// frees empty slabs of all allocators and passes the resulting
+		// numbers to the instrumentation hook, if there is one
+	static void SetInstrumentationHook(slab_allocator_hook);
+
+private:
+	struct Slab;
+	struct Block;
+	struct ThreadCache;
+
+	Slab *NewSlab();
+	void LinkPartialSlab(Slab *);
+	void UnlinkPartialSlab(Slab *);
+
+	Block *AllocateBlock();
+	void FreeBlock(Block *);
+	void Drain(ThreadCache *, int32 keep);
+		// these need the lock
+	ThreadCache *CurrentThreadCache();
+	void Refill(ThreadCache *);
+
+	const char *fName;
+	size_t fBlockSize;
+	size_t fBlockStride;
+	int32 fBlocksPerSlab;
+	size_t fSlabSize;
+	Slab *fPartialSlabs;
+		// all slabs that have free blocks, full ones are not kept track of
+	slab_allocator_info fInfo;
+	mutable Benaphore fLock;
+	int32 fThreadCacheIndex;
+		// TLS slot of the calling thread's cache, -1 if there is none
+	ThreadCache *fThreadCaches;
+	SlabAllocator *fNextAllocator;
+
+	static SlabAllocator *sFirstAllocator;
+	static slab_allocator_hook sInstrumentationHook;
+};
+
+} // namespace BPrivate
+
+using namespace BPrivate;
+
+#endif
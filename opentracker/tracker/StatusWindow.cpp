@@ -42,6 +42,7 @@ All rights reserved.
 #include <StringView.h>
 #include <String.h>
 
+#include <stdio.h>
 #include <string.h>
 
 #include "AutoLock.h"
@@ -49,10 +50,15 @@ All rights reserved.
 #include "Commands.h"
 #include "StatusWindow.h"
 #include "DeskWindow.h"
+#include "Utilities.h"
 
 
 const float	kDefaultStatusViewHeight = 50;
-const float kUpdateGrain = 100000;
+const bigtime_t kStatusSampleInterval = 100000;
+	// how often the status views look at the progress of their operation
+const bigtime_t kEstimateInterval = 1000000;
+const float kThroughputSmoothing = 0.2f;
+	// weight of the latest sample in the throughput
 const BRect kStatusRect(200, 200, 550, 200);
 
 
@@ -79,6 +85,71 @@ BStatusWindow *gStatusWindow = NULL;
 }
 
 
+static inline void
+MemoryBarrier()
+{
+	// Add and Sample order their plain loads and stores against the
+	// sequence count. On x86 atomic_add() and atomic_or() are locked
+	// instructions and already fence the memory accesses around them,
+	// PowerPC reorders freely and needs an explicit sync
+#if __POWERPC__
+#	if __GNUC__
+	__asm__ __volatile__ ("sync" : : : "memory");
+#	else
+	__sync();
+#	endif
+#endif
+}
+
+
+StatusProgress::StatusProgress()
+	:	fSequence(0),
+		fProcessedSize(0),
+		fItemCount(0)
+{
+	fItem[0] = '\0';
+	fItem[B_FILE_NAME_LENGTH - 1] = '\0';
+}
+
+
+void
+StatusProgress::Add(const char *item, off_t size)
+{
+	// only ever called by the thread running the operation
+	atomic_add(&fSequence, 1);
+	MemoryBarrier();
+
+	fProcessedSize += size;
+	if (item != NULL) {
+		fItemCount++;
+		strncpy(fItem, item, B_FILE_NAME_LENGTH - 1);
+	}
+
+	MemoryBarrier();
+	atomic_add(&fSequence, 1);
+}
+
+
+bool
+StatusProgress::Sample(off_t *processedSize, int32 *itemCount, char *item) const
+{
+	vint32 *sequence = const_cast<vint32 *>(&fSequence);
+
+	int32 before = atomic_or(sequence, 0);
+	if ((before & 1) != 0)
+		return false;
+
+	MemoryBarrier();
+	*processedSize = fProcessedSize;
+	*itemCount = fItemCount;
+	memcpy(item, fItem, B_FILE_NAME_LENGTH);
+	MemoryBarrier();
+
+	// if Add got in between, what we copied may be torn
+	return atomic_or(sequence, 0) == before;
+}
+
+
 filter_result
 BStatusMouseFilter::Filter(BMessage *, BHandler **target)
 {
@@ -134,6 +205,7 @@ BStatusWindow::BStatusWindow()
 		fRetainDesktopFocus(false)
 {
 	SetSizeLimits(0, 100000, 0, 100000);
+	SetPulseRate(kStatusSampleInterval);
 	fMouseDownFilter = new BStatusMouseFilter();
 	AddCommonFilter(fMouseDownFilter);
 
@@ -337,20 +409,27 @@ BStatusWindow::HasStatus(thread_id thread)
 
 
 void
-BStatusWindow::UpdateStatus(thread_id thread, const char *curItem, off_t itemSize,
-	bool optional)
+BStatusWindow::UpdateStatus(thread_id thread, const char *curItem, off_t itemSize)
+{
+	StatusProgress *progress = StatusProgressFor(thread);
+	if (progress)
+		progress->Add(curItem, itemSize);
+}
+
+
+StatusProgress *
+BStatusWindow::StatusProgressFor(thread_id thread)
 {
 	AutoLock<BWindow> lock(this);
 
 	int32 numItems = fViewList.CountItems();
 	for (int32 index = 0; index < numItems; index++) {
 		BStatusView *view = fViewList.ItemAt(index);
-		if (view->Thread() == thread) {
-			view->UpdateStatus(curItem, itemSize, optional);
-			break;
-		}
+		if (view->Thread() == thread)
+			return view->Progress();
 	}
 
+	return NULL;
 }
 
 
@@ -372,8 +451,43 @@ BStatusWindow::InitStatusItem(thread_id thread, int32 totalItems,  off_t totalSi
 }
 
 
+void
+BStatusWindow::SetStatusTotals(thread_id thread, int32 totalItems,
+	off_t totalSize)
+{
+	AutoLock<BWindow> lock(this);
+	
+	int32 numItems = fViewList.CountItems();
+	for (int32 index = 0; index < numItems; index++) {
+		BStatusView *view = fViewList.ItemAt(index);
+		if (view->Thread() == thread) {
+			view->SetTotals(totalItems, totalSize);
+			break;
+		}
+	}
+}
+
+
+void
+BStatusWindow::CancelStatusItem(thread_id thread)
+{
+	AutoLock<BWindow> lock(this);
+	
+	int32 numItems = fViewList.CountItems();
+	for (int32 index = 0; index < numItems; index++) {
+		BStatusView *view = fViewList.ItemAt(index);
+		if (view->Thread() == thread) {
+			view->SetWasCanceled();
+			if (view->IsPaused())
+				resume_thread(thread);
+			break;
+		}
+	}
+}
+
+
 BStatusView::BStatusView(BRect bounds, thread_id thread, StatusWindowState type)
-	:	BView(bounds, "StatusView", B_FOLLOW_NONE, B_WILL_DRAW),
+	:	BView(bounds, "StatusView", B_FOLLOW_NONE, B_WILL_DRAW | B_PULSE_NEEDED),
 		fBitmap(NULL)
 {
 	Init();
@@ -485,12 +599,19 @@ void
 BStatusView::Init()
 {
 	fDestDir = "";
+	fEstimate = "";
+	fTotalItems = 0;
+	fTotalSize = 0;
+	fBarScale = 1;
 	fCurItem = 0;
-	fPendingStatusString[0] = '\0';
+	fShowCount = true;
 	fWasCanceled = false;
 	fIsPaused = false;
-	fLastUpdateTime = 0;
-	fItemSize = 0;
+	fLastSampleTime = 0;
+	fLastEstimateTime = 0;
+	fThroughput = 0;
+	fProcessedSize = 0;
+		// the next sample shows everything that was done so far
 }
 
 
@@ -507,7 +628,9 @@ BStatusView::InitStatus(int32 totalItems, off_t totalSize,
 	const entry_ref *destDir, bool showCount)
 {
 	Init();
+	fTotalItems = totalItems;
 	fTotalSize = totalSize;
+	fBarScale = max_c(totalSize, 1);
 	fShowCount = showCount;
 
 	BEntry entry;
@@ -517,88 +640,134 @@ BStatusView::InitStatus(int32 totalItems, off_t totalSize,
 		fDestDir = name;
 	}
 	
-	BString buffer;
-	buffer << "of " << totalItems;
-
 	switch (fType) {
 		case kCopyState:
-			fStatusBar->Reset("Copying: ", buffer.String());
+			fStatusBar->Reset("Copying: ", NULL);
 			break;
 
 		case kCreateLinkState:
-			fStatusBar->Reset("Creating Links: ", buffer.String());
+			fStatusBar->Reset("Creating Links: ", NULL);
 			break;
 
 		case kMoveState:
-			fStatusBar->Reset("Moving: ", buffer.String());
+			fStatusBar->Reset("Moving: ", NULL);
 			break;
 
 		case kTrashState:
-			fStatusBar->Reset("Emptying Trash" B_UTF8_ELLIPSIS " ", buffer.String());
+			fStatusBar->Reset("Emptying Trash" B_UTF8_ELLIPSIS " ", NULL);
 			break;
 
 		case kDeleteState:
-			fStatusBar->Reset("Deleting: ", buffer.String());
+			fStatusBar->Reset("Deleting: ", NULL);
 			break;
 
 		case kRestoreFromTrashState:
-			fStatusBar->Reset("Restoring: ", buffer.String());
+			fStatusBar->Reset("Restoring: ", NULL);
 			break;
 
 		default:
 			break;
 	}
 
-	fStatusBar->SetMaxValue(1);
+	fStatusBar->SetMaxValue(max_c(1, (float)fTotalSize / fBarScale));
 		// SetMaxValue has to be here because Reset changes it to 100
+	if (fShowCount)
+		fStatusBar->SetTrailingText(CountText().String());
 	Invalidate();
 }
 
 
 void
-BStatusView::UpdateStatus(const char *curItem, off_t itemSize, bool optional)
+BStatusView::SetTotals(int32 totalItems, off_t totalSize)
 {
-	float currentTime = system_time();
+	// the bar keeps its value, only its maximum moves; resetting it
+	// would make it flicker every time the totals are refined
+	fTotalItems = totalItems;
+	fTotalSize = max_c(totalSize, fProcessedSize);
+	fStatusBar->SetMaxValue(max_c(1, (float)fTotalSize / fBarScale));
+	if (fShowCount)
+		fStatusBar->SetTrailingText(CountText().String());
+}
 
-	if (fShowCount) {
-	
-		if (curItem)
-			fCurItem++;
-	
-		fItemSize += itemSize;
 
-		if (!optional || ((currentTime - fLastUpdateTime) > kUpdateGrain)) {
-			if (curItem != NULL || fPendingStatusString[0]) {
-				// forced update or past update time
-				
-				BString buffer;
-				buffer <<  fCurItem << " ";
-				
-				// if we don't have curItem, take the one from the stash
-				const char *statusItem = curItem != NULL 
-					? curItem : fPendingStatusString;
+BString
+BStatusView::CountText() const
+{
+	BString text;
+	if (fCurItem > 0)
+		text << fCurItem << " ";
+	text << "of " << fTotalItems;
+	return text;
+}
+
 
-				fStatusBar->Update((float)fItemSize / fTotalSize, statusItem, buffer.String());
+void
+BStatusView::Pulse()
+{
+	// however often the operation reports progress, the display is only
+	// brought up to date here
+	if (fIsPaused || fTotalSize <= 0)
+		return;
+
+	off_t processedSize;
+	int32 itemCount;
+	char item[B_FILE_NAME_LENGTH];
+	if (!fProgress.Sample(&processedSize, &itemCount, item))
+		return;
+
+	bigtime_t now = system_time();
+	if (fLastSampleTime > 0 && now > fLastSampleTime) {
+		float throughput = (processedSize - fProcessedSize) * 1000000.0f
+			/ (now - fLastSampleTime);
+		fThroughput += (throughput - fThroughput) * kThroughputSmoothing;
+	}
+	fLastSampleTime = now;
 
-				// we already displayed this item, clear the stash
-				fPendingStatusString[0] =  '\0';
+	if (processedSize != fProcessedSize || itemCount != fCurItem) {
+		float delta = (float)(processedSize - fProcessedSize) / fBarScale;
+		fProcessedSize = processedSize;
 
-				fLastUpdateTime = currentTime;
-			}
-			else 
-				// don't have a file to show, just update the bar
-				fStatusBar->Update((float)fItemSize / fTotalSize);
-
-			fItemSize = 0;
-		} else if (curItem != NULL) {
-			// stash away the name of the item we are currently processing
-			// so we can show it when the time comes
-			strncpy(fPendingStatusString, curItem, 127);
-			fPendingStatusString[127] = '0';
+		if (fShowCount && itemCount != fCurItem) {
+			fCurItem = itemCount;
+			fStatusBar->Update(delta, item, CountText().String());
+		} else
+			fStatusBar->Update(delta);
+	}
+
+	if (now - fLastEstimateTime >= kEstimateInterval)
+		UpdateEstimate(now);
+}
+
+
+void
+BStatusView::UpdateEstimate(bigtime_t now)
+{
+	fLastEstimateTime = now;
+
+	BString estimate;
+	if (fThroughput >= 1 && fProcessedSize < fTotalSize) {
+		char buffer[64];
+		if (fType == kCopyState) {
+			// only copies count bytes, the rest count items
+			if (fThroughput >= kMBSize)
+				sprintf(buffer, "%.1f MB/s, ", fThroughput / kMBSize);
+			else
+				sprintf(buffer, "%.0f KB/s, ", fThroughput / kKBSize);
+			estimate << buffer;
 		}
-	} else {
-		fStatusBar->Update((float)fItemSize / fTotalSize);
-		fItemSize = 0;
+
+		int32 seconds = (int32)((fTotalSize - fProcessedSize) / fThroughput);
+		if (seconds >= 3600) {
+			sprintf(buffer, "%ld:%02ld:%02ld left", seconds / 3600,
+				(seconds / 60) % 60, seconds % 60);
+		} else
+			sprintf(buffer, "%ld:%02ld left", seconds / 60, seconds % 60);
+		estimate << buffer;
+	}
+
+	if (estimate != fEstimate) {
+		fEstimate = estimate;
+		Invalidate();
 	}
 }
 
@@ -609,6 +778,8 @@ BStatusView::MessageReceived(BMessage *message)
 	switch (message->what) {
 		case kPauseButton:
 			fIsPaused = !fIsPaused;
+			// the time spent paused must not count against the throughput
+			fLastSampleTime = 0;
 			if (!fIsPaused) {
 				
 				// force window update
@@ -624,6 +795,7 @@ BStatusView::MessageReceived(BMessage *message)
 			if (fIsPaused) {
 				// resume so that the copy loop gets a chance to finish up
 				fIsPaused = false;
+				fLastSampleTime = 0;
 				
 				// force window update
 				Invalidate();
@@ -673,11 +845,19 @@ BStatusView::Draw(BRect)
 
 	if (IsPaused())
 		DrawString("Paused: click to resume or stop");
-	else if (fDestDir.Length()) {
-		BString buffer;
-		buffer << "To: " << fDestDir;
-		SetHighColor(0, 0, 0);
-		DrawString(buffer.String());
+	else {
+		if (fDestDir.Length()) {
+			BString buffer;
+			buffer << "To: " << fDestDir;
+			SetHighColor(0, 0, 0);
+			DrawString(buffer.String());
+		}
+
+		if (fEstimate.Length()) {
+			tp.x = fStatusBar->Frame().right - StringWidth(fEstimate.String());
+			MovePenTo(tp);
+			DrawString(fEstimate.String());
+		}
 	}
 }
 
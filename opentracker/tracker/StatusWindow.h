@@ -39,6 +39,7 @@ All rights reserved.
 #include <View.h>
 #include <Bitmap.h>
 #include <StatusBar.h>
+#include <StorageDefs.h>
 #include <String.h>
 
 #include "ObjectList.h"
@@ -57,6 +58,30 @@ enum StatusWindowState {
 
 class BStatusView;
 
+class StatusProgress {
+	// the progress of one operation; the thread running the operation
+	// adds to it without locking anything, the status view samples it at
+	// its own pace. There is only ever the one writer, a sequence count
+	// tells the reader when it raced with it; the accesses around the
+	// count are fenced, see MemoryBarrier() in StatusWindow.cpp
+public:
+	StatusProgress();
+
+	void Add(const char *item, off_t size);
+		// <item> is the item that is now being worked on, or NULL
+
+	bool Sample(off_t *processedSize, int32 *itemCount, char *item) const;
+		// <item> needs room for B_FILE_NAME_LENGTH bytes; returns false
+		// if the writer was busy, try again next time instead of waiting
+
+private:
+	vint32 fSequence;
+		// odd while Add is at work
+	off_t fProcessedSize;
+	int32 fItemCount;
+	char fItem[B_FILE_NAME_LENGTH];
+};
+
 class BStatusWindow : public BWindow {
 public:
 	BStatusWindow();
@@ -64,9 +89,15 @@ public:
 	void CreateStatusItem(thread_id, StatusWindowState);
 	void InitStatusItem(thread_id, int32 totalItems, off_t totalSize,
 		const entry_ref *destDir = NULL, bool showCount = true);
-	void UpdateStatus(thread_id, const char *curItem, off_t itemSize, bool optional = false);
-		// if true is passed in <optional> status will only
-		// be updated if 0.2 seconds elapsed since the last update
+	void SetStatusTotals(thread_id, int32 totalItems, off_t totalSize);
+		// the totals passed to InitStatusItem may only be an estimate;
+		// this refines them while the operation is already running
+	void CancelStatusItem(thread_id);
+	void UpdateStatus(thread_id, const char *curItem, off_t itemSize);
+		// the display catches up at the sample rate of the status views
+	StatusProgress *StatusProgressFor(thread_id);
+		// what the thread can update without going through the window;
+		// stays valid until the thread removes its status item
 	void RemoveStatusItem(thread_id);
 	bool HasStatus(thread_id);
 	bool CheckCanceledOrPaused(thread_id);
@@ -97,15 +128,17 @@ public:
 	
 	void InitStatus(int32 totalItems, off_t totalSize, const entry_ref *destDir,
 		bool showCount);
+	void SetTotals(int32 totalItems, off_t totalSize);
 	
 	// BView overrides
 	virtual	void Draw(BRect);
 	virtual	void AttachedToWindow();
 	virtual	void MessageReceived(BMessage *);
-	void UpdateStatus(const char *curItem, off_t itemSize, bool optional = false);
-		// if true is passed in <optional> status will only
-		// be updated if 0.2 seconds elapsed since the last update
-	
+	virtual	void Pulse();
+		// samples the progress and updates the display
+
+	StatusProgress *Progress();
+
 	bool WasCanceled() const;
 	bool IsPaused() const;
 	thread_id Thread() const;
@@ -115,21 +148,33 @@ public:
 	// called by AboutToQuit
 	
 private:
+	void UpdateEstimate(bigtime_t now);
+	BString CountText() const;
+
 	BStatusBar *fStatusBar;
+	StatusProgress fProgress;
+	int32 fTotalItems;
 	off_t fTotalSize;
-	off_t fItemSize;
+	off_t fBarScale;
+		// bytes per unit of the bar, fixed when the status is inited so
+		// that refining the totals only changes the bar's maximum
+	off_t fProcessedSize;
+		// as of the last sample
 	int32 fCurItem;
 	int32 fType;
 	BBitmap *fBitmap;
 	BButton *fStopButton;
 	BButton *fPauseButton;
 	thread_id fThread;
-	float fLastUpdateTime;
+	bigtime_t fLastSampleTime;
+	bigtime_t fLastEstimateTime;
+	float fThroughput;
+		// per second, smoothed over the samples
 	bool fShowCount;
 	bool fWasCanceled;
 	bool fIsPaused;
 	BString fDestDir;
-	char fPendingStatusString[128];
+	BString fEstimate;
 
 	typedef BView _inherited;
 };
@@ -152,6 +197,12 @@ BStatusView::Thread() const
 	return fThread;
 }
 
+inline StatusProgress *
+BStatusView::Progress()
+{
+	return &fProgress;
+}
+
 extern BStatusWindow *gStatusWindow;
 
 } // namespace BPrivate
@@ -36,19 +36,45 @@ All rights reserved.
 
 #include "Tests.h"
 
+#include <Application.h>
+#include <Bitmap.h>
 #include <Debug.h>
+#include <Directory.h>
+#include <File.h>
+#include <FindDirectory.h>
 #include <Locker.h>
+#include <NodeInfo.h>
+#include <NodeMonitor.h>
 #include <Path.h>
 #include <String.h>
+#include <Volume.h>
 #include <Window.h>
 
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "Attributes.h"
+#include "AttributeStream.h"
 #include "EntryIterator.h"
+#include "FSUtils.h"
 #include "IconCache.h"
 #include "Model.h"
+#include "NavListingCache.h"
+#include "NodeAttributes.h"
 #include "NodeWalker.h"
+#include "Pose.h"
+#include "PoseGrid.h"
+#include "PoseList.h"
+#include "PoseView.h"
+#include "SlabAllocator.h"
+#include "StatusWindow.h"
 #include "StopWatch.h"
+#include "TextWidget.h"
 #include "Thread.h"
+#include "Utilities.h"
+#include "ViewState.h"
 
 
 
@@ -61,6 +87,14 @@ const char *pathsToSearch[] = {
 	0
 };
 
+namespace BPrivate {
+extern
+#if !B_BEOS_VERSION_DANO
+_IMPEXP_BE
+#endif
+bool CheckNodeIconHintPrivate(const BNode *, bool);
+}
+
 namespace BTrackerPrivate {
 
 class IconSpewer : public SimpleThread {
@@ -316,4 +350,1648 @@ RunIconCacheTests()
 	(new IconTestWindow())->Show();
 }
 
+
+// #pragma mark -
+
+//	Pose view benchmarks; these work on synthetic poses that use the
+//	columns of the pose view they are started from, the poses are never
+//	added to the view itself. The list mode ones run on a pose view of
+//	their own, drawn into an offscreen bitmap. Results go to stdout.
+
+namespace BPrivate {
+
+class PoseViewBenchmarkAccess {
+	// sets up and runs protected BPoseView code on pose views owned by
+	// the benchmarks
+public:
+	static void InitListMode(BPoseView *view)
+	{
+		// what Init does short of the title view, the scroll bars and
+		// adding the poses of the target; needs the view attached
+		view->DisableSaveLocation();
+		view->RestoreState(BMessage());
+		view->fListElemHeight = ceilf(BPoseView::fFontHeight < 20
+			? 20 : BPoseView::fFontHeight + 6);
+	}
+
+	static PoseList *Poses(BPoseView *view)
+	{
+		return view->fPoseList;
+	}
+
+	static void SelectPosesListMode(BPoseView *view, BRect rect,
+		int32 *firstRow, int32 *lastRow)
+	{
+		view->SelectPosesListMode(rect, firstRow, lastRow);
+	}
+
+	static void SetAddPosesHook(void (*hook)(BPoseView *, int32))
+	{
+		BPoseView::fAddPosesHook = hook;
+	}
+};
+
+}	// namespace BPrivate
+
+namespace BTrackerPrivate {
+
+const int32 kBenchmarkPoseCount = 100000;
+const int32 kBenchmarkNotificationCount = 10000;
+
+
+static void
+AddBenchmarkPoses(BPoseView *poseView, PoseList *list, int32 first, int32 count)
+{
+	// the entries live on a bogus device, the models only get their
+	// node_ref and entry_ref set up and never touch the disk
+	node_ref dirNode;
+	dirNode.device = -1;
+	dirNode.node = 1;
+
+	for (int32 index = first; index < first + count; index++) {
+		node_ref itemNode;
+		itemNode.device = dirNode.device;
+		itemNode.node = 1000 + index;
+
+		char name[B_FILE_NAME_LENGTH];
+		sprintf(name, "pose %ld", index);
+		Model *model = new Model(&dirNode, &itemNode, name);
+
+		// give the sort benchmarks something to sort by
+		StatStruct *statBuf = const_cast<StatStruct *>(model->StatBuf());
+		statBuf->st_size = rand() % 1000000;
+		statBuf->st_mtime = rand();
+
+		list->AddItem(new BPose(model, poseView));
+	}
+}
+
+
+static BPoseView *
+NewBenchmarkListView(BBitmap *bitmap, int32 poseCount)
+{
+	// a list mode pose view with <poseCount> poses, drawing into <bitmap>;
+	// the target lives on the same bogus device as the poses. Returns
+	// with the bitmap locked, DeleteBenchmarkListView unlocks it
+	node_ref dirNode;
+	dirNode.device = -1;
+	dirNode.node = 0;
+	node_ref node;
+	node.device = -1;
+	node.node = 1;
+
+	BPoseView *view = new BPoseView(new Model(&dirNode, &node, "benchmark"),
+		bitmap->Bounds(), kListMode, B_FOLLOW_NONE);
+
+	bitmap->Lock();
+	bitmap->AddChild(view);
+	PoseViewBenchmarkAccess::InitListMode(view);
+	AddBenchmarkPoses(view, PoseViewBenchmarkAccess::Poses(view), 0,
+		poseCount);
+
+	return view;
+}
+
+
+static void
+DeleteBenchmarkListView(BBitmap *bitmap, BPoseView *view)
+{
+	bitmap->RemoveChild(view);
+	delete view;
+	bitmap->Unlock();
+}
+
+
+static BPose *
+LinearFindPose(const PoseList *list, const node_ref *node, int32 *resultingIndex,
+	bool deep)
+{
+	// the un-indexed PoseList::FindPose/DeepFindPose, used as a baseline
+	int32 count = list->CountItems();
+	for (int32 index = 0; index < count; index++) {
+		BPose *pose = list->ItemAt(index);
+		Model *model = pose->TargetModel();
+		if (*model->NodeRef() == *node
+			|| (deep && model->IsSymLink() && model->LinkTo()
+				&& *model->LinkTo()->NodeRef() == *node)) {
+			if (resultingIndex)
+				*resultingIndex = index;
+			return pose;
+		}
+	}
+	return NULL;
+}
+
+
+struct BenchmarkNotification {
+	int32 opcode;
+	node_ref node;
+};
+
+
+static void
+MakeBenchmarkNotifications(BenchmarkNotification *notifications, int32 count,
+	int32 poseCount)
+{
+	// a mix of creations of new nodes, removals and attribute changes of
+	// existing ones, same sequence every time
+	srand(42);
+	for (int32 index = 0; index < count; index++) {
+		BenchmarkNotification &notification = notifications[index];
+		notification.node.device = -1;
+		switch (rand() % 3) {
+			case 0:
+				notification.opcode = B_ENTRY_CREATED;
+				notification.node.node = 1000 + poseCount + index;
+				break;
+			case 1:
+				notification.opcode = B_ENTRY_REMOVED;
+				notification.node.node = 1000 + rand() % poseCount;
+				break;
+			default:
+				notification.opcode = B_ATTR_CHANGED;
+				notification.node.node = 1000 + rand() % poseCount;
+				break;
+		}
+	}
+}
+
+
+static bigtime_t
+ReplayBenchmarkNotifications(PoseList *list,
+	const BenchmarkNotification *notifications, int32 count, bool indexed)
+{
+	// does the pose list part of what FSNotification does for each
+	// notification; new poses are stand-ins that are never dereferenced
+	BStopWatch watch("", true);
+	for (int32 index = 0; index < count; index++) {
+		const BenchmarkNotification &notification = notifications[index];
+		int32 poseIndex;
+		BPose *pose;
+		switch (notification.opcode) {
+			case B_ENTRY_CREATED:
+				// EntryCreated bails if it already has the node
+				pose = indexed ? list->FindPose(&notification.node)
+					: LinearFindPose(list, &notification.node, NULL, false);
+				break;
+
+			case B_ENTRY_REMOVED:
+				pose = indexed ? list->FindPose(&notification.node, &poseIndex)
+					: LinearFindPose(list, &notification.node, &poseIndex, false);
+				if (pose)
+					list->RemoveItemAt(poseIndex);
+				break;
+
+			case B_ATTR_CHANGED:
+				pose = indexed ? list->DeepFindPose(&notification.node, &poseIndex)
+					: LinearFindPose(list, &notification.node, &poseIndex, true);
+				break;
+		}
+	}
+	return watch.ElapsedTime();
+}
+
+
+static void
+BenchmarkPoseListLookups(BPoseView *poseView)
+{
+	BenchmarkNotification *notifications
+		= new BenchmarkNotification [kBenchmarkNotificationCount];
+	MakeBenchmarkNotifications(notifications, kBenchmarkNotificationCount,
+		kBenchmarkPoseCount);
+
+	// kept non-owning, copying an owning list would clone the poses
+	PoseList poses(kBenchmarkPoseCount);
+	AddBenchmarkPoses(poseView, &poses, 0, kBenchmarkPoseCount);
+
+	for (int32 pass = 0; pass < 2; pass++) {
+		bool indexed = pass != 0;
+
+		PoseList list(poses);
+		bigtime_t elapsed = ReplayBenchmarkNotifications(&list, notifications,
+			kBenchmarkNotificationCount, indexed);
+
+		printf("PoseList: %ld notifications against %ld poses, %s: %Ld ms\n",
+			kBenchmarkNotificationCount, kBenchmarkPoseCount,
+			indexed ? "indexed" : "linear", elapsed / 1000);
+	}
+
+	for (int32 index = 0; index < poses.CountItems(); index++)
+		delete poses.ItemAt(index);
+
+	delete [] notifications;
+}
+
+static int
+CompareBenchmarkPoses(const BPose *pose1, const BPose *pose2, void *castToPoseView)
+{
+	// the per-comparison PoseCompareAddWidget SortPoses used to use,
+	// used as a baseline
+	BPoseView *view = (BPoseView *)castToPoseView;
+	uint32 sort = view->PrimarySort();
+	BColumn *column = view->ColumnFor(sort);
+	if (!column)
+		return 0;
+
+	BPose *primary = const_cast<BPose *>(pose1);
+	BPose *secondary = const_cast<BPose *>(pose2);
+	if (view->ReverseSort()) {
+		primary = const_cast<BPose *>(pose2);
+		secondary = const_cast<BPose *>(pose1);
+	}
+
+	int32 result = 0;
+	for (int32 count = 0; ; count++) {
+		BTextWidget *widget1 = primary->WidgetFor(sort);
+		if (!widget1)
+			widget1 = primary->AddWidget(view, column);
+
+		BTextWidget *widget2 = secondary->WidgetFor(sort);
+		if (!widget2)
+			widget2 = secondary->AddWidget(view, column);
+
+		if (!widget1 || !widget2)
+			return result;
+
+		result = widget1->Compare(*widget2, view);
+		if (count || result != 0)
+			return result;
+
+		sort = view->SecondarySort();
+		if (!sort)
+			return result;
+
+		column = view->ColumnFor(sort);
+		if (!column)
+			return result;
+	}
+}
+
+
+static void
+ShuffleBenchmarkPoses(PoseList *list)
+{
+	int32 count = list->CountItems();
+	BPose **poses = new BPose *[count];
+	for (int32 index = 0; index < count; index++)
+		poses[index] = list->ItemAt(index);
+
+	srand(42);
+	for (int32 index = count - 1; index > 0; index--) {
+		int32 otherIndex = rand() % (index + 1);
+		BPose *pose = poses[otherIndex];
+		poses[otherIndex] = poses[index];
+		poses[index] = pose;
+	}
+
+	list->SetOrder(poses);
+	delete [] poses;
+}
+
+
+static void
+BenchmarkPoseSorting(BPoseView *poseView)
+{
+	const char *attributes[] = { kAttrStatName, kAttrStatSize,
+		kAttrStatModified };
+	const uint32 types[] = { B_STRING_TYPE, B_OFF_T_TYPE, B_TIME_TYPE };
+	const int32 poseCounts[] = { 10000, 100000 };
+
+	uint32 primarySort = poseView->PrimarySort();
+	uint32 secondarySort = poseView->SecondarySort();
+
+	for (int32 countIndex = 0; countIndex < 2; countIndex++) {
+		PoseList poses(poseCounts[countIndex]);
+		AddBenchmarkPoses(poseView, &poses, 0, poseCounts[countIndex]);
+
+		for (int32 attrIndex = 0; attrIndex < 3; attrIndex++) {
+			uint32 attrHash = AttrHashString(attributes[attrIndex],
+				types[attrIndex]);
+			if (!poseView->ColumnFor(attrHash)) {
+				printf("PoseSort: %s column not shown, skipped\n",
+					attributes[attrIndex]);
+				continue;
+			}
+			poseView->SetPrimarySort(attrHash);
+			poseView->SetSecondarySort(0);
+
+			ShuffleBenchmarkPoses(&poses);
+			BStopWatch watch("", true);
+			poses.SortItems(CompareBenchmarkPoses, poseView);
+			bigtime_t compareTime = watch.ElapsedTime();
+
+			ShuffleBenchmarkPoses(&poses);
+			watch.Reset();
+			poseView->SortPoseList(&poses);
+			bigtime_t sortKeyTime = watch.ElapsedTime();
+
+			printf("PoseSort: %ld poses by %s, compare: %Ld ms, "
+				"sort keys: %Ld ms\n", poses.CountItems(), attributes[attrIndex],
+				compareTime / 1000, sortKeyTime / 1000);
+		}
+
+		for (int32 index = 0; index < poses.CountItems(); index++)
+			delete poses.ItemAt(index);
+	}
+
+	poseView->SetPrimarySort(primarySort);
+	poseView->SetSecondarySort(secondarySort);
+}
+
+static BPose *
+LinearFindBestMatch(const PoseList *list, const char *matchString,
+	int32 *matchingIndex)
+{
+	// the linear scan FindBestMatch used to do, used as a baseline
+	char bestSoFar[B_FILE_NAME_LENGTH] = { 0 };
+	BPose *poseToSelect = NULL;
+
+	int32 count = list->CountItems();
+	for (int32 index = 0; index < count; index++) {
+		BPose *pose = list->ItemAt(index);
+		const char *text = pose->TargetModel()->Name();
+		if (strcasecmp(text, matchString) >= 0)
+			if (strcasecmp(text, bestSoFar) <= 0 || !bestSoFar[0]) {
+				strcpy(bestSoFar, text);
+				poseToSelect = pose;
+				*matchingIndex = index;
+			}
+	}
+
+	return poseToSelect;
+}
+
+
+static void
+BenchmarkTypeAhead(BPoseView *poseView)
+{
+	// types 100 names of 100k poses, one keystroke at a time
+	const int32 kTypedNames = 100;
+
+	PoseList poses(kBenchmarkPoseCount);
+	AddBenchmarkPoses(poseView, &poses, 0, kBenchmarkPoseCount);
+
+	for (int32 pass = 0; pass < 2; pass++) {
+		bool indexed = pass != 0;
+		int32 keystrokes = 0;
+		int32 misses = 0;
+
+		srand(42);
+		BStopWatch watch("", true);
+		for (int32 typed = 0; typed < kTypedNames; typed++) {
+			char name[B_FILE_NAME_LENGTH];
+			sprintf(name, "Pose %ld", rand() % kBenchmarkPoseCount);
+
+			char matchString[B_FILE_NAME_LENGTH];
+			for (int32 length = 1; name[length - 1]; length++) {
+				strncpy(matchString, name, length);
+				matchString[length] = '\0';
+
+				int32 index;
+				BPose *pose = indexed
+					? poses.FindName(matchString, kNameAtOrAfter, &index)
+					: LinearFindBestMatch(&poses, matchString, &index);
+				if (!pose || poses.ItemAt(index) != pose)
+					misses++;
+				keystrokes++;
+			}
+		}
+
+		printf("TypeAhead: %ld keystrokes in %ld poses, %s: %Ld ms, "
+			"%ld misses\n", keystrokes, kBenchmarkPoseCount,
+			indexed ? "indexed" : "linear", watch.ElapsedTime() / 1000, misses);
+	}
+
+	for (int32 index = 0; index < poses.CountItems(); index++)
+		delete poses.ItemAt(index);
+}
+
+
+static void
+BenchmarkRubberBandSelection()
+{
+	// drags a selection rect down over 300 rows of 100k list mode poses
+	// with every tenth pose selected, one row per mouse move, through
+	// BPoseView::SelectPosesListMode; checks that every pose in the rect
+	// ends up flipped and every other one keeps its selection
+	const int32 kFirstRow = kBenchmarkPoseCount / 2;
+	const int32 kMoves = 300;
+
+	BBitmap bitmap(BRect(0, 0, 799, 599), B_RGB32, true);
+	BPoseView *poseView = NewBenchmarkListView(&bitmap, kBenchmarkPoseCount);
+	PoseList &poses = *PoseViewBenchmarkAccess::Poses(poseView);
+
+	for (int32 index = 0; index < kBenchmarkPoseCount; index += 10)
+		poses.ItemAt(index)->Select(true);
+
+	float rowHeight = poseView->ListElemHeight();
+	BRect rect(poses.ItemAt(0)->CalcRect(BPoint(0, 0), poseView));
+	rect.top = kFirstRow * rowHeight + 1;
+
+	int32 firstRow = 0;
+	int32 lastRow = -1;
+	int32 mismatches = 0;
+
+	BStopWatch watch("", true);
+	for (int32 move = 0; move < kMoves; move++) {
+		rect.bottom = (kFirstRow + move) * rowHeight + 1;
+		PoseViewBenchmarkAccess::SelectPosesListMode(poseView, rect,
+			&firstRow, &lastRow);
+	}
+	bigtime_t time = watch.ElapsedTime();
+
+	for (int32 index = 0; index < kBenchmarkPoseCount; index++) {
+		bool selected = index % 10 == 0;
+		if (index >= kFirstRow && index < kFirstRow + kMoves)
+			selected = !selected;
+
+		if (poses.ItemAt(index)->IsSelected() != selected)
+			mismatches++;
+	}
+
+	printf("RubberBandSelection: %ld moves: %Ld ms, rows %ld to %ld "
+		"selected, %ld mismatches\n", kMoves, time / 1000, firstRow, lastRow,
+		mismatches);
+
+	DeleteBenchmarkListView(&bitmap, poseView);
+}
+
+
+static void
+BenchmarkListScrolling()
+{
+	// scrolls a 200k row list mode view from top to bottom in evenly
+	// spaced jumps and fully redraws it after each, the way a drag of the
+	// scroll bar thumb does; prints the average and the worst frame
+	const int32 kRowCount = 200000;
+	const int32 kFrames = 500;
+
+	BBitmap bitmap(BRect(0, 0, 799, 599), B_RGB32, true);
+	BPoseView *poseView = NewBenchmarkListView(&bitmap, kRowCount);
+
+	float height = poseView->Bounds().Height();
+	float range = kRowCount * poseView->ListElemHeight() - height;
+
+	bigtime_t total = 0;
+	bigtime_t worst = 0;
+	for (int32 frame = 0; frame < kFrames; frame++) {
+		bigtime_t start = system_time();
+
+		poseView->ScrollTo(BPoint(0, floorf(range * frame / (kFrames - 1))));
+		poseView->Draw(poseView->Bounds());
+		poseView->Sync();
+
+		bigtime_t time = system_time() - start;
+		total += time;
+		if (time > worst)
+			worst = time;
+	}
+
+	printf("ListScrolling: %ld frames over %ld rows: %Ld us per frame, "
+		"worst %Ld us\n", kFrames, kRowCount, total / kFrames, worst);
+
+	DeleteBenchmarkListView(&bitmap, poseView);
+}
+
+
+// icon layout with fixed size poses on a 64 x 64 grid in a 1024 pixel wide
+// view, much like a large icon mode window
+const int32 kBenchmarkIconCount = 20000;
+const float kBenchmarkIconGrid = 64;
+const float kBenchmarkIconWidth = 60;
+const float kBenchmarkIconHeight = 50;
+const float kBenchmarkViewWidth = 1024;
+
+struct BenchmarkIconLayout {
+	BenchmarkIconLayout(bool useGrid)
+		:	useGrid(useGrid),
+			sorted(kBenchmarkIconCount),
+			all(kBenchmarkIconCount)
+		{}
+
+	bool useGrid;
+	PoseList sorted;
+		// by location.y, what fVSPoseList used to be searched with
+	PoseList all;
+		// in the order the poses were added, the last one is on top
+	PoseGrid grid;
+};
+
+
+static BRect
+BenchmarkIconRect(BPoint location)
+{
+	return BRect(location.x - (kBenchmarkIconWidth - B_LARGE_ICON) / 2,
+		location.y, location.x + (kBenchmarkIconWidth + B_LARGE_ICON) / 2,
+		location.y + kBenchmarkIconHeight);
+}
+
+
+static int32
+BenchmarkFirstIconAtOrBelow(const PoseList *list, float y)
+{
+	int32 low = 0;
+	int32 high = list->CountItems();
+	while (low < high) {
+		int32 middle = (low + high) / 2;
+		if (list->ItemAt(middle)->Location().y < y)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+
+static BPose *
+BenchmarkIconInSlot(BPose *pose, void *castToRect)
+{
+	BRect *rect = (BRect *)castToRect;
+	if (pose->Location().y < rect->bottom
+		&& rect->Intersects(BenchmarkIconRect(pose->Location())))
+		return pose;
+
+	return NULL;
+}
+
+
+static bool
+BenchmarkIconSlotOccupied(const BenchmarkIconLayout *layout, BRect rect)
+{
+	if (layout->useGrid) {
+		BRect area(rect.left - kBenchmarkIconWidth, rect.top - kBenchmarkIconHeight,
+			rect.right + kBenchmarkIconWidth, rect.bottom);
+		return layout->grid.EachPoseAt(area, BenchmarkIconInSlot, &rect) != NULL;
+	}
+
+	int32 count = layout->sorted.CountItems();
+	for (int32 index = BenchmarkFirstIconAtOrBelow(&layout->sorted,
+			rect.top - kBenchmarkIconHeight); index < count; index++) {
+		BPose *pose = layout->sorted.ItemAt(index);
+		if (pose->Location().y >= rect.bottom)
+			break;
+		if (rect.Intersects(BenchmarkIconRect(pose->Location())))
+			return true;
+	}
+	return false;
+}
+
+
+static void
+BenchmarkPlaceIcon(BenchmarkIconLayout *layout, BPose *pose, BPoint *hint)
+{
+	// what PlacePose and NextSlot do
+	BRect rect(BenchmarkIconRect(*hint));
+	rect.InsetBy(-3, 0);
+	while (BenchmarkIconSlotOccupied(layout, rect)) {
+		rect.OffsetBy(kBenchmarkIconGrid, 0);
+		if (rect.right > kBenchmarkViewWidth) {
+			hint->x = kBenchmarkIconGrid / 2;
+			hint->y += kBenchmarkIconGrid;
+			rect = BenchmarkIconRect(*hint);
+			rect.InsetBy(-3, 0);
+		}
+	}
+	rect.InsetBy(3, 0);
+
+	BPoint location(rect.left + (kBenchmarkIconWidth - B_LARGE_ICON) / 2, rect.top);
+	pose->SetLocation(location);
+	*hint = location + BPoint(kBenchmarkIconGrid, 0);
+
+	layout->sorted.AddItem(pose, BenchmarkFirstIconAtOrBelow(&layout->sorted,
+		location.y + 1));
+	layout->all.AddItem(pose);
+	if (layout->useGrid)
+		layout->grid.Add(pose, location);
+}
+
+
+static void
+BenchmarkRemoveIcon(BenchmarkIconLayout *layout, BPose *pose)
+{
+	layout->sorted.RemoveItem(pose);
+	layout->all.RemoveItem(pose);
+	if (layout->useGrid)
+		layout->grid.Remove(pose);
+}
+
+
+struct BenchmarkIconHit {
+	const PoseList *all;
+	BPoint point;
+	int32 index;
+};
+
+
+static BPose *
+BenchmarkIconAtPoint(BPose *pose, void *castToHit)
+{
+	BenchmarkIconHit *hit = (BenchmarkIconHit *)castToHit;
+	int32 index;
+	if (BenchmarkIconRect(pose->Location()).Contains(hit->point)
+		&& hit->all->FindPose(pose->TargetModel(), &index) == pose) {
+		if (index > hit->index)
+			hit->index = index;
+	}
+	return NULL;
+}
+
+
+static int32
+BenchmarkFindIcon(const BenchmarkIconLayout *layout, BPoint point)
+{
+	if (layout->useGrid) {
+		BenchmarkIconHit hit;
+		hit.all = &layout->all;
+		hit.point = point;
+		hit.index = -1;
+		layout->grid.EachPoseAt(BRect(point.x - kBenchmarkIconWidth,
+			point.y - kBenchmarkIconHeight, point.x + kBenchmarkIconWidth, point.y),
+			BenchmarkIconAtPoint, &hit);
+		return hit.index;
+	}
+
+	for (int32 index = layout->all.CountItems() - 1; index >= 0; index--) {
+		if (BenchmarkIconRect(layout->all.ItemAt(index)->Location()).Contains(point))
+			return index;
+	}
+	return -1;
+}
+
+
+static void
+BenchmarkIconPlacement(BPoseView *poseView)
+{
+	// lays out 20k icons from scratch, then removes and auto-places 200
+	// of them again with the placement hint reset each time like
+	// RemovePose does, then does 2000 hit tests; compares scanning the
+	// y-sorted list with the pose grid
+	const int32 kReplaced = 200;
+	const int32 kHitTests = 2000;
+
+	PoseList poses(kBenchmarkIconCount);
+	AddBenchmarkPoses(poseView, &poses, 0, kBenchmarkIconCount);
+
+	for (int32 pass = 0; pass < 2; pass++) {
+		BenchmarkIconLayout layout(pass != 0);
+
+		BStopWatch watch("", true);
+		BPoint hint(kBenchmarkIconGrid / 2, kBenchmarkIconGrid / 2);
+		for (int32 index = 0; index < kBenchmarkIconCount; index++)
+			BenchmarkPlaceIcon(&layout, poses.ItemAt(index), &hint);
+		bigtime_t layoutTime = watch.ElapsedTime();
+
+		srand(42);
+		watch.Reset();
+		for (int32 count = 0; count < kReplaced; count++) {
+			BPose *pose = poses.ItemAt(rand() % kBenchmarkIconCount);
+			BenchmarkRemoveIcon(&layout, pose);
+			hint = BPoint(kBenchmarkIconGrid / 2, kBenchmarkIconGrid / 2);
+			BenchmarkPlaceIcon(&layout, pose, &hint);
+		}
+		bigtime_t replaceTime = watch.ElapsedTime();
+
+		float bottom = layout.sorted.LastItem()->Location().y + kBenchmarkIconGrid;
+		int32 hits = 0;
+		watch.Reset();
+		for (int32 count = 0; count < kHitTests; count++) {
+			BPoint point(rand() % (int32)kBenchmarkViewWidth, rand() % (int32)bottom);
+			if (BenchmarkFindIcon(&layout, point) >= 0)
+				hits++;
+		}
+		bigtime_t hitTime = watch.ElapsedTime();
+
+		printf("IconPlacement: %ld icons, %s: layout %Ld ms, %ld replaced %Ld ms, "
+			"%ld hit tests %Ld ms (%ld hits)\n", kBenchmarkIconCount,
+			layout.useGrid ? "grid" : "sorted list", layoutTime / 1000, kReplaced,
+			replaceTime / 1000, kHitTests, hitTime / 1000, hits);
+	}
+
+	for (int32 index = 0; index < poses.CountItems(); index++)
+		delete poses.ItemAt(index);
+}
+
+
+static BPose *
+TopmostPoseAt(BPoseView *poseView, BPoint point)
+{
+	for (int32 index = poseView->CountItems() - 1; index >= 0; index--) {
+		BPose *pose = poseView->PoseAtIndex(index);
+		if (pose->PointInPose(poseView, point))
+			return pose;
+	}
+	return NULL;
+}
+
+
+static void
+CheckViewModeHitTesting(BPoseView *poseView)
+{
+	// switches the view between mini and large icons and back to where
+	// it started; after each switch hit tests a point in the name of the
+	// first 1000 poses and checks that the grid finds the same pose as
+	// scanning the whole pose list does
+	const int32 kMaxChecked = 1000;
+	const uint32 modes[] = { kMiniIconMode, kIconMode, kMiniIconMode,
+		poseView->ViewMode() };
+
+	for (uint32 step = 0; step < sizeof(modes) / sizeof(modes[0]); step++) {
+		if (poseView->ViewMode() != modes[step])
+			poseView->SetViewMode(modes[step]);
+		if (poseView->ViewMode() == kListMode)
+			continue;
+
+		int32 count = min_c(poseView->CountItems(), kMaxChecked);
+		int32 mismatches = 0;
+		for (int32 index = 0; index < count; index++) {
+			BPose *pose = poseView->PoseAtIndex(index);
+			BPoint point(pose->Location());
+			if (poseView->ViewMode() == kIconMode)
+				point += BPoint(B_LARGE_ICON / 2,
+					B_LARGE_ICON + poseView->FontHeight() / 2);
+			else
+				point += BPoint(B_MINI_ICON / 2, poseView->IconPoseHeight() / 2);
+
+			if (poseView->FindPose(point) != TopmostPoseAt(poseView, point))
+				mismatches++;
+		}
+
+		printf("ViewModeHitTesting: %s icons, %ld poses: %ld mismatches\n",
+			poseView->ViewMode() == kIconMode ? "large" : "mini", count,
+			mismatches);
+	}
+}
+
+
+static int
+CompareNamesCaseInsensitive(const void *name1, const void *name2)
+{
+	return strcasecmp(*(const char **)name1, *(const char **)name2);
+}
+
+
+static int
+CompareNamesCollated(const void *name1, const void *name2)
+{
+	// collates without a cache, building both keys on every comparison
+	BString key1;
+	BString key2;
+	GetCollationKey(*(const char **)name1, &key1);
+	GetCollationKey(*(const char **)name2, &key2);
+	return strcmp(key1.String(), key2.String());
+}
+
+
+static int
+CompareCollationKeys(const void *key1, const void *key2)
+{
+	return strcmp(*(const char **)key1, *(const char **)key2);
+}
+
+
+static void
+BenchmarkNameSorting()
+{
+	// sorts 100k names case-insensitive, collated and by cached
+	// collation keys, the way StringAttributeText now does
+	const char *prefixes[] = { "Report", "report", "Résumé", "resume",
+		"Übersicht", "IMG_", "Straße", "strasse" };
+
+	BString *names = new BString [kBenchmarkPoseCount];
+	const char **sorted = new const char * [kBenchmarkPoseCount];
+	BString *keys = new BString [kBenchmarkPoseCount];
+
+	srand(42);
+	for (int32 index = 0; index < kBenchmarkPoseCount; index++) {
+		names[index] << prefixes[rand() % 8] << " " << rand() % 100000;
+		sorted[index] = names[index].String();
+	}
+
+	BStopWatch watch("", true);
+	qsort(sorted, kBenchmarkPoseCount, sizeof(const char *),
+		CompareNamesCaseInsensitive);
+	bigtime_t caseInsensitiveTime = watch.ElapsedTime();
+
+	for (int32 index = 0; index < kBenchmarkPoseCount; index++)
+		sorted[index] = names[index].String();
+
+	watch.Reset();
+	qsort(sorted, kBenchmarkPoseCount, sizeof(const char *),
+		CompareNamesCollated);
+	bigtime_t collatedTime = watch.ElapsedTime();
+
+	watch.Reset();
+	for (int32 index = 0; index < kBenchmarkPoseCount; index++)
+		GetCollationKey(names[index].String(), &keys[index]);
+	bigtime_t keyTime = watch.ElapsedTime();
+
+	for (int32 index = 0; index < kBenchmarkPoseCount; index++)
+		sorted[index] = keys[index].String();
+
+	watch.Reset();
+	qsort(sorted, kBenchmarkPoseCount, sizeof(const char *),
+		CompareCollationKeys);
+	bigtime_t cachedTime = watch.ElapsedTime();
+
+	printf("NameSort: %ld names, strcasecmp: %Ld ms, collated: %Ld ms, "
+		"cached keys: %Ld ms (+ %Ld ms building them)\n", kBenchmarkPoseCount,
+		caseInsensitiveTime / 1000, collatedTime / 1000, cachedTime / 1000,
+		keyTime / 1000);
+
+	delete [] keys;
+	delete [] sorted;
+	delete [] names;
+}
+
+const int32 kBenchmarkIconCount = 10000;
+
+static void
+BenchmarkIconTransform(icon_size size)
+{
+	// highlights 10k icons the way MakeTransformedIcon used to, copying
+	// with SetBits and mapping byte by byte through an int32 table, and
+	// the way it does now
+	IconCache *iconCache = IconCache::sIconCache;
+	BRect bounds(0, 0, size - 1, size - 1);
+
+	// highlighting a bitmap holding every color index yields the table
+	BBitmap ramp(BRect(0, 0, 15, 15), B_CMAP8);
+	for (int32 index = 0; index < 256; index++)
+		((uint8 *)ramp.Bits())[index] = (uint8)index;
+	LazyBitmapAllocator rampHighlighted(B_MINI_ICON);
+	iconCache->MakeSelectedIcon(&ramp, B_MINI_ICON, &rampHighlighted);
+	int32 table[256];
+	for (int32 index = 0; index < 256; index++)
+		table[index] = ((uint8 *)rampHighlighted.Get()->Bits())[index];
+
+	BBitmap **icons = new BBitmap * [kBenchmarkIconCount];
+	srand(42);
+	for (int32 index = 0; index < kBenchmarkIconCount; index++) {
+		icons[index] = new BBitmap(bounds, B_CMAP8);
+		uint8 *bits = (uint8 *)icons[index]->Bits();
+		for (int32 byte = 0; byte < icons[index]->BitsLength(); byte++)
+			bits[byte] = (uint8)rand();
+	}
+
+	BBitmap scalar(bounds, B_CMAP8);
+	LazyBitmapAllocator lazyBitmap(size);
+
+	BStopWatch watch("", true);
+	for (int32 index = 0; index < kBenchmarkIconCount; index++) {
+		int32 bitsLength = scalar.BitsLength();
+		scalar.SetBits(icons[index]->Bits(), bitsLength, 0, B_CMAP8);
+		uchar *bits = (uchar *)scalar.Bits();
+		for (int32 byte = 0; byte < bitsLength; byte++) 
+			bits[byte] = (uchar)table[(uchar)bits[byte]];
+	}
+	bigtime_t scalarTime = watch.ElapsedTime();
+
+	watch.Reset();
+	for (int32 index = 0; index < kBenchmarkIconCount; index++)
+		iconCache->MakeSelectedIcon(icons[index], size, &lazyBitmap);
+	bigtime_t kernelTime = watch.ElapsedTime();
+
+	// the last icon is still in both bitmaps
+	bool differ = memcmp(scalar.Bits(), lazyBitmap.Get()->Bits(),
+		scalar.BitsLength()) != 0;
+
+	printf("IconTransform: %ld %ldx%ld icons, SetBits + int32 table: %Ld us, "
+		"direct: %Ld us%s\n", kBenchmarkIconCount, (int32)size, (int32)size,
+		scalarTime, kernelTime, differ ? ", RESULTS DIFFER" : "");
+
+	for (int32 index = 0; index < kBenchmarkIconCount; index++)
+		delete icons[index];
+	delete [] icons;
+}
+
+static void
+PrintIconCacheStats()
+{
+	icon_cache_stats node;
+	icon_cache_stats shared;
+	IconCache::sIconCache->GetStats(&node, &shared);
+
+	printf("IconCache: node %Ld hits, %Ld misses, %Ld evictions, %Ld KB; "
+		"shared %Ld hits, %Ld misses, %Ld KB\n", node.hits, node.misses,
+		node.evictions, node.bytes / 1024, shared.hits, shared.misses,
+		shared.bytes / 1024);
+}
+
+const int32 kBenchmarkNavListingRounds = 20;
+
+static void
+BenchmarkNavListing()
+{
+	// builds the models for a nav menu of the system apps folder the
+	// way BNavMenu reads a folder, and from a listing cache entry; both
+	// include the copy the menu item makes
+	NavListingCache *cache = NavListingCache::sNavListingCache;
+	BPath path;
+	entry_ref ref;
+	if (cache == NULL || find_directory(B_BEOS_APPS_DIRECTORY, &path) != B_OK
+		|| get_ref_for_path(path.Path(), &ref) != B_OK)
+		return;
+
+	BDirectory dir(&ref);
+	node_ref dirNode;
+	if (dir.GetNodeRef(&dirNode) != B_OK)
+		return;
+
+	int32 count = 0;
+	BStopWatch watch("", true);
+	for (int32 round = 0; round < kBenchmarkNavListingRounds; round++) {
+		dir.Rewind();
+		BEntry entry;
+		count = 0;
+		while (dir.GetNextEntry(&entry) == B_OK) {
+			Model model(&entry, true);
+			if (model.InitCheck() != B_OK)
+				continue;
+
+			PoseInfo poseInfo;
+			if (model.Node() != NULL)
+				model.Node()->ReadAttr(kAttrPoseInfo, B_RAW_TYPE, 0,
+					&poseInfo, sizeof(poseInfo));
+			model.CloseNode();
+			if (model.IsSymLink())
+				model.SetLinkTo(new Model(model.EntryRef(), true));
+
+			Model itemModel(model);
+			count++;
+		}
+	}
+	bigtime_t diskTime = watch.ElapsedTime();
+
+	// wait for the background thread to read the folder
+	cache->Forget(&dirNode);
+	cache->Prefetch(&ref);
+	BObjectList<NavListingEntry> entries(50, true);
+	for (int32 tries = 50; tries > 0; tries--) {
+		if (cache->GetListing(&dirNode, &entries))
+			break;
+		snooze(100000);
+	}
+	if (entries.CountItems() == 0)
+		return;
+
+	watch.Reset();
+	for (int32 round = 0; round < kBenchmarkNavListingRounds; round++) {
+		entries.MakeEmpty();
+		cache->GetListing(&dirNode, &entries);
+		entries.SortItems(&NavListingEntry::CompareFolderNamesFirst);
+
+		for (int32 index = 0; index < entries.CountItems(); index++) {
+			Model *model = entries.ItemAt(index)->NewModel();
+			Model itemModel(*model);
+			delete model;
+		}
+	}
+	bigtime_t cachedTime = watch.ElapsedTime();
+
+	printf("NavListing: %ld x %s, %ld entries, from disk: %Ld us, "
+		"cached: %Ld us\n", kBenchmarkNavListingRounds, path.Path(), count,
+		diskTime, cachedTime);
+}
+
+static void
+PrintNavListingCacheStats()
+{
+	if (NavListingCache::sNavListingCache == NULL)
+		return;
+
+	nav_listing_cache_stats stats;
+	NavListingCache::sNavListingCache->GetStats(&stats);
+
+	printf("NavListingCache: %Ld hits, %Ld misses, %Ld prefetched, %Ld of "
+		"those used, %Ld invalidated, %Ld evicted; %ld listings, %ld entries\n",
+		stats.hits, stats.misses, stats.prefetches, stats.prefetchHits,
+		stats.invalidations, stats.evictions, stats.listings, stats.entries);
+}
+
+static void
+PrintSlabAllocatorInfo(const slab_allocator_info *info)
+{
+	printf("%s: %ld allocations, %ld frees, %ld blocks of %ld bytes in use, "
+		"peak %ld; %ld slabs, %ld KB, peak %ld KB\n", info->name,
+		info->allocations, info->frees, info->used_blocks,
+		(int32)info->block_size, info->peak_used_blocks, info->slabs,
+		(int32)(info->heap_size / 1024), (int32)(info->peak_heap_size / 1024));
+}
+
+static bigtime_t sOpenStartTime;
+static bigtime_t sFirstPosesTime;
+static node_ref sOpenFolder;
+static int32 sOpenEntryCount;
+static int32 sOpenPoseCount;
+
+
+static void
+OpenLargeDirectoryPosesAdded(BPoseView *view, int32 count)
+{
+	if (*view->TargetModel()->NodeRef() != sOpenFolder)
+		return;
+
+	bigtime_t now = system_time();
+	if (sOpenPoseCount == 0)
+		sFirstPosesTime = now;
+
+	sOpenPoseCount += count;
+	if (sOpenPoseCount < sOpenEntryCount)
+		return;
+
+	printf("AddPoses: first poses after %Ld ms, all %ld after %Ld ms\n",
+		(sFirstPosesTime - sOpenStartTime) / 1000, sOpenPoseCount,
+		(now - sOpenStartTime) / 1000);
+	PoseViewBenchmarkAccess::SetAddPosesHook(NULL);
+}
+
+
+static void
+BenchmarkOpenLargeDirectory()
+{
+	// creates a folder with lots of empty files (the first time around)
+	// and opens it, timing how long it takes until the first and the last
+	// chunk of poses shows up; closing the window prints what the models,
+	// poses and widgets took from the heap
+	SlabAllocator::SetInstrumentationHook(&PrintSlabAllocatorInfo);
+
+	BPath path;
+	if (find_directory(B_COMMON_TEMP_DIRECTORY, &path) != B_OK)
+		return;
+
+	path.Append("tracker benchmark folder");
+	BDirectory dir;
+	if (create_directory(path.Path(), 0755) != B_OK
+		|| dir.SetTo(path.Path()) != B_OK)
+		return;
+
+	for (int32 index = dir.CountEntries(); index < kBenchmarkPoseCount; index++) {
+		char name[B_FILE_NAME_LENGTH];
+		sprintf(name, "file %ld", index);
+		BFile file(&dir, name, B_CREATE_FILE | B_WRITE_ONLY);
+		if (file.InitCheck() != B_OK)
+			return;
+	}
+
+	entry_ref ref;
+	if (get_ref_for_path(path.Path(), &ref) != B_OK)
+		return;
+
+	if (dir.GetNodeRef(&sOpenFolder) != B_OK)
+		return;
+
+	sOpenEntryCount = dir.CountEntries();
+	sOpenPoseCount = 0;
+	printf("AddPoses: opening %s, %ld entries\n", path.Path(),
+		sOpenEntryCount);
+
+	PoseViewBenchmarkAccess::SetAddPosesHook(&OpenLargeDirectoryPosesAdded);
+	sOpenStartTime = system_time();
+
+	BMessage message(B_REFS_RECEIVED);
+	message.AddRef("refs", &ref);
+	be_app->PostMessage(&message);
+}
+
+static void
+BenchmarkNodeAttributes(directory_which which)
+{
+	// reads what a new pose needs from every node in the apps folder
+	// or the large directory benchmark folder, the way Model and
+	// ReadPoseInfo used to and through NodeAttributes; run once before
+	// timing so both go against a warm cache
+	BPath path;
+	if (find_directory(which, &path) != B_OK)
+		return;
+
+	if (which == B_COMMON_TEMP_DIRECTORY)
+		path.Append("tracker benchmark folder");
+
+	BDirectory dir(path.Path());
+	if (dir.InitCheck() != B_OK)
+		return;
+
+	for (int32 pass = 0; pass < 3; pass++) {
+		bool batched = pass == 2;
+		int32 count = 0;
+
+		dir.Rewind();
+		BStopWatch watch("", true);
+		BEntry entry;
+		while (dir.GetNextEntry(&entry) == B_OK) {
+			BNode node(&entry);
+			if (node.InitCheck() != B_OK)
+				continue;
+
+			count++;
+			if (batched) {
+				NodeAttributes attributes(kPoseInfoAttribute | kTypeAttribute
+					| kPreferredAppAttribute | kAppSignatureAttribute
+					| kIconAttributes);
+				attributes.Read(&node);
+				continue;
+			}
+
+			char type[B_MIME_TYPE_LENGTH];
+			BNodeInfo info(&node);
+			CheckNodeIconHintPrivate(&node, false);
+			if (info.GetType(type) == B_OK)
+				info.GetPreferredApp(type);
+			node.ReadAttr(kAttrAppSignature, B_MIME_STRING_TYPE, 0, type,
+				B_MIME_TYPE_LENGTH);
+
+			PoseInfo poseInfo;
+			ReadAttr(&node, kAttrPoseInfo, kAttrPoseInfoForeign, B_RAW_TYPE, 0,
+				&poseInfo, sizeof(poseInfo), &PoseInfo::EndianSwap);
+		}
+
+		if (pass > 0) {
+			printf("NodeAttributes: %s, %ld nodes, %s: %Ld us\n", path.Path(),
+				count, batched ? "batched" : "one by one", watch.ElapsedTime());
+		}
+	}
+}
+
+const int32 kBenchmarkWindowStateRounds = 1000;
+
+static void
+BenchmarkWindowState()
+{
+	// saves a window state with a dozen columns to a folder both ways
+	// and restores it from the separate attributes through the attribute
+	// stream, like windows used to, and from the single record
+	BPath path;
+	if (find_directory(B_COMMON_TEMP_DIRECTORY, &path) != B_OK)
+		return;
+
+	path.Append("tracker window state benchmark");
+	BDirectory dir;
+	if (create_directory(path.Path(), 0755) != B_OK
+		|| dir.SetTo(path.Path()) != B_OK)
+		return;
+
+	BRect frame(100, 100, 600, 400);
+	uint32 workspaces = 1;
+	BViewState viewState;
+	BObjectList<BColumn> columns(12, true);
+	for (int32 index = 0; index < 12; index++) {
+		char title[32];
+		sprintf(title, "Column %ld", index);
+		columns.AddItem(new BColumn(title, 50 + index * 100, 90, B_ALIGN_LEFT,
+			index == 0 ? kAttrStatName : title, B_STRING_TYPE, index == 0,
+			true));
+	}
+
+	AttributeStreamFileNode streamNode(&dir);
+	BMallocIO stream;
+	WindowStateArchive archive;
+	for (int32 index = 0; index < columns.CountItems(); index++) {
+		columns.ItemAt(index)->ArchiveToStream(&stream);
+		archive.AddColumn(columns.ItemAt(index));
+	}
+	streamNode.Write(kAttrColumns, kAttrColumnsForeign, B_RAW_TYPE,
+		stream.Position(), stream.Buffer());
+
+	stream.Seek(0, SEEK_SET);
+	viewState.ArchiveToStream(&stream);
+	streamNode.Write(kAttrViewState, kAttrViewStateForeign, B_RAW_TYPE,
+		stream.Position(), stream.Buffer());
+	streamNode.Write(kAttrWindowFrame, 0, B_RECT_TYPE, sizeof(BRect), &frame);
+	streamNode.Write(kAttrWindowWorkspace, 0, B_INT32_TYPE, sizeof(uint32),
+		&workspaces);
+
+	archive.SetFrame(frame);
+	archive.SetWorkspaces(workspaces);
+	archive.SetViewState(&viewState);
+	if (archive.WriteTo(&dir, kAttrWindowState) != B_OK)
+		return;
+
+	for (int32 pass = 0; pass < 2; pass++) {
+		bool flat = pass != 0;
+		BStopWatch watch("", true);
+		for (int32 round = 0; round < kBenchmarkWindowStateRounds; round++) {
+			BObjectList<BColumn> restored(12, true);
+			BViewState *restoredState = NULL;
+
+			if (flat) {
+				WindowStateArchive restoredArchive;
+				if (restoredArchive.ReadFrom(&dir, kAttrWindowState) != B_OK)
+					break;
+				restoredArchive.GetFrame(&frame);
+				restoredArchive.GetWorkspaces(&workspaces);
+				restoredArchive.InstantiateColumns(&restored);
+				restoredState = restoredArchive.InstantiateViewState();
+			} else {
+				// what the AttributeStreamNode versions of RestoreWindowState
+				// and RestoreState do, minus the foreign attribute fallback
+				streamNode.Read(kAttrWindowFrame, 0, B_RECT_TYPE, sizeof(BRect),
+					&frame);
+				streamNode.Read(kAttrWindowWorkspace, 0, B_INT32_TYPE,
+					sizeof(uint32), &workspaces);
+
+				const char *names[] = { kAttrColumns, kAttrViewState };
+				for (int32 index = 0; index < 2; index++) {
+					size_t size = (size_t)streamNode.Contains(names[index],
+						B_RAW_TYPE);
+					char *buffer = new char[size];
+					streamNode.Read(names[index], 0, B_RAW_TYPE, size, buffer);
+					BMallocIO restoredStream;
+					restoredStream.WriteAt(0, buffer, size);
+					restoredStream.Seek(0, SEEK_SET);
+					delete [] buffer;
+
+					if (index == 0) {
+						for (;;) {
+							BColumn *column = BColumn::InstantiateFromStream(
+								&restoredStream);
+							if (!column)
+								break;
+							restored.AddItem(column);
+						}
+					} else {
+						restoredState = BViewState::InstantiateFromStream(
+							&restoredStream);
+					}
+				}
+			}
+
+			if (restored.CountItems() != columns.CountItems()
+				|| restoredState == NULL) {
+				printf("WindowState: restoring failed\n");
+				delete restoredState;
+				return;
+			}
+			delete restoredState;
+		}
+
+		printf("WindowState: %ld restores, %s: %Ld us\n",
+			kBenchmarkWindowStateRounds,
+			flat ? "single record" : "attribute stream", watch.ElapsedTime());
+	}
+}
+
+static void
+BenchmarkPoseMerging(BPoseView *poseView)
+{
+	// inserts 100k poses into a sorted list of 100k, in chunks the size
+	// AddPosesTask hands out, one by one and merged
+	const int32 kChunkSize = 512;
+
+	PoseList poses(kBenchmarkPoseCount);
+	AddBenchmarkPoses(poseView, &poses, 0, kBenchmarkPoseCount);
+	poseView->SortPoseList(&poses);
+
+	PoseList newPoses(kBenchmarkPoseCount);
+	AddBenchmarkPoses(poseView, &newPoses, kBenchmarkPoseCount,
+		kBenchmarkPoseCount);
+
+	for (int32 pass = 0; pass < 2; pass++) {
+		bool merge = pass != 0;
+		PoseList list(poses);
+
+		BStopWatch watch("", true);
+		for (int32 first = 0; first < kBenchmarkPoseCount; first += kChunkSize) {
+			int32 last = min_c(first + kChunkSize, kBenchmarkPoseCount);
+			if (merge) {
+				PoseList chunk(kChunkSize);
+				for (int32 index = first; index < last; index++)
+					chunk.AddItem(newPoses.ItemAt(index));
+
+				poseView->MergePoseList(&list, &chunk);
+				continue;
+			}
+
+			for (int32 index = first; index < last; index++) {
+				// what BSearchList and AddItem used to do for every pose
+				BPose *pose = newPoses.ItemAt(index);
+				int32 from = 0;
+				int32 to = list.CountItems();
+				while (from < to) {
+					int32 middle = (from + to) / 2;
+					if (CompareBenchmarkPoses(pose, list.ItemAt(middle),
+							poseView) > 0)
+						from = middle + 1;
+					else
+						to = middle;
+				}
+				list.AddItem(pose, from);
+			}
+		}
+
+		printf("PoseMerge: %ld poses into %ld, %s: %Ld ms\n",
+			kBenchmarkPoseCount, kBenchmarkPoseCount,
+			merge ? "merged" : "one by one", watch.ElapsedTime() / 1000);
+	}
+
+	for (int32 index = 0; index < kBenchmarkPoseCount; index++) {
+		delete poses.ItemAt(index);
+		delete newPoses.ItemAt(index);
+	}
+}
+
+class BenchmarkCopyLoopControl : public CopyLoopControl {
+	// copies without asking, counts how often the status would be updated
+	public:
+		BenchmarkCopyLoopControl()
+			:	fStatusUpdates(0)
+		{
+		}
+
+		virtual bool FileError(const char *message, const char *name,
+			status_t error, bool)
+		{
+			printf("Copy: %s %s: %s\n", message, name, strerror(error));
+			return false;
+		}
+
+		virtual void UpdateStatus(const char *, entry_ref, int32, bool)
+		{
+			fStatusUpdates++;
+		}
+
+		virtual bool CheckUserCanceled()
+		{
+			return false;
+		}
+
+		virtual OverwriteMode OverwriteOnConflict(const BEntry *, const char *,
+			const BDirectory *, bool, bool)
+		{
+			return kReplace;
+		}
+
+		virtual bool SkipEntry(const BEntry *, bool)
+		{
+			return false;
+		}
+
+		int32 fStatusUpdates;
+};
+
+const int32 kBenchmarkSmallFileCount = 200000;
+const int32 kBenchmarkFilesPerFolder = 1000;
+const off_t kBenchmarkLargeFileSize = 20LL * 1024 * 1024 * 1024;
+
+
+static status_t
+RemoveBenchmarkTree(BEntry *entry)
+{
+	if (entry->IsDirectory()) {
+		BDirectory dir(entry);
+		BEntry child;
+		while (dir.GetNextEntry(&child) == B_OK) {
+			status_t result = RemoveBenchmarkTree(&child);
+			if (result != B_OK)
+				return result;
+		}
+	}
+	return entry->Remove();
+}
+
+
+static bool
+MakeBenchmarkCopySources(BDirectory *dir)
+{
+	// creates the source files the first time around; 200 folders with
+	// 1000 files of up to 4 KB each, and one 20 GB file
+	char buffer[64 * 1024];
+	for (uint32 index = 0; index < sizeof(buffer); index++)
+		buffer[index] = (char)rand();
+
+	BDirectory smallFiles;
+	if (dir->CreateDirectory("small files", &smallFiles) == B_OK) {
+		BDirectory folder;
+		for (int32 index = 0; index < kBenchmarkSmallFileCount; index++) {
+			char name[B_FILE_NAME_LENGTH];
+			if (index % kBenchmarkFilesPerFolder == 0) {
+				sprintf(name, "folder %ld", index / kBenchmarkFilesPerFolder);
+				if (smallFiles.CreateDirectory(name, &folder) != B_OK)
+					return false;
+			}
+
+			sprintf(name, "file %ld", index);
+			BFile file(&folder, name, B_CREATE_FILE | B_WRITE_ONLY);
+			if (file.InitCheck() != B_OK
+				|| file.Write(buffer, 1 + rand() % 4096) < 0)
+				return false;
+		}
+	}
+
+	BEntry largeFile(dir, "large file");
+	if (!largeFile.Exists()) {
+		node_ref node;
+		dir->GetNodeRef(&node);
+		BVolume volume(node.device);
+		if (volume.FreeBytes() < 3 * kBenchmarkLargeFileSize) {
+			printf("Copy: not enough space for the large file benchmark\n");
+			return true;
+		}
+
+		BFile file(dir, "large file", B_CREATE_FILE | B_WRITE_ONLY);
+		for (off_t size = 0; size < kBenchmarkLargeFileSize;
+				size += sizeof(buffer)) {
+			if (file.Write(buffer, sizeof(buffer)) != sizeof(buffer))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+static void
+BenchmarkCopy()
+{
+	// copies the small files and the large file with the old copy loop,
+	// file by file, and with the pooled, read ahead one and small files
+	// batched; twice each and alternating
+	BPath path;
+	if (find_directory(B_COMMON_TEMP_DIRECTORY, &path) != B_OK)
+		return;
+
+	path.Append("tracker copy benchmark");
+	BDirectory dir;
+	if (create_directory(path.Path(), 0755) != B_OK
+		|| dir.SetTo(path.Path()) != B_OK
+		|| !MakeBenchmarkCopySources(&dir))
+		return;
+
+	const char *sources[] = { "small files", "large file" };
+	for (uint32 source = 0; source < sizeof(sources) / sizeof(sources[0]);
+			source++) {
+		for (int32 pass = 0; pass < 4; pass++) {
+			bool legacy = (pass & 1) == 0;
+			BEntry entry(&dir, sources[source]);
+			if (!entry.Exists())
+				continue;
+
+			BDirectory destDir;
+			BEntry destEntry(&dir, "copy");
+			if (destEntry.Exists())
+				RemoveBenchmarkTree(&destEntry);
+			if (dir.CreateDirectory("copy", &destDir) != B_OK)
+				return;
+
+			BenchmarkCopyLoopControl loopControl;
+			BStopWatch watch("", true);
+			status_t result = FSBenchmarkCopy(&entry, &destDir, &loopControl,
+				legacy);
+			bigtime_t elapsed = watch.ElapsedTime();
+
+			printf("Copy: %s, %s loop: %Ld ms, %ld status updates%s\n",
+				sources[source], legacy ? "old" : "new", elapsed / 1000,
+				loopControl.fStatusUpdates, result != B_OK ? " (failed)" : "");
+
+			destEntry.SetTo(&dir, "copy");
+			RemoveBenchmarkTree(&destEntry);
+		}
+	}
+}
+
+const int32 kBenchmarkConcurrentCopies = 16;
+
+struct ConcurrentCopyParams {
+	BEntry source;
+	BDirectory destDir;
+	off_t size;
+	status_t result;
+};
+
+
+static int32
+ConcurrentCopyThread(void *castToParams)
+{
+	// one copy operation with its own status view, the way
+	// CopyTask() sets them up
+	ConcurrentCopyParams *params = (ConcurrentCopyParams *)castToParams;
+	thread_id thread = find_thread(NULL);
+
+	entry_ref destRef;
+	BEntry destEntry;
+	params->destDir.GetEntry(&destEntry);
+	destEntry.GetRef(&destRef);
+
+	gStatusWindow->CreateStatusItem(thread, kCopyState);
+	gStatusWindow->InitStatusItem(thread, kBenchmarkFilesPerFolder,
+		params->size, &destRef);
+
+	TrackerCopyLoopControl loopControl(thread);
+	params->result = FSBenchmarkCopy(&params->source, &params->destDir,
+		&loopControl, false);
+
+	gStatusWindow->RemoveStatusItem(thread);
+	return 0;
+}
+
+
+static void
+BenchmarkConcurrentCopies()
+{
+	// runs 16 copies of the same folder of small files at once, each
+	// reporting to the status window; measures how much time the status
+	// window thread spends keeping up with them
+	if (gStatusWindow == NULL)
+		return;
+
+	BPath path;
+	if (find_directory(B_COMMON_TEMP_DIRECTORY, &path) != B_OK)
+		return;
+
+	path.Append("tracker copy benchmark");
+	BDirectory dir(path.Path());
+	BDirectory smallFiles(&dir, "small files");
+	BEntry source(&smallFiles, "folder 0");
+	if (!source.IsDirectory())
+		return;
+
+	off_t size = 0;
+	BDirectory sourceDir(&source);
+	BEntry entry;
+	while (sourceDir.GetNextEntry(&entry) == B_OK) {
+		off_t fileSize;
+		if (entry.GetSize(&fileSize) == B_OK)
+			size += fileSize;
+	}
+
+	ConcurrentCopyParams params[kBenchmarkConcurrentCopies];
+	thread_id threads[kBenchmarkConcurrentCopies];
+	for (int32 index = 0; index < kBenchmarkConcurrentCopies; index++) {
+		char name[B_FILE_NAME_LENGTH];
+		sprintf(name, "copy %ld", index);
+		BEntry destEntry(&dir, name);
+		if (destEntry.Exists())
+			RemoveBenchmarkTree(&destEntry);
+		if (dir.CreateDirectory(name, &params[index].destDir) != B_OK)
+			return;
+
+		params[index].source = source;
+		params[index].size = size;
+		params[index].result = B_OK;
+	}
+
+	thread_info info;
+	bigtime_t statusTime = 0;
+	if (get_thread_info(gStatusWindow->Thread(), &info) == B_OK)
+		statusTime = info.user_time + info.kernel_time;
+
+	BStopWatch watch("", true);
+	for (int32 index = 0; index < kBenchmarkConcurrentCopies; index++) {
+		threads[index] = spawn_thread(ConcurrentCopyThread, "copy benchmark",
+			B_NORMAL_PRIORITY, &params[index]);
+		resume_thread(threads[index]);
+	}
+
+	int32 failed = 0;
+	for (int32 index = 0; index < kBenchmarkConcurrentCopies; index++) {
+		status_t result;
+		wait_for_thread(threads[index], &result);
+		if (params[index].result != B_OK)
+			failed++;
+	}
+	bigtime_t elapsed = watch.ElapsedTime();
+
+	if (get_thread_info(gStatusWindow->Thread(), &info) == B_OK)
+		statusTime = info.user_time + info.kernel_time - statusTime;
+
+	printf("StatusWindow: %ld concurrent copies of %ld files: %Ld ms, "
+		"status window thread %Ld ms%s\n", kBenchmarkConcurrentCopies,
+		kBenchmarkFilesPerFolder, elapsed / 1000, statusTime / 1000,
+		failed ? " (failed)" : "");
+
+	for (int32 index = 0; index < kBenchmarkConcurrentCopies; index++) {
+		char name[B_FILE_NAME_LENGTH];
+		sprintf(name, "copy %ld", index);
+		BEntry destEntry(&dir, name);
+		RemoveBenchmarkTree(&destEntry);
+	}
+}
+
+}	// namespace BTrackerPrivate
+
+
+void
+RunPoseViewBenchmarks(BPoseView *poseView)
+{
+	BTrackerPrivate::BenchmarkPoseListLookups(poseView);
+	BTrackerPrivate::BenchmarkPoseSorting(poseView);
+	BTrackerPrivate::BenchmarkNameSorting();
+	BTrackerPrivate::BenchmarkTypeAhead(poseView);
+	BTrackerPrivate::BenchmarkRubberBandSelection();
+	BTrackerPrivate::BenchmarkListScrolling();
+	BTrackerPrivate::BenchmarkIconPlacement(poseView);
+	BTrackerPrivate::CheckViewModeHitTesting(poseView);
+	BTrackerPrivate::BenchmarkIconTransform(B_LARGE_ICON);
+	BTrackerPrivate::BenchmarkIconTransform(B_MINI_ICON);
+	BTrackerPrivate::PrintIconCacheStats();
+	BTrackerPrivate::BenchmarkNavListing();
+	BTrackerPrivate::PrintNavListingCacheStats();
+	BTrackerPrivate::BenchmarkPoseMerging(poseView);
+	BTrackerPrivate::BenchmarkOpenLargeDirectory();
+	BTrackerPrivate::BenchmarkNodeAttributes(B_APPS_DIRECTORY);
+	BTrackerPrivate::BenchmarkNodeAttributes(B_COMMON_TEMP_DIRECTORY);
+	BTrackerPrivate::BenchmarkWindowState();
+	BTrackerPrivate::BenchmarkCopy();
+	BTrackerPrivate::BenchmarkConcurrentCopies();
+}
+
 #endif
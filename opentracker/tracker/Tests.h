@@ -32,8 +32,14 @@ names are registered trademarks or trademarks of their respective holders.
 All rights reserved.
 */
 
+namespace BPrivate {
+class BPoseView;
+}
+
 #if DEBUG
 void RunIconCacheTests();
+void RunPoseViewBenchmarks(BPrivate::BPoseView *);
 #else
 inline void RunIconCacheTests() {}
+inline void RunPoseViewBenchmarks(BPrivate::BPoseView *) {}
 #endif
@@ -49,6 +49,7 @@ All rights reserved.
 #include "Commands.h"
 #include "FSUtils.h"
 #include "PoseView.h"
+#include "SlabAllocator.h"
 #include "TextWidget.h"
 #include "Utilities.h"
 #include "WidgetAttributeText.h"
@@ -57,6 +58,23 @@ All rights reserved.
 const float kWidthMargin = 20;
 
 
+static SlabAllocator sWidgetAllocator("widget allocator", sizeof(BTextWidget));
+
+
+void *
+BTextWidget::operator new(size_t size)
+{
+	return sWidgetAllocator.Allocate(size);
+}
+
+
+void
+BTextWidget::operator delete(void *widget)
+{
+	sWidgetAllocator.Free(widget);
+}
+
+
 BTextWidget::BTextWidget(Model *model, BColumn *column, BPoseView *view)
 	:
 	fText(WidgetAttributeText::NewWidgetText(model, column, view)),
@@ -83,6 +101,13 @@ BTextWidget::Compare(const BTextWidget &with, BPoseView *view) const
 }
 
 
+uint32
+BTextWidget::SortKey(int64 *scalar, const char **string) const
+{
+	return fText->SortKey(scalar, string);
+}
+
+
 void
 BTextWidget::RecalculateText(const BPoseView *view)
 {
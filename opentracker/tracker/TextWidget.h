@@ -49,6 +49,10 @@ public:
 	BTextWidget(Model *, BColumn *, BPoseView *);
 	virtual ~BTextWidget();
 
+	void *operator new(size_t);
+	void operator delete(void *);
+		// widgets come from a slab allocator, see SlabAllocator.h
+
 	void Draw(BRect widgetRect, BRect widgetTextRect, float width, BPoseView *,
 		bool selected, uint32 clipboardMode);
 	void Draw(BRect widgetRect, BRect widgetTextRect, float width, BPoseView *,
@@ -91,6 +95,9 @@ public:
 	float PreferredWidth(const BPoseView *) const;
 	int	Compare(const BTextWidget &, BPoseView *) const;
 		// used for sorting in PoseViews
+	uint32 SortKey(int64 *scalar, const char **string) const;
+		// compact form of the text for sorting, see
+		// WidgetAttributeText::SortKey
 
 	void RecalculateText(const BPoseView *view);
 	
@@ -52,6 +52,7 @@ All rights reserved.
 #include <Volume.h>
 #include <VolumeRoster.h>
 
+#include "AddOnRegistry.h"
 #include "Attributes.h"
 #include "AutoLock.h"
 #include "AutoMounter.h"
@@ -67,6 +68,7 @@ All rights reserved.
 #include "InfoWindow.h"
 #include "MimeTypes.h"
 #include "MimeTypeList.h"
+#include "NavListingCache.h"
 #include "NodePreloader.h"
 #include "OpenWithWindow.h"
 #include "PoseView.h"
@@ -139,10 +141,14 @@ InitIconPreloader()
 			&& !strcmp(info.signature, kDeskbarSignature))
 			preload = true;
 	}
-	if (preload)
+	if (preload) {
 		gPreloader = NodePreloader::InstallNodePreloader("NodePreloader", be_app);
+		NavListingCache::InstallNavListingCache("NavListingCache", be_app);
+	}
 
 	IconCache::sIconCache = new IconCache();
+	IconCache::sIconCache->SetNodeIconBudget(
+		(size_t)TrackerSettings().NodeIconCacheSize() * 1024);
 
 	atomic_add(&lock, -1);
 }
@@ -342,9 +348,18 @@ TTracker::Quit()
 	fTrashWatcher->Lock();
 	fTrashWatcher->Quit();
 
+	AddOnRegistry::sAddOnRegistry = NULL;
+	fAddOnRegistry->Lock();
+	fAddOnRegistry->Quit();
+
 	WellKnowEntryList::Quit();
 	
 	delete gPreloader;
+
+	NavListingCache *navListingCache = NavListingCache::sNavListingCache;
+	NavListingCache::sNavListingCache = NULL;
+	delete navListingCache;
+
 	delete fTaskLoop;
 	delete IconCache::sIconCache;
 
@@ -1205,6 +1220,10 @@ TTracker::ReadyToRun()
 	fTrashWatcher = new BTrashWatcher();
 	fTrashWatcher->Run();
 
+	fAddOnRegistry = new AddOnRegistry();
+	fAddOnRegistry->Run();
+	AddOnRegistry::sAddOnRegistry = fAddOnRegistry;
+
 	fClipboardRefsWatcher = new BClipboardRefsWatcher();
 	fClipboardRefsWatcher->Run();
 	
@@ -47,6 +47,7 @@ All rights reserved.
 
 namespace BPrivate {
 
+class AddOnRegistry;
 class AutoMounter;
 class BClipboardRefsWatcher;
 class BContainerWindow;
@@ -214,6 +215,7 @@ class TTracker : public BApplication {
 		WindowList fWindowList;
 		BClipboardRefsWatcher *fClipboardRefsWatcher;
 		BTrashWatcher *fTrashWatcher;
+		AddOnRegistry *fAddOnRegistry;
 		AutoMounter *fAutoMounter;
 		TaskLoop *fTaskLoop;
 		int32 fNodeMonitorCount;
@@ -33,6 +33,7 @@ All rights reserved.
 */
 
 
+#include "IconCache.h"
 #include "Tracker.h"
 #include "TrackerSettings.h"
 #include "WidgetAttributeText.h"
@@ -87,6 +88,9 @@ class TTrackerState : public Settings {
 		BooleanValueSetting *fDontMoveFilesToTrash;
 		BooleanValueSetting *fAskBeforeDeleteFile;
 
+		ScalarValueSetting *fModelWorkerCount;
+		ScalarValueSetting *fNodeIconCacheSize;
+
 		Benaphore fInitLock;
 		bool fInited;
 		bool fSettingsLoaded;
@@ -203,6 +207,10 @@ TTrackerState::LoadSettingsIfNeeded()
 	Add(fDontMoveFilesToTrash = new BooleanValueSetting("DontMoveFilesToTrash", false));
 	Add(fAskBeforeDeleteFile = new BooleanValueSetting("AskBeforeDeleteFile", true));
 
+	Add(fModelWorkerCount = new ScalarValueSetting("ModelWorkers", 4, "", "", 1, 16));
+	Add(fNodeIconCacheSize = new ScalarValueSetting("NodeIconCacheSize", 8192, "", "",
+		256, 1024 * 1024));
+
 	TryReadingSettings();
 
 	NameAttributeText::SetSortFolderNamesFirst(fSortFolderNamesFirst->Value());
@@ -580,3 +588,32 @@ TrackerSettings::SetAskBeforeDeleteFile(bool enabled)
 	gTrackerState.fAskBeforeDeleteFile->SetValue(enabled);
 }
 
+
+int32
+TrackerSettings::ModelWorkerCount()
+{
+	return gTrackerState.fModelWorkerCount->Value();
+}
+
+
+void
+TrackerSettings::SetModelWorkerCount(int32 count)
+{
+	gTrackerState.fModelWorkerCount->ValueChanged(count);
+}
+
+
+int32
+TrackerSettings::NodeIconCacheSize()
+{
+	return gTrackerState.fNodeIconCacheSize->Value();
+}
+
+
+void
+TrackerSettings::SetNodeIconCacheSize(int32 kilobytes)
+{
+	gTrackerState.fNodeIconCacheSize->ValueChanged(kilobytes);
+	if (IconCache::sIconCache)
+		IconCache::sIconCache->SetNodeIconBudget((size_t)kilobytes * 1024);
+}
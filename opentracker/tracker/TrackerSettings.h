@@ -126,6 +126,14 @@ class TrackerSettings {
 		bool AskBeforeDeleteFile();
 		void SetAskBeforeDeleteFile(bool);
 
+		int32 ModelWorkerCount();
+		void SetModelWorkerCount(int32);
+			// number of threads building models when a folder is opened
+		int32 NodeIconCacheSize();
+		void SetNodeIconCacheSize(int32);
+			// in kilobytes, icons nodes define themselves beyond that are
+			// dropped least recently used first
+
 	private:
 		//TTrackerState *fSettings;
 };
@@ -38,6 +38,7 @@ All rights reserved.
 #include <stdlib.h>
 #include <time.h>
 #include <stdarg.h>
+#include <stddef.h>
 
 #include <Bitmap.h>
 #include <Debug.h>
@@ -120,6 +121,125 @@ AttrHashString(const char *string, uint32 type)
 }
 
 
+// Mime types and app signatures are kept once per process; there are only
+// as many of them as there are types installed, so entries are never
+// removed and the pointers handed out stay valid for good. Every spelling
+// gets its own entry, the spellings of a type that only differ in case
+// share a key.
+
+struct InternedMimeString {
+	InternedMimeString *next;
+	uint32 hash;
+	const char *key;
+		// the first spelling of this type that got interned
+	char string[1];
+};
+
+const int32 kInternedMimeStringSlots = 512;
+
+static InternedMimeString *sInternedMimeStrings[kInternedMimeStringSlots];
+static Benaphore sInternedMimeStringLock("interned mime strings");
+static const char *kEmptyMimeString = "";
+
+
+static uint32
+HashMimeString(const char *string)
+{
+	// case insensitive flavor of HashString
+	char ch;
+	uint32 result = 0;
+
+	while((ch = *string++) != 0) {
+		result = (result << 7) ^ (result >> 24);
+		result ^= tolower((uint8)ch);
+	}
+
+	result ^= result << 12;
+	return result;
+}
+
+
+static const char *
+LookupMimeString(const char *string, bool add, bool returnKey)
+{
+	if (!string || !string[0])
+		return kEmptyMimeString;
+
+	uint32 hash = HashMimeString(string);
+	InternedMimeString **slot
+		= &sInternedMimeStrings[hash % kInternedMimeStringSlots];
+
+	const char *result = NULL;
+	const char *key = NULL;
+	sInternedMimeStringLock.Lock();
+
+	// all spellings of a type hash the same and end up in one slot
+	for (InternedMimeString *entry = *slot; entry; entry = entry->next) {
+		if (entry->hash != hash || strcasecmp(entry->string, string) != 0)
+			continue;
+
+		key = entry->key;
+		if (returnKey) {
+			result = key;
+			break;
+		}
+		if (strcmp(entry->string, string) == 0) {
+			result = entry->string;
+			break;
+		}
+	}
+
+	if (!result && add) {
+		int32 length = (int32)strlen(string);
+		InternedMimeString *entry = (InternedMimeString *)
+			new char [sizeof(InternedMimeString) + length];
+		entry->hash = hash;
+		memcpy(entry->string, string, length + 1);
+		entry->key = key ? key : entry->string;
+		entry->next = *slot;
+		*slot = entry;
+		result = entry->string;
+	}
+
+	sInternedMimeStringLock.Unlock();
+	return result;
+}
+
+
+const char *
+InternMimeString(const char *string)
+{
+	return LookupMimeString(string, true, false);
+}
+
+
+const char *
+FindInternedMimeString(const char *string)
+{
+	return LookupMimeString(string, false, false);
+}
+
+
+const char *
+MimeStringKey(const char *interned)
+{
+	if (!interned[0])
+		return kEmptyMimeString;
+
+	// the key doesn't change once the entry is in the table, no need
+	// to lock
+	return ((const InternedMimeString *)(interned
+		- offsetof(InternedMimeString, string)))->key;
+}
+
+
+const char *
+FindMimeStringKey(const char *string)
+{
+	return LookupMimeString(string, false, true);
+}
+
+
 bool
 ValidateStream(BMallocIO *stream, uint32 key, int32 version)
 {
@@ -1112,6 +1232,107 @@ TruncateLeaf(BString *string)
 }
 
 
+// base characters for U+00C0 - U+00FF, used for the primary collation key;
+// the upper and lower case ranges only differ in 0xd7/0xf7 and 0xdf/0xff
+static const uint8 kBaseCharacters[] = {
+	'a', 'a', 'a', 'a', 'a', 'a', 'a', 'c',
+	'e', 'e', 'e', 'e', 'i', 'i', 'i', 'i',
+	0xf0, 'n', 'o', 'o', 'o', 'o', 'o', 0xd7,
+	'o', 'u', 'u', 'u', 'u', 'y', 0xfe, 0xdf,
+	'a', 'a', 'a', 'a', 'a', 'a', 'a', 'c',
+	'e', 'e', 'e', 'e', 'i', 'i', 'i', 'i',
+	0xf0, 'n', 'o', 'o', 'o', 'o', 'o', 0xf7,
+	'o', 'u', 'u', 'u', 'u', 'y', 0xfe, 'y'
+};
+
+
+static inline bool
+IsLatin1Character(const char *string)
+{
+	// U+00C0 - U+00FF are encoded as 0xc3 0x80 - 0xc3 0xbf
+	return (uint8)string[0] == 0xc3 && ((uint8)string[1] & 0xc0) == 0x80;
+}
+
+
+static char *
+PutUTF8Latin1(char *dest, uint8 character)
+{
+	if (character < 0x80) {
+		*dest++ = character;
+		return dest;
+	}
+
+	*dest++ = 0xc0 | (character >> 6);
+	*dest++ = 0x80 | (character & 0x3f);
+	return dest;
+}
+
+
+int32
+FoldCase(const char *string, char *buffer)
+{
+	// U+00C0 - U+00DE fold to U+00E0 - U+00FE, except for U+00D7, which
+	// isn't a letter; the result is exactly as long as <string>
+	char *dest = buffer;
+	for (const char *src = string; *src; ) {
+		if (IsLatin1Character(src)) {
+			uint8 character = 0xc0 | (src[1] & 0x3f);
+			if (character < 0xdf && character != 0xd7)
+				character += 0x20;
+			dest = PutUTF8Latin1(dest, character);
+			src += 2;
+		} else
+			*dest++ = tolower((uint8)*src++);
+	}
+	*dest = '\0';
+
+	return dest - buffer;
+}
+
+
+void
+GetCollationKey(const char *string, BString *key)
+{
+	// The key consists of three levels, separated by '\01':
+	// - the string folded to lower case, accents removed, 'ß' as "ss"
+	// - the string folded to lower case
+	// - the string itself
+	// All levels are always there, leaving one out would turn the key
+	// into a prefix of others and sort it before them ("abc" before "Abc").
+
+	int32 length = strlen(string);
+	char *buffer = key->LockBuffer(3 * length + 2);
+	if (!buffer) {
+		key->SetTo(string);
+		return;
+	}
+
+	char *dest = buffer;
+	for (const char *src = string; *src; ) {
+		if (IsLatin1Character(src)) {
+			uint8 character = 0xc0 | (src[1] & 0x3f);
+			if (character == 0xdf) {
+				*dest++ = 's';
+				*dest++ = 's';
+			} else
+				dest = PutUTF8Latin1(dest, kBaseCharacters[character - 0xc0]);
+			src += 2;
+		} else
+			*dest++ = tolower((uint8)*src++);
+	}
+
+	*dest++ = '\01';
+	dest += FoldCase(string, dest);
+
+	*dest++ = '\01';
+	memcpy(dest, string, length);
+	dest += length;
+	*dest = '\0';
+
+	key->UnlockBuffer(dest - buffer);
+}
+
+
 int64
 StringToScalar(const char *text)
 {
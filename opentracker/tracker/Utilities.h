@@ -142,6 +142,20 @@ bool ValidateStream(BMallocIO *, uint32, int32 version);
 uint32 HashString(const char *string, uint32 seed);
 uint32 AttrHashString(const char *string, uint32 type);
 
+const char *InternMimeString(const char *string);
+	// returns the process-wide copy of a mime type or app signature,
+	// spelled just like <string>; interned strings can be compared by
+	// pointer. NULL maps to an empty string
+const char *FindInternedMimeString(const char *string);
+	// same as above, but returns NULL instead of adding <string>
+	// if it hasn't been interned yet
+const char *MimeStringKey(const char *interned);
+	// returns the same pointer for all interned spellings of a type that
+	// only differ in case, for comparing types the way BMimeType does
+const char *FindMimeStringKey(const char *string);
+	// the key of <string> without interning it, NULL if no spelling of
+	// it has been interned yet
+
 
 class OffscreenBitmap {
 	// a utility class for setting up offscreen bitmaps
@@ -410,6 +424,15 @@ int64 StringToScalar(const char *text);
 void EmbedUniqueVolumeInfo(BMessage *, const BVolume *);
 status_t MatchArchivedVolume(BVolume *, const BMessage *, int32 index = 0);
 void TruncateLeaf(BString *string);
+int32 FoldCase(const char *string, char *buffer);
+	// folds <string> to lower case, accented Latin-1 letters included, into
+	// <buffer>, which may be <string> itself; the result has the same
+	// length, which is returned
+void GetCollationKey(const char *string, BString *key);
+	// builds a key that, compared with strcmp, orders strings
+	// case-insensitive with accented characters next to their base
+	// characters; case and accents only decide between otherwise equal
+	// strings
 
 void StringFromStream(BString *, BMallocIO *, bool endianSwap = false);
 void StringToStream(const BString *, BMallocIO *);
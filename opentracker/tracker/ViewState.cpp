@@ -34,7 +34,9 @@ All rights reserved.
 
 #include <Debug.h>
 #include <AppDefs.h>
+#include <ByteOrder.h>
 #include <InterfaceDefs.h>
+#include <Node.h>
 
 #include "Attributes.h"
 #include "Commands.h"
@@ -411,3 +413,291 @@ BViewState::_Sanitize(BViewState *state, bool fixOnly)
 	return state;
 }
 
+
+//	#pragma mark -
+
+
+const uint32 kWindowStateMagic = 'TWst';
+const size_t kMaxWindowStateSize = 10000;
+	// protects against munged attributes, like the stream readers do
+
+
+WindowStateArchive::WindowStateArchive()
+	:
+	fBuffer(NULL)
+{
+	memset(&fHeader, 0, sizeof(fHeader));
+	fHeader.fMagic = kWindowStateMagic;
+	fHeader.fVersion = kWindowStateArchiveVersion;
+
+	// make room for the header, the columns follow it
+	fData.Write(&fHeader, sizeof(fHeader));
+}
+
+
+WindowStateArchive::~WindowStateArchive()
+{
+	free(fBuffer);
+}
+
+
+status_t
+WindowStateArchive::ReadFrom(const BNode *node, const char *attributeName)
+{
+	free(fBuffer);
+	fBuffer = (char *)malloc(kMaxWindowStateSize);
+	if (fBuffer == NULL)
+		return B_NO_MEMORY;
+
+	// no need to ask for the size first, a record that doesn't fit
+	// won't match the size it claims to have
+	ssize_t size = node->ReadAttr(attributeName, B_RAW_TYPE, 0, fBuffer,
+		kMaxWindowStateSize);
+
+	status_t result = B_OK;
+	if (size < 0)
+		result = (status_t)size;
+	else if (size < (ssize_t)sizeof(Header))
+		result = B_BAD_DATA;
+	else {
+		uint32 magic = ((Header *)fBuffer)->fMagic;
+		if (magic == kWindowStateMagic) {
+			if (!Validate((size_t)size, false))
+				result = B_BAD_DATA;
+		} else if (magic == B_SWAP_INT32(kWindowStateMagic)) {
+			PRINT(("endian swapping window state\n"));
+			if (!Validate((size_t)size, true))
+				result = B_BAD_DATA;
+		} else
+			result = B_BAD_DATA;
+	}
+
+	if (result != B_OK) {
+		free(fBuffer);
+		fBuffer = NULL;
+	}
+	return result;
+}
+
+
+status_t
+WindowStateArchive::WriteTo(BNode *node, const char *attributeName)
+{
+	fHeader.fSize = fData.BufferLength();
+	fData.WriteAt(0, &fHeader, sizeof(fHeader));
+
+	ssize_t result = node->WriteAttr(attributeName, B_RAW_TYPE, 0,
+		fData.Buffer(), fHeader.fSize);
+	if (result < 0)
+		return (status_t)result;
+
+	return result == (ssize_t)fHeader.fSize ? B_OK : B_ERROR;
+}
+
+
+size_t
+WindowStateArchive::ColumnSize(const Column *column)
+{
+	return (sizeof(Column) + column->fTitleLength + column->fAttrNameLength
+		+ 3) & ~3;
+}
+
+
+bool
+WindowStateArchive::Validate(size_t size, bool endianSwap)
+{
+	Header *header = (Header *)fBuffer;
+	if (endianSwap) {
+		header->fVersion = B_SWAP_INT32(header->fVersion);
+		header->fSize = B_SWAP_INT32(header->fSize);
+		header->fFlags = B_SWAP_INT32(header->fFlags);
+		swap_data(B_RECT_TYPE, &header->fFrame, sizeof(BRect), B_SWAP_ALWAYS);
+		header->fWorkspaces = B_SWAP_INT32(header->fWorkspaces);
+		header->fViewMode = B_SWAP_INT32(header->fViewMode);
+		header->fLastIconMode = B_SWAP_INT32(header->fLastIconMode);
+		swap_data(B_POINT_TYPE, &header->fListOrigin, sizeof(BPoint),
+			B_SWAP_ALWAYS);
+		swap_data(B_POINT_TYPE, &header->fIconOrigin, sizeof(BPoint),
+			B_SWAP_ALWAYS);
+		header->fPrimarySortAttr = B_SWAP_INT32(header->fPrimarySortAttr);
+		header->fPrimarySortType = B_SWAP_INT32(header->fPrimarySortType);
+		header->fSecondarySortAttr = B_SWAP_INT32(header->fSecondarySortAttr);
+		header->fSecondarySortType = B_SWAP_INT32(header->fSecondarySortType);
+		header->fColumnCount = B_SWAP_INT32(header->fColumnCount);
+	}
+
+	if (header->fVersion != kWindowStateArchiveVersion
+		|| header->fSize != size
+		|| header->fColumnCount < 0)
+		return false;
+
+	// walk the columns, they have to fill the rest exactly
+	size_t offset = sizeof(Header);
+	for (int32 index = 0; index < header->fColumnCount; index++) {
+		if (offset + sizeof(Column) > size)
+			return false;
+
+		Column *column = (Column *)(fBuffer + offset);
+		if (endianSwap) {
+			column->fOffset = B_SWAP_FLOAT(column->fOffset);
+			column->fWidth = B_SWAP_FLOAT(column->fWidth);
+			column->fAlignment = B_SWAP_INT32(column->fAlignment);
+			column->fAttrHash = B_SWAP_INT32(column->fAttrHash);
+			column->fAttrType = B_SWAP_INT32(column->fAttrType);
+			column->fTitleLength = B_SWAP_INT16(column->fTitleLength);
+			column->fAttrNameLength = B_SWAP_INT16(column->fAttrNameLength);
+		}
+
+		offset += ColumnSize(column);
+		if (offset > size)
+			return false;
+	}
+
+	return offset == size;
+}
+
+
+bool
+WindowStateArchive::GetFrame(BRect *frame) const
+{
+	const Header *header = (const Header *)fBuffer;
+	if (header == NULL || (header->fFlags & kHasFrame) == 0)
+		return false;
+
+	*frame = header->fFrame;
+	return true;
+}
+
+
+bool
+WindowStateArchive::GetWorkspaces(uint32 *workspaces) const
+{
+	const Header *header = (const Header *)fBuffer;
+	if (header == NULL || (header->fFlags & kHasWorkspaces) == 0)
+		return false;
+
+	*workspaces = header->fWorkspaces;
+	return true;
+}
+
+
+BViewState *
+WindowStateArchive::InstantiateViewState() const
+{
+	const Header *header = (const Header *)fBuffer;
+	if (header == NULL || (header->fFlags & kHasViewState) == 0)
+		return NULL;
+
+	BViewState *state = new (std::nothrow) BViewState;
+	if (state == NULL)
+		return NULL;
+
+	state->fViewMode = header->fViewMode;
+	state->fLastIconMode = header->fLastIconMode;
+	state->fListOrigin = header->fListOrigin;
+	state->fIconOrigin = header->fIconOrigin;
+	state->fPrimarySortAttr = header->fPrimarySortAttr;
+	state->fPrimarySortType = header->fPrimarySortType;
+	state->fSecondarySortAttr = header->fSecondarySortAttr;
+	state->fSecondarySortType = header->fSecondarySortType;
+	state->fReverseSort = header->fReverseSort != 0;
+	state->fStateNeedsSaving = false;
+
+	BViewState::_Sanitize(state, true);
+	return BViewState::_Sanitize(state);
+}
+
+
+void
+WindowStateArchive::InstantiateColumns(BObjectList<BColumn> *list) const
+{
+	const Header *header = (const Header *)fBuffer;
+	if (header == NULL)
+		return;
+
+	const char *data = fBuffer + sizeof(Header);
+	for (int32 index = 0; index < header->fColumnCount; index++) {
+		const Column *flat = (const Column *)data;
+		const char *title = data + sizeof(Column);
+		data += ColumnSize(flat);
+
+		BColumn *column = new (std::nothrow) BColumn("", flat->fOffset,
+			flat->fWidth, (alignment)flat->fAlignment, "", flat->fAttrType,
+			flat->fStatField != 0, flat->fEditable != 0);
+		if (column == NULL)
+			break;
+
+		column->fTitle.SetTo(title, flat->fTitleLength);
+		column->fAttrName.SetTo(title + flat->fTitleLength,
+			flat->fAttrNameLength);
+		column->fAttrHash = flat->fAttrHash;
+
+		column = BColumn::_Sanitize(column);
+		if (column == NULL)
+			break;
+
+		list->AddItem(column);
+	}
+}
+
+
+void
+WindowStateArchive::SetFrame(BRect frame)
+{
+	fHeader.fFrame = frame;
+	fHeader.fFlags |= kHasFrame;
+}
+
+
+void
+WindowStateArchive::SetWorkspaces(uint32 workspaces)
+{
+	fHeader.fWorkspaces = workspaces;
+	fHeader.fFlags |= kHasWorkspaces;
+}
+
+
+void
+WindowStateArchive::SetViewState(const BViewState *state)
+{
+	fHeader.fViewMode = state->fViewMode;
+	fHeader.fLastIconMode = state->fLastIconMode;
+	fHeader.fListOrigin = state->fListOrigin;
+	fHeader.fIconOrigin = state->fIconOrigin;
+	fHeader.fPrimarySortAttr = state->fPrimarySortAttr;
+	fHeader.fPrimarySortType = state->fPrimarySortType;
+	fHeader.fSecondarySortAttr = state->fSecondarySortAttr;
+	fHeader.fSecondarySortType = state->fSecondarySortType;
+	fHeader.fReverseSort = state->fReverseSort;
+	fHeader.fFlags |= kHasViewState;
+}
+
+
+void
+WindowStateArchive::AddColumn(const BColumn *column)
+{
+	if (column->fTitle.Length() > 0xffff || column->fAttrName.Length() > 0xffff)
+		return;
+
+	Column flat;
+	memset(&flat, 0, sizeof(flat));
+	flat.fOffset = column->fOffset;
+	flat.fWidth = column->fWidth;
+	flat.fAlignment = column->fAlignment;
+	flat.fAttrHash = column->fAttrHash;
+	flat.fAttrType = column->fAttrType;
+	flat.fTitleLength = (uint16)column->fTitle.Length();
+	flat.fAttrNameLength = (uint16)column->fAttrName.Length();
+	flat.fStatField = column->fStatField;
+	flat.fEditable = column->fEditable;
+
+	fData.Write(&flat, sizeof(flat));
+	fData.Write(column->fTitle.String(), flat.fTitleLength);
+	fData.Write(column->fAttrName.String(), flat.fAttrNameLength);
+
+	const uint32 kPadding = 0;
+	fData.Write(&kPadding, ColumnSize(&flat) - sizeof(flat)
+		- flat.fTitleLength - flat.fAttrNameLength);
+
+	fHeader.fColumnCount++;
+}
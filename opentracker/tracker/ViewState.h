@@ -36,11 +36,17 @@ All rights reserved.
 
 
 #include <DataIO.h>
+#include <Rect.h>
 #include <String.h>
 
+#include "ObjectList.h"
+
+class BNode;
 
 namespace BPrivate {
 
+class WindowStateArchive;
+
 const int32 kColumnStateArchiveVersion = 21;
 	// bump version when layout or size changes
 
@@ -76,6 +82,8 @@ class BColumn {
 	private:
 		static BColumn *_Sanitize(BColumn *column);
 
+		friend class WindowStateArchive;
+
 		BString fTitle;
 		float fOffset;
 		float fWidth;
@@ -128,6 +136,8 @@ class BViewState {
 	private:
 		static BViewState *_Sanitize(BViewState *state, bool fixOnly = false);
 
+		friend class WindowStateArchive;
+
 		uint32 fViewMode;
 		uint32 fLastIconMode;
 		BPoint fListOrigin;
@@ -141,6 +151,89 @@ class BViewState {
 };
 
 
+const int32 kWindowStateArchiveVersion = 3;
+	// bump version when layout or size changes
+
+class WindowStateArchive {
+	// the frame, workspaces, view state and columns of a window as one
+	// flat record, stored in a single attribute in the byte order of
+	// the writer and tagged with it; it is read with one attribute read
+	// and used in place. The separate attributes BViewState and BColumn
+	// stream themselves to remain the compatibility format
+	public:
+		WindowStateArchive();
+		~WindowStateArchive();
+
+		status_t ReadFrom(const BNode *, const char *attributeName);
+			// validates the record and swaps it in place if it was written
+			// with the other endianness
+		status_t WriteTo(BNode *, const char *attributeName);
+
+		// valid after a successful ReadFrom
+		bool GetFrame(BRect *) const;
+		bool GetWorkspaces(uint32 *) const;
+		BViewState *InstantiateViewState() const;
+		void InstantiateColumns(BObjectList<BColumn> *) const;
+
+		// collect the state for WriteTo
+		void SetFrame(BRect);
+		void SetWorkspaces(uint32);
+		void SetViewState(const BViewState *);
+		void AddColumn(const BColumn *);
+
+	private:
+		enum {
+			kHasFrame = 0x1,
+			kHasWorkspaces = 0x2,
+			kHasViewState = 0x4
+		};
+
+		struct Header {
+			uint32 fMagic;
+			int32 fVersion;
+			uint32 fSize;
+			uint32 fFlags;
+			BRect fFrame;
+			uint32 fWorkspaces;
+			uint32 fViewMode;
+			uint32 fLastIconMode;
+			BPoint fListOrigin;
+			BPoint fIconOrigin;
+			uint32 fPrimarySortAttr;
+			uint32 fPrimarySortType;
+			uint32 fSecondarySortAttr;
+			uint32 fSecondarySortType;
+			uint8 fReverseSort;
+			uint8 fUnused[3];
+			int32 fColumnCount;
+		};
+
+		struct Column {
+			float fOffset;
+			float fWidth;
+			int32 fAlignment;
+			uint32 fAttrHash;
+			uint32 fAttrType;
+			uint16 fTitleLength;
+			uint16 fAttrNameLength;
+			uint8 fStatField;
+			uint8 fEditable;
+			uint8 fUnused[2];
+			// followed by the title and the attribute name, not terminated,
+			// padded to a multiple of four bytes
+		};
+
+		static size_t ColumnSize(const Column *);
+		bool Validate(size_t size, bool endianSwap);
+
+		char *fBuffer;
+			// what ReadFrom read
+		Header fHeader;
+		BMallocIO fData;
+			// what WriteTo writes, the header goes in front last
+};
+
+
 inline const char *
 BColumn::Title() const
 {
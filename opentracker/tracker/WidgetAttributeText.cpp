@@ -500,6 +500,13 @@ WidgetAttributeText::AttrAsString(const Model *model, BString *result,
 }
 
 
+uint32
+WidgetAttributeText::SortKey(int64 *, const char **)
+{
+	return kNoSortKey;
+}
+
+
 bool 
 WidgetAttributeText::IsEditable() const
 {
@@ -519,7 +526,8 @@ WidgetAttributeText::SetDirty(bool value)
 
 StringAttributeText::StringAttributeText(const Model *model, const BColumn *column)
 	:	WidgetAttributeText(model, column),
-	fValueDirty(true)
+	fValueDirty(true),
+	fCollationKeyDirty(true)
 {
 }
 
@@ -534,6 +542,18 @@ StringAttributeText::Value()
 }
 
 
+const char *
+StringAttributeText::CollationKey()
+{
+	if (fValueDirty || fCollationKeyDirty) {
+		GetCollationKey(Value(), &fCollationKey);
+		fCollationKeyDirty = false;
+	}
+
+	return fCollationKey.String();
+}
+
+
 bool
 StringAttributeText::CheckAttributeChanged()
 {
@@ -545,6 +565,7 @@ StringAttributeText::CheckAttributeChanged()
 	
 	fFullValueText = newString;
 	fDirty = true;		// have to redo fitted string
+	fCollationKeyDirty = true;
 	return true;
 }
 
@@ -576,10 +597,15 @@ StringAttributeText::Compare(WidgetAttributeText &attr, BPoseView *)
 		dynamic_cast<StringAttributeText *>(&attr);
 	ASSERT(compareTo);
 
-	if (fValueDirty)
-		ReadValue(&fFullValueText);
+	return strcmp(CollationKey(), compareTo->CollationKey());
+}
 
-	return strcasecmp(fFullValueText.String(), compareTo->Value());
+
+uint32
+StringAttributeText::SortKey(int64 *, const char **string)
+{
+	*string = CollationKey();
+	return kStringSortKey;
 }
 
 
@@ -605,6 +631,7 @@ StringAttributeText::CommitEditedText(BTextView *textView)
 
 	// update text and width in this widget
 	fFullValueText = text;
+	fCollationKeyDirty = true;
 
 	return true;
 }
@@ -663,7 +690,19 @@ ScalarAttributeText::Compare(WidgetAttributeText &attr, BPoseView *)
 	if (fValueDirty)
 		fValue = ReadValue();
 
-	return fValue > compareTo->Value() ? (fValue == compareTo->Value() ? 0 : -1) : 1 ;
+	int64 value = compareTo->Value();
+	if (fValue == value)
+		return 0;
+
+	return fValue > value ? -1 : 1;
+}
+
+
+uint32
+ScalarAttributeText::SortKey(int64 *scalar, const char **)
+{
+	*scalar = Value();
+	return kScalarSortKey;
 }
 
 
@@ -752,6 +791,20 @@ NameAttributeText::NameAttributeText(const Model *model, const BColumn *column)
 }
 
 
+static int32
+FolderNamesFirstRank(const Model *model)
+{
+	// ranks the same way Model::CompareFolderNamesFirst does
+	const Model *resolved = model->ResolveIfLink();
+	if (resolved->IsVolume())
+		return 0;
+	if (resolved->IsDirectory())
+		return 1;
+
+	return 2;
+}
+
+
 int
 NameAttributeText::Compare(WidgetAttributeText &attr, BPoseView *)
 {
@@ -759,13 +812,26 @@ NameAttributeText::Compare(WidgetAttributeText &attr, BPoseView *)
 
 	ASSERT(compareTo);
 
-	if (fValueDirty)
-		ReadValue(&fFullValueText);
+	if (NameAttributeText::sSortFolderNamesFirst) {
+		int32 rank = FolderNamesFirstRank(fModel);
+		int32 compareToRank = FolderNamesFirstRank(attr.TargetModel());
+		if (rank != compareToRank)
+			return rank < compareToRank ? -1 : 1;
+	}
 
-	if (NameAttributeText::sSortFolderNamesFirst) 
-		return fModel->CompareFolderNamesFirst(attr.TargetModel());
+	return strcmp(CollationKey(), compareTo->CollationKey());
+}
+
+
+uint32
+NameAttributeText::SortKey(int64 *scalar, const char **string)
+{
+	if (!NameAttributeText::sSortFolderNamesFirst)
+		return StringAttributeText::SortKey(scalar, string);
 
-	return strcasecmp(fFullValueText.String(), compareTo->Value());
+	*scalar = FolderNamesFirstRank(fModel);
+	*string = CollationKey();
+	return kRankedStringSortKey;
 }
 
 
@@ -49,6 +49,19 @@ class BColumn;
 // (Used in InfoWindow.cpp)
 const uint32 kSizeType = 'kszt';
 
+// kinds of sort keys returned by WidgetAttributeText::SortKey
+enum {
+	kNoSortKey,
+		// no compact key, attribute texts need to be compared with Compare
+	kScalarSortKey,
+		// sorts by the scalar, largest value first
+	kStringSortKey,
+		// sorts by the string, which is a collation key (see
+		// GetCollationKey) and can be compared with strcmp
+	kRankedStringSortKey
+		// sorts by the scalar, smallest value first, then by the string
+};
+
 class WidgetAttributeText {
 	// each of subclasses knows how to retrieve a specific attribute
 	// from a model that is passed in and knows how to display the
@@ -73,6 +86,12 @@ class WidgetAttributeText {
 			// override to define a compare of two different attributes for
 			// sorting
 
+		virtual uint32 SortKey(int64 *scalar, const char **string);
+			// returns a compact form of the value that sorts the same way
+			// Compare does; the string stays valid until the value changes
+			// returns kNoSortKey if there is none, in which case Compare
+			// has to be used
+
 		static WidgetAttributeText *NewWidgetText(const Model *, const BColumn *,
 			const BPoseView *);
 			// WidgetAttributeText factory
@@ -143,6 +162,9 @@ class StringAttributeText : public WidgetAttributeText {
 		const char *Value();
 			// returns the untrucated text that corresponds to the attribute
 			// value
+		const char *CollationKey();
+			// returns the collation key of the value; it is computed once
+			// and kept until the value changes
 		virtual bool CheckAttributeChanged();
 
 		virtual float PreferredWidth(const BPoseView *) const;
@@ -156,9 +178,12 @@ class StringAttributeText : public WidgetAttributeText {
 		virtual void ReadValue(BString *result) = 0;
 
 		virtual int Compare(WidgetAttributeText &, BPoseView *view);
+		virtual uint32 SortKey(int64 *scalar, const char **string);
 		BString fFullValueText;
 		bool fValueDirty;
 			// used for lazy read, managed by ReadValue
+		BString fCollationKey;
+		bool fCollationKeyDirty;
 };
 
 
@@ -175,6 +200,7 @@ class ScalarAttributeText : public WidgetAttributeText {
 	protected:
 		virtual int64 ReadValue() = 0;
 		virtual int Compare(WidgetAttributeText &, BPoseView *view);
+		virtual uint32 SortKey(int64 *scalar, const char **string);
 		int64 fValue;
 		bool fValueDirty;
 			// used for lazy read, managed by ReadValue
@@ -271,6 +297,7 @@ class NameAttributeText : public StringAttributeText {
 	protected:
 		virtual bool CommitEditedTextFlavor(BTextView *);
 		virtual int Compare(WidgetAttributeText &, BPoseView *view);
+		virtual uint32 SortKey(int64 *scalar, const char **string);
 		virtual void ReadValue(BString *result);
 
 		static bool sSortFolderNamesFirst;